@@ -0,0 +1,520 @@
+// ObjectStore.cxx - local content-addressed cache of downloaded files
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include "ObjectStore.hxx"
+
+#include <cstdio>
+#include <cctype>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#  include <sys/utime.h>
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <utime.h>
+#endif
+
+#if defined(__linux__)
+#  include <sys/ioctl.h>
+#  include <linux/fs.h>
+#endif
+
+#include <boost/foreach.hpp>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/strutils.hxx>
+#include <simgear/package/md5.h>
+#include <simgear/threads/SGGuard.hxx>
+
+namespace simgear
+{
+
+namespace {
+
+    const size_t MD5_HEX_LENGTH = 32;
+
+    // trim() evicts down to this share of the maximum size, so that the
+    // store isn't scanned again by every insertion once it is full
+    const unsigned int TRIM_PERCENT = 90;
+
+    // temporary files older than this are left over from writers which
+    // died, and are removed by trim()
+    const time_t STALE_TEMPORARY_SECONDS = 24 * 60 * 60;
+
+    struct ObjectInfo
+    {
+        SGPath path;
+        time_t lastUse;
+        size_t size;
+
+        bool operator<(const ObjectInfo& other) const
+            { return lastUse < other.lastUse; }
+    };
+
+    // every writer gets a temporary name of its own, so that concurrent
+    // insertions of the same object (by other threads or processes sharing
+    // the store) never write to the same file
+    SGPath temporaryPath(const SGPath& obj)
+    {
+        std::ostringstream name;
+        name << obj.str() << "." << getpid()
+             << "." << SGThread::current() << ".new";
+        return SGPath(name.str());
+    }
+
+    bool fileSize(const SGPath& p, size_t& size)
+    {
+        struct stat buf;
+        if (stat(p.c_str(), &buf) != 0) {
+            return false;
+        }
+
+        size = buf.st_size;
+        return true;
+    }
+
+    std::string digestHex(SG_MD5_CTX& ctx)
+    {
+        unsigned char digest[MD5_DIGEST_LENGTH];
+        SG_MD5Final(digest, &ctx);
+        return strutils::encodeHex(digest, MD5_DIGEST_LENGTH);
+    }
+
+    std::string dataMD5(const std::string& data)
+    {
+        SG_MD5_CTX ctx;
+        SG_MD5Init(&ctx);
+        SG_MD5Update(&ctx, (const unsigned char*) data.data(), data.size());
+        return digestHex(ctx);
+    }
+
+    bool fileMD5(const SGPath& p, std::string& md5Hex)
+    {
+        std::ifstream in(p.c_str(), std::ios::in | std::ios::binary);
+        if (!in.is_open()) {
+            return false;
+        }
+
+        SG_MD5_CTX ctx;
+        SG_MD5Init(&ctx);
+        std::vector<char> buf(64 * 1024);
+        while (in) {
+            in.read(&buf[0], buf.size());
+            SG_MD5Update(&ctx, (const unsigned char*) &buf[0], in.gcount());
+        }
+
+        md5Hex = digestHex(ctx);
+        return !in.bad();
+    }
+
+    bool reflink(const SGPath& src, const SGPath& dest)
+    {
+#if defined(__linux__) && defined(FICLONE)
+        int in = ::open(src.c_str(), O_RDONLY);
+        if (in < 0) {
+            return false;
+        }
+
+        int out = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) {
+            ::close(in);
+            return false;
+        }
+
+        bool ok = (ioctl(out, FICLONE, in) == 0);
+        ::close(in);
+        ::close(out);
+        if (!ok) {
+            ::unlink(dest.c_str());
+        }
+        return ok;
+#else
+        return false;
+#endif
+    }
+
+    bool copyFile(const SGPath& src, const SGPath& dest)
+    {
+        std::ifstream in(src.c_str(), std::ios::in | std::ios::binary);
+        if (!in.is_open()) {
+            return false;
+        }
+
+        std::ofstream out(dest.c_str(),
+                          std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        out << in.rdbuf();
+        out.close();
+        return !out.fail();
+    }
+
+    /**
+     * copy src to dest, as a copy-on-write clone where the file system
+     * allows for it. Never a hard link: objects and the files they are
+     * copied to or from must not share their contents, or rewriting one
+     * in place would change the other. dest must not exist.
+     */
+    bool cloneFile(const SGPath& src, const SGPath& dest)
+    {
+        return reflink(src, dest) || copyFile(src, dest);
+    }
+
+} // of anonymous namespace
+
+ObjectStore::ObjectStore(const SGPath& root) :
+    _root(root),
+    _maxSize(0),
+    _size(0),
+    _hits(0),
+    _misses(0)
+{
+    Dir d(_root);
+    if (!d.exists()) {
+        d.create(0755);
+    }
+
+    scanSize();
+}
+
+ObjectStore::~ObjectStore()
+{
+}
+
+void ObjectStore::setMaxSize(size_t bytes)
+{
+    {
+        SGGuard<SGMutex> g(_lock);
+        _maxSize = bytes;
+    }
+    trim();
+}
+
+size_t ObjectStore::maxSize() const
+{
+    SGGuard<SGMutex> g(_lock);
+    return _maxSize;
+}
+
+size_t ObjectStore::size() const
+{
+    SGGuard<SGMutex> g(_lock);
+    return _size;
+}
+
+bool ObjectStore::isValidKey(const std::string& md5Hex) const
+{
+    if (md5Hex.size() != MD5_HEX_LENGTH) {
+        return false;
+    }
+
+    for (unsigned int i=0; i<md5Hex.size(); ++i) {
+        if (!isxdigit(md5Hex[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+SGPath ObjectStore::pathForObject(const std::string& md5Hex) const
+{
+    // digests are case-insensitive, the names of objects are not
+    std::string key = strutils::lowercase(md5Hex);
+    SGPath p(_root);
+    p.append(key.substr(0, 2));
+    p.append(key);
+    return p;
+}
+
+bool ObjectStore::contains(const std::string& md5Hex) const
+{
+    if (!isValidKey(md5Hex)) {
+        return false;
+    }
+
+    return pathForObject(md5Hex).exists();
+}
+
+void ObjectStore::touch(const SGPath& path)
+{
+    // the modification time doubles as the LRU timestamp; access times
+    // are unreliable since most volumes are mounted noatime / relatime
+    utime(path.c_str(), NULL);
+}
+
+bool ObjectStore::verify(const std::string& md5Hex, const std::string& actual,
+                         const SGPath& obj)
+{
+    if (strutils::lowercase(md5Hex) == actual) {
+        return true;
+    }
+
+    SG_LOG(SG_IO, SG_WARN, "ObjectStore: dropping corrupt object " << obj);
+    size_t len = 0;
+    bool known = fileSize(obj, len);
+    if (SGPath(obj).remove() && known) {
+        SGGuard<SGMutex> g(_lock);
+        _size -= std::min(len, _size);
+    }
+    return false;
+}
+
+bool ObjectStore::materialize(const std::string& md5Hex, const SGPath& dest)
+{
+    SGPath obj = pathForObject(md5Hex);
+    std::string actual;
+    if (!isValidKey(md5Hex) || !fileMD5(obj, actual)
+        || !verify(md5Hex, actual, obj))
+    {
+        SGGuard<SGMutex> g(_lock);
+        ++_misses;
+        return false;
+    }
+
+    Dir parent(dest.dir());
+    if (!parent.exists()) {
+        parent.create(0755);
+    }
+
+    SGPath destPath(dest);
+    if (destPath.exists()) {
+        destPath.remove();
+    }
+
+    if (!cloneFile(obj, destPath)) {
+        SG_LOG(SG_IO, SG_WARN, "ObjectStore: failed to materialize "
+               << md5Hex << " at " << dest);
+        SGGuard<SGMutex> g(_lock);
+        ++_misses;
+        return false;
+    }
+
+    touch(obj);
+    SGGuard<SGMutex> g(_lock);
+    ++_hits;
+    return true;
+}
+
+bool ObjectStore::read(const std::string& md5Hex, std::string& data)
+{
+    SGPath obj = pathForObject(md5Hex);
+    std::ifstream in;
+    if (isValidKey(md5Hex)) {
+        in.open(obj.c_str(), std::ios::in | std::ios::binary);
+    }
+
+    if (!in.is_open()) {
+        SGGuard<SGMutex> g(_lock);
+        ++_misses;
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+    in.close();
+    if (!verify(md5Hex, dataMD5(data), obj)) {
+        data.clear();
+        SGGuard<SGMutex> g(_lock);
+        ++_misses;
+        return false;
+    }
+
+    touch(obj);
+    SGGuard<SGMutex> g(_lock);
+    ++_hits;
+    return true;
+}
+
+bool ObjectStore::commitTemporary(const SGPath& tmp, const SGPath& dest,
+                                  size_t len)
+{
+    SGPath t(tmp);
+    if (dest.exists()) {
+        // raced with another writer, which is harmless: same content
+        t.remove();
+        touch(dest);
+        return true;
+    }
+
+    if (!t.rename(dest)) {
+        t.remove();
+        return false;
+    }
+
+    {
+        SGGuard<SGMutex> g(_lock);
+        _size += len;
+    }
+
+    trim();
+    return true;
+}
+
+bool ObjectStore::insertFile(const std::string& md5Hex, const SGPath& src)
+{
+    if (!isValidKey(md5Hex)) {
+        return false;
+    }
+
+    SGPath obj = pathForObject(md5Hex);
+    if (obj.exists()) {
+        touch(obj);
+        return true;
+    }
+
+    size_t len = 0;
+    if (!fileSize(src, len)) {
+        return false;
+    }
+
+    Dir parent(obj.dir());
+    if (!parent.exists()) {
+        parent.create(0755);
+    }
+
+    // clone to a temporary name first, so readers never see partial objects
+    SGPath tmp = temporaryPath(obj);
+
+    if (!cloneFile(src, tmp)) {
+        SG_LOG(SG_IO, SG_WARN, "ObjectStore: failed to insert " << src);
+        return false;
+    }
+
+    return commitTemporary(tmp, obj, len);
+}
+
+bool ObjectStore::insertData(const std::string& md5Hex, const char* data,
+                             size_t len)
+{
+    if (!isValidKey(md5Hex)) {
+        return false;
+    }
+
+    SGPath obj = pathForObject(md5Hex);
+    if (obj.exists()) {
+        touch(obj);
+        return true;
+    }
+
+    Dir parent(obj.dir());
+    if (!parent.exists()) {
+        parent.create(0755);
+    }
+
+    SGPath tmp = temporaryPath(obj);
+    std::ofstream f(tmp.c_str(),
+                    std::ios::out | std::ios::trunc | std::ios::binary);
+    f.write(data, len);
+    f.close();
+    if (f.fail()) {
+        SG_LOG(SG_IO, SG_WARN, "ObjectStore: failed to write " << tmp);
+        tmp.remove();
+        return false;
+    }
+
+    return commitTemporary(tmp, obj, len);
+}
+
+void ObjectStore::scanSize()
+{
+    size_t total = 0;
+    Dir d(_root);
+    BOOST_FOREACH(SGPath bucket, d.children(Dir::TYPE_DIR | Dir::NO_DOT_OR_DOTDOT)) {
+        BOOST_FOREACH(SGPath obj, Dir(bucket).children(Dir::TYPE_FILE)) {
+            size_t len = 0;
+            if (fileSize(obj, len)) {
+                total += len;
+            }
+        }
+    }
+
+    SGGuard<SGMutex> g(_lock);
+    _size = total;
+}
+
+void ObjectStore::trim()
+{
+    size_t maxSize;
+    {
+        SGGuard<SGMutex> g(_lock);
+        if ((_maxSize == 0) || (_size <= _maxSize)) {
+            return;
+        }
+        maxSize = _maxSize;
+    }
+
+    // other processes may share the store, so re-scan rather than trusting
+    // our own running total
+    std::vector<ObjectInfo> objects;
+    size_t total = 0;
+    Dir d(_root);
+    BOOST_FOREACH(SGPath bucket, d.children(Dir::TYPE_DIR | Dir::NO_DOT_OR_DOTDOT)) {
+        BOOST_FOREACH(SGPath obj, Dir(bucket).children(Dir::TYPE_FILE)) {
+            if (obj.extension() == "new") {
+                // in-flight insertion, unless it is old
+                if (obj.modTime() + STALE_TEMPORARY_SECONDS < time(NULL)) {
+                    obj.remove();
+                }
+                continue;
+            }
+
+            ObjectInfo info;
+            info.path = obj;
+            info.lastUse = obj.modTime();
+            if (!fileSize(obj, info.size)) {
+                continue;
+            }
+
+            total += info.size;
+            objects.push_back(info);
+        }
+    }
+
+    std::sort(objects.begin(), objects.end());
+    std::vector<ObjectInfo>::iterator it = objects.begin();
+    unsigned int evicted = 0;
+    size_t lowWater = maxSize / 100 * TRIM_PERCENT;
+    for (; (total > lowWater) && (it != objects.end()); ++it) {
+        if (it->path.remove()) {
+            total -= it->size;
+            ++evicted;
+        }
+    }
+
+    SG_LOG(SG_IO, SG_DEBUG, "ObjectStore: evicted " << evicted << " objects from " << _root);
+    SGGuard<SGMutex> g(_lock);
+    _size = total;
+}
+
+} // of namespace simgear
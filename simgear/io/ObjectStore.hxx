@@ -0,0 +1,130 @@
+// ObjectStore.hxx - local content-addressed cache of downloaded files
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef SG_IO_OBJECTSTORE_HXX
+#define SG_IO_OBJECTSTORE_HXX
+
+#include <string>
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+#include <simgear/threads/SGThread.hxx>
+
+namespace simgear
+{
+
+/**
+ * Content-addressed store of files, keyed by the hex MD5 digest which
+ * DAV / SVN servers and package catalogs already transmit. Objects live
+ * under <root>/<first two hex digits>/<digest>, so several processes (or
+ * several machines sharing a cache volume) can use the same store without
+ * any additional index.
+ *
+ * Package installs look archives up before downloading them. SVN update
+ * reports carry file contents inline, so working copies only add files to
+ * the store, and restore missing base files from it.
+ *
+ * Objects are copied in and out as reflinks (copy-on-write clones) where
+ * the file system supports them, and plain copies otherwise, so they never
+ * share their contents with a file which might be rewritten in place.
+ * Their digest is checked whenever they are used; corrupt objects are
+ * removed and reported as missing.
+ *
+ * The total size is capped; once exceeded, least-recently used objects
+ * (by modification time, which is refreshed on every hit) are evicted
+ * until the store is back below 90% of the cap.
+ */
+class ObjectStore : public SGReferenced
+{
+public:
+    ObjectStore(const SGPath& root);
+    ~ObjectStore();
+
+    SGPath root() const
+        { return _root; }
+
+    /**
+     * maximum size of the store in bytes; zero means unlimited.
+     */
+    void setMaxSize(size_t bytes);
+    size_t maxSize() const;
+
+    /**
+     * current (approximate) size of the store in bytes
+     */
+    size_t size() const;
+
+    bool contains(const std::string& md5Hex) const;
+
+    /**
+     * create the object with digest md5Hex at dest, replacing any existing
+     * file. Returns false if the object is not in the store (or corrupt),
+     * or the destination could not be written.
+     */
+    bool materialize(const std::string& md5Hex, const SGPath& dest);
+
+    /**
+     * read the object into memory. Returns false if the object is not in
+     * the store, or corrupt.
+     */
+    bool read(const std::string& md5Hex, std::string& data);
+
+    /**
+     * add a copy of an existing file to the store. The caller is
+     * responsible for having verified the digest.
+     */
+    bool insertFile(const std::string& md5Hex, const SGPath& src);
+
+    /**
+     * add an in-memory buffer to the store. The caller is responsible
+     * for having verified the digest.
+     */
+    bool insertData(const std::string& md5Hex, const char* data, size_t len);
+
+    /**
+     * once the store exceeds its maximum size, evict least-recently used
+     * objects until it is below 90% of it. Called automatically after
+     * insertions.
+     */
+    void trim();
+
+    unsigned int hits() const
+        { return _hits; }
+    unsigned int misses() const
+        { return _misses; }
+private:
+    SGPath pathForObject(const std::string& md5Hex) const;
+    bool isValidKey(const std::string& md5Hex) const;
+    bool verify(const std::string& md5Hex, const std::string& actual,
+                const SGPath& obj);
+    void touch(const SGPath& path);
+    void scanSize();
+    bool commitTemporary(const SGPath& tmp, const SGPath& dest, size_t len);
+
+    SGPath _root;
+    size_t _maxSize;
+    size_t _size;
+    unsigned int _hits;
+    unsigned int _misses;
+    mutable SGMutex _lock;
+};
+
+typedef SGSharedPtr<ObjectStore> ObjectStoreRef;
+
+} // of namespace simgear
+
+#endif // of SG_IO_OBJECTSTORE_HXX
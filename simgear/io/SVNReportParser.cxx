@@ -47,6 +47,7 @@
 #include "SVNDirectory.hxx"
 #include "SVNRepository.hxx"
 #include "DAVMultiStatus.hxx"
+#include "ObjectStore.hxx"
 
 using std::cout;
 using std::cerr;
@@ -98,6 +99,53 @@ namespace {
       return false;
     }
     
+  /**
+   * incremental base64 decoder: input may be split at any point,
+   * whitespace and padding are skipped.
+   */
+  class Base64Decoder
+  {
+  public:
+      Base64Decoder() :
+          _bits(0),
+          _bitCount(0)
+      {
+          memset(_table, 0xff, sizeof(_table));
+          const char* alphabet =
+              "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+          for (int i=0; i<64; ++i) {
+              _table[(unsigned char) alphabet[i]] = i;
+          }
+      }
+
+      void reset()
+      {
+          _bits = 0;
+          _bitCount = 0;
+      }
+
+      void decode(const char* s, int length, std::vector<unsigned char>& output)
+      {
+          for (int i=0; i<length; ++i) {
+              unsigned char v = _table[(unsigned char) s[i]];
+              if (v == 0xff) {
+                  continue; // whitespace, padding
+              }
+
+              _bits = (_bits << 6) | v;
+              _bitCount += 6;
+              if (_bitCount >= 8) {
+                  _bitCount -= 8;
+                  output.push_back((_bits >> _bitCount) & 0xff);
+              }
+          }
+      }
+  private:
+      unsigned char _table[256];
+      unsigned int _bits;
+      unsigned int _bitCount;
+  };
+
 //  const char* SVN_UPDATE_REPORT_TAG = SVN_NS "update-report";
  // const char* SVN_TARGET_REVISION_TAG = SVN_NS "target-revision";
   const char* SVN_OPEN_DIRECTORY_TAG = SVN_NS "open-directory";
@@ -166,8 +214,15 @@ namespace {
          _ptr = p;
      }
   
+    /**
+     * apply the window, replacing output with the target view. Source
+     * copies are relative to the source view, target copies relative to
+     * the start of this window's target view.
+     */
     bool apply(std::vector<unsigned char>& output, std::istream& source)
     {
+        output.clear();
+        output.reserve(targetViewLength);
         unsigned char* pEnd = _ptr + instructionLength;
         unsigned char* newData = pEnd;
         
@@ -196,6 +251,11 @@ namespace {
           }
 
           if (op == svn_txdelta_target) {
+              if ((size_t) offset >= output.size()) {
+                  SG_LOG(SG_IO, SG_INFO, "SVNDeltaWindow: bad target offset");
+                  return false;
+              }
+
               // this is inefficent, but ranges can overlap.
               while (length > 0) {
                   output.push_back(output[offset++]);
@@ -205,12 +265,15 @@ namespace {
               output.insert(output.end(), newData, newData + length);
               newData += length;
           } else if (op == svn_txdelta_source) {
-            source.seekg(offset);
-            char* sourceBuf = (char*) malloc(length);
-            assert(sourceBuf);
-            source.read(sourceBuf, length);
-            output.insert(output.end(), sourceBuf, sourceBuf + length);
-            free(sourceBuf);
+            source.clear();
+            source.seekg(sourceViewOffset + offset);
+            size_t pos = output.size();
+            output.resize(pos + length);
+            source.read((char*) output.data() + pos, length);
+            if (source.gcount() != length) {
+                SG_LOG(SG_IO, SG_INFO, "SVNDeltaWindow: short source read");
+                return false;
+            }
           } else {
               SG_LOG(SG_IO, SG_WARN, "bad opcode logic");
               return false;
@@ -249,11 +312,13 @@ public:
     currentPath(repo->fsBase())
   {
     inFile = false;
+    fileMissing = false;
     currentDir = repo->rootDir();
   }
 
   ~SVNReportParserPrivate()
   {
+      abortTextDelta();
   }
   
   void startElement (const char * name, const char** attributes)
@@ -265,7 +330,13 @@ public:
     ExpatAtts attrs(attributes);
     tagStack.push_back(name);
     if (!strcmp(name, SVN_TXDELTA_TAG)) {
-        txDeltaData.clear();
+        if (fileMissing && attrs.getValue("base-checksum")) {
+            restoreFromStore(attrs.getValue("base-checksum"));
+        }
+
+        if (!fileMissing) {
+            beginTextDelta(currentPath);
+        }
     } else if (!strcmp(name, SVN_ADD_FILE_TAG)) {
       string fileName(attrs.getValue("name"));
       SGPath filePath(currentDir->fsDir().file(fileName));
@@ -277,8 +348,14 @@ public:
       currentPath = filePath;
        
       if (!filePath.exists()) {
-          fail(SVNRepository::SVN_ERROR_FILE_NOT_FOUND);
-          return;
+          if (!tree->objectStore()) {
+              fail(SVNRepository::SVN_ERROR_FILE_NOT_FOUND);
+              return;
+          }
+
+          // we may be able to restore the base text from the object store,
+          // once we see the base checksum on the txdelta
+          fileMissing = true;
       }
 
       inFile = true;
@@ -332,58 +409,134 @@ public:
       currentDir->beginUpdateReport();
   }
   
+  void restoreFromStore(const std::string& baseChecksum)
+  {
+      if (tree->objectStore()->materialize(baseChecksum, currentPath)) {
+          fileMissing = false;
+      }
+  }
+
   void deleteEntry(const std::string& entryName)
   {
       currentDir->deleteChildByName(entryName);
   }
   
-  bool decodeTextDelta(const SGPath& outputPath)
+  /**
+   * txdelta payloads can be very large (an initial sync is one huge
+   * report), so decode base64, apply svndiff windows and write the result
+   * as each chunk of character data arrives, instead of buffering the
+   * whole element. The result is written to a temporary file next to the
+   * target, since source copies read from the previous version.
+   */
+  void beginTextDelta(const SGPath& outputPath)
   {
-      std::vector<unsigned char> output, decoded;
-    strutils::decodeBase64(txDeltaData, decoded);
-    size_t bytesToDecode = decoded.size();
-         
-    unsigned char* p = decoded.data();
-    if (memcmp(p, "SVN\0", DELTA_HEADER_SIZE) != 0) {
-        return false; // bad header
-    }
-    
-    bytesToDecode -= DELTA_HEADER_SIZE;
-    p += DELTA_HEADER_SIZE;
-    std::ifstream source;
-    source.open(outputPath.c_str(), std::ios::in | std::ios::binary);
-    
-    while (bytesToDecode > 0) {  
-        if (!SVNDeltaWindow::isWindowComplete(p, bytesToDecode)) {
-            SG_LOG(SG_IO, SG_WARN, "SVN txdelta broken window");
-            return false;
-        }
-	
-        SVNDeltaWindow window(p);      
-        assert(bytesToDecode >= window.size());
-        window.apply(output, source);
-        bytesToDecode -= window.size();
-        p += window.size();
-    }
+      base64.reset();
+      deltaBuffer.clear();
+      deltaOffset = 0;
+      deltaHeaderSeen = false;
+
+      deltaSource.clear();
+      deltaSource.open(outputPath.c_str(), std::ios::in | std::ios::binary);
+
+      deltaTempPath = outputPath;
+      deltaTempPath.concat(".svn-new");
+      deltaOutput.clear();
+      deltaOutput.open(deltaTempPath.c_str(),
+        std::ios::out | std::ios::trunc | std::ios::binary);
+
+      memset(&md5Context, 0, sizeof(SG_MD5_CTX));
+      SG_MD5Init(&md5Context);
+  }
+
+  bool processTextDelta(const char* s, int length)
+  {
+      base64.decode(s, length, deltaBuffer);
 
-    source.close();
+      if (!deltaHeaderSeen) {
+          if (deltaBuffer.size() < DELTA_HEADER_SIZE) {
+              return true; // wait for more data
+          }
 
-    std::ofstream f;
-    f.open(outputPath.c_str(), 
-      std::ios::out | std::ios::trunc | std::ios::binary);
-    f.write((char*) output.data(), output.size());
+          if (memcmp(deltaBuffer.data(), "SVN\0", DELTA_HEADER_SIZE) != 0) {
+              return false; // bad header
+          }
 
-    // compute MD5 while we have the file in memory
-    memset(&md5Context, 0, sizeof(SG_MD5_CTX));
-    SG_MD5Init(&md5Context);
-    SG_MD5Update(&md5Context, (unsigned char*) output.data(), output.size());
-    unsigned char digest[MD5_DIGEST_LENGTH];
-    SG_MD5Final(digest, &md5Context);
-    decodedFileMd5 = strutils::encodeHex(digest, MD5_DIGEST_LENGTH);
+          deltaHeaderSeen = true;
+          deltaOffset = DELTA_HEADER_SIZE;
+      }
+
+      while (deltaOffset < deltaBuffer.size()) {
+          unsigned char* p = deltaBuffer.data() + deltaOffset;
+          size_t bytesAvailable = deltaBuffer.size() - deltaOffset;
+          if (!SVNDeltaWindow::isWindowComplete(p, bytesAvailable)) {
+              break; // wait for more data
+          }
+
+          SVNDeltaWindow window(p);
+          if (!window.apply(windowOutput, deltaSource)) {
+              return false;
+          }
 
-    return true;
+          deltaOutput.write((char*) windowOutput.data(), windowOutput.size());
+          SG_MD5Update(&md5Context, windowOutput.data(), windowOutput.size());
+          deltaOffset += window.size();
+      }
+
+      // discard consumed windows, keeping any partial one
+      deltaBuffer.erase(deltaBuffer.begin(), deltaBuffer.begin() + deltaOffset);
+      deltaOffset = 0;
+      return !deltaOutput.fail();
   }
-  
+
+  bool finishTextDelta(const SGPath& outputPath)
+  {
+      deltaSource.close();
+      deltaOutput.close();
+
+      bool ok = deltaHeaderSeen && deltaBuffer.empty() && !deltaOutput.fail();
+      if (deltaHeaderSeen && !deltaBuffer.empty()) {
+          SG_LOG(SG_IO, SG_WARN, "SVN txdelta broken window");
+      }
+
+      std::vector<unsigned char>().swap(deltaBuffer);
+      std::vector<unsigned char>().swap(windowOutput);
+      if (!ok) {
+          deltaTempPath.remove();
+          return false;
+      }
+
+      // replace the old version only once the new one is complete
+      SGPath existing(outputPath);
+      if (existing.exists()) {
+          existing.remove();
+      }
+
+      if (!deltaTempPath.rename(outputPath)) {
+          return false;
+      }
+
+      unsigned char digest[MD5_DIGEST_LENGTH];
+      SG_MD5Final(digest, &md5Context);
+      decodedFileMd5 = strutils::encodeHex(digest, MD5_DIGEST_LENGTH);
+      return true;
+  }
+
+  /**
+   * Close the streams of a text delta which won't be finished, and remove
+   * its partial output.
+   */
+  void abortTextDelta()
+  {
+      if (deltaSource.is_open()) {
+          deltaSource.close();
+      }
+
+      if (deltaOutput.is_open()) {
+          deltaOutput.close();
+          deltaTempPath.remove();
+      }
+  }
+
   void endElement (const char * name)
   {
       if (status != SVNRepository::SVN_NO_ERROR) {
@@ -394,7 +547,9 @@ public:
     tagStack.pop_back();
         
     if (!strcmp(name, SVN_TXDELTA_TAG)) {
-      if (!decodeTextDelta(currentPath)) {
+      if (fileMissing) {
+        fail(SVNRepository::SVN_ERROR_FILE_NOT_FOUND);
+      } else if (!finishTextDelta(currentPath)) {
         fail(SVNRepository::SVN_ERROR_TXDELTA);
       }
     } else if (!strcmp(name, SVN_ADD_FILE_TAG)) {
@@ -421,6 +576,8 @@ public:
       // validate against (presumably) just written file
       if (decodedFileMd5 != md5Sum) {
         fail(SVNRepository::SVN_ERROR_CHECKSUM);
+      } else if (tree->objectStore()) {
+        tree->objectStore()->insertFile(md5Sum, currentPath);
       }
     } else if (!strcmp(name, SVN_OPEN_DIRECTORY_TAG)) {
         currentDir->updateReportComplete();
@@ -437,6 +594,10 @@ public:
   
   void finishFile(const SGPath& path)
   {
+      if (fileMissing) {
+          fail(SVNRepository::SVN_ERROR_FILE_NOT_FOUND);
+      }
+
       currentPath = path.dir();
       inFile = false;
   }
@@ -450,7 +611,9 @@ public:
     if (tagStack.back() == SVN_SET_PROP_TAG) {
       setPropValue.append(s, length);
     } else if (tagStack.back() == SVN_TXDELTA_TAG) {
-      txDeltaData.append(s, length);
+      if (!fileMissing && !processTextDelta(s, length)) {
+        fail(SVNRepository::SVN_ERROR_TXDELTA);
+      }
     } else if (tagStack.back() == SVN_DAV_MD5_CHECKSUM) {
       md5Sum.append(s, length);
     }
@@ -471,6 +634,7 @@ public:
   void fail(SVNRepository::ResultCode err)
   {
       status = err;
+      abortTextDelta();
   }
   
   SVNRepository* tree;
@@ -484,13 +648,22 @@ public:
 // in-flight data
   string_list tagStack;
   string currentVersionName;
-  string txDeltaData;
   SGPath currentPath;
   bool inFile;
+  bool fileMissing; ///< open-file on a path absent locally
     
   unsigned int revision;
   SG_MD5_CTX md5Context;
   string md5Sum, decodedFileMd5;
+
+// streaming txdelta state
+  Base64Decoder base64;
+  std::vector<unsigned char> deltaBuffer, windowOutput;
+  size_t deltaOffset;
+  bool deltaHeaderSeen;
+  std::ifstream deltaSource;
+  std::ofstream deltaOutput;
+  SGPath deltaTempPath;
   std::string setPropName, setPropValue;
 };
 
@@ -556,6 +729,7 @@ SVNReportParser::innerParseXML(const char* data, int size)
     
       XML_ParserFree(_d->xmlParser);
       _d->parserInited = false;
+      _d->abortTextDelta();
       return SVNRepository::SVN_ERROR_XML;
     } else if (isEnd) {
         XML_ParserFree(_d->xmlParser);
@@ -37,6 +37,7 @@
 #include <simgear/io/SVNDirectory.hxx>
 #include <simgear/io/sg_file.hxx>
 #include <simgear/io/SVNReportParser.hxx>
+#include <simgear/io/ObjectStore.hxx>
 
 using std::cout;
 using std::cerr;
@@ -63,6 +64,7 @@ public:
     std::string baseUrl;
     std::string vccUrl;
     std::string targetRevision;
+    ObjectStoreRef objectStore;
     bool isUpdating;
     SVNRepository::ResultCode status;
     
@@ -299,6 +301,16 @@ HTTP::Client* SVNRepository::http() const
   return _d->http;
 }
 
+void SVNRepository::setObjectStore(ObjectStore* store)
+{
+  _d->objectStore = store;
+}
+
+ObjectStore* SVNRepository::objectStore() const
+{
+  return _d->objectStore.get();
+}
+
 SGPath SVNRepository::fsBase() const
 {
   return _d->rootCollection->fsPath();
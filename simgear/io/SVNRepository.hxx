@@ -34,6 +34,7 @@ namespace simgear  {
   
 class SVNDirectory;  
 class SVNRepoPrivate;
+class ObjectStore;
 
 class SVNRepository
 {
@@ -50,6 +51,15 @@ public:
 
     HTTP::Client* http() const;
 
+    /**
+     * share a content-addressed store with other repositories (and package
+     * installs). Verified files are added to the store as they are
+     * written, and files missing locally are restored from it instead of
+     * failing the update.
+     */
+    void setObjectStore(ObjectStore* store);
+    ObjectStore* objectStore() const;
+
     void update();
 
     bool isDoingSync() const;
@@ -0,0 +1,274 @@
+// bench_svn_report - measure SVN update-report parsing throughput and memory
+//
+// usage: bench_svn_report [report.xml]
+//        bench_svn_report --synthetic <megabytes>
+//
+// A recorded report (for example captured from a TerraSync initial sync)
+// is parsed into a temporary directory in 64k chunks, as the HTTP client
+// would deliver it. Without a recording, a send-all report of the given
+// size is synthesized first.
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+#ifndef _WIN32
+#  include <sys/resource.h>
+#endif
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/strutils.hxx>
+#include <simgear/package/md5.h>
+#include <simgear/timing/timestamp.hxx>
+
+#include "SVNRepository.hxx"
+#include "SVNReportParser.hxx"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+using namespace simgear;
+
+namespace {
+
+const size_t WINDOW_SIZE = 100 * 1024;
+const size_t FILE_SIZE = 4 * 1024 * 1024;
+const size_t FILES_PER_DIR = 16;
+
+long peakRSSKBytes()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return -1;
+#endif
+}
+
+void encodeSize(std::vector<unsigned char>& out, size_t v)
+{
+    unsigned char buf[10];
+    int n = 0;
+    do {
+        buf[n++] = v & 0x7f;
+        v >>= 7;
+    } while (v);
+
+    while (n > 1) {
+        out.push_back(buf[--n] | 0x80);
+    }
+    out.push_back(buf[0]);
+}
+
+class Base64Writer
+{
+public:
+    Base64Writer(std::ostream& os) :
+        _os(os),
+        _column(0)
+    {
+    }
+
+    void write(const std::vector<unsigned char>& data)
+    {
+        _pending.insert(_pending.end(), data.begin(), data.end());
+        size_t whole = (_pending.size() / 3) * 3;
+        emit(0, whole);
+        _pending.erase(_pending.begin(), _pending.begin() + whole);
+    }
+
+    void finish()
+    {
+        emit(0, _pending.size());
+        _pending.clear();
+        _os << '\n';
+        _column = 0;
+    }
+private:
+    void emit(size_t start, size_t end)
+    {
+        static const char* alphabet =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (size_t i=start; i<end; i += 3) {
+            unsigned int v = _pending[i] << 16;
+            size_t n = std::min<size_t>(3, end - i);
+            if (n > 1) v |= _pending[i+1] << 8;
+            if (n > 2) v |= _pending[i+2];
+
+            char quad[4];
+            quad[0] = alphabet[(v >> 18) & 0x3f];
+            quad[1] = alphabet[(v >> 12) & 0x3f];
+            quad[2] = (n > 1) ? alphabet[(v >> 6) & 0x3f] : '=';
+            quad[3] = (n > 2) ? alphabet[v & 0x3f] : '=';
+            _os.write(quad, 4);
+            _column += 4;
+            if (_column >= 76) {
+                _os << '\n';
+                _column = 0;
+            }
+        }
+    }
+
+    std::ostream& _os;
+    std::vector<unsigned char> _pending;
+    int _column;
+};
+
+void writeSyntheticFile(std::ostream& os, const string& name, unsigned int seed)
+{
+    os << "<S:add-file name=\"" << name << "\">\n"
+       << "<S:set-prop name=\"svn:entry:committed-rev\">1</S:set-prop>\n"
+       << "<S:txdelta>";
+
+    SG_MD5_CTX md5;
+    memset(&md5, 0, sizeof(SG_MD5_CTX));
+    SG_MD5Init(&md5);
+
+    Base64Writer b64(os);
+    std::vector<unsigned char> delta;
+    delta.push_back('S'); delta.push_back('V'); delta.push_back('N'); delta.push_back(0);
+
+    std::vector<unsigned char> content(WINDOW_SIZE);
+    for (size_t done = 0; done < FILE_SIZE; done += WINDOW_SIZE) {
+        size_t len = std::min(WINDOW_SIZE, FILE_SIZE - done);
+        for (size_t i=0; i<len; ++i) {
+            seed = seed * 1103515245 + 12345;
+            content[i] = (seed >> 16) & 0xff;
+        }
+        SG_MD5Update(&md5, content.data(), len);
+
+        // one window: a single 'new data' instruction
+        std::vector<unsigned char> insn;
+        insn.push_back(0x80); // op = new, length follows
+        encodeSize(insn, len);
+
+        encodeSize(delta, 0); // source view offset
+        encodeSize(delta, 0); // source view length
+        encodeSize(delta, len); // target view length
+        encodeSize(delta, insn.size());
+        encodeSize(delta, len);
+        delta.insert(delta.end(), insn.begin(), insn.end());
+        delta.insert(delta.end(), content.begin(), content.begin() + len);
+        b64.write(delta);
+        delta.clear();
+    }
+    b64.finish();
+
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    SG_MD5Final(digest, &md5);
+    os << "</S:txdelta>\n"
+       << "<S:prop><V:md5-checksum>"
+       << strutils::encodeHex(digest, MD5_DIGEST_LENGTH)
+       << "</V:md5-checksum></S:prop>\n"
+       << "</S:add-file>\n";
+}
+
+void writeSyntheticReport(const SGPath& path, unsigned int megabytes)
+{
+    std::ofstream os(path.c_str(), std::ios::out | std::ios::trunc);
+    os << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+       << "<S:update-report xmlns:S=\"svn:\" "
+          "xmlns:V=\"http://subversion.tigris.org/xmlns/dav/\" "
+          "xmlns:D=\"DAV:\" send-all=\"true\">\n"
+       << "<S:target-revision rev=\"1\"/>\n"
+       << "<S:open-directory rev=\"0\">\n";
+
+    unsigned int fileCount = (megabytes * 1024 * 1024) / FILE_SIZE;
+    for (unsigned int f=0; f<fileCount; ++f) {
+        if ((f % FILES_PER_DIR) == 0) {
+            if (f > 0) {
+                os << "</S:add-directory>\n";
+            }
+            os << "<S:add-directory name=\"d" << (f / FILES_PER_DIR) << "\">\n";
+        }
+
+        std::ostringstream name;
+        name << "f" << f << ".bin";
+        writeSyntheticFile(os, name.str(), f);
+    }
+
+    if (fileCount > 0) {
+        os << "</S:add-directory>\n";
+    }
+
+    os << "</S:open-directory>\n</S:update-report>\n";
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    sglog().setLogLevels( SG_ALL, SG_WARN );
+
+    Dir work = Dir::tempDir("sg_svn_bench");
+    work.setRemoveOnDestroy();
+
+    SGPath report;
+    if ((argc > 2) && !strcmp(argv[1], "--synthetic")) {
+        report = work.file("report.xml");
+        writeSyntheticReport(report, atoi(argv[2]));
+    } else if (argc > 1) {
+        report = SGPath(argv[1]);
+    } else {
+        report = work.file("report.xml");
+        writeSyntheticReport(report, 64);
+    }
+
+    std::ifstream in(report.c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        cerr << "unable to open report:" << report << endl;
+        return EXIT_FAILURE;
+    }
+
+    long rssBefore = peakRSSKBytes();
+    SVNRepository repo(work.file("checkout"), NULL);
+    repo.setBaseUrl("http://localhost/bench");
+    SVNReportParser parser(&repo);
+
+    const size_t CHUNK_SIZE = 64 * 1024;
+    std::vector<char> chunk(CHUNK_SIZE);
+    size_t total = 0;
+    SVNRepository::ResultCode rc = SVNRepository::SVN_NO_ERROR;
+
+    SGTimeStamp st;
+    st.stamp();
+    while (in && (rc == SVNRepository::SVN_NO_ERROR)) {
+        in.read(chunk.data(), CHUNK_SIZE);
+        if (in.gcount() > 0) {
+            total += in.gcount();
+            rc = parser.parseXML(chunk.data(), in.gcount());
+        }
+    }
+
+    if (rc == SVNRepository::SVN_NO_ERROR) {
+        rc = parser.finishParse();
+    }
+
+    int elapsedMsec = st.elapsedMSec();
+    if (rc != SVNRepository::SVN_NO_ERROR) {
+        cerr << "report parsing failed with code " << rc << endl;
+        return EXIT_FAILURE;
+    }
+
+    double mbytes = total / (1024.0 * 1024.0);
+    cout << "parsed " << mbytes << " MB in " << elapsedMsec << " msec ("
+         << (mbytes * 1000.0 / std::max(elapsedMsec, 1)) << " MB/sec)" << endl;
+    cout << "peak RSS: " << peakRSSKBytes() << " KB (before parse: "
+         << rssBefore << " KB)" << endl;
+    return EXIT_SUCCESS;
+}
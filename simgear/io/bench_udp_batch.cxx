@@ -0,0 +1,183 @@
+// bench_udp_batch - compare per-datagram and batched UDP receive
+//
+// usage: bench_udp_batch [packets-per-second] [seconds]
+//
+// A sender thread pushes datagrams at a fixed rate (100k/sec by default)
+// over loopback, while the main thread drains them first with one read()
+// per datagram, then with readBatch(). For each mode the number of
+// datagrams received and lost, the receive system calls and the receiver
+// CPU time are reported.
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+
+#ifndef _WIN32
+#  include <sys/resource.h>
+#endif
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include "sg_socket_udp.hxx"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using namespace simgear;
+
+namespace {
+
+const char* PORT = "2012";
+const int PAYLOAD_SIZE = 200;
+const int SEND_BATCH = 50;
+
+double threadCPUSeconds()
+{
+#if defined(RUSAGE_THREAD)
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+#elif !defined(_WIN32)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+#ifndef _WIN32
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#else
+    return 0.0;
+#endif
+}
+
+class SenderThread : public SGThread
+{
+public:
+    SenderThread(int rate, int seconds) :
+        _rate(rate),
+        _seconds(seconds),
+        _sent(0)
+    {
+    }
+
+    virtual ~SenderThread()
+    {
+    }
+
+    unsigned int sent() const
+        { return _sent; }
+
+    virtual void run()
+    {
+        SGSocketUDP client("localhost", PORT);
+        if (!client.open(SG_IO_OUT)) {
+            cerr << "unable to open sender socket" << endl;
+            return;
+        }
+
+        std::vector<char> payload(PAYLOAD_SIZE * SEND_BATCH, 'x');
+        SocketBuffer messages[SEND_BATCH];
+        for (int i=0; i<SEND_BATCH; ++i) {
+            messages[i].data = &payload[i * PAYLOAD_SIZE];
+            messages[i].size = PAYLOAD_SIZE;
+        }
+
+        // send in small bursts, paced against the wall clock
+        SGTimeStamp start = SGTimeStamp::now();
+        unsigned int total = _rate * _seconds;
+        while (_sent < total) {
+            double elapsed = (SGTimeStamp::now() - start).toSecs();
+            unsigned int due = std::min<unsigned int>(total, elapsed * _rate);
+            if (_sent + SEND_BATCH > due) {
+                SGTimeStamp::sleepForMSec(1);
+                continue;
+            }
+
+            _sent += client.writeBatch(messages, SEND_BATCH);
+        }
+
+        client.close();
+    }
+
+private:
+    int _rate;
+    int _seconds;
+    unsigned int _sent;
+};
+
+void runMode(bool batched, int rate, int seconds)
+{
+    SGSocketUDP server("", PORT);
+    if (!server.open(SG_IO_IN)) {
+        cerr << "unable to open receiver socket" << endl;
+        exit(EXIT_FAILURE);
+    }
+    server.setBlocking(false);
+
+    SenderThread* sender = new SenderThread(rate, seconds);
+    sender->start();
+
+    SGIOMessageBatch batch(64, PAYLOAD_SIZE + 1);
+    char buf[SG_IO_MAX_MSG_SIZE];
+    unsigned int received = 0;
+    double cpuStart = threadCPUSeconds();
+
+    // run slightly longer than the sender, to drain the socket buffer
+    SGTimeStamp st = SGTimeStamp::now();
+    while ((SGTimeStamp::now() - st).toSecs() < seconds + 0.5) {
+        int n;
+        if (batched) {
+            n = server.readBatch(batch.messages(), batch.count());
+        } else {
+            n = (server.read(buf, sizeof(buf)) > 0) ? 1 : 0;
+        }
+
+        if (n > 0) {
+            received += n;
+        } else {
+            // idle, as a simulation frame loop would be between polls
+            SGTimeStamp::sleepForMSec(1);
+        }
+    }
+
+    double cpu = threadCPUSeconds() - cpuStart;
+    sender->join();
+
+    unsigned int sent = sender->sent();
+    cout << (batched ? "readBatch:" : "read:     ")
+         << " received " << received << " of " << sent
+         << " (lost " << (sent - std::min(sent, received)) << ")"
+         << ", " << server.get_recv_calls() << " receive calls"
+         << ", " << (cpu * 1000.0) << " msec CPU" << endl;
+
+    delete sender;
+    server.close();
+}
+
+} // of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    sglog().setLogLevels( SG_ALL, SG_ALERT );
+    Socket::initSockets();
+
+    int rate = (argc > 1) ? atoi(argv[1]) : 100000;
+    int seconds = (argc > 2) ? atoi(argv[2]) : 3;
+
+    cout << "sending " << rate << " datagrams/sec of " << PAYLOAD_SIZE
+         << " bytes for " << seconds << " seconds" << endl;
+
+    runMode(false, rate, seconds);
+    runMode(true, rate, seconds);
+    return EXIT_SUCCESS;
+}
@@ -24,6 +24,18 @@
 #include "iochannel.hxx"
 
 
+SGIOMessageBatch::SGIOMessageBatch( int count, int size ) :
+    storage( count * size ),
+    slots( count )
+{
+    for ( int i = 0; i < count; ++i ) {
+	slots[i].buf = &storage[i * size];
+	slots[i].capacity = size;
+	slots[i].length = 0;
+    }
+}
+
+
 // constructor
 SGIOChannel::SGIOChannel()
 {
@@ -54,6 +66,23 @@ int SGIOChannel::readline( char *buf, int length ) {
 }
 
 
+// read a single message; channels which can do better override this
+int SGIOChannel::readBatch( SGIOMessage *messages, int count ) {
+    if ( count <= 0 ) {
+	return 0;
+    }
+
+    int result = read( messages[0].buf, messages[0].capacity );
+    if ( result <= 0 ) {
+	return result;
+    }
+
+    messages[0].length = result;
+    messages[0].timestamp = SGTimeStamp::now();
+    return 1;
+}
+
+
 // dummy process routine
 int SGIOChannel::write( const char *buf, const int length ) {
     return false;
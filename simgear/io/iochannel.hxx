@@ -30,6 +30,10 @@
 
 #include <simgear/compiler.h>
 
+#include <vector>
+
+#include <simgear/timing/timestamp.hxx>
+
 #define SG_IO_MAX_MSG_SIZE 16384
 
 /**
@@ -53,6 +57,34 @@ enum SGChannelType {
 };
 
 
+/**
+ * One message slot for SGIOChannel::readBatch(). The storage is owned by
+ * the caller (normally through SGIOMessageBatch); readBatch() fills in
+ * length and the time the message was received.
+ */
+struct SGIOMessage {
+    char *buf;
+    int capacity;
+    int length;
+    SGTimeStamp timestamp;
+};
+
+/**
+ * Preallocated message slots, reused for every readBatch() call so that
+ * draining a channel does not allocate.
+ */
+class SGIOMessageBatch {
+    std::vector<char> storage;
+    std::vector<SGIOMessage> slots;
+
+public:
+    SGIOMessageBatch( int count, int size = SG_IO_MAX_MSG_SIZE );
+
+    inline SGIOMessage *messages() { return &slots[0]; }
+    inline int count() const { return (int) slots.size(); }
+    inline SGIOMessage& operator[]( int i ) { return slots[i]; }
+};
+
 /**
  * The SGIOChannel base class provides a consistent method for
  * applications to communication through various mediums. By providing
@@ -114,6 +146,18 @@ public:
      */
     virtual int readline( char *buf, int length );
 
+    /**
+     * The readBatch() method reads up to count messages in one go, for
+     * channels where several are usually waiting (datagram sockets). Each
+     * message is stored in its own slot, null terminated, and stamped with
+     * the time it was received. The default implementation reads a single
+     * message with read().
+     * @param messages array of message slots, see SGIOMessageBatch
+     * @param count number of slots
+     * @return number of messages read, or a negative value on error
+     */
+    virtual int readBatch( SGIOMessage *messages, int count );
+
 
     /**
      * The write() method is modeled after the write() Unix system
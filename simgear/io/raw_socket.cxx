@@ -45,6 +45,7 @@
 #else
 #  include <sys/types.h>
 #  include <sys/socket.h>
+#  include <sys/uio.h>
 #  include <netinet/in.h>
 #  include <arpa/inet.h>
 #  include <sys/time.h>
@@ -58,6 +59,7 @@
 #endif
 
 #include <map>
+#include <vector>
 
 #include <simgear/debug/logstream.hxx>
 #include <simgear/structure/exception.hxx>
@@ -626,6 +628,70 @@ int Socket::sendto ( const void * buffer, int size,
 }
 
 
+int Socket::sendv (const SocketBuffer* buffers, int count, int flags)
+{
+  assert ( handle != -1 ) ;
+#if defined(WINSOCK)
+  std::vector<WSABUF> wsaBuffers(count);
+  for (int i=0; i<count; ++i) {
+    wsaBuffers[i].buf = (char*) buffers[i].data;
+    wsaBuffers[i].len = buffers[i].size;
+  }
+
+  DWORD sent = 0;
+  if (WSASend(handle, wsaBuffers.data(), count, &sent, flags, NULL, NULL) != 0) {
+    return -1;
+  }
+  return sent;
+#else
+  std::vector<struct iovec> iov(count);
+  for (int i=0; i<count; ++i) {
+    iov[i].iov_base = (void*) buffers[i].data;
+    iov[i].iov_len = buffers[i].size;
+  }
+
+  // sendmsg rather than writev, so MSG_NOSIGNAL applies
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = count;
+  return ::sendmsg (handle, &msg, flags | MSG_NOSIGNAL);
+#endif
+}
+
+
+int Socket::sendBatch (const SocketBuffer* messages, int count, int flags)
+{
+  assert ( handle != -1 ) ;
+  const int MAX_BATCH = 64 ;
+  if (count > MAX_BATCH) {
+    count = MAX_BATCH;
+  }
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+  // keep the headers on the stack, this is called per frame
+  struct iovec iov[MAX_BATCH];
+  struct mmsghdr msgs[MAX_BATCH];
+  memset(msgs, 0, sizeof(struct mmsghdr) * count);
+  for (int i=0; i<count; ++i) {
+    iov[i].iov_base = (void*) messages[i].data;
+    iov[i].iov_len = messages[i].size;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  return ::sendmmsg (handle, msgs, count, flags | MSG_NOSIGNAL);
+#else
+  int sent = 0;
+  for (; sent < count; ++sent) {
+    if (send(messages[sent].data, messages[sent].size, flags) < 0) {
+      return (sent > 0) ? sent : -1;
+    }
+  }
+  return sent;
+#endif
+}
+
+
 int Socket::recv (void * buffer, int size, int flags)
 {
   assert ( handle != -1 ) ;
@@ -642,6 +708,53 @@ int Socket::recvfrom ( void * buffer, int size,
 }
 
 
+int Socket::recvBatch (SocketRecvBuffer* messages, int count, int flags)
+{
+  assert ( handle != -1 ) ;
+  const int MAX_BATCH = 64 ;
+  if (count > MAX_BATCH) {
+    count = MAX_BATCH;
+  }
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+  // keep the headers on the stack, this is called per frame
+  struct iovec iov[MAX_BATCH];
+  struct mmsghdr msgs[MAX_BATCH];
+  memset(msgs, 0, sizeof(struct mmsghdr) * count);
+  for (int i=0; i<count; ++i) {
+    iov[i].iov_base = messages[i].data;
+    iov[i].iov_len = messages[i].size;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int result = ::recvmmsg (handle, msgs, count, flags | MSG_WAITFORONE, NULL);
+  for (int i=0; i<result; ++i) {
+    messages[i].length = msgs[i].msg_len;
+  }
+  return result;
+#elif defined(MSG_DONTWAIT)
+  int received = 0;
+  for (; received < count; ++received) {
+    // only the first receive may block
+    int f = (received > 0) ? (flags | MSG_DONTWAIT) : flags;
+    int result = recv(messages[received].data, messages[received].size, f);
+    if (result < 0) {
+      return (received > 0) ? received : -1;
+    }
+    messages[received].length = result;
+  }
+  return received;
+#else
+  int result = recv(messages[0].data, messages[0].size, flags);
+  if (result < 0) {
+    return -1;
+  }
+  messages[0].length = result;
+  return 1;
+#endif
+}
+
+
 void Socket::close (void)
 {
   if ( handle != -1 )
@@ -68,6 +68,27 @@ public:
 };
 
 
+/*
+ * One element of a scatter/gather send: either a fragment of a stream
+ * write, or a complete datagram in a batch.
+ */
+struct SocketBuffer
+{
+  const void* data;
+  int size;
+};
+
+/*
+ * One datagram slot for a batched receive: size is the capacity on
+ * input, length the size received on output.
+ */
+struct SocketRecvBuffer
+{
+  void* data;
+  int size;
+  int length;
+};
+
 /*
  * Socket type
  */
@@ -94,9 +115,21 @@ public:
   int   connect     ( IPAddress* addr ) ;
   int   send	    ( const void * buffer, int size, int flags = 0 ) ;
   int   sendto      ( const void * buffer, int size, int flags, const IPAddress* to ) ;
+
+  // gather buffers into a single send call, returns bytes sent
+  int   sendv       ( const SocketBuffer* buffers, int count, int flags = 0 ) ;
+
+  // send each buffer as a separate datagram on a connected socket, using a
+  // single system call where supported; returns the number of datagrams sent
+  // (at most 64 per call)
+  int   sendBatch   ( const SocketBuffer* messages, int count, int flags = 0 ) ;
   int   recv	    ( void * buffer, int size, int flags = 0 ) ;
   int   recvfrom    ( void * buffer, int size, int flags, IPAddress* from ) ;
 
+  // receive up to count datagrams, waiting (if blocking) only for the
+  // first; returns the number received (at most 64 per call)
+  int   recvBatch   ( SocketRecvBuffer* messages, int count, int flags = 0 ) ;
+
   void setBlocking ( bool blocking ) ;
   void setBroadcast ( bool broadcast ) ;
 
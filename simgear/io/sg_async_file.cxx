@@ -0,0 +1,880 @@
+// sg_async_file.cxx -- Asynchronous file I/O routines
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#ifdef _WIN32
+#  include <io.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#if !defined(_MSC_VER)
+# include <unistd.h>
+#endif
+
+// The blocks are raw data, which text mode would translate on Windows
+#ifndef O_BINARY
+#  define O_BINARY 0
+#endif
+
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H)
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  include <linux/io_uring.h>
+#  if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#    define SG_HAVE_IO_URING 1
+#  endif
+#endif
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/threads/SGQueue.hxx>
+#include <simgear/threads/SGGuard.hxx>
+
+#include "sg_async_file.hxx"
+
+namespace simgear
+{
+
+/**
+ * One positioned read or write. On completion, result holds the number
+ * of bytes transferred, or a negative errno value.
+ */
+struct AsyncIORequest
+{
+    enum Op { READ, WRITE };
+
+    Op op;
+    int fd;
+    char* buf;
+    size_t length;
+    off_t offset;
+    int result;
+    void* userData;
+#ifdef SG_HAVE_IO_URING
+    struct iovec iov;
+#endif
+};
+
+/**
+ * Submission / completion queue pair. Requests complete in any order.
+ */
+class AsyncIOEngine
+{
+public:
+    virtual ~AsyncIOEngine() {}
+
+    virtual const char* name() const = 0;
+
+    virtual bool submit(AsyncIORequest* req) = 0;
+
+    /**
+     * return the next completed request, or NULL if there is none. With
+     * wait set, block until one completes; the caller must have a
+     * request in flight. NULL is then only returned if waiting failed,
+     * and the requests in flight will not be reported any more.
+     */
+    virtual AsyncIORequest* complete(bool wait) = 0;
+};
+
+namespace {
+
+int performRequest(AsyncIORequest* req)
+{
+    size_t done = 0;
+    while (done < req->length) {
+        char* p = req->buf + done;
+        size_t len = req->length - done;
+#ifdef _WIN32
+        if (_lseeki64(req->fd, req->offset + done, SEEK_SET) < 0) {
+            return -errno;
+        }
+        int n = (req->op == AsyncIORequest::READ) ?
+            ::_read(req->fd, p, len) : ::_write(req->fd, p, len);
+#else
+        ssize_t n = (req->op == AsyncIORequest::READ) ?
+            ::pread(req->fd, p, len, req->offset + done) :
+            ::pwrite(req->fd, p, len, req->offset + done);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (done > 0) ? (int) done : -errno;
+        }
+
+        if (n == 0) {
+            break; // end of file
+        }
+        done += n;
+    }
+
+    return done;
+}
+
+/**
+ * Fallback engine: requests are performed in order by a single worker
+ * thread, which is all a sequential stream needs.
+ */
+class ThreadEngine : public AsyncIOEngine
+{
+public:
+    ThreadEngine() :
+        _worker(this)
+    {
+        _worker.start();
+    }
+
+    ~ThreadEngine()
+    {
+        _submitted.push(NULL);
+        _worker.join();
+    }
+
+    virtual const char* name() const
+        { return "thread"; }
+
+    virtual bool submit(AsyncIORequest* req)
+    {
+        _submitted.push(req);
+        return true;
+    }
+
+    virtual AsyncIORequest* complete(bool wait)
+    {
+        SGGuard<SGMutex> g(_lock);
+        while (_completed.empty()) {
+            if (!wait) {
+                return NULL;
+            }
+            _done.wait(_lock);
+        }
+
+        AsyncIORequest* req = _completed.front();
+        _completed.pop_front();
+        return req;
+    }
+
+private:
+    class Worker : public SGThread
+    {
+    public:
+        Worker(ThreadEngine* engine) :
+            _engine(engine)
+        {
+        }
+
+        virtual ~Worker()
+        {
+        }
+
+        virtual void run()
+        {
+            for (;;) {
+                AsyncIORequest* req = _engine->_submitted.pop();
+                if (!req) {
+                    return;
+                }
+
+                req->result = performRequest(req);
+                SGGuard<SGMutex> g(_engine->_lock);
+                _engine->_completed.push_back(req);
+                _engine->_done.signal();
+            }
+        }
+
+    private:
+        ThreadEngine* _engine;
+    };
+
+    SGBlockingQueue<AsyncIORequest*> _submitted;
+    SGMutex _lock;
+    SGWaitCondition _done;
+    std::deque<AsyncIORequest*> _completed;
+    Worker _worker;
+};
+
+#ifdef SG_HAVE_IO_URING
+
+/**
+ * io_uring engine, driven through the raw system calls so that no
+ * additional library is required. Kernels without io_uring (or where it
+ * is disabled by policy) fail in setup, and the thread engine is used.
+ */
+class UringEngine : public AsyncIOEngine
+{
+public:
+    static UringEngine* create(unsigned entries)
+    {
+        UringEngine* e = new UringEngine;
+        if (!e->init(entries)) {
+            delete e;
+            return NULL;
+        }
+        return e;
+    }
+
+    ~UringEngine()
+    {
+        if (_sqes) {
+            munmap(_sqes, _sqesSize);
+        }
+        if (_cqRing && (_cqRing != _sqRing)) {
+            munmap(_cqRing, _cqRingSize);
+        }
+        if (_sqRing) {
+            munmap(_sqRing, _sqRingSize);
+        }
+        if (_ringFd >= 0) {
+            ::close(_ringFd);
+        }
+    }
+
+    virtual const char* name() const
+        { return "io_uring"; }
+
+    virtual bool submit(AsyncIORequest* req)
+    {
+        unsigned tail = *_sqTail;
+        if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries) {
+            return false;
+        }
+
+        unsigned index = tail & *_sqMask;
+        struct io_uring_sqe* sqe = &_sqes[index];
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+        req->iov.iov_base = req->buf;
+        req->iov.iov_len = req->length;
+        sqe->opcode = (req->op == AsyncIORequest::READ) ?
+            IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->fd = req->fd;
+        sqe->off = req->offset;
+        sqe->addr = (unsigned long) &req->iov;
+        sqe->len = 1;
+        sqe->user_data = (unsigned long) req;
+
+        _sqArray[index] = index;
+        __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        int result;
+        do {
+            result = enter(1, 0, 0);
+        } while ((result < 0) && (errno == EINTR));
+        return result == 1;
+    }
+
+    virtual AsyncIORequest* complete(bool wait)
+    {
+        for (;;) {
+            unsigned head = *_cqHead;
+            if (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+                struct io_uring_cqe* cqe = &_cqes[head & *_cqMask];
+                AsyncIORequest* req = (AsyncIORequest*) cqe->user_data;
+                req->result = cqe->res;
+                __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+                return req;
+            }
+
+            if (!wait) {
+                return NULL;
+            }
+
+            if ((enter(0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR)) {
+                SG_LOG(SG_IO, SG_ALERT, "io_uring wait failed: " << strerror(errno));
+                return NULL;
+            }
+        }
+    }
+
+private:
+    UringEngine() :
+        _ringFd(-1),
+        _sqRing(NULL),
+        _cqRing(NULL),
+        _sqes(NULL)
+    {
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return syscall(__NR_io_uring_enter, _ringFd, toSubmit, minComplete,
+                       flags, NULL, 0);
+    }
+
+    void* mapRing(size_t size, off_t offset)
+    {
+        void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, _ringFd, offset);
+        return (p == MAP_FAILED) ? NULL : p;
+    }
+
+    bool init(unsigned entries)
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        _ringFd = syscall(__NR_io_uring_setup, entries, &params);
+        if (_ringFd < 0) {
+            return false;
+        }
+
+        _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqRingSize = params.cq_off.cqes +
+            params.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP);
+#else
+        bool single = false;
+#endif
+        if (single) {
+            _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+        }
+
+        _sqRing = mapRing(_sqRingSize, IORING_OFF_SQ_RING);
+        if (!_sqRing) {
+            return false;
+        }
+
+        _cqRing = single ? _sqRing : mapRing(_cqRingSize, IORING_OFF_CQ_RING);
+        if (!_cqRing) {
+            return false;
+        }
+
+        _sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        _sqes = (struct io_uring_sqe*) mapRing(_sqesSize, IORING_OFF_SQES);
+        if (!_sqes) {
+            return false;
+        }
+
+        char* sq = (char*) _sqRing;
+        _sqHead = (unsigned*) (sq + params.sq_off.head);
+        _sqTail = (unsigned*) (sq + params.sq_off.tail);
+        _sqMask = (unsigned*) (sq + params.sq_off.ring_mask);
+        _sqArray = (unsigned*) (sq + params.sq_off.array);
+        _sqEntries = params.sq_entries;
+
+        char* cq = (char*) _cqRing;
+        _cqHead = (unsigned*) (cq + params.cq_off.head);
+        _cqTail = (unsigned*) (cq + params.cq_off.tail);
+        _cqMask = (unsigned*) (cq + params.cq_off.ring_mask);
+        _cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+        return true;
+    }
+
+    int _ringFd;
+    void* _sqRing;
+    void* _cqRing;
+    struct io_uring_sqe* _sqes;
+    size_t _sqRingSize;
+    size_t _cqRingSize;
+    size_t _sqesSize;
+
+    unsigned* _sqHead;
+    unsigned* _sqTail;
+    unsigned* _sqMask;
+    unsigned* _sqArray;
+    unsigned _sqEntries;
+
+    unsigned* _cqHead;
+    unsigned* _cqTail;
+    unsigned* _cqMask;
+    struct io_uring_cqe* _cqes;
+};
+
+#endif // of SG_HAVE_IO_URING
+
+AsyncIOEngine* createEngine(unsigned depth, bool allowIOUring)
+{
+#ifdef SG_HAVE_IO_URING
+    if (allowIOUring) {
+        AsyncIOEngine* e = UringEngine::create(depth);
+        if (e) {
+            return e;
+        }
+        SG_LOG(SG_IO, SG_INFO, "io_uring not available, using a worker thread");
+    }
+#endif
+    return new ThreadEngine;
+}
+
+} // of anonymous namespace
+
+} // of namespace simgear
+
+using simgear::AsyncIORequest;
+
+
+struct SGAsyncFile::Block {
+    AsyncIORequest request;
+    std::vector<char> data;
+    int length;                 // valid bytes, for reads once done
+    int consumed;               // bytes handed to the reader
+    int pass;                   // read pass the block belongs to
+    bool done;
+};
+
+
+bool SGAsyncFile::use_io_uring = true;
+
+
+SGAsyncFile::SGAsyncFile( const std::string& file, int repeat_,
+                          int blockSize, int blockCount ) :
+    file_name(file),
+    fp(-1),
+    eof_flag(true),
+    repeat(repeat_),
+    iteration(0),
+    block_size(blockSize),
+    engine(NULL),
+    fill(NULL),
+    in_flight(0),
+    next_offset(0),
+    read_pass(0),
+    pass_bytes(0),
+    reading_done(false),
+    io_error(false),
+    write_stalls(0)
+{
+    set_type( sgFileType );
+
+    for ( int i = 0; i < std::max(blockCount, 2); ++i ) {
+	Block* b = new Block;
+	b->data.resize( block_size );
+	b->length = 0;
+	b->consumed = 0;
+	b->pass = 0;
+	b->done = true;
+	blocks.push_back( b );
+    }
+}
+
+SGAsyncFile::~SGAsyncFile() {
+    if ( fp != -1 ) {
+	close();
+    }
+
+    for ( unsigned int i = 0; i < blocks.size(); ++i ) {
+	delete blocks[i];
+    }
+}
+
+
+// open the file based on specified direction
+bool SGAsyncFile::open( const SGProtocolDir d ) {
+    set_dir( d );
+
+    if ( get_dir() == SG_IO_OUT ) {
+#ifdef _WIN32
+        int mode = 00666;
+#else
+        mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+#endif
+	fp = ::open( file_name.c_str(),
+		     O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, mode );
+    } else if ( get_dir() == SG_IO_IN ) {
+	fp = ::open( file_name.c_str(), O_RDONLY | O_BINARY );
+    } else {
+	SG_LOG( SG_IO, SG_ALERT,
+		"Error:  bidirection mode not available for files." );
+	return false;
+    }
+
+    if ( fp == -1 ) {
+	SG_LOG( SG_IO, SG_ALERT, "Error opening file: "	<< file_name );
+	return false;
+    }
+
+    engine = simgear::createEngine( blocks.size(), use_io_uring );
+    SG_LOG( SG_IO, SG_DEBUG, "Opened " << file_name << " for asynchronous I/O using "
+	    << engine->name() );
+
+    eof_flag = false;
+    iteration = 0;
+    next_offset = 0;
+    read_pass = 0;
+    pass_bytes = 0;
+    reading_done = false;
+    io_error = false;
+    queued.clear();
+    spare.clear();
+    fill = NULL;
+
+    if ( get_dir() == SG_IO_IN ) {
+	// start reading ahead straight away
+	for ( unsigned int i = 0; i < blocks.size(); ++i ) {
+	    submitRead( blocks[i] );
+	}
+    } else {
+	spare = blocks;
+    }
+
+    return true;
+}
+
+
+void SGAsyncFile::submit( Block* b ) {
+    b->done = false;
+    b->request.fd = fp;
+    b->request.userData = b;
+    ++in_flight;
+    if ( !engine->submit( &b->request ) ) {
+	SG_LOG( SG_IO, SG_ALERT, "Error queueing I/O request: " << file_name );
+	io_error = true;
+	b->done = true;
+	--in_flight;
+    }
+}
+
+
+void SGAsyncFile::submitRead( Block* b ) {
+    b->length = 0;
+    b->consumed = 0;
+    b->pass = read_pass;
+    b->request.op = AsyncIORequest::READ;
+    b->request.buf = &b->data[0];
+    b->request.length = block_size;
+    b->request.offset = next_offset;
+    next_offset += block_size;
+    queued.push_back( b );
+    submit( b );
+}
+
+
+void SGAsyncFile::submitWrite( Block* b ) {
+    b->request.op = AsyncIORequest::WRITE;
+    b->request.buf = &b->data[0];
+    b->request.length = b->length;
+    b->request.offset = next_offset;
+    next_offset += b->length;
+    queued.push_back( b );
+    submit( b );
+}
+
+
+// collect completed requests, optionally waiting for at least one
+void SGAsyncFile::pollCompletions( bool wait ) {
+    bool block = wait;
+    while ( engine && (in_flight > 0) ) {
+	AsyncIORequest* req = engine->complete( block );
+	if ( !req ) {
+	    if ( block ) {
+		// the engine can't wait for the requests still in flight,
+		// so fail them rather than have the caller wait forever
+		io_error = true;
+		std::deque<Block*>::iterator it;
+		for ( it = queued.begin(); it != queued.end(); ++it ) {
+		    (*it)->done = true;
+		}
+		in_flight = 0;
+	    }
+	    break;
+	}
+	block = false;
+
+	Block* b = static_cast<Block*>( req->userData );
+	bool reading = (req->op == AsyncIORequest::READ);
+	if ( req->result < 0 ) {
+	    SG_LOG( SG_IO, SG_ALERT, "Error " << (reading ? "reading" : "writing")
+		    << " file: " << file_name << ": " << strerror(-req->result) );
+	    io_error = true;
+	} else {
+	    if ( reading ) {
+		b->length += req->result;
+	    }
+
+	    if ( (req->result > 0) && (req->result < (int) req->length) ) {
+		// short transfer, continue with the remainder
+		req->buf += req->result;
+		req->length -= req->result;
+		req->offset += req->result;
+		if ( engine->submit( req ) ) {
+		    continue;
+		}
+		io_error = true;
+	    }
+	}
+
+	b->done = true;
+	--in_flight;
+    }
+}
+
+
+// retire fully consumed read blocks, and reuse them further ahead
+void SGAsyncFile::advance() {
+    while ( !queued.empty() ) {
+	Block* b = queued.front();
+	if ( !b->done || (b->consumed < b->length) ) {
+	    return;
+	}
+	queued.pop_front();
+
+	if ( !reading_done && (b->pass == read_pass) && (b->length < block_size) ) {
+	    // a short block ends the pass; blocks queued behind it belong
+	    // to the old pass and read nothing
+	    if ( (repeat < 0 || iteration < repeat - 1) && (pass_bytes > 0) ) {
+		++iteration;
+		++read_pass;
+		pass_bytes = 0;
+		next_offset = 0;
+	    } else {
+		reading_done = true;
+		eof_flag = true;
+	    }
+	}
+
+	if ( !reading_done ) {
+	    submitRead( b );
+	}
+    }
+}
+
+
+// copy available data without consuming it. at_end is set if the data
+// reaches the end of the current pass
+int SGAsyncFile::peek( char *buf, int length, bool& at_end ) {
+    at_end = false;
+    int n = 0;
+    std::deque<Block*>::iterator it;
+    for ( it = queued.begin(); (it != queued.end()) && (n < length); ++it ) {
+	Block* b = *it;
+	if ( !b->done ) {
+	    break;
+	}
+
+	int take = std::min( length - n, b->length - b->consumed );
+	memcpy( buf + n, &b->data[b->consumed], take );
+	n += take;
+
+	if ( (b->pass == read_pass) && (b->length < block_size) ) {
+	    at_end = (b->consumed + take == b->length);
+	    break;
+	}
+    }
+
+    return n;
+}
+
+
+void SGAsyncFile::consume( int length ) {
+    advance();
+    while ( (length > 0) && !queued.empty() && queued.front()->done ) {
+	Block* b = queued.front();
+	int take = std::min( length, b->length - b->consumed );
+	b->consumed += take;
+	pass_bytes += take;
+	length -= take;
+	advance();
+    }
+}
+
+
+// read a block of data of specified size
+int SGAsyncFile::read( char *buf, int length ) {
+    if ( eof_flag ) {
+	return 0;
+    }
+
+    pollCompletions( false );
+    advance();
+    if ( io_error ) {
+	eof_flag = true;
+	return -1;
+    }
+
+    bool at_end;
+    int result = peek( buf, length, at_end );
+    consume( result );
+    return result;
+}
+
+
+// read a line of data, length is max size of input buffer
+int SGAsyncFile::readline( char *buf, int length ) {
+    if ( length <= 0 ) {
+	return 0;
+    }
+
+    buf[0] = '\0';
+    if ( eof_flag ) {
+	return 0;
+    }
+
+    pollCompletions( false );
+    advance();
+    if ( io_error ) {
+	eof_flag = true;
+	return -1;
+    }
+
+    bool at_end;
+    int result = peek( buf, length - 1, at_end );
+
+    // find the end of line
+    int i;
+    for ( i = 0; i < result && buf[i] != '\n'; ++i );
+    if ( i < result ) {
+	result = i + 1;
+    } else if ( (result < length - 1) && !at_end ) {
+	// the rest of the line is still being read
+	result = 0;
+    }
+
+    consume( result );
+    buf[ result ] = '\0';
+    return result;
+}
+
+
+// move completed writes back to the spare list
+void SGAsyncFile::reclaim() {
+    std::deque<Block*>::iterator it = queued.begin();
+    while ( it != queued.end() ) {
+	if ( (*it)->done ) {
+	    spare.push_back( *it );
+	    it = queued.erase( it );
+	} else {
+	    ++it;
+	}
+    }
+}
+
+
+// queue data to be written to the file
+int SGAsyncFile::write( const char *buf, const int length ) {
+    if ( io_error ) {
+	return -1;
+    }
+
+    int done = 0;
+    while ( done < length ) {
+	if ( !fill ) {
+	    pollCompletions( false );
+	    reclaim();
+	    if ( spare.empty() ) {
+		// the disk is falling behind, this is the only place we block
+		++write_stalls;
+		while ( spare.empty() ) {
+		    pollCompletions( true );
+		    reclaim();
+		}
+		if ( io_error ) {
+		    return -1;
+		}
+	    }
+
+	    fill = spare.back();
+	    spare.pop_back();
+	    fill->length = 0;
+	}
+
+	int take = std::min( length - done, block_size - fill->length );
+	memcpy( &fill->data[fill->length], buf + done, take );
+	fill->length += take;
+	done += take;
+
+	if ( fill->length == block_size ) {
+	    submitWrite( fill );
+	    fill = NULL;
+	}
+    }
+
+    // while the disk is idle, write out partial blocks straight away
+    // rather than holding the data back until a block fills
+    pollCompletions( false );
+    if ( fill && (in_flight == 0) ) {
+	submitWrite( fill );
+	fill = NULL;
+    }
+
+    return length;
+}
+
+
+// queue null terminated string to be written to the file
+int SGAsyncFile::writestring( const char *str ) {
+    int length = std::strlen( str );
+    return write( str, length );
+}
+
+
+// wait for all queued writes
+bool SGAsyncFile::flush() {
+    if ( fill ) {
+	if ( fill->length > 0 ) {
+	    submitWrite( fill );
+	} else {
+	    spare.push_back( fill );
+	}
+	fill = NULL;
+    }
+
+    while ( in_flight > 0 ) {
+	pollCompletions( true );
+    }
+    reclaim();
+
+    return !io_error;
+}
+
+
+// close the port
+bool SGAsyncFile::close() {
+    if ( fp == -1 ) {
+	return false;
+    }
+
+    bool ok = true;
+    if ( get_dir() == SG_IO_OUT ) {
+	ok = flush();
+    }
+
+    // outstanding read-ahead still targets our buffers
+    while ( in_flight > 0 ) {
+	pollCompletions( true );
+    }
+
+    delete engine;
+    engine = NULL;
+    queued.clear();
+    spare.clear();
+    fill = NULL;
+
+    if ( ::close( fp ) == -1 ) {
+	ok = false;
+    }
+
+    fp = -1;
+    eof_flag = true;
+    return ok;
+}
+
+
+const char* SGAsyncFile::get_backend() const {
+    return engine ? engine->name() : "none";
+}
@@ -0,0 +1,146 @@
+///@file
+/// Asynchronous file I/O channel.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _SG_ASYNC_FILE_HXX
+#define _SG_ASYNC_FILE_HXX
+
+#include <simgear/compiler.h>
+#include "iochannel.hxx"
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <sys/types.h>
+
+namespace simgear { class AsyncIOEngine; }
+
+/**
+ * A file I/O class based on SGIOChannel, which does not block the caller
+ * on the disk.
+ *
+ * In SG_IO_IN mode the file is read sequentially into a ring of blocks,
+ * several of which are kept in flight ahead of the reader. In SG_IO_OUT
+ * mode writes are copied into blocks which are written behind the caller;
+ * the caller only waits when every block is still in flight.
+ *
+ * Requests are submitted through io_uring on Linux kernels which provide
+ * it, and to a worker thread otherwise.
+ *
+ * Unlike SGFile, read() and readline() return 0 while the next block is
+ * still being read; eof() tells this apart from the end of the file.
+ */
+class SGAsyncFile : public SGIOChannel {
+
+    struct Block;
+
+    std::string file_name;
+    int fp;
+    bool eof_flag;
+    // Number of repetitions to play. -1 means loop infinitely.
+    const int repeat;
+    int iteration;              // number of current repetition,
+                                // starting at 0
+
+    int block_size;
+    simgear::AsyncIOEngine* engine;
+    std::vector<Block*> blocks;
+    std::deque<Block*> queued;  // reads in file order, or writes in flight
+    std::vector<Block*> spare;  // write blocks available for filling
+    Block* fill;                // write block being filled
+    int in_flight;
+
+    off_t next_offset;
+    int read_pass;              // iteration the reader is consuming
+    long pass_bytes;            // bytes consumed in the current pass
+    bool reading_done;
+    bool io_error;
+    unsigned int write_stalls;
+
+    static bool use_io_uring;
+
+    void submit( Block* b );
+    void submitRead( Block* b );
+    void submitWrite( Block* b );
+    void pollCompletions( bool wait );
+    void advance();
+    int peek( char *buf, int length, bool& at_end );
+    void consume( int length );
+    void reclaim();
+
+public:
+
+    /**
+     * Create an instance of SGAsyncFile.
+     * The file is not opened until open() is called.
+     * @param file name of file to open
+     * @param repeat_ On eof restart at the beginning of the file
+     * @param blockSize size of each read-ahead / write-behind block
+     * @param blockCount number of blocks, i.e. the queue depth
+     */
+    SGAsyncFile( const std::string& file, int repeat_ = 1,
+                 int blockSize = 64 * 1024, int blockCount = 4 );
+
+    /** Destructor */
+    ~SGAsyncFile();
+
+    // open the file based on specified direction
+    bool open( const SGProtocolDir dir );
+
+    // read a block of data of up to the specified size, or 0 if no data
+    // is available yet
+    int read( char *buf, int length );
+
+    // read a line of data, length is max size of input buffer. Returns 0
+    // if the complete line is not available yet
+    int readline( char *buf, int length );
+
+    // queue data to be written to the file
+    int write( const char *buf, const int length );
+
+    // queue null terminated string to be written to the file
+    int writestring( const char *str );
+
+    // wait for pending writes, and close file
+    bool close();
+
+    /**
+     * Wait until all queued writes have reached the file.
+     * @return false if any write failed
+     */
+    bool flush();
+
+    /** @return the name of the file being manipulated. */
+    inline std::string get_file_name() const { return file_name; }
+
+    /** @return true of eof conditions exists */
+    virtual bool eof() const { return eof_flag; };
+
+    /** @return name of the backend in use ("io_uring" or "thread") */
+    const char* get_backend() const;
+
+    /** @return number of times write() had to wait for a free block */
+    inline unsigned int get_write_stalls() const { return write_stalls; }
+
+    /**
+     * Allow or prevent the io_uring backend for files opened afterwards,
+     * mainly for testing the worker thread fallback.
+     */
+    static void setUseIOUring( bool enabled ) { use_io_uring = enabled; }
+};
+
+#endif // _SG_ASYNC_FILE_HXX
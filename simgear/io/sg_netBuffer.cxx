@@ -27,6 +27,7 @@
 
 #include <cassert>
 #include <cstring>
+#include <algorithm>
 
 #include <simgear/debug/logstream.hxx>
 
@@ -83,7 +84,11 @@ bool NetBuffer::append (int n)
 NetBufferChannel::NetBufferChannel (int in_buffer_size, int out_buffer_size) :
     in_buffer (in_buffer_size),
     out_buffer (out_buffer_size),
-    should_close (0)
+    should_close (0),
+    out_queue_offset (0),
+    out_queue_length (0),
+    messages_queued (0),
+    send_calls (0)
 { /* empty */
 }
 
@@ -91,6 +96,9 @@ void NetBufferChannel::handleClose ( void )
 {
   in_buffer.remove () ;
   out_buffer.remove () ;
+  out_queue.clear () ;
+  out_queue_offset = 0 ;
+  out_queue_length = 0 ;
   should_close = 0 ;
   NetChannel::handleClose () ;
 }
@@ -98,13 +106,55 @@ void NetBufferChannel::handleClose ( void )
 
 bool NetBufferChannel::bufferSend (const char* msg, int msg_len)
 {
-  if ( out_buffer.append(msg,msg_len) )
+  if ( out_queue.empty() )
+  {
+    if ( out_buffer.append(msg,msg_len) )
+    {
+      ++messages_queued ;
+      return true ;
+    }
+  }
+  else if ( pendingOutput() + msg_len <= out_buffer.getMaxLength() )
+  {
+    // copy behind the shared messages, coalescing into our own tail
+    QueuedMessage& tail = out_queue.back() ;
+    if ( tail.owned )
+    {
+      tail.message->data().append(msg, msg_len) ;
+    }
+    else
+    {
+      QueuedMessage q ;
+      q.message = new NetMessage(msg, msg_len) ;
+      q.owned = true ;
+      out_queue.push_back(q) ;
+    }
+    out_queue_length += msg_len ;
+    ++messages_queued ;
     return true ;
+  }
     
   SG_LOG(SG_IO, SG_WARN, "NetBufferChannel: output buffer overflow!" ) ;
   return false ;
 }
 
+bool NetBufferChannel::bufferSend (NetMessage* msg)
+{
+  if ( pendingOutput() + msg->getLength() > out_buffer.getMaxLength() )
+  {
+    SG_LOG(SG_IO, SG_WARN, "NetBufferChannel: output buffer overflow!" ) ;
+    return false ;
+  }
+
+  QueuedMessage q ;
+  q.message = msg ;
+  q.owned = false ;
+  out_queue.push_back(q) ;
+  out_queue_length += msg->getLength() ;
+  ++messages_queued ;
+  return true ;
+}
+
 void NetBufferChannel::handleBufferRead (NetBuffer& buffer)
 {
   /* do something here */
@@ -134,18 +184,36 @@ NetBufferChannel::handleRead (void)
 void
 NetBufferChannel::handleWrite (void)
 {
-  if (out_buffer.getLength())
+  if (pendingOutput())
   {
     if (isConnected())
     {
-      int length = out_buffer.getLength() ;
-      if (length>512)
-        length=512;
-      int num_sent = NetChannel::send (
-        out_buffer.getData(), length);
+      // gather everything pending into one send call
+      const int MAX_SEGMENTS = 64 ;
+      SocketBuffer segments[MAX_SEGMENTS] ;
+      int count = 0 ;
+      if (out_buffer.getLength())
+      {
+        segments[count].data = out_buffer.getData() ;
+        segments[count].size = out_buffer.getLength() ;
+        ++count ;
+      }
+
+      int offset = out_queue_offset ;
+      std::deque<QueuedMessage>::const_iterator it = out_queue.begin() ;
+      for (; (it != out_queue.end()) && (count < MAX_SEGMENTS); ++it)
+      {
+        segments[count].data = it->message->getData() + offset ;
+        segments[count].size = it->message->getLength() - offset ;
+        offset = 0 ;
+        ++count ;
+      }
+
+      int num_sent = NetChannel::sendv (segments, count) ;
+      ++send_calls ;
       if (num_sent > 0)
       {
-        out_buffer.remove (0, num_sent);
+        consumeOutput (num_sent) ;
         //ulSetError ( UL_DEBUG, "netBufferChannel: %d sent", num_sent ) ;
       }
     }
@@ -156,4 +224,31 @@ NetBufferChannel::handleWrite (void)
   }
 }
 
+void
+NetBufferChannel::consumeOutput (int num_sent)
+{
+  int from_buffer = std::min(num_sent, out_buffer.getLength()) ;
+  if (from_buffer > 0)
+  {
+    out_buffer.remove (0, from_buffer) ;
+    num_sent -= from_buffer ;
+  }
+
+  out_queue_length -= num_sent ;
+  while (num_sent > 0)
+  {
+    assert (!out_queue.empty()) ;
+    int remaining = out_queue.front().message->getLength() - out_queue_offset ;
+    if (num_sent < remaining)
+    {
+      out_queue_offset += num_sent ;
+      return ;
+    }
+
+    num_sent -= remaining ;
+    out_queue.pop_front() ;
+    out_queue_offset = 0 ;
+  }
+}
+
 } // of namespace simgear
@@ -78,7 +78,12 @@
 #ifndef SG_NET_BUFFER_H
 #define SG_NET_BUFFER_H
 
+#include <deque>
+#include <string>
+
 #include <simgear/io/sg_netChannel.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
 
 namespace simgear
 {
@@ -114,6 +119,33 @@ public:
   bool append (int n);
 };
 
+// ===========================================================================
+// NetMessage
+// ===========================================================================
+
+/*
+**  An encoded payload which can be queued on any number of channels
+**  without being copied, e.g. a relay forwarding one packet to many
+**  clients. The payload must not be modified once queued.
+*/
+class NetMessage : public SGReferenced
+{
+  std::string payload ;
+
+public:
+  NetMessage () {}
+  NetMessage ( const char* s, int n ) : payload(s, n) {}
+
+  /* take over the contents of s, leaving it empty */
+  explicit NetMessage ( std::string& s ) { payload.swap(s) ; }
+
+  std::string& data () { return payload ; }
+  const char* getData () const { return payload.data() ; }
+  int getLength () const { return (int) payload.size() ; }
+};
+
+typedef SGSharedPtr<NetMessage> NetMessageRef;
+
 // ===========================================================================
 // NetBufferChannel
 // ===========================================================================
@@ -123,6 +155,29 @@ class NetBufferChannel : public NetChannel
   NetBuffer in_buffer;
   NetBuffer out_buffer;
   int should_close ;
+
+  /*
+  **  Output is gathered into one send call from out_buffer (small copied
+  **  messages, always older than anything queued) followed by the queue of
+  **  shared messages. Once a shared message is queued, later copied
+  **  messages are queued behind it to preserve ordering.
+  */
+  struct QueuedMessage
+  {
+    NetMessageRef message ;
+    bool owned ; // created by this channel, so it may be appended to
+  } ;
+  std::deque<QueuedMessage> out_queue ;
+  int out_queue_offset ; // bytes of the head message already sent
+  int out_queue_length ; // total unsent bytes in the queue
+
+  unsigned int messages_queued ;
+  unsigned int send_calls ;
+
+  int pendingOutput () const
+  {
+    return out_buffer.getLength() + out_queue_length ;
+  }
   
   virtual bool readable (void)
   {
@@ -134,10 +189,11 @@ class NetBufferChannel : public NetChannel
 
   virtual bool writable (void)
   {
-    return (out_buffer.getLength() || should_close);
+    return (pendingOutput() || should_close);
   }
 
   virtual void handleWrite (void) ;
+  void consumeOutput (int num_sent) ;
 
 public:
 
@@ -147,7 +203,22 @@ public:
   void closeWhenDone (void) { should_close = 1 ; }
 
   virtual bool bufferSend (const char* msg, int msg_len);
+
+  /*
+  **  queue a shared message without copying it. Fails (returning false)
+  **  if the total pending output would exceed the output buffer size.
+  */
+  bool bufferSend (NetMessage* msg);
+
   virtual void handleBufferRead (NetBuffer& buffer);
+
+  /*
+  **  statistics: messages queued through bufferSend(), and the send
+  **  system calls issued to flush them
+  */
+  unsigned int getMessagesQueued () const { return messages_queued ; }
+  unsigned int getSendCalls () const { return send_calls ; }
+  void resetStatistics () { messages_queued = send_calls = 0 ; }
 };
 
 } // namespace simgear
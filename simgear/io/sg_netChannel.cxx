@@ -121,6 +121,32 @@ NetChannel::send (const void * buffer, int size, int flags)
   
 }
 
+int
+NetChannel::sendv (const SocketBuffer* buffers, int count, int flags)
+{
+  int size = 0;
+  for (int i=0; i<count; ++i) {
+    size += buffers[i].size;
+  }
+
+  int result = Socket::sendv (buffers, count, flags);
+  
+  if (result == size) {
+    write_blocked = false ;
+    return result;
+  } else if (result >= 0) {
+    write_blocked = true ;
+    return result;
+  } else if (isNonBlockingError ()) {
+    write_blocked = true ;
+    return 0;
+  } else {
+    this->handleError (result);
+    close();
+    return -1;
+  }
+}
+
 int
 NetChannel::recv (void * buffer, int size, int flags)
 {
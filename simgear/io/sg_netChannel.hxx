@@ -90,6 +90,7 @@ public:
   int   listen  ( int backlog ) ;
   int   connect ( const char* host, int port ) ;
   int   send    ( const void * buf, int size, int flags = 0 ) ;
+  int   sendv   ( const SocketBuffer* bufs, int count, int flags = 0 ) ;
   int   recv    ( void * buf, int size, int flags = 0 ) ;
 
   // poll() eligibility predicates
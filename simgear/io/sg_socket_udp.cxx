@@ -39,7 +39,11 @@ using std::string;
 SGSocketUDP::SGSocketUDP( const string& host, const string& port ) :
     hostname(host),
     port_str(port),
-    save_len(0)
+    save_len(0),
+    messages_sent(0),
+    send_calls(0),
+    messages_received(0),
+    recv_calls(0)
 {
     set_valid( false );
 }
@@ -111,8 +115,10 @@ int SGSocketUDP::read( char *buf, int length ) {
     // prevent buffer overflow
     int maxsize = std::min(length - 1, SG_IO_MAX_MSG_SIZE);
 
+    ++recv_calls;
     if ( (result = sock.recv(buf, maxsize, 0)) >= 0 ) {
 	buf[result] = '\0';
+	++messages_received;
 	// printf("msg received = %s\n", buf);
     }
 
@@ -120,6 +126,40 @@ int SGSocketUDP::read( char *buf, int length ) {
 }
 
 
+// read several datagrams from socket (server)
+int SGSocketUDP::readBatch( SGIOMessage *messages, int count ) {
+    if ( ! isvalid() ) {
+	return 0;
+    }
+
+    const int MAX_BATCH = 64;
+    simgear::SocketRecvBuffer slots[MAX_BATCH];
+    count = std::min(count, MAX_BATCH);
+    for ( int i = 0; i < count; ++i ) {
+	// prevent buffer overflow, leaving room for the terminator
+	slots[i].data = messages[i].buf;
+	slots[i].size = std::min(messages[i].capacity - 1, SG_IO_MAX_MSG_SIZE);
+	slots[i].length = 0;
+    }
+
+    ++recv_calls;
+    int result = sock.recvBatch( slots, count, 0 );
+    if ( result <= 0 ) {
+	return result;
+    }
+
+    SGTimeStamp now = SGTimeStamp::now();
+    for ( int i = 0; i < result; ++i ) {
+	messages[i].length = slots[i].length;
+	messages[i].buf[slots[i].length] = '\0';
+	messages[i].timestamp = now;
+    }
+
+    messages_received += result;
+    return result;
+}
+
+
 // read a line of data, length is max size of input buffer
 int SGSocketUDP::readline( char *buf, int length ) {
     if ( ! isvalid() ) {
@@ -176,15 +216,40 @@ int SGSocketUDP::write( const char *buf, const int length ) {
 	return 0;
     }
 
+    ++send_calls;
     if ( sock.send( buf, length, 0 ) < 0 ) {
 	SG_LOG( SG_IO, SG_WARN, "Error writing to socket: " << port );
 	return 0;
     }
 
+    ++messages_sent;
     return length;
 }
 
 
+// write several datagrams to socket (client)
+int SGSocketUDP::writeBatch( const simgear::SocketBuffer* messages, int count ) {
+    if ( ! isvalid() ) {
+	return 0;
+    }
+
+    // the kernel may accept only part of a batch
+    int sent = 0;
+    while ( sent < count ) {
+	++send_calls;
+	int result = sock.sendBatch( messages + sent, count - sent, 0 );
+	if ( result <= 0 ) {
+	    SG_LOG( SG_IO, SG_WARN, "Error writing to socket: " << port );
+	    break;
+	}
+	sent += result;
+    }
+
+    messages_sent += sent;
+    return sent;
+}
+
+
 // write null terminated string to socket (server)
 int SGSocketUDP::writestring( const char *str ) {
     if ( !isvalid() ) {
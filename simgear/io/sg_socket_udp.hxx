@@ -53,6 +53,11 @@ private:
 
     short unsigned int port;
 
+    unsigned int messages_sent;
+    unsigned int send_calls;
+    unsigned int messages_received;
+    unsigned int recv_calls;
+
 public:
 
     /**
@@ -105,12 +110,36 @@ public:
     // read data from socket
     int readline( char *buf, int length );
 
+    // read up to count datagrams, with a single system call where
+    // supported (recvmmsg() on Linux)
+    int readBatch( SGIOMessage *messages, int count );
+
     // write data to a socket
     int write( const char *buf, const int length );
 
     // write null terminated string to a socket
     int writestring( const char *str );
 
+    /**
+     * Send several datagrams, each buffer as one message, with as few
+     * system calls as the platform allows (sendmmsg() on Linux). The
+     * buffers are sent in place, without copying.
+     * @return number of datagrams sent
+     */
+    int writeBatch( const simgear::SocketBuffer* messages, int count );
+
+    /** @return number of datagrams sent since opening */
+    unsigned int get_messages_sent() const { return messages_sent; }
+
+    /** @return number of send system calls since opening */
+    unsigned int get_send_calls() const { return send_calls; }
+
+    /** @return number of datagrams received through read() and readBatch() */
+    unsigned int get_messages_received() const { return messages_received; }
+
+    /** @return number of receive system calls for read() and readBatch() */
+    unsigned int get_recv_calls() const { return recv_calls; }
+
     // close file
     bool close();
 
@@ -0,0 +1,184 @@
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include "sg_async_file.hxx"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+using namespace simgear;
+
+#define COMPARE(a, b) \
+    if ((a) != (b))  { \
+        cerr << "failed:" << #a << " != " << #b << endl; \
+        cerr << "\tgot:" << a << endl; \
+        exit(1); \
+    }
+
+#define VERIFY(a) \
+    if (!(a))  { \
+        cerr << "failed:" << #a << endl; \
+        exit(1); \
+    }
+
+// small blocks, so that every test crosses many block boundaries
+const int BLOCK_SIZE = 4096;
+const int BLOCK_COUNT = 3;
+
+string readFile(const SGPath& p)
+{
+    std::ifstream f(p.c_str(), std::ios::in | std::ios::binary);
+    return string(std::istreambuf_iterator<char>(f),
+                  std::istreambuf_iterator<char>());
+}
+
+string makeContent()
+{
+    std::ostringstream os;
+    for (int i=0; i<5000; ++i) {
+        os << "line " << i << ":" << string(i % 97, 'x') << "\n";
+    }
+    return os.str();
+}
+
+string readAll(SGAsyncFile& f, int chunk)
+{
+    string result;
+    std::vector<char> buf(chunk);
+    SGTimeStamp st;
+    st.stamp();
+    while (!f.eof()) {
+        int n = f.read(&buf[0], chunk);
+        VERIFY(n >= 0);
+        result.append(&buf[0], n);
+        VERIFY(st.elapsedMSec() < 10000);
+    }
+    return result;
+}
+
+void test_write(const SGPath& path, const string& content)
+{
+    SGAsyncFile f(path.str(), 1, BLOCK_SIZE, BLOCK_COUNT);
+    VERIFY(f.open(SG_IO_OUT));
+
+    // uneven writes, including ones larger than a block
+    size_t pos = 0;
+    int size = 1;
+    while (pos < content.size()) {
+        int len = std::min<size_t>(size, content.size() - pos);
+        COMPARE(f.write(content.data() + pos, len), len);
+        pos += len;
+        size = (size * 7 + 3) % 9000;
+    }
+
+    VERIFY(f.flush());
+    COMPARE(readFile(path), content);
+
+    VERIFY(f.writestring("tail\n"));
+    VERIFY(f.close());
+    COMPARE(readFile(path), content + "tail\n");
+}
+
+void test_read(const SGPath& path, const string& content)
+{
+    SGAsyncFile f(path.str(), 1, BLOCK_SIZE, BLOCK_COUNT);
+    VERIFY(f.open(SG_IO_IN));
+    COMPARE(readAll(f, 1000), content);
+    COMPARE(f.read(NULL, 0), 0);
+    VERIFY(f.close());
+}
+
+void test_readline(const SGPath& path, const string& content)
+{
+    SGAsyncFile f(path.str(), 1, BLOCK_SIZE, BLOCK_COUNT);
+    VERIFY(f.open(SG_IO_IN));
+
+    std::istringstream expected(content);
+    string line;
+    char buf[256];
+    int lines = 0;
+    SGTimeStamp st;
+    st.stamp();
+    while (std::getline(expected, line)) {
+        int n;
+        while ((n = f.readline(buf, sizeof(buf))) == 0) {
+            VERIFY(!f.eof());
+            VERIFY(st.elapsedMSec() < 10000);
+        }
+        COMPARE(string(buf, n), line + "\n");
+        ++lines;
+    }
+
+    COMPARE(lines, 5001);
+    while (!f.eof()) {
+        COMPARE(f.readline(buf, sizeof(buf)), 0);
+    }
+    f.close();
+}
+
+void test_repeat(const SGPath& path, const string& content)
+{
+    SGAsyncFile f(path.str(), 3, BLOCK_SIZE, BLOCK_COUNT);
+    VERIFY(f.open(SG_IO_IN));
+    COMPARE(readAll(f, 777), content + content + content);
+    f.close();
+
+    // an empty file must not loop forever
+    SGPath empty(path.dir());
+    empty.append("empty.dat");
+    std::ofstream(empty.c_str()).close();
+
+    SGAsyncFile e(empty.str(), -1, BLOCK_SIZE, BLOCK_COUNT);
+    VERIFY(e.open(SG_IO_IN));
+    COMPARE(readAll(e, 100), string());
+    e.close();
+}
+
+void test_backend(const Dir& base, bool allowIOUring)
+{
+    SGAsyncFile::setUseIOUring(allowIOUring);
+
+    SGPath path(base.file("data.txt"));
+    string content = makeContent();
+    test_write(path, content);
+    content += "tail\n";
+
+    SGAsyncFile probe(path.str());
+    VERIFY(probe.open(SG_IO_IN));
+    cout << "testing " << probe.get_backend() << " backend" << endl;
+    if (!allowIOUring) {
+        COMPARE(string(probe.get_backend()), string("thread"));
+    }
+    probe.close();
+
+    test_read(path, content);
+    test_readline(path, content);
+    test_repeat(path, content);
+}
+
+int main(int argc, char* argv[])
+{
+    Dir base = Dir::tempDir("sg_async_file");
+    base.setRemoveOnDestroy();
+
+    test_backend(base, true);
+    test_backend(base, false);
+
+    cout << "all tests passed ok" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+
+#include <simgear/timing/timestamp.hxx>
+
+#include "sg_netBuffer.hxx"
+#include "sg_socket_udp.hxx"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+using namespace simgear;
+
+#define COMPARE(a, b) \
+    if ((a) != (b))  { \
+        cerr << "failed:" << #a << " != " << #b << endl; \
+        cerr << "\tgot:" << a << endl; \
+        exit(1); \
+    }
+
+#define VERIFY(a) \
+    if (!(a))  { \
+        cerr << "failed:" << #a << endl; \
+        exit(1); \
+    }
+
+const int TCP_PORT = 2010;
+
+class ReceiveChannel : public NetBufferChannel
+{
+public:
+    ReceiveChannel() : NetBufferChannel(65536) {}
+
+    virtual void handleBufferRead(NetBuffer& buffer)
+    {
+        received.append(buffer.getData(), buffer.getLength());
+        buffer.remove();
+    }
+
+    string received;
+};
+
+class Listener : public NetChannel
+{
+public:
+    Listener(NetChannelPoller* poller) :
+        _poller(poller),
+        channel(NULL)
+    {
+        open();
+        bind(NULL, TCP_PORT);
+        listen(5);
+        _poller->addChannel(this);
+    }
+
+    virtual bool writable (void) { return false ; }
+
+    virtual void handleAccept (void)
+    {
+        IPAddress addr;
+        int handle = accept(&addr);
+        channel = new ReceiveChannel;
+        channel->setHandle(handle);
+        _poller->addChannel(channel);
+    }
+
+    NetChannelPoller* _poller;
+    ReceiveChannel* channel;
+};
+
+void test_gather()
+{
+    NetChannelPoller poller;
+    Listener listener(&poller);
+
+    NetBufferChannel sender(4096, 65536);
+    sender.open();
+    sender.connect("localhost", TCP_PORT);
+    poller.addChannel(&sender);
+
+    // interleave copied and shared messages, the order must be preserved
+    NetMessageRef shared(new NetMessage("<shared>", 8));
+    string expected;
+    for (int i=0; i<500; ++i) {
+        std::ostringstream os;
+        os << "msg" << i << ";";
+        VERIFY(sender.bufferSend(os.str().c_str(), os.str().size()));
+        expected += os.str();
+
+        if ((i % 3) == 0) {
+            VERIFY(sender.bufferSend(shared.get()));
+            expected += "<shared>";
+        }
+    }
+
+    SGTimeStamp st;
+    st.stamp();
+    while (!listener.channel || (listener.channel->received.size() < expected.size())) {
+        poller.poll(10);
+        VERIFY(st.elapsedMSec() < 5000);
+    }
+
+    COMPARE(listener.channel->received, expected);
+    COMPARE(sender.getMessagesQueued(), 667);
+    VERIFY(sender.getSendCalls() < 10);
+    cout << "sent " << sender.getMessagesQueued() << " messages with "
+         << sender.getSendCalls() << " send calls" << endl;
+}
+
+void test_overflow()
+{
+    NetBufferChannel chan(4096, 64);
+    NetMessageRef big(new NetMessage(string(48, 'x').c_str(), 48));
+    VERIFY(chan.bufferSend(big.get()));
+    VERIFY(chan.bufferSend("0123456789", 10));
+    VERIFY(!chan.bufferSend("0123456789", 10));
+    VERIFY(!chan.bufferSend(big.get()));
+}
+
+void test_udp_batch()
+{
+    SGSocketUDP server("", "2011");
+    VERIFY(server.open(SG_IO_IN));
+
+    SGSocketUDP client("localhost", "2011");
+    VERIFY(client.open(SG_IO_OUT));
+
+    const int COUNT = 32;
+    string payloads[COUNT];
+    SocketBuffer messages[COUNT];
+    for (int i=0; i<COUNT; ++i) {
+        std::ostringstream os;
+        os << "datagram-" << i;
+        payloads[i] = os.str();
+        messages[i].data = payloads[i].data();
+        messages[i].size = payloads[i].size();
+    }
+
+    COMPARE(client.writeBatch(messages, COUNT), COUNT);
+    COMPARE(client.get_messages_sent(), COUNT);
+    VERIFY(client.get_send_calls() <= COUNT);
+
+    char buf[256];
+    for (int i=0; i<COUNT / 2; ++i) {
+        int len = server.read(buf, sizeof(buf));
+        COMPARE(string(buf, len), payloads[i]);
+    }
+
+    // drain the remainder in batches, order must be preserved
+    SGIOMessageBatch batch(8, 256);
+    int received = COUNT / 2;
+    while (received < COUNT) {
+        int n = server.readBatch(batch.messages(), batch.count());
+        VERIFY(n > 0);
+        for (int i=0; i<n; ++i) {
+            COMPARE(string(batch[i].buf, batch[i].length), payloads[received + i]);
+            VERIFY(batch[i].timestamp.toUSecs() > 0);
+        }
+        received += n;
+    }
+
+    COMPARE(server.get_messages_received(), COUNT);
+    VERIFY(server.get_recv_calls() <= COUNT);
+
+    client.close();
+    server.close();
+}
+
+int main(int argc, char* argv[])
+{
+    Socket::initSockets();
+
+    test_gather();
+    test_overflow();
+    test_udp_batch();
+
+    cout << "all tests passed ok" << endl;
+    return EXIT_SUCCESS;
+}
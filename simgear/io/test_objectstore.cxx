@@ -0,0 +1,202 @@
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <ctime>
+
+#ifdef _WIN32
+#  include <sys/utime.h>
+#else
+#  include <utime.h>
+#endif
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/strutils.hxx>
+#include <simgear/package/md5.h>
+
+#include "ObjectStore.hxx"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+using namespace simgear;
+
+#define COMPARE(a, b) \
+    if ((a) != (b))  { \
+        cerr << "failed:" << #a << " != " << #b << endl; \
+        cerr << "\tgot:" << a << endl; \
+        exit(1); \
+    }
+
+#define VERIFY(a) \
+    if (!(a))  { \
+        cerr << "failed:" << #a << endl; \
+        exit(1); \
+    }
+
+string md5Hex(const string& data)
+{
+    SG_MD5_CTX ctx;
+    SG_MD5Init(&ctx);
+    SG_MD5Update(&ctx, (const unsigned char*) data.data(), data.size());
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    SG_MD5Final(digest, &ctx);
+    return strutils::encodeHex(digest, MD5_DIGEST_LENGTH);
+}
+
+SGPath objectPath(ObjectStore* store, const string& key)
+{
+    SGPath p(store->root());
+    p.append(key.substr(0, 2));
+    p.append(key);
+    return p;
+}
+
+string readFile(const SGPath& p)
+{
+    std::ifstream f(p.c_str(), std::ios::in | std::ios::binary);
+    return string(std::istreambuf_iterator<char>(f),
+                  std::istreambuf_iterator<char>());
+}
+
+void writeFile(const SGPath& p, const string& data)
+{
+    std::ofstream f(p.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    f << data;
+}
+
+void test_basic(const Dir& base)
+{
+    ObjectStoreRef store(new ObjectStore(base.file("store")));
+    string payload("hello object store");
+    const string KEY_A = md5Hex(payload);
+    const string KEY_B = md5Hex("from a file");
+    VERIFY(!store->contains(KEY_A));
+    VERIFY(!store->contains("not-a-digest"));
+
+    VERIFY(store->insertData(KEY_A, payload.data(), payload.size()));
+    VERIFY(store->contains(KEY_A));
+    COMPARE(store->size(), payload.size());
+
+    string d;
+    VERIFY(store->read(KEY_A, d));
+    COMPARE(d, payload);
+
+    SGPath dest(base.file("out/a.txt"));
+    VERIFY(store->materialize(KEY_A, dest));
+    COMPARE(readFile(dest), payload);
+
+    // a materialized file must be replaced, not rewritten in place
+    SGPath(dest).remove();
+    writeFile(dest, "changed");
+    VERIFY(store->read(KEY_A, d));
+    COMPARE(d, payload);
+
+    VERIFY(!store->materialize(KEY_B, base.file("out/b.txt")));
+    COMPARE(store->hits(), 3);
+    COMPARE(store->misses(), 1);
+
+    // insert a copy of an existing file, which may then be rewritten
+    SGPath src(base.file("src.txt"));
+    writeFile(src, "from a file");
+    VERIFY(store->insertFile(KEY_B, src));
+    writeFile(src, "edited in place");
+    VERIFY(store->read(KEY_B, d));
+    COMPARE(d, string("from a file"));
+
+    // a second store on the same root sees the objects
+    ObjectStoreRef other(new ObjectStore(base.file("store")));
+    VERIFY(other->contains(KEY_B));
+    COMPARE(other->size(), store->size());
+}
+
+void test_corrupt(const Dir& base)
+{
+    ObjectStoreRef store(new ObjectStore(base.file("corrupt-store")));
+    string payload("some object");
+    const string key = md5Hex(payload);
+    VERIFY(store->insertData(key, payload.data(), payload.size()));
+
+    // corrupt objects are dropped rather than used
+    writeFile(objectPath(store, key), "some 0bject");
+    string d;
+    VERIFY(!store->read(key, d));
+    VERIFY(!store->contains(key));
+    COMPARE(store->size(), 0);
+
+    VERIFY(store->insertData(key, payload.data(), payload.size()));
+    writeFile(objectPath(store, key), "truncated");
+    SGPath dest(base.file("out/corrupt.txt"));
+    VERIFY(!store->materialize(key, dest));
+    VERIFY(!dest.exists());
+    VERIFY(!store->contains(key));
+    COMPARE(store->misses(), 2);
+    COMPARE(store->hits(), 0);
+
+    // keys are matched regardless of case
+    VERIFY(store->insertData(strutils::uppercase(key),
+                             payload.data(), payload.size()));
+    VERIFY(store->read(strutils::uppercase(key), d));
+    COMPARE(d, payload);
+    VERIFY(store->contains(key));
+    VERIFY(objectPath(store, key).exists());
+}
+
+void test_trim(const Dir& base)
+{
+    ObjectStoreRef store(new ObjectStore(base.file("trim-store")));
+    string a(1000, 'a'), b(1000, 'b'), c(1000, 'c');
+    const string KEY_A = md5Hex(a);
+    const string KEY_B = md5Hex(b);
+    const string KEY_C = md5Hex(c);
+    VERIFY(store->insertData(KEY_A, a.data(), a.size()));
+    VERIFY(store->insertData(KEY_B, b.data(), b.size()));
+
+    // make A the most recently used object
+    SGPath pathB = objectPath(store, KEY_B);
+    time_t now = time(NULL);
+    struct utimbuf old = { now - 100, now - 100 };
+    utime(pathB.c_str(), &old);
+
+    store->setMaxSize(2500);
+    VERIFY(store->insertData(KEY_C, c.data(), c.size()));
+    VERIFY(store->contains(KEY_A));
+    VERIFY(!store->contains(KEY_B));
+    VERIFY(store->contains(KEY_C));
+    COMPARE(store->size(), 2000);
+
+    // eviction goes below the maximum, so that the next insertions don't
+    // have to trim again
+    store->setMaxSize(0);
+    VERIFY(store->insertData(KEY_B, b.data(), b.size()));
+    SGPath pathA = objectPath(store, KEY_A);
+    utime(pathA.c_str(), &old);
+    struct utimbuf older = { now - 50, now - 50 };
+    utime(pathB.c_str(), &older);
+    store->setMaxSize(2050);
+    VERIFY(!store->contains(KEY_A));
+    VERIFY(!store->contains(KEY_B));
+    VERIFY(store->contains(KEY_C));
+    COMPARE(store->size(), 1000);
+}
+
+int main(int argc, char* argv[])
+{
+    Dir base = Dir::tempDir("sg_objectstore");
+    base.setRemoveOnDestroy();
+
+    test_basic(base);
+    test_corrupt(base);
+    test_trim(base);
+
+    cout << "all tests passed ok" << endl;
+    return 0;
+}
@@ -36,7 +36,7 @@ static naRef dofld(naContext c, int argc, naRef* args, int sign)
     int bit = argc > 1 ? (int)naNumValue(args[1]).num : -1;
     int len = argc > 2 ? (int)naNumValue(args[2]).num : -1;
     unsigned int f;
-    if(!naIsString(s) || !MUTABLE(args[0]) || bit < 0 || len < 0)
+    if(!naIsString(s) || bit < 0 || len < 0)
         naRuntimeError(c, "missing/bad argument to fld/sfld");
     f = fld(c, (void*)naStr_data(s), naStr_len(s), bit, len);
     if(!sign) return naNum(f);
@@ -60,9 +60,10 @@ static naRef f_setfld(naContext c, naRef me, int argc, naRef* args)
     int bit = argc > 1 ? (int)naNumValue(args[1]).num : -1;
     int len = argc > 2 ? (int)naNumValue(args[2]).num : -1;
     naRef val = argc > 3 ? naNumValue(args[3]) : naNil();
-    if(!argc || !MUTABLE(args[0])|| bit < 0 || len < 0 || IS_NIL(val))
+    char* buf = naStr_mutable(s);
+    if(!buf || bit < 0 || len < 0 || IS_NIL(val))
         naRuntimeError(c, "missing/bad argument to setfld");
-    setfld(c, (void*)naStr_data(s), naStr_len(s), bit, len, (unsigned int)val.num);
+    setfld(c, (void*)buf, naStr_len(s), bit, len, (unsigned int)val.num);
     return naNil();
 }
 
@@ -0,0 +1,312 @@
+#include <string.h>
+#include "nasal.h"
+#include "data.h"
+#include "code.h"
+
+// Serialized code objects, for caching compiled modules.  The format is
+// a header followed by the top level code object:
+//
+//   "NaBC", version, NUM_OPCODES, first line, source length, source hash
+//   code: nArgs, nOptArgs, needArgVector, restArgSym, nConstants,
+//         codesz, nLines, constants, bytecode, argument symbols,
+//         optional argument symbols and values, line table
+//   checksum of all of the above
+//
+// Integers are stored little endian, numbers as IEEE doubles.  Strings
+// which were interned as symbols are tagged, as the interpreter
+// compares symbols by identity.  Bump BC_VERSION when the code
+// generator output or this format changes.
+
+#define BC_VERSION 1
+
+enum { BC_NIL, BC_NUM, BC_STR, BC_SYM, BC_CODE };
+
+struct Out {
+    unsigned char* buf;
+    int len;
+    int sz;
+};
+
+struct In {
+    const unsigned char* buf;
+    int len;
+    int pos;
+    int bad;
+};
+
+static unsigned int hashbytes(const char* src, int len)
+{
+    int i;
+    unsigned int h = 2166136261u;
+    for(i=0; i<len; i++) h = (h ^ (unsigned char)src[i]) * 16777619u;
+    return h;
+}
+
+static void putbytes(struct Out* o, const void* p, int n)
+{
+    if(o->len + n > o->sz) {
+        o->sz = 2 * (o->len + n);
+        o->buf = naRealloc(o->buf, o->sz);
+    }
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+}
+
+static void put(struct Out* o, unsigned long long v, int n)
+{
+    unsigned char b[8];
+    int i;
+    for(i=0; i<n; i++) b[i] = (unsigned char)(v >> (8*i));
+    putbytes(o, b, n);
+}
+
+static unsigned long long get(struct In* in, int n)
+{
+    unsigned long long v = 0;
+    int i;
+    if(in->pos + n > in->len) { in->bad = 1; return 0; }
+    for(i=0; i<n; i++) v |= (unsigned long long)in->buf[in->pos++] << (8*i);
+    return v;
+}
+
+static int isSymbol(naRef s)
+{
+    naRef sym;
+    return naHash_get(globals->symbols, s, &sym) && IDENTICAL(sym, s);
+}
+
+static void putshorts(struct Out* o, unsigned short* v, int n)
+{
+    int i;
+    for(i=0; i<n; i++) put(o, v[i], 2);
+}
+
+static void putcode(struct Out* o, struct naCode* c)
+{
+    int i;
+    put(o, c->nArgs, 1);
+    put(o, c->nOptArgs, 1);
+    put(o, c->needArgVector, 1);
+    put(o, c->restArgSym, 2);
+    put(o, c->nConstants, 2);
+    put(o, c->codesz, 2);
+    put(o, c->nLines, 2);
+    for(i=0; i<c->nConstants; i++) {
+        naRef k = c->constants[i];
+        if(IS_NIL(k)) {
+            put(o, BC_NIL, 1);
+        } else if(IS_NUM(k)) {
+            union { double d; unsigned long long u; } u;
+            u.d = k.num;
+            put(o, BC_NUM, 1);
+            put(o, u.u, 8);
+        } else if(IS_STR(k)) {
+            put(o, isSymbol(k) ? BC_SYM : BC_STR, 1);
+            put(o, naStr_len(k), 4);
+            putbytes(o, naStr_data(k), naStr_len(k));
+        } else {
+            put(o, BC_CODE, 1);
+            putcode(o, PTR(k).code);
+        }
+    }
+    putshorts(o, BYTECODE(c), c->codesz);
+    putshorts(o, ARGSYMS(c), c->nArgs);
+    putshorts(o, OPTARGSYMS(c), c->nOptArgs);
+    putshorts(o, OPTARGVALS(c), c->nOptArgs);
+    putshorts(o, LINEIPS(c), c->nLines);
+}
+
+naRef naSaveCode(naContext ctx, naRef code, int firstLine,
+                 const char* src, int srclen)
+{
+    struct Out o;
+    naRef result;
+    if(!IS_CODE(code)) return naNil();
+    o.buf = 0;
+    o.len = o.sz = 0;
+    putbytes(&o, "NaBC", 4);
+    put(&o, BC_VERSION, 2);
+    put(&o, NUM_OPCODES, 2);
+    put(&o, (unsigned int)firstLine, 4);
+    put(&o, (unsigned int)srclen, 4);
+    put(&o, hashbytes(src, srclen), 4);
+    putcode(&o, PTR(code).code);
+    put(&o, hashbytes((char*)o.buf, o.len), 4);
+    result = naStr_fromdata(naNewString(ctx), (char*)o.buf, o.len);
+    naFree(o.buf);
+    return result;
+}
+
+static int opSize(int op)
+{
+    switch(op) {
+    case OP_PUSHCONST: case OP_LOCAL: case OP_MEMBER: case OP_UNPACK:
+    case OP_FCALL: case OP_MCALL: case OP_JMP: case OP_JMPLOOP:
+    case OP_JIFNOTPOP: case OP_JIFEND: case OP_JIFTRUE: case OP_JIFNOT:
+    case OP_LCONSTOP: case OP_LSMALLOP: case OP_LLOCALOP: case OP_LMEMBER:
+        return 2;
+    }
+    return 1;
+}
+
+// The interpreter doesn't check the opcodes, constant indices and jump
+// targets it reads, which the code generator gets right.  A cache file
+// which is consistent but wrong (from a bug, or written on purpose)
+// must not make it read out of bounds.
+static int validcode(struct naCode* c)
+{
+    int i, ip, op, ok = 1, n = c->codesz;
+    unsigned short* bc = BYTECODE(c);
+    char* start;
+    for(i=0; i<c->nArgs; i++)
+        if(ARGSYMS(c)[i] >= c->nConstants) return 0;
+    for(i=0; i<c->nOptArgs; i++)
+        if(OPTARGSYMS(c)[i] >= c->nConstants
+           || OPTARGVALS(c)[i] >= c->nConstants)
+            return 0;
+    if(n == 0) return 0;
+
+    // Instructions, and the operands which index the constants.  The
+    // superinstructions are followed by the rest of their sequence.
+    start = naAlloc(n);
+    naBZero(start, n);
+    for(ip=0; ok && ip<n; ip += opSize(op)) {
+        op = bc[ip];
+        start[ip] = 1;
+        if(op >= NUM_OPCODES || ip + opSize(op) > n) { ok = 0; break; }
+        switch(op) {
+        case OP_PUSHCONST: case OP_LOCAL: case OP_MEMBER:
+            ok = bc[ip+1] < c->nConstants;
+            break;
+        case OP_LCONSTOP: case OP_LLOCALOP:
+            ok = bc[ip+1] < c->nConstants && ip + 4 < n
+                && bc[ip+2] == (op == OP_LCONSTOP ? OP_PUSHCONST : OP_LOCAL);
+            break;
+        case OP_LSMALLOP:
+            ok = bc[ip+1] < c->nConstants && ip + 3 < n
+                && (bc[ip+2] == OP_PUSHONE || bc[ip+2] == OP_PUSHZERO);
+            break;
+        case OP_LMEMBER:
+            ok = bc[ip+1] < c->nConstants && ip + 3 < n
+                && bc[ip+2] == OP_MEMBER;
+            break;
+        }
+    }
+    // Jumps may only go to instructions, and the code has to end in a
+    // return (the last instruction of the code generator's output)
+    for(ip=0; ok && ip<n; ip += opSize(bc[ip])) {
+        switch(bc[ip]) {
+        case OP_JMP: case OP_JMPLOOP: case OP_JIFNOTPOP: case OP_JIFEND:
+        case OP_JIFTRUE: case OP_JIFNOT:
+            ok = bc[ip+1] < n && start[bc[ip+1]];
+            break;
+        }
+        if(ip + opSize(bc[ip]) == n)
+            ok = ok && bc[ip] == OP_RETURN;
+    }
+    naFree(start);
+    return ok;
+}
+
+static naRef getcode(naContext ctx, naRef srcFile, struct In* in, int depth)
+{
+    int i, nArgs, nOptArgs, needArgVector, restArgSym, nConsts, codesz, nLines;
+    naRef consts, codeObj;
+    struct naCode* c;
+
+    nArgs = (int)get(in, 1);
+    nOptArgs = (int)get(in, 1);
+    needArgVector = (int)get(in, 1);
+    restArgSym = (int)get(in, 2);
+    nConsts = (int)get(in, 2);
+    codesz = (int)get(in, 2);
+    nLines = (int)get(in, 2);
+    // nArgs and nOptArgs are 5 bit fields in naCode
+    if(in->bad || depth > MAX_RECURSION || nArgs >= 32 || nOptArgs >= 32
+       || restArgSym >= nConsts) {
+        in->bad = 1;
+        return naNil();
+    }
+
+    // Collect the constants in a vector first, which keeps them alive
+    // through the allocations until the code object is complete
+    consts = naNewVector(ctx);
+    for(i=0; i<nConsts && !in->bad; i++) {
+        int type = (int)get(in, 1);
+        naRef k = naNil();
+        if(type == BC_NUM) {
+            union { double d; unsigned long long u; } u;
+            u.u = get(in, 8);
+            k = naNum(u.d);
+        } else if(type == BC_STR || type == BC_SYM) {
+            int len = (int)get(in, 4);
+            if(len < 0 || in->pos + len > in->len) { in->bad = 1; break; }
+            k = naStr_fromdata(naNewString(ctx),
+                               (const char*)in->buf + in->pos, len);
+            in->pos += len;
+            if(type == BC_SYM) k = naInternSymbol(k);
+        } else if(type == BC_CODE) {
+            k = getcode(ctx, srcFile, in, depth + 1);
+        } else if(type != BC_NIL) {
+            in->bad = 1;
+        }
+        naVec_append(consts, k);
+    }
+    if(in->bad || in->pos + 2 * (codesz + nArgs + 2*nOptArgs + nLines) > in->len)
+        return naNil();
+
+    codeObj = naNewCode(ctx);
+    c = PTR(codeObj).code;
+    c->nArgs = nArgs;
+    c->nOptArgs = nOptArgs;
+    c->needArgVector = needArgVector;
+    c->restArgSym = restArgSym;
+    c->nConstants = nConsts;
+    c->codesz = codesz;
+    c->nLines = nLines;
+    c->srcFile = srcFile;
+    c->constants = 0;
+    c->mcache = 0;
+    c->constants = naAlloc((int)(size_t)(LINEIPS(c)+c->nLines));
+    for(i=0; i<nConsts; i++)
+        c->constants[i] = naVec_get(consts, i);
+    for(i=0; i<codesz; i++) BYTECODE(c)[i] = (unsigned short)get(in, 2);
+    for(i=0; i<nArgs; i++) ARGSYMS(c)[i] = (unsigned short)get(in, 2);
+    for(i=0; i<nOptArgs; i++) OPTARGSYMS(c)[i] = (unsigned short)get(in, 2);
+    for(i=0; i<nOptArgs; i++) OPTARGVALS(c)[i] = (unsigned short)get(in, 2);
+    for(i=0; i<nLines; i++) LINEIPS(c)[i] = (unsigned short)get(in, 2);
+    if(!validcode(c)) {
+        in->bad = 1;
+        return naNil();
+    }
+    return codeObj;
+}
+
+naRef naLoadCode(naContext ctx, naRef srcFile, int firstLine,
+                 const char* src, int srclen, const char* buf, int len)
+{
+    struct In in;
+    naRef code;
+    in.buf = (const unsigned char*)buf;
+    in.len = len;
+    in.pos = 4;
+    in.bad = 0;
+    if(len < 24 || memcmp(buf, "NaBC", 4) != 0
+       || get(&in, 2) != BC_VERSION || get(&in, 2) != NUM_OPCODES
+       || get(&in, 4) != (unsigned int)firstLine
+       || get(&in, 4) != (unsigned int)srclen
+       || get(&in, 4) != hashbytes(src, srclen) || in.bad)
+        return naNil();
+
+    // The interpreter trusts the bytecode, so don't load anything
+    // which got truncated or corrupted on disk
+    in.pos = len - 4;
+    if(get(&in, 4) != hashbytes(buf, len - 4))
+        return naNil();
+    in.len = len - 4;
+    in.pos = 20;
+
+    naTempSave(ctx, srcFile);
+    code = getcode(ctx, srcFile, &in, 0);
+    return in.bad || in.pos != in.len ? naNil() : code;
+}
@@ -126,9 +126,10 @@ static void containerSet(naContext ctx, naRef box, naRef key, naRef val)
     else if(IS_HASH(box)) naHash_set(box, key, val);
     else if(IS_VEC(box))  naVec_set(box, checkVec(ctx, box, key), val);
     else if(IS_STR(box)) {
-        if(PTR(box).str->hashcode)
+        char* buf = naStr_mutable(box);
+        if(!buf)
             ERR(ctx, "cannot change immutable string");
-        naStr_data(box)[checkStr(ctx, box, key)] = (char)numify(ctx, val);
+        buf[checkStr(ctx, box, key)] = (char)numify(ctx, val);
     } else ERR(ctx, "insert into non-container");
 }
 
@@ -167,6 +168,7 @@ static void initGlobals()
 
     globals->sem = naNewSem();
     globals->lock = naNewLock();
+    globals->strLock = naNewLock();
 
     globals->allocCount = 256; // reasonable starting value
     for(i=0; i<NUM_NASAL_TYPES; i++)
@@ -309,6 +311,8 @@ static struct Frame* setupFuncall(naContext ctx, int nargs, int mcall, int named
     struct Frame* f;
     int opf = ctx->opTop - nargs;
 
+    if(naProfileFlag) naProfileSample(ctx);
+
     args = &ctx->opStack[opf];
     func = ctx->opStack[--opf];
     if(!IS_FUNC(func)) ERR(ctx, "function/method call on uncallable object");
@@ -351,6 +355,28 @@ static naRef evalEquality(int op, naRef ra, naRef rb)
     return naNum((op==OP_EQ) ? result : !result);
 }
 
+// The binary operators of the superinstructions, as in run()
+static naRef evalBinOp(naContext ctx, int op, naRef ra, naRef rb)
+{
+    double l, r;
+    if(op == OP_EQ || op == OP_NEQ)
+        return evalEquality(op, ra, rb);
+    l = IS_NUM(ra) ? ra.num : numify(ctx, ra);
+    r = IS_NUM(rb) ? rb.num : numify(ctx, rb);
+    switch(op) {
+    case OP_PLUS:  return naNum(l + r);
+    case OP_MINUS: return naNum(l - r);
+    case OP_MUL:   return naNum(l * r);
+    case OP_DIV:   return naNum(l / r);
+    case OP_LT:    return naNum(l <  r ? 1 : 0);
+    case OP_LTE:   return naNum(l <= r ? 1 : 0);
+    case OP_GT:    return naNum(l >  r ? 1 : 0);
+    case OP_GTE:   return naNum(l >= r ? 1 : 0);
+    }
+    ERR(ctx, "BUG: bad superinstruction operator");
+    return naNil();
+}
+
 static naRef evalCat(naContext ctx, naRef l, naRef r)
 {
     if(IS_VEC(l) && IS_VEC(r)) {
@@ -442,7 +468,9 @@ static const char* ghostGetMember(naContext ctx, naRef obj, naRef field, naRef*
 // indicate success, or a non-empty error message.  Works this way so
 // we can generate smart error messages without throwing them with a
 // longjmp -- this gets called under naMember_get() from C code.
-static const char* getMember_r(naContext ctx, naRef obj, naRef field, naRef* out, int count)
+// Clears *cacheable if the result came from something the member
+// caches can't track (ghosts and strings).
+static const char* getMember_r(naContext ctx, naRef obj, naRef field, naRef* out, int count, int* cacheable)
 {
     int i;
     naRef p;
@@ -450,21 +478,26 @@ static const char* getMember_r(naContext ctx, naRef obj, naRef field, naRef* out
     if(--count < 0) return "too many parents";
 
     if (IS_GHOST(obj)) {
+        *cacheable = 0;
         if (ghostGetMember(ctx, obj, field, out)) return "";
         if(!ghostGetMember(ctx, obj, globals->parentsRef, &p)) return 0;
     } else if (IS_HASH(obj)) {
         if(naHash_get(obj, field, out)) return "";
         if(!naHash_get(obj, globals->parentsRef, &p)) return 0;
     } else if (IS_STR(obj) ) {
-        return getMember_r(ctx, getStringMethods(ctx), field, out, count);
+        *cacheable = 0;
+        return getMember_r(ctx, getStringMethods(ctx), field, out, count, cacheable);
     } else {
         return "non-objects have no members";
     }
     
     if(!IS_VEC(p)) return "object \"parents\" field not vector";
+    PTR(p).vec->proto = 1;
     pv = PTR(p).vec->rec;
     for(i=0; pv && i<pv->size; i++) {
-        const char* err = getMember_r(ctx, pv->array[i], field, out, count);
+        const char* err;
+        if(IS_HASH(pv->array[i])) PTR(pv->array[i]).hash->proto = 1;
+        err = getMember_r(ctx, pv->array[i], field, out, count, cacheable);
         if(err) return err; /* either an error or success */
     }
     return 0;
@@ -473,11 +506,77 @@ static const char* getMember_r(naContext ctx, naRef obj, naRef field, naRef* out
 static void getMember(naContext ctx, naRef obj, naRef fld,
                       naRef* result, int count)
 {
-    const char* err = getMember_r(ctx, obj, fld, result, count);
+    int cacheable;
+    const char* err = getMember_r(ctx, obj, fld, result, count, &cacheable);
     if(!err)   naRuntimeError(ctx, "No such member: %s", naStr_data(fld));
     if(err[0]) naRuntimeError(ctx, err);
 }
 
+// Inline caches for OP_MEMBER, one per field constant of a function.
+// Each remembers, for the last few "parents" vectors seen, the value
+// found by walking them.  Every vector and hash walked through gets its
+// proto flag set, so that changing it bumps naMemberEpoch and thereby
+// invalidates all entries.
+#define MEMBER_CACHE_WAYS 2
+
+struct MemberCache {
+    struct naVec* parents[MEMBER_CACHE_WAYS];
+    unsigned int epoch[MEMBER_CACHE_WAYS];
+    naRef val[MEMBER_CACHE_WAYS];
+};
+
+unsigned int naMemberEpoch = 0;
+
+static void getCachedMember(naContext ctx, struct naCode* cd, int idx,
+                            naRef obj, naRef* result)
+{
+    int i, cacheable = 1;
+    naRef p, fld = cd->constants[idx];
+    struct MemberCache* mc;
+    struct naVec* pv;
+    const char* err;
+
+    // Only lookups on hashes go through parents that can be tracked,
+    // and the caches are not safe to fill from several threads.
+    if(!IS_HASH(obj) || globals->nThreads > 1) {
+        getMember(ctx, obj, fld, result, 64);
+        return;
+    }
+    if(naHash_get(obj, fld, result))
+        return;
+    if(naHash_get(obj, globals->parentsRef, &p) && IS_VEC(p) && cd->mcache) {
+        pv = PTR(p).vec;
+        mc = &cd->mcache[idx];
+        for(i=0; i<MEMBER_CACHE_WAYS; i++)
+            if(mc->parents[i] == pv && mc->epoch[i] == naMemberEpoch) {
+                *result = mc->val[i];
+                return;
+            }
+    }
+
+    err = getMember_r(ctx, obj, fld, result, 64, &cacheable);
+    if(!err)   naRuntimeError(ctx, "No such member: %s", naStr_data(fld));
+    if(err[0]) naRuntimeError(ctx, err);
+    if(!cacheable)
+        return;
+
+    // Found through the parents (the walk checked they are a vector)
+    if(!cd->mcache) {
+        int sz = sizeof(struct MemberCache) * cd->nConstants;
+        cd->mcache = naAlloc(sz);
+        naBZero(cd->mcache, sz);
+    }
+    mc = &cd->mcache[idx];
+    for(i=MEMBER_CACHE_WAYS-1; i>0; i--) {
+        mc->parents[i] = mc->parents[i-1];
+        mc->epoch[i] = mc->epoch[i-1];
+        mc->val[i] = mc->val[i-1];
+    }
+    mc->parents[0] = PTR(p).vec;
+    mc->epoch[0] = naMemberEpoch;
+    mc->val[0] = *result;
+}
+
 static void setMember(naContext ctx, naRef obj, naRef fld, naRef value)
 {
     if (IS_GHOST(obj)) {
@@ -495,7 +594,8 @@ static void setMember(naContext ctx, naRef obj, naRef fld, naRef value)
 
 int naMember_get(naContext ctx, naRef obj, naRef field, naRef* out)
 {
-    const char* err = getMember_r(ctx, obj, field, out, 64);
+    int cacheable;
+    const char* err = getMember_r(ctx, obj, field, out, 64, &cacheable);
     return err && !err[0];
 }
 
@@ -557,6 +657,26 @@ static void evalSlice2(naContext ctx, naRef src, naRef dst,
 #define STK(n) (ctx->opStack[ctx->opTop-(n)])
 #define SETFRAME(F) f = (F); cd = PTR(PTR(f->func).func->code).code;
 #define FIXFRAME() SETFRAME(&(ctx->fStack[ctx->fTop-1]))
+
+// With GCC and clang, every opcode handler jumps straight to the next
+// handler through a table of label addresses ("computed goto"), which
+// gives each handler its own, better predicted, indirect branch.  The
+// switch still handles the first instruction, and other compilers.
+// Bytecode may come from a cache on disk, so opcodes out of range and
+// unused slots of the table lead to the error for bad opcodes.
+#if defined(__GNUC__) && !defined(INTERPRETER_DUMP)
+# define OPCASE(o) case o: L_##o
+# define BADOP() default: L_BADOP
+# define NEXT() { ctx->ntemps = 0;                                      \
+                  op = BYTECODE(cd)[f->ip++];                           \
+                  goto *dispatch[(unsigned)op < NUM_OPCODES              \
+                                 ? op : NUM_OPCODES]; }
+#else
+# define OPCASE(o) case o
+# define BADOP() default
+# define NEXT() break
+#endif
+
 static naRef run(naContext ctx)
 {
     struct Frame* f;
@@ -564,6 +684,28 @@ static naRef run(naContext ctx)
     int op, arg;
     naRef a, b;
 
+#if defined(__GNUC__) && !defined(INTERPRETER_DUMP)
+#   define L(o) [o] = &&L_##o
+    static void* dispatch[NUM_OPCODES + 1] = {
+        [0 ... NUM_OPCODES] = &&L_BADOP,
+        L(OP_NOT), L(OP_MUL), L(OP_PLUS), L(OP_MINUS), L(OP_DIV), L(OP_NEG),
+        L(OP_CAT), L(OP_LT), L(OP_LTE), L(OP_GT), L(OP_GTE), L(OP_EQ),
+        L(OP_NEQ), L(OP_EACH), L(OP_JMP), L(OP_JMPLOOP), L(OP_JIFNOTPOP),
+        L(OP_JIFEND), L(OP_FCALL), L(OP_MCALL), L(OP_RETURN),
+        L(OP_PUSHCONST), L(OP_PUSHONE), L(OP_PUSHZERO), L(OP_PUSHNIL),
+        L(OP_POP), L(OP_DUP), L(OP_XCHG), L(OP_INSERT), L(OP_EXTRACT),
+        L(OP_MEMBER), L(OP_SETMEMBER), L(OP_LOCAL), L(OP_SETLOCAL),
+        L(OP_NEWVEC), L(OP_VAPPEND), L(OP_NEWHASH), L(OP_HAPPEND),
+        L(OP_MARK), L(OP_UNMARK), L(OP_BREAK), L(OP_SETSYM), L(OP_DUP2),
+        L(OP_INDEX), L(OP_BREAK2), L(OP_PUSHEND), L(OP_JIFTRUE),
+        L(OP_JIFNOT), L(OP_FCALLH), L(OP_MCALLH), L(OP_XCHG2), L(OP_UNPACK),
+        L(OP_SLICE), L(OP_SLICE2), L(OP_BIT_AND), L(OP_BIT_OR),
+        L(OP_BIT_XOR), L(OP_BIT_NEG), L(OP_LCONSTOP), L(OP_LSMALLOP),
+        L(OP_LLOCALOP), L(OP_LMEMBER)
+    };
+#   undef L
+#endif
+
     ctx->dieArg = naNil();
     ctx->error[0] = 0;
 
@@ -574,11 +716,11 @@ static naRef run(naContext ctx)
         DBG(printf("Stack Depth: %d\n", ctx->opTop));
         DBG(printOpDEBUG(f->ip-1, op));
         switch(op) {
-        case OP_POP:  ctx->opTop--; break;
-        case OP_DUP:  PUSH(STK(1)); break;
-        case OP_DUP2: PUSH(STK(2)); PUSH(STK(2)); break;
-        case OP_XCHG:  a=STK(1); STK(1)=STK(2); STK(2)=a; break;
-        case OP_XCHG2: a=STK(1); STK(1)=STK(2); STK(2)=STK(3); STK(3)=a; break;
+        OPCASE(OP_POP):  ctx->opTop--; NEXT();
+        OPCASE(OP_DUP):  PUSH(STK(1)); NEXT();
+        OPCASE(OP_DUP2): PUSH(STK(2)); PUSH(STK(2)); NEXT();
+        OPCASE(OP_XCHG):  a=STK(1); STK(1)=STK(2); STK(2)=a; NEXT();
+        OPCASE(OP_XCHG2): a=STK(1); STK(1)=STK(2); STK(2)=STK(3); STK(3)=a; NEXT();
 
 #define BINOP(expr) do { \
     double l = IS_NUM(STK(2)) ? STK(2).num : numify(ctx, STK(2)); \
@@ -586,146 +728,147 @@ static naRef run(naContext ctx)
     SETNUM(STK(2), expr);                                         \
     ctx->opTop--; } while(0)
 
-        case OP_PLUS:  BINOP(l + r);         break;
-        case OP_MINUS: BINOP(l - r);         break;
-        case OP_MUL:   BINOP(l * r);         break;
-        case OP_DIV:   BINOP(l / r);         break;
-        case OP_LT:    BINOP(l <  r ? 1 : 0); break;
-        case OP_LTE:   BINOP(l <= r ? 1 : 0); break;
-        case OP_GT:    BINOP(l >  r ? 1 : 0); break;
-        case OP_GTE:   BINOP(l >= r ? 1 : 0); break;
-        case OP_BIT_AND: BINOP((int)l & (int)r); break;
-        case OP_BIT_OR:  BINOP((int)l | (int)r); break;
-        case OP_BIT_XOR: BINOP((int)l ^ (int)r); break;
+        OPCASE(OP_PLUS):  BINOP(l + r);         NEXT();
+        OPCASE(OP_MINUS): BINOP(l - r);         NEXT();
+        OPCASE(OP_MUL):   BINOP(l * r);         NEXT();
+        OPCASE(OP_DIV):   BINOP(l / r);         NEXT();
+        OPCASE(OP_LT):    BINOP(l <  r ? 1 : 0); NEXT();
+        OPCASE(OP_LTE):   BINOP(l <= r ? 1 : 0); NEXT();
+        OPCASE(OP_GT):    BINOP(l >  r ? 1 : 0); NEXT();
+        OPCASE(OP_GTE):   BINOP(l >= r ? 1 : 0); NEXT();
+        OPCASE(OP_BIT_AND): BINOP((int)l & (int)r); NEXT();
+        OPCASE(OP_BIT_OR):  BINOP((int)l | (int)r); NEXT();
+        OPCASE(OP_BIT_XOR): BINOP((int)l ^ (int)r); NEXT();
 #undef BINOP
 
-        case OP_EQ: case OP_NEQ:
+        OPCASE(OP_EQ): OPCASE(OP_NEQ):
             STK(2) = evalEquality(op, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_CAT:
+            NEXT();
+        OPCASE(OP_CAT):
             STK(2) = evalCat(ctx, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_NEG:
+            NEXT();
+        OPCASE(OP_NEG):
             STK(1) = naNum(-numify(ctx, STK(1)));
-            break;
-        case OP_BIT_NEG:
+            NEXT();
+        OPCASE(OP_BIT_NEG):
             STK(1) = naNum(~(int)numify(ctx, STK(1)));
-            break;
-        case OP_NOT:
+            NEXT();
+        OPCASE(OP_NOT):
             STK(1) = naNum(boolify(ctx, STK(1)) ? 0 : 1);
-            break;
-        case OP_PUSHCONST:
+            NEXT();
+        OPCASE(OP_PUSHCONST):
             a = CONSTARG();
             if(IS_CODE(a)) a = bindFunction(ctx, f, a);
             PUSH(a);
-            break;
-        case OP_PUSHONE:
+            NEXT();
+        OPCASE(OP_PUSHONE):
             PUSH(naNum(1));
-            break;
-        case OP_PUSHZERO:
+            NEXT();
+        OPCASE(OP_PUSHZERO):
             PUSH(naNum(0));
-            break;
-        case OP_PUSHNIL:
+            NEXT();
+        OPCASE(OP_PUSHNIL):
             PUSH(naNil());
-            break;
-        case OP_PUSHEND:
+            NEXT();
+        OPCASE(OP_PUSHEND):
             PUSH(endToken());
-            break;
-        case OP_NEWVEC:
+            NEXT();
+        OPCASE(OP_NEWVEC):
             PUSH(naNewVector(ctx));
-            break;
-        case OP_VAPPEND:
+            NEXT();
+        OPCASE(OP_VAPPEND):
             naVec_append(STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_NEWHASH:
+            NEXT();
+        OPCASE(OP_NEWHASH):
             PUSH(naNewHash(ctx));
-            break;
-        case OP_HAPPEND:
+            NEXT();
+        OPCASE(OP_HAPPEND):
             naHash_set(STK(3), STK(2), STK(1));
             ctx->opTop -= 2;
-            break;
-        case OP_LOCAL:
+            NEXT();
+        OPCASE(OP_LOCAL):
             a = CONSTARG();
             getLocal(ctx, f, &a, &b);
             PUSH(b);
-            break;
-        case OP_SETSYM:
+            NEXT();
+        OPCASE(OP_SETSYM):
             setSymbol(f, STK(1), STK(2));
             ctx->opTop--;
-            break;
-        case OP_SETLOCAL:
+            NEXT();
+        OPCASE(OP_SETLOCAL):
             naHash_set(f->locals, STK(1), STK(2));
             ctx->opTop--;
-            break;
-        case OP_MEMBER:
-            getMember(ctx, STK(1), CONSTARG(), &STK(1), 64);
-            break;
-        case OP_SETMEMBER:
+            NEXT();
+        OPCASE(OP_MEMBER):
+            getCachedMember(ctx, cd, ARG(), STK(1), &STK(1));
+            NEXT();
+        OPCASE(OP_SETMEMBER):
             setMember(ctx, STK(2), STK(1), STK(3));
-            break;
-        case OP_INSERT:
+            NEXT();
+        OPCASE(OP_INSERT):
             containerSet(ctx, STK(2), STK(1), STK(3));
             ctx->opTop -= 2;
-            break;
-        case OP_EXTRACT:
+            NEXT();
+        OPCASE(OP_EXTRACT):
             STK(2) = containerGet(ctx, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_SLICE:
+            NEXT();
+        OPCASE(OP_SLICE):
             evalSlice(ctx, STK(3), STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_SLICE2:
+            NEXT();
+        OPCASE(OP_SLICE2):
             evalSlice2(ctx, STK(4), STK(3), STK(2), STK(1));
             ctx->opTop -= 2;
-            break;
-        case OP_JMPLOOP:
-            // Identical to JMP, except for locking
+            NEXT();
+        OPCASE(OP_JMPLOOP):
+            // Identical to JMP, except for locking and profiling
             naCheckBottleneck();
+            if(naProfileFlag) naProfileSample(ctx);
             f->ip = BYTECODE(cd)[f->ip];
             DBG(printf("   [Jump to: %d]\n", f->ip));
-            break;
-        case OP_JMP:
+            NEXT();
+        OPCASE(OP_JMP):
             f->ip = BYTECODE(cd)[f->ip];
             DBG(printf("   [Jump to: %d]\n", f->ip));
-            break;
-        case OP_JIFEND:
+            NEXT();
+        OPCASE(OP_JIFEND):
             arg = ARG();
             if(IS_END(STK(1))) {
                 ctx->opTop--; // Pops **ONLY** if it's nil!
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFTRUE:
+            NEXT();
+        OPCASE(OP_JIFTRUE):
             arg = ARG();
             if(boolify(ctx, STK(1))) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFNOT:
+            NEXT();
+        OPCASE(OP_JIFNOT):
             arg = ARG();
             if(!boolify(ctx, STK(1))) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFNOTPOP:
+            NEXT();
+        OPCASE(OP_JIFNOTPOP):
             arg = ARG();
             if(!boolify(ctx, POP())) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_FCALL:  SETFRAME(setupFuncall(ctx, ARG(), 0, 0)); break;
-        case OP_MCALL:  SETFRAME(setupFuncall(ctx, ARG(), 1, 0)); break;
-        case OP_FCALLH: SETFRAME(setupFuncall(ctx,     1, 0, 1)); break;
-        case OP_MCALLH: SETFRAME(setupFuncall(ctx,     1, 1, 1)); break;
-        case OP_RETURN:
+            NEXT();
+        OPCASE(OP_FCALL):  SETFRAME(setupFuncall(ctx, ARG(), 0, 0)); NEXT();
+        OPCASE(OP_MCALL):  SETFRAME(setupFuncall(ctx, ARG(), 1, 0)); NEXT();
+        OPCASE(OP_FCALLH): SETFRAME(setupFuncall(ctx,     1, 0, 1)); NEXT();
+        OPCASE(OP_MCALLH): SETFRAME(setupFuncall(ctx,     1, 1, 1)); NEXT();
+        OPCASE(OP_RETURN):
             a = STK(1);
             ctx->dieArg = naNil();
             if(ctx->callChild) naFreeContext(ctx->callChild);
@@ -733,31 +876,62 @@ static naRef run(naContext ctx)
             ctx->opTop = f->bp + 1; // restore the correct opstack frame!
             STK(1) = a;
             FIXFRAME();
-            break;
-        case OP_EACH:
+            NEXT();
+        OPCASE(OP_EACH):
             evalEach(ctx, 0);
-            break;
-        case OP_INDEX:
+            NEXT();
+        OPCASE(OP_INDEX):
             evalEach(ctx, 1);
-            break;
-        case OP_MARK: // save stack state (e.g. "setjmp")
+            NEXT();
+        OPCASE(OP_MARK): // save stack state (e.g. "setjmp")
             if(ctx->markTop >= MAX_MARK_DEPTH)
                 ERR(ctx, "mark stack overflow");
             ctx->markStack[ctx->markTop++] = ctx->opTop;
-            break;
-        case OP_UNMARK: // pop stack state set by mark
+            NEXT();
+        OPCASE(OP_UNMARK): // pop stack state set by mark
             ctx->markTop--;
-            break;
-        case OP_BREAK: // restore stack state (FOLLOW WITH JMP!)
+            NEXT();
+        OPCASE(OP_BREAK): // restore stack state (FOLLOW WITH JMP!)
             ctx->opTop = ctx->markStack[ctx->markTop-1];
-            break;
-        case OP_BREAK2: // same, but also pop the mark stack
+            NEXT();
+        OPCASE(OP_BREAK2): // same, but also pop the mark stack
             ctx->opTop = ctx->markStack[--ctx->markTop];
-            break;
-        case OP_UNPACK:
+            NEXT();
+        OPCASE(OP_UNPACK):
             evalUnpack(ctx, ARG());
-            break;
-        default:
+            NEXT();
+        OPCASE(OP_LCONSTOP):
+            a = CONSTARG();
+            getLocal(ctx, f, &a, &a);
+            f->ip++;
+            b = CONSTARG();
+            arg = ARG();
+            PUSH(evalBinOp(ctx, arg, a, b));
+            NEXT();
+        OPCASE(OP_LSMALLOP):
+            a = CONSTARG();
+            getLocal(ctx, f, &a, &a);
+            b = naNum(ARG() == OP_PUSHONE ? 1 : 0);
+            arg = ARG();
+            PUSH(evalBinOp(ctx, arg, a, b));
+            NEXT();
+        OPCASE(OP_LLOCALOP):
+            a = CONSTARG();
+            getLocal(ctx, f, &a, &a);
+            f->ip++;
+            b = CONSTARG();
+            getLocal(ctx, f, &b, &b);
+            arg = ARG();
+            PUSH(evalBinOp(ctx, arg, a, b));
+            NEXT();
+        OPCASE(OP_LMEMBER):
+            a = CONSTARG();
+            getLocal(ctx, f, &a, &b);
+            PUSH(b);
+            f->ip++;
+            getCachedMember(ctx, cd, ARG(), STK(1), &STK(1));
+            NEXT();
+        BADOP():
             ERR(ctx, "BUG: bad opcode");
         }
         ctx->ntemps = 0; // reset GC temp vector
@@ -769,6 +943,9 @@ static naRef run(naContext ctx)
 #undef CONSTARG
 #undef STK
 #undef FIXFRAME
+#undef OPCASE
+#undef BADOP
+#undef NEXT
 
 void naSave(naContext ctx, naRef obj)
 {
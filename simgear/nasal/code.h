@@ -27,7 +27,14 @@ enum {
     OP_NEWHASH, OP_HAPPEND, OP_MARK, OP_UNMARK, OP_BREAK, OP_SETSYM, OP_DUP2,
     OP_INDEX, OP_BREAK2, OP_PUSHEND, OP_JIFTRUE, OP_JIFNOT, OP_FCALLH,
     OP_MCALLH, OP_XCHG2, OP_UNPACK, OP_SLICE, OP_SLICE2, OP_BIT_AND, OP_BIT_OR,
-    OP_BIT_XOR, OP_BIT_NEG
+    OP_BIT_XOR, OP_BIT_NEG,
+    // Superinstructions, written over the first opcode of a sequence
+    // by the code generator (see fuseOps())
+    OP_LCONSTOP,  // OP_LOCAL, OP_PUSHCONST (a number), binary operator
+    OP_LSMALLOP,  // OP_LOCAL, OP_PUSHONE or OP_PUSHZERO, binary operator
+    OP_LLOCALOP,  // OP_LOCAL, OP_LOCAL, binary operator
+    OP_LMEMBER,   // OP_LOCAL, OP_MEMBER
+    NUM_OPCODES
 };
 
 struct Frame {
@@ -42,6 +49,12 @@ struct Globals {
     struct naPool pools[NUM_NASAL_TYPES];
     int allocCount;
 
+    // Incremental collection state: objects marked but not yet scanned
+    int gcPhase;
+    int gcFull; // finish the collection in progress at the next pause
+    int gcStepCount; // allocations until the next incremental step
+    struct GrayStack gray;
+
     // Dead blocks waiting to be freed when it is safe
     void** deadBlocks;
     int deadsz;
@@ -54,6 +67,7 @@ struct Globals {
     int bottleneck;
     void* sem;
     void* lock;
+    void* strLock; // flattening ropes, see string.c
 
     // Constants
     naRef meRef;
@@ -122,6 +136,14 @@ void* naNewSem();
 void naFreeSem(void* sem);
 void naSemDown(void* sem);
 void naSemUp(void* sem, int count);
+int naNewThread(void (*fn)(void*), void* arg); // returns 0 on failure
+
+// Monotonic clock in microseconds, for bounding collector pauses
+double naTimeUsec();
+
+// Raised by naProfileTick(), the interpreter then calls naProfileSample()
+extern volatile int naProfileFlag;
+void naProfileSample(naContext ctx);
 
 void naCheckBottleneck();
 
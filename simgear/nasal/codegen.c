@@ -752,6 +752,62 @@ static void genExprList(struct Parser* p, struct Token* t)
     }
 }
 
+static int opSize(int op)
+{
+    switch(op) {
+    case OP_PUSHCONST: case OP_LOCAL: case OP_MEMBER: case OP_UNPACK:
+    case OP_FCALL: case OP_MCALL: case OP_JMP: case OP_JMPLOOP:
+    case OP_JIFNOTPOP: case OP_JIFEND: case OP_JIFTRUE: case OP_JIFNOT:
+        return 2;
+    }
+    return 1;
+}
+
+static int isBinOp(int op)
+{
+    switch(op) {
+    case OP_PLUS: case OP_MINUS: case OP_MUL: case OP_DIV: case OP_LT:
+    case OP_LTE: case OP_GT: case OP_GTE: case OP_EQ: case OP_NEQ:
+        return 1;
+    }
+    return 0;
+}
+
+// Peephole pass replacing the first opcode of frequent sequences with
+// a superinstruction which does the work of the whole sequence.  The
+// rest of the sequence stays in place (and is skipped over), so that
+// jumps into it and the line number table remain valid.  The
+// superinstructions only read opcodes which never start a sequence, so
+// overlapping sequences can be fused independently.
+static void fuseOps(struct Parser* p)
+{
+    unsigned short* bc = p->cg->byteCode;
+    int ip, next, n = p->cg->codesz;
+    for(ip = 0; ip < n; ip = next) {
+        next = ip + opSize(bc[ip]);
+        if(bc[ip] != OP_LOCAL || next + 1 >= n)
+            continue;
+        switch(bc[next]) {
+        case OP_PUSHCONST:
+            if(next + 2 < n && isBinOp(bc[next+2])
+               && IS_NUM(naVec_get(p->cg->consts, bc[next+1])))
+                bc[ip] = OP_LCONSTOP;
+            break;
+        case OP_PUSHONE: case OP_PUSHZERO:
+            if(isBinOp(bc[next+1]))
+                bc[ip] = OP_LSMALLOP;
+            break;
+        case OP_LOCAL:
+            if(next + 2 < n && isBinOp(bc[next+2]))
+                bc[ip] = OP_LLOCALOP;
+            break;
+        case OP_MEMBER:
+            bc[ip] = OP_LMEMBER;
+            break;
+        }
+    }
+}
+
 naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
 {
     int i;
@@ -772,6 +828,7 @@ naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
 
     genExprList(p, block);
     emit(p, OP_RETURN);
+    fuseOps(p);
     
     // Now make a code object
     codeObj = naNewCode(p->context);
@@ -799,6 +856,7 @@ naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
     code->nLines = cg.nextLineIp;
     code->srcFile = p->srcFile;
     code->constants = 0;
+    code->mcache = 0;
     code->constants = naAlloc((int)(size_t)(LINEIPS(code)+code->nLines));
     for(i=0; i<code->nConstants; i++)
         code->constants[i] = naVec_get(p->cg->consts, i);
@@ -371,6 +371,16 @@ namespace nasal
 
       typedef std::map<std::string, member_t> MemberMap;
 
+      /**
+       * Entry of the member table used for lookups from Nasal, with the
+       * Nasal function of a method cached.
+       */
+      struct member_entry_t
+      {
+        member_t* member;
+        naRef     func;
+      };
+
       /**
        * Register a new ghost type.
        *
@@ -442,6 +452,7 @@ namespace nasal
               member->second.func
             );
         }
+        updateMemberTable();
 
         if( !_fallback_setter )
           _fallback_setter = base->_fallback_setter;
@@ -585,7 +596,10 @@ namespace nasal
                      const setter_t& setter = setter_t() )
       {
         if( !getter.empty() || !setter.empty() )
+        {
           _members[field] = member_t(getter, setter);
+          updateMemberTable();
+        }
         else
           SG_LOG
           (
@@ -765,6 +779,7 @@ namespace nasal
       Ghost& method(const std::string& name, const method_t& func)
       {
         _members[name].func = new MethodHolder(func);
+        updateMemberTable();
         return *this;
       }
 
@@ -1205,6 +1220,11 @@ namespace nasal
       fallback_getter_t _fallback_getter;
       fallback_setter_t _fallback_setter;
 
+      /// Hash of interned member names to indices into _member_list, built
+      /// by updateMemberTable() whenever the members change
+      ObjectHolder<>                _member_table;
+      std::vector<member_entry_t>   _member_list;
+
       explicit Ghost(const std::string& name):
         GhostMetadata( name,
                        &_ghost_type_strong,
@@ -1303,6 +1323,54 @@ namespace nasal
         );
       }
 
+      /**
+       * Build the hash of member names used by findMember(). This happens
+       * whenever the members change, so that lookups, which may come from
+       * several threads, only read it.
+       */
+      void updateMemberTable()
+      {
+        naContext c = naNewContext();
+        naRef table = naNewHash(c);
+        std::vector<member_entry_t> list;
+        list.reserve(_members.size());
+        for( typename MemberMap::iterator member = _members.begin();
+                                          member != _members.end();
+                                        ++member )
+        {
+          member_entry_t entry = {
+            &member->second,
+            member->second.func ? member->second.func->get_naRef(c)
+                                : naNil()
+          };
+          naHash_set( table,
+                      naInternSymbol(to_nasal(c, member->first)),
+                      naNum(list.size()) );
+          list.push_back(entry);
+        }
+        _member_list.swap(list);
+        _member_table.reset(table);
+        naFreeContext(c);
+      }
+
+      /**
+       * Find a member by its Nasal name. Member names in Nasal code are
+       * interned symbols, so usually the hash lookup only compares
+       * pointers.
+       *
+       * @return The member, or NULL if there is no member with this name
+       */
+      const member_entry_t* findMember(naRef key) const
+      {
+        naRef index;
+        if(    !naIsString(key)
+            || !_member_table.valid()
+            || !naHash_get(_member_table.get_naRef(), key, &index) )
+          return NULL;
+
+        return &_member_list[ static_cast<size_t>(index.num) ];
+      }
+
       /**
        * Callback for retrieving a ghost member.
        */
@@ -1311,7 +1379,6 @@ namespace nasal
                                         naRef key,
                                         naRef* out )
       {
-        const std::string key_str = nasal::from_nasal<std::string>(c, key);
         // TODO merge instance parents with static class parents
 //        if( key_str == "parents" )
 //        {
@@ -1322,20 +1389,22 @@ namespace nasal
 //          return "";
 //        }
 
-        typename MemberMap::iterator member =
-          getSingletonPtr()->_members.find(key_str);
+        const member_entry_t* entry = getSingletonPtr()->findMember(key);
 
-        if( member == getSingletonPtr()->_members.end() )
+        if( !entry )
         {
           fallback_getter_t fallback_get = getSingletonPtr()->_fallback_getter;
           if(    !fallback_get
-              || !fallback_get(obj, c, key_str, *out) )
+              || !fallback_get( obj,
+                                c,
+                                nasal::from_nasal<std::string>(c, key),
+                                *out ) )
             return 0;
         }
-        else if( member->second.func )
-          *out = member->second.func->get_naRef(c);
-        else if( !member->second.getter.empty() )
-          *out = member->second.getter(obj, c);
+        else if( !naIsNil(entry->func) )
+          *out = entry->func;
+        else if( !entry->member->getter.empty() )
+          *out = entry->member->getter(obj, c);
         else
           return "Read-protected member";
 
@@ -1371,11 +1440,12 @@ namespace nasal
                                  naRef field,
                                  naRef val )
       {
-        const std::string key = nasal::from_nasal<std::string>(c, field);
-        const MemberMap& members = getSingletonPtr()->_members;
+        const member_entry_t* entry = getSingletonPtr()->findMember(field);
+        if( entry && !entry->member->setter.empty() && !entry->member->func )
+          return entry->member->setter(obj, c, val);
 
-        typename MemberMap::const_iterator member = members.find(key);
-        if( member == members.end() )
+        const std::string key = nasal::from_nasal<std::string>(c, field);
+        if( !entry )
         {
           fallback_setter_t fallback_set = getSingletonPtr()->_fallback_setter;
           if( !fallback_set )
@@ -1383,12 +1453,10 @@ namespace nasal
           else if( !fallback_set(obj, c, key, val) )
             naRuntimeError(c, "ghost: Failed to write (_set: %s)", key.c_str());
         }
-        else if( member->second.setter.empty() )
+        else if( entry->member->setter.empty() )
           naRuntimeError(c, "ghost: Write protected member: %s", key.c_str());
-        else if( member->second.func )
-          naRuntimeError(c, "ghost: Write to function: %s", key.c_str());
         else
-          member->second.setter(obj, c, val);
+          naRuntimeError(c, "ghost: Write to function: %s", key.c_str());
       }
 
       static void
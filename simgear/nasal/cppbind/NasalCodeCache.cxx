@@ -0,0 +1,162 @@
+// Cache of compiled Nasal code on disk
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#include "NasalCodeCache.hxx"
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#endif
+
+namespace nasal
+{
+
+  //----------------------------------------------------------------------------
+  CodeCache::Stats::Stats():
+    hits(0),
+    misses(0),
+    load_msec(0),
+    compile_msec(0)
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  CodeCache::CodeCache(const SGPath& dir):
+    _dir(dir)
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  naRef CodeCache::parse( naContext c,
+                          const std::string& filename,
+                          int first_line,
+                          const char* buf,
+                          int len,
+                          int* err_line )
+  {
+    SGTimeStamp st;
+    st.stamp();
+
+    naRef src_file = naStr_fromdata( naNewString(c),
+                                     filename.c_str(),
+                                     filename.length() );
+    SGPath path = entryPath(buf, len);
+
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    if( in )
+    {
+      std::string data( (std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>() );
+      naRef code = naLoadCode( c, src_file, first_line, buf, len,
+                               data.data(), data.size() );
+      if( naIsCode(code) )
+      {
+        _stats.hits += 1;
+        _stats.load_msec += st.elapsedMSec();
+        return code;
+      }
+
+      SG_LOG(SG_NASAL, SG_INFO, "Stale code cache entry for " << filename);
+    }
+
+    naRef code = naParseCode( c, src_file, first_line,
+                              const_cast<char*>(buf), len, err_line );
+    if( !naIsCode(code) )
+      return code;
+
+    // Write to a temporary file first, so that other threads and processes
+    // sharing the cache never see a partial entry.  Each writer uses its
+    // own temporary file, as several may compile the same code at once.
+    naRef data = naSaveCode(c, code, first_line, buf, len);
+    simgear::Dir dir(_dir);
+    if( naIsString(data) && (dir.exists() || dir.create(0755)) )
+    {
+      std::ostringstream tmp_name;
+      tmp_name << path.str() << "." << getpid()
+               << "." << SGThread::current() << ".tmp";
+      SGPath tmp(tmp_name.str());
+      std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary);
+      out.write(naStr_data(data), naStr_len(data));
+      out.close();
+
+      if( !out || !tmp.rename(path) )
+      {
+        SG_LOG(SG_NASAL, SG_WARN, "Failed to write " << path);
+        tmp.remove();
+      }
+    }
+
+    _stats.misses += 1;
+    _stats.compile_msec += st.elapsedMSec();
+    return code;
+  }
+
+  //----------------------------------------------------------------------------
+  void CodeCache::clear()
+  {
+    simgear::Dir dir(_dir);
+    if( !dir.exists() )
+      return;
+
+    simgear::PathList entries =
+      dir.children(simgear::Dir::TYPE_FILE, ".nbc");
+    for(size_t i = 0; i < entries.size(); ++i)
+      entries[i].remove();
+  }
+
+  //----------------------------------------------------------------------------
+  const CodeCache::Stats& CodeCache::stats() const
+  {
+    return _stats;
+  }
+
+  //----------------------------------------------------------------------------
+  void CodeCache::resetStats()
+  {
+    _stats = Stats();
+  }
+
+  //----------------------------------------------------------------------------
+  SGPath CodeCache::entryPath(const char* buf, int len) const
+  {
+    // 64 bit FNV-1a
+    unsigned long long hash = 14695981039346656037ULL;
+    for(int i = 0; i < len; ++i)
+      hash = (hash ^ static_cast<unsigned char>(buf[i])) * 1099511628211ULL;
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.nbc", hash);
+
+    SGPath path(_dir);
+    path.append(name);
+    return path;
+  }
+
+} // namespace nasal
@@ -0,0 +1,83 @@
+///@file
+/// Cache of compiled Nasal code on disk
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_NASAL_CODECACHE_HXX_
+#define SG_NASAL_CODECACHE_HXX_
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/nasal/nasal.h>
+
+#include <string>
+
+namespace nasal
+{
+
+  /**
+   * Keeps the compiled code of Nasal sources in a directory, so that
+   * unchanged modules are loaded from there instead of being parsed
+   * again (see naSaveCode()/naLoadCode()).  Entries are named after a
+   * 64 bit hash of the source text, and only used if the length and a
+   * 32 bit hash of the source stored in them match as well.  These are
+   * FNV hashes, so sources made to collide on purpose would load the
+   * wrong code.  Damaged or inconsistent entries are not loaded.
+   */
+  class CodeCache
+  {
+    public:
+      struct Stats
+      {
+        Stats();
+
+        unsigned int hits;      ///< sources loaded from the cache
+        unsigned int misses;    ///< sources compiled (and stored)
+        double load_msec;       ///< time spent loading cached code
+        double compile_msec;    ///< time spent compiling and storing
+      };
+
+      /**
+       * @param dir   Cache directory, created on first use
+       */
+      explicit CodeCache(const SGPath& dir);
+
+      /**
+       * Same as naParseCode(), but uses the cache.
+       */
+      naRef parse( naContext c,
+                   const std::string& filename,
+                   int first_line,
+                   const char* buf,
+                   int len,
+                   int* err_line );
+
+      /**
+       * Remove all entries from the cache directory.
+       */
+      void clear();
+
+      const Stats& stats() const;
+      void resetStats();
+
+    protected:
+      SGPath _dir;
+      Stats _stats;
+
+      SGPath entryPath(const char* buf, int len) const;
+  };
+
+} // namespace nasal
+
+#endif /* SG_NASAL_CODECACHE_HXX_ */
@@ -18,9 +18,126 @@
 
 #include "NasalContext.hxx"
 
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <vector>
+
 namespace nasal
 {
 
+  namespace
+  {
+    /// Requests a sample from the Nasal interpreter at a fixed interval
+    class ProfilerThread:
+      public SGThread
+    {
+      public:
+        ProfilerThread(int interval_usec):
+          _interval(SGTimeStamp::fromUSec(interval_usec)),
+          _running(true)
+        {}
+
+        virtual ~ProfilerThread()
+        {}
+
+        void stop()
+        {
+          SGGuard<SGMutex> lock(_mutex);
+          _running = false;
+        }
+
+        virtual void run()
+        {
+          for(;;)
+          {
+            SGTimeStamp::sleepFor(_interval);
+            {
+              SGGuard<SGMutex> lock(_mutex);
+              if( !_running )
+                return;
+            }
+            naProfileTick();
+          }
+        }
+
+      private:
+        SGTimeStamp _interval;
+        SGMutex _mutex;
+        bool _running;
+    };
+
+    ProfilerThread* profiler_thread = 0;
+    SGMutex profiler_mutex;
+
+    std::string frameName(const naProfileFrame& frame, bool func)
+    {
+      std::ostringstream name;
+      name << frame.file << ":" << (func ? frame.funcLine : frame.line);
+      return name.str();
+    }
+
+    void collectFolded(void* user, const naProfileFrame* frames,
+                       int depth, int count)
+    {
+      std::ostream& os = *static_cast<std::ostream*>(user);
+      for(int i = 0; i < depth; ++i)
+        os << (i ? ";" : "") << frameName(frames[i], true);
+      os << " " << count << "\n";
+    }
+
+    struct ProfileCounts
+    {
+      std::map<std::string, std::pair<int, int> > funcs; // self, total
+      std::map<std::string, int> lines;
+    };
+
+    void collectCounts(void* user, const naProfileFrame* frames,
+                       int depth, int count)
+    {
+      ProfileCounts& counts = *static_cast<ProfileCounts*>(user);
+      if( !depth )
+        return;
+
+      // Count recursive functions only once per stack
+      std::set<std::string> seen;
+      for(int i = 0; i < depth; ++i)
+      {
+        std::string func = frameName(frames[i], true);
+        if( seen.insert(func).second )
+          counts.funcs[func].second += count;
+      }
+
+      const naProfileFrame& leaf = frames[depth - 1];
+      counts.funcs[frameName(leaf, true)].first += count;
+      counts.lines[frameName(leaf, false)] += count;
+    }
+
+    template<class T>
+    bool bySelf(const std::pair<std::string, T>& a,
+                const std::pair<std::string, T>& b);
+
+    template<>
+    bool bySelf(const std::pair<std::string, std::pair<int, int> >& a,
+                const std::pair<std::string, std::pair<int, int> >& b)
+    {
+      return a.second.first > b.second.first;
+    }
+
+    template<>
+    bool bySelf(const std::pair<std::string, int>& a,
+                const std::pair<std::string, int>& b)
+    {
+      return a.second > b.second;
+    }
+  }
+
   //----------------------------------------------------------------------------
   Context::Context():
     _ctx(naNewContext())
@@ -46,4 +163,73 @@ namespace nasal
     return Hash(_ctx);
   }
 
+  //----------------------------------------------------------------------------
+  void Context::startProfiler(int interval_usec)
+  {
+    SGGuard<SGMutex> lock(profiler_mutex);
+    if( profiler_thread )
+      return;
+
+    naProfileStart();
+    profiler_thread = new ProfilerThread(interval_usec);
+    profiler_thread->start();
+  }
+
+  //----------------------------------------------------------------------------
+  void Context::stopProfiler()
+  {
+    SGGuard<SGMutex> lock(profiler_mutex);
+    if( !profiler_thread )
+      return;
+
+    naProfileStop();
+    profiler_thread->stop();
+    profiler_thread->join();
+    delete profiler_thread;
+    profiler_thread = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  bool Context::isProfiling()
+  {
+    return naProfileRunning();
+  }
+
+  //----------------------------------------------------------------------------
+  void Context::resetProfiler()
+  {
+    naProfileReset();
+  }
+
+  //----------------------------------------------------------------------------
+  void Context::writeFoldedStacks(std::ostream& os)
+  {
+    naProfileForEach(&collectFolded, &os);
+  }
+
+  //----------------------------------------------------------------------------
+  void Context::writeProfile(std::ostream& os)
+  {
+    ProfileCounts counts;
+    naProfileForEach(&collectCounts, &counts);
+
+    typedef std::pair<std::string, std::pair<int, int> > FuncEntry;
+    std::vector<FuncEntry> funcs(counts.funcs.begin(), counts.funcs.end());
+    std::stable_sort(funcs.begin(), funcs.end(), &bySelf<std::pair<int, int> >);
+
+    typedef std::pair<std::string, int> LineEntry;
+    std::vector<LineEntry> lines(counts.lines.begin(), counts.lines.end());
+    std::stable_sort(lines.begin(), lines.end(), &bySelf<int>);
+
+    os << naProfileSamples() << " samples\n"
+       << "functions (self total):\n";
+    for(size_t i = 0; i < funcs.size(); ++i)
+      os << "  " << funcs[i].second.first << " " << funcs[i].second.second
+         << " " << funcs[i].first << "\n";
+
+    os << "lines (self):\n";
+    for(size_t i = 0; i < lines.size(); ++i)
+      os << "  " << lines[i].second << " " << lines[i].first << "\n";
+  }
+
 } // namespace nasal
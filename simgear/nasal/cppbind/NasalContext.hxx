@@ -21,6 +21,8 @@
 
 #include "NasalHash.hxx"
 
+#include <iosfwd>
+
 namespace nasal
 {
 
@@ -37,6 +39,31 @@ namespace nasal
 
       Hash newHash();
 
+      /**
+       * Start the sampling profiler (see naProfileStart()), with a timer
+       * thread requesting a sample every @a interval_usec microseconds.
+       * Samples are added to those of earlier runs until resetProfiler().
+       */
+      static void startProfiler(int interval_usec = 1000);
+      static void stopProfiler();
+      static bool isProfiling();
+      static void resetProfiler();
+
+      /**
+       * Write the samples as folded stacks, the input format of
+       * flamegraph.pl: one line "frame;frame;frame count" per distinct
+       * stack, outermost frame first.  Frames are named "file:line"
+       * after the first line of their function.
+       */
+      static void writeFoldedStacks(std::ostream& os);
+
+      /**
+       * Write a summary of the samples: for every function the samples
+       * spent in it (self) and in it or its callees (total), then the
+       * self samples of every line.  Both sorted by self samples.
+       */
+      static void writeProfile(std::ostream& os);
+
     protected:
       naContext _ctx;
   };
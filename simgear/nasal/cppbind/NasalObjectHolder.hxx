@@ -142,7 +142,7 @@ namespace nasal
     _gc_key(0)
   {
     if( !naIsNil(obj) )
-      naGCSave(obj);
+      _gc_key = naGCSave(obj);
   }
 
   //----------------------------------------------------------------------------
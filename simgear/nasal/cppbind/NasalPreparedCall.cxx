@@ -0,0 +1,174 @@
+// Nasal function call prepared for being repeated from C++
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#include "NasalPreparedCall.hxx"
+
+namespace nasal
+{
+  enum RefIndex
+  {
+    REF_FUNC,
+    REF_SELF,
+    REF_OBJ,
+    REF_NAME,
+    REF_INTERNED
+  };
+
+  //----------------------------------------------------------------------------
+  PreparedCall::PreparedCall():
+    _func(naNil()),
+    _self(naNil())
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  PreparedCall::PreparedCall(naRef func, naRef self):
+    _func(naNil()),
+    _self(naNil())
+  {
+    setFunction(func, self);
+  }
+
+  //----------------------------------------------------------------------------
+  PreparedCall::PreparedCall(naRef obj, const std::string& name):
+    _func(naNil()),
+    _self(naNil())
+  {
+    setMethod(obj, name);
+  }
+
+  //----------------------------------------------------------------------------
+  void PreparedCall::setFunction(naRef func, naRef self)
+  {
+    if( !naIsFunc(func) && !naIsCode(func) )
+      func = naNil();
+
+    Context ctx;
+    setRefs(ctx, func, self, naNil(), naNil());
+  }
+
+  //----------------------------------------------------------------------------
+  void PreparedCall::setMethod(naRef obj, const std::string& name)
+  {
+    Context ctx;
+    // Interned, so that looking up the method compares the key by identity
+    setRefs(ctx, naNil(), obj, obj, naInternSymbol(to_nasal(ctx, name)));
+    resolve();
+  }
+
+  //----------------------------------------------------------------------------
+  void PreparedCall::setSelf(naRef self)
+  {
+    if( !_refs.valid() )
+    {
+      Context ctx;
+      setRefs(ctx, _func, self, naNil(), naNil());
+      return;
+    }
+
+    naVec_set(_refs.get_naRef(), REF_SELF, self);
+    _self = self;
+  }
+
+  //----------------------------------------------------------------------------
+  bool PreparedCall::resolve()
+  {
+    if( !_refs.valid() )
+      return valid();
+
+    naRef refs = _refs.get_naRef(),
+          obj = naVec_get(refs, REF_OBJ),
+          name = naVec_get(refs, REF_NAME);
+    if( naIsNil(name) )
+      return valid();
+
+    Context ctx;
+    naRef func;
+    if(    !naMember_get(ctx, obj, name, &func)
+        || !(naIsFunc(func) || naIsCode(func)) )
+      func = naNil();
+
+    naVec_set(refs, REF_FUNC, func);
+    _func = func;
+    return valid();
+  }
+
+  //----------------------------------------------------------------------------
+  bool PreparedCall::valid() const
+  {
+    return !naIsNil(_func);
+  }
+
+  //----------------------------------------------------------------------------
+  naRef PreparedCall::getFunction() const
+  {
+    return _func;
+  }
+
+  //----------------------------------------------------------------------------
+  naRef PreparedCall::getSelf() const
+  {
+    return _self;
+  }
+
+  //----------------------------------------------------------------------------
+  naRef PreparedCall::intern(const std::string& str)
+  {
+    Context ctx;
+    if( !_refs.valid() )
+      setRefs(ctx, _func, _self, naNil(), naNil());
+
+    naRef s = to_nasal(ctx, str);
+    naVec_append(_refs.get_naRef(), s);
+    return s;
+  }
+
+  //----------------------------------------------------------------------------
+  void PreparedCall::setRefs( naContext c,
+                              naRef func,
+                              naRef self,
+                              naRef obj,
+                              naRef name )
+  {
+    naRef refs = naNewVector(c);
+    naVec_append(refs, func);
+    naVec_append(refs, self);
+    naVec_append(refs, obj);
+    naVec_append(refs, name);
+
+    // Keep strings interned earlier, they might still be used as arguments
+    if( _refs.valid() )
+    {
+      naRef old = _refs.get_naRef();
+      for(int i = REF_INTERNED; i < naVec_size(old); ++i)
+        naVec_append(refs, naVec_get(old, i));
+    }
+
+    _refs.reset(refs);
+    _func = func;
+    _self = self;
+  }
+
+  //----------------------------------------------------------------------------
+  void PreparedCall::checkError(naContext c)
+  {
+    const char* error = naGetError(c);
+    if( error )
+      throw std::runtime_error(error);
+  }
+
+} // namespace nasal
@@ -0,0 +1,164 @@
+///@file
+/// Nasal function call prepared for being repeated from C++
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_NASAL_PREPARED_CALL_HXX_
+#define SG_NASAL_PREPARED_CALL_HXX_
+
+#include "NasalContext.hxx"
+#include "NasalObjectHolder.hxx"
+#include "from_nasal.hxx"
+#include "to_nasal.hxx"
+
+#include <boost/call_traits.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/preprocessor/iteration/iterate.hpp>
+#include <boost/preprocessor/repetition/enum.hpp>
+#include <boost/preprocessor/repetition/enum_binary_params.hpp>
+#include <boost/preprocessor/repetition/enum_trailing_params.hpp>
+#include <boost/type_traits/is_void.hpp>
+#include <boost/utility/enable_if.hpp>
+
+#include <stdexcept>
+#include <string>
+
+namespace nasal
+{
+
+  /**
+   * Call of a Nasal function which is repeated often from C++ (eg. every
+   * frame).  Unlike Object::callMethod or a boost::function converted
+   * from Nasal, the function (or method) is looked up only once and the
+   * call itself does not allocate anything on the C++ side: arguments
+   * are converted into a buffer on the stack, numbers and booleans
+   * without touching the Nasal heap.  Strings passed as std::string are
+   * still converted on every call, use intern() to convert them once.
+   *
+   * @code
+   * nasal::PreparedCall update(obj, "update");
+   * naRef mode = update.intern("cruise");
+   *
+   * // every frame
+   * double pos = update.call<double>(dt, mode);
+   * @endcode
+   *
+   * Errors raised by the Nasal code are thrown as std::runtime_error.
+   * The function, "me" and interned strings are saved from the garbage
+   * collector for the lifetime of the PreparedCall.
+   */
+  class PreparedCall:
+    private boost::noncopyable
+  {
+    public:
+
+      /**
+       * Empty call, not valid() until assigned with setFunction() or
+       * setMethod()
+       */
+      PreparedCall();
+
+      /**
+       * @param func  Function or code object to call
+       * @param self  Value of "me" inside the function
+       */
+      explicit PreparedCall(naRef func, naRef self = naNil());
+
+      /**
+       * Call method @a name of the Nasal object @a obj (a hash, possibly
+       * inheriting the method from its parents) with "me" set to @a obj.
+       */
+      PreparedCall(naRef obj, const std::string& name);
+
+      /**
+       * @see PreparedCall(naRef, naRef)
+       */
+      void setFunction(naRef func, naRef self = naNil());
+
+      /**
+       * @see PreparedCall(naRef, const std::string&)
+       */
+      void setMethod(naRef obj, const std::string& name);
+
+      /**
+       * Change the value of "me" used for further calls.
+       */
+      void setSelf(naRef self);
+
+      /**
+       * Look up the method again, eg. after it has been replaced by the
+       * Nasal code.  Does nothing for calls to a plain function.
+       *
+       * @return Whether the method has been found
+       */
+      bool resolve();
+
+      /**
+       * Whether there is a function to call
+       */
+      bool valid() const;
+
+      naRef getFunction() const;
+      naRef getSelf() const;
+
+      /**
+       * Convert @a str to a Nasal string once, to pass it to call()
+       * without allocating a new string every time.  The string is kept
+       * until this PreparedCall is destroyed, so only use it while setting
+       * up the call, not for every call.
+       */
+      naRef intern(const std::string& str);
+
+      // Build dependency for CMake, gcc, etc.
+#define SG_DONT_DO_ANYTHING
+# include <simgear/nasal/cppbind/detail/PreparedCall_call_templates.hxx>
+#undef SG_DONT_DO_ANYTHING
+
+#define BOOST_PP_ITERATION_LIMITS (0, 9)
+#define BOOST_PP_FILENAME_1 <simgear/nasal/cppbind/detail/PreparedCall_call_templates.hxx>
+#include BOOST_PP_ITERATE()
+
+    protected:
+      /// [function, me, object, method name, interned strings...]
+      ObjectHolder<> _refs;
+      naRef _func,
+            _self;
+
+      void setRefs(naContext c, naRef func, naRef self, naRef obj, naRef name);
+
+      /**
+       * Throw the error of the last call in @a c, if there was one.
+       */
+      static void checkError(naContext c);
+
+      template<class Ret>
+      static typename boost::disable_if<boost::is_void<Ret>, Ret>::type
+      result(Context& c, naRef ret)
+      {
+        checkError(c);
+        return from_nasal_helper(c, ret, static_cast<Ret*>(0));
+      }
+
+      template<class Ret>
+      static typename boost::enable_if<boost::is_void<Ret>, Ret>::type
+      result(Context& c, naRef)
+      {
+        checkError(c);
+      }
+  };
+
+} // namespace nasal
+
+#endif /* SG_NASAL_PREPARED_CALL_HXX_ */
@@ -0,0 +1,36 @@
+#ifndef SG_NASAL_PREPARED_CALL_HXX_
+# error Nasal cppbind - do not include this file!
+#endif
+
+#ifndef SG_DONT_DO_ANYTHING
+#define n BOOST_PP_ITERATION()
+
+#define SG_CALL_ARG(z, n, dummy)\
+      to_nasal<typename boost::call_traits<A##n>::param_type>(ctx, a##n)
+
+  template<
+    class Ret
+    BOOST_PP_ENUM_TRAILING_PARAMS(n, class A)
+  >
+  Ret call( BOOST_PP_ENUM_BINARY_PARAMS(n, const A, & a) )
+  {
+    if( !valid() )
+      return Ret();
+
+    Context ctx;
+#if n
+    naRef args[n] = {
+      BOOST_PP_ENUM(n, SG_CALL_ARG, 0)
+    };
+#else
+    naRef* args = NULL;
+#endif
+
+    naRef ret = naCallMethodCtx(ctx, _func, _self, n, args, naNil());
+    return result<Ret>(ctx, ret);
+  }
+
+#undef SG_CALL_ARG
+
+#undef n
+#endif // SG_DONT_DO_ANYTHING
@@ -60,6 +60,20 @@ class TestContext:
       return naCallMethod(code, me, 0, 0, naNil());
     }
 
+    /// Run code which is expected to fail, return the error message
+    std::string error(const std::string& code_str, nasal::Me me)
+    {
+      int err_line = -1;
+      naRef code = naParseCode( c, to_nasal("<TextContext::error>"), 0,
+                                (char*)code_str.c_str(), code_str.length(),
+                                &err_line );
+      if( !naIsCode(code) )
+        throw std::runtime_error("Failed to parse code: " + code_str);
+
+      naCall(c, code, 0, 0, me, naNil());
+      return naGetError(c) ? naGetError(c) : "";
+    }
+
     template<class T>
     T exec(const std::string& code)
     {
@@ -1,8 +1,11 @@
 #define BOOST_TEST_MODULE cppbind
 #include <BoostTestTargetConfig.h>
 
+#include "TestContext.hxx"
 #include <simgear/nasal/cppbind/Ghost.hxx>
 #include <simgear/nasal/cppbind/NasalHash.hxx>
+#include <simgear/nasal/cppbind/NasalObject.hxx>
+#include <simgear/nasal/cppbind/NasalPreparedCall.hxx>
 #include <simgear/nasal/cppbind/NasalString.hxx>
 #include <simgear/math/SGMath.hxx>
 #include <simgear/structure/map.hxx>
@@ -456,3 +459,109 @@ BOOST_AUTO_TEST_CASE( cppbind_misc_testing )
 
   naFreeContext(c);
 }
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( cppbind_prepared_call )
+{
+  TestContext c;
+  using nasal::PreparedCall;
+
+  naRef obj = c.exec(
+    "var Base = { scale: func(x) x * me.factor };"
+    "var obj = { parents: [Base], factor: 3, count: 0 };"
+    "obj.next = func { me.count += 1; };"
+    "obj.label = func(name, n) name ~ n;"
+    "obj.fail = func me.no_such_method();"
+    "obj;",
+    naNil()
+  );
+  BOOST_REQUIRE( naIsHash(obj) );
+  naTempSave(c.c, obj);
+
+  PreparedCall invalid;
+  BOOST_CHECK( !invalid.valid() );
+  BOOST_CHECK_EQUAL( invalid.call<int>(2), 0 );
+
+  PreparedCall missing(obj, "missing");
+  BOOST_CHECK( !missing.valid() );
+
+  // inherited method, "me" is the object
+  PreparedCall scale(obj, "scale");
+  BOOST_REQUIRE( scale.valid() );
+  BOOST_CHECK_EQUAL( scale.call<int>(2), 6 );
+  BOOST_CHECK_EQUAL( scale.call<double>(0.5), 1.5 );
+
+  // void result
+  PreparedCall next(obj, "next");
+  next.call<void>();
+  next.call<void>();
+  BOOST_CHECK_EQUAL( nasal::Hash(obj, c.c).get<int>("count"), 2 );
+
+  // interned strings and other arguments
+  PreparedCall label(obj, "label");
+  naRef name = label.intern("value ");
+  naGC();
+  BOOST_CHECK_EQUAL( label.call<std::string>(name, 4), "value 4" );
+  BOOST_CHECK_EQUAL( label.call<std::string>(std::string("x"), true), "x1" );
+
+  // the method is only looked up again on request
+  naRef base = naVec_get(nasal::Hash(obj, c.c).get<naRef>("parents"), 0);
+  nasal::Hash(base, c.c).set("scale", naNil());
+  naGC();
+  BOOST_CHECK_EQUAL( scale.call<int>(2), 6 );
+  BOOST_CHECK( !scale.resolve() );
+  BOOST_CHECK_EQUAL( scale.call<int>(2), 0 );
+
+  // plain function with a different "me"
+  naRef other = c.exec("{ factor: 10 };", naNil());
+  naTempSave(c.c, other);
+  PreparedCall func(obj); // not a function
+  BOOST_CHECK( !func.valid() );
+  func.setFunction(nasal::Hash(obj, c.c).get<naRef>("label"), other);
+  BOOST_CHECK( naIsIdentical(func.getSelf(), other) );
+  BOOST_CHECK_EQUAL( func.call<std::string>(std::string("a"), 1), "a1" );
+
+  // errors are thrown
+  PreparedCall fail(obj, "fail");
+  BOOST_CHECK_THROW( fail.call<void>(), std::runtime_error );
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( cppbind_prepared_call_paths )
+{
+  TestContext c;
+  nasal::Object::setupGhost();
+
+  // the same method, called in the three ways C++ code can call Nasal
+  naRef impl = c.exec(
+    "var Base = { update: func(dt, mode) mode == 'on' ? dt * 2 : dt };"
+    "{ parents: [Base] };",
+    naNil()
+  );
+  BOOST_REQUIRE( naIsHash(impl) );
+  naTempSave(c.c, impl);
+
+  const int num_calls = 1000;
+  const double dt = 0.25;
+
+  nasal::ObjectRef obj = new nasal::Object(impl);
+  double sum = 0;
+  for(int i = 0; i < num_calls; ++i)
+    sum += obj->callMethod<double>("update", dt, std::string("on"));
+  BOOST_CHECK_EQUAL( sum, num_calls * 0.5 );
+
+  typedef boost::function<double (nasal::Me, double, std::string)> UpdateFunc;
+  UpdateFunc update = nasal::get_member<UpdateFunc>(c.c, impl, "update");
+  BOOST_REQUIRE( update );
+  sum = 0;
+  for(int i = 0; i < num_calls; ++i)
+    sum += update(impl, dt, "on");
+  BOOST_CHECK_EQUAL( sum, num_calls * 0.5 );
+
+  nasal::PreparedCall prepared(impl, "update");
+  naRef on = prepared.intern("on");
+  sum = 0;
+  for(int i = 0; i < num_calls; ++i)
+    sum += prepared.call<double>(dt, on);
+  BOOST_CHECK_EQUAL( sum, num_calls * 0.5 );
+}
@@ -1,6 +1,7 @@
 #define BOOST_TEST_MODULE cppbind
 #include <BoostTestTargetConfig.h>
 
+#include "TestContext.hxx"
 #include <simgear/nasal/cppbind/Ghost.hxx>
 #include <simgear/nasal/cppbind/NasalContext.hxx>
 
@@ -186,3 +187,90 @@ BOOST_AUTO_TEST_CASE( storage_traits )
 
   nasal::shared_ptr_storage<DerivedWeakPtr>::unref(d_weak);
 }
+
+//------------------------------------------------------------------------------
+class Counter:
+  public SGReferenced
+{
+  public:
+    Counter(): _count(0) {}
+
+    int getCount() const { return _count; }
+    void setCount(int count) { _count = count; }
+    int increment(int step) { return _count += step; }
+    int decrement(int step) { return _count -= step; }
+    bool getMember(const std::string& key, std::string& val_out) const
+    {
+      if( key != "dynamic" )
+        return false;
+
+      val_out = "fallback";
+      return true;
+    }
+
+  protected:
+    int _count;
+};
+
+typedef SGSharedPtr<Counter> CounterPtr;
+
+BOOST_AUTO_TEST_CASE( ghost_member_table )
+{
+  nasal::Ghost<CounterPtr>::init("Counter")
+    .member("count", &Counter::getCount, &Counter::setCount)
+    .method("increment", &Counter::increment)
+    ._get(&Counter::getMember);
+  TestContext c;
+
+  CounterPtr counter = new Counter();
+  naRef me = c.to_nasal(counter);
+  naTempSave(c.c, me);
+
+  BOOST_CHECK_EQUAL( c.from_nasal<int>(c.exec(
+    "me.increment(2); me.increment(3); me.count;", me
+  )), 5 );
+  BOOST_CHECK_EQUAL( c.from_nasal<std::string>(c.exec(
+    "me.dynamic;", me
+  )), "fallback" );
+  BOOST_CHECK_EQUAL( c.error("me.decrement;", me),
+                     "No such member: decrement" );
+
+  // the same method object is returned every time
+  BOOST_CHECK_EQUAL( c.from_nasal<int>(c.exec(
+    "var f = me.increment; f == me.increment;", me
+  )), 1 );
+
+  // members registered later are found
+  nasal::Ghost<CounterPtr>::init("Counter")
+    .member("count", &Counter::getCount, &Counter::setCount)
+    .method("increment", &Counter::increment)
+    .method("decrement", &Counter::decrement);
+  BOOST_CHECK_EQUAL( c.from_nasal<int>(c.exec(
+    "me.count = 10; me.decrement(4);", me
+  )), 6 );
+  BOOST_CHECK_EQUAL( counter->getCount(), 6 );
+
+  // writing to a method fails
+  BOOST_CHECK_EQUAL( c.error("me.increment = 1;", me),
+                     "ghost: Write protected member: increment" );
+
+  // lookups in a ghost with as many members as eg. a Canvas element
+  nasal::Ghost<CounterPtr>& ghost = nasal::Ghost<CounterPtr>::init("Counter")
+    .member("count", &Counter::getCount, &Counter::setCount)
+    .method("increment", &Counter::increment);
+  for(char m = 'a'; m <= 'z'; ++m)
+  {
+    ghost.method(std::string("method_") + m, &Counter::decrement);
+    ghost.member(std::string("member_") + m, &Counter::getCount);
+  }
+
+  counter->setCount(0);
+  BOOST_CHECK_EQUAL( c.from_nasal<int>(c.exec(
+    "var sum = 0;"
+    "for(var i = 0; i < 100; i += 1) {"
+    "  me.increment(1);"
+    "  sum += me.count;"
+    "}"
+    "sum + me.method_q(50) + me.member_z;", me
+  )), 5050 + 50 + 50 );
+}
@@ -0,0 +1,107 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+#include <simgear/timing/timestamp.hxx>
+#include <iostream>
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( superinstructions )
+{
+  TestContext c;
+
+  // local and constant
+  BOOST_CHECK_EQUAL(c.exec<double>("var x = 3; x * 2.5"), 7.5);
+  BOOST_CHECK_EQUAL(c.exec<double>("var x = 3; x - 0.5"), 2.5);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 3; x / 2 == 1.5"), 1);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = '7'; x + 3"), 10);
+
+  // local and one or zero
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 3; x + 1"), 4);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 3; x - 1"), 2);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 3; x > 0"), 1);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 0; x == 0"), 1);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = nil; x != 0"), 1);
+
+  // two locals
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 3; var y = 4; x * y"), 12);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 3; var y = 4; x >= y"), 0);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 3; var y = 4; x <= y"), 1);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 'a'; var y = 'a'; x == y"), 1);
+  BOOST_CHECK_EQUAL(c.exec<int>("var x = 'a'; var y = 'b'; x != y"), 1);
+
+  // local and member
+  BOOST_CHECK_EQUAL(c.exec<int>("var h = { a: { b: 5 } }; h.a.b"), 5);
+
+  // compound assignment and loops
+  BOOST_CHECK_EQUAL(c.exec<int>(
+    "var sum = 0;"
+    "for(var i = 0; i < 100; i += 1) sum += i;"
+    "sum"), 4950);
+
+  // jumps into the middle of a fused sequence: the else branch of the
+  // conditional is fused with the addition, the then branch jumps to it
+  BOOST_CHECK_EQUAL(c.exec<int>(
+    "var x = 10; var y = 20; var c = 1; (c ? x : y) + 1"), 11);
+  BOOST_CHECK_EQUAL(c.exec<int>(
+    "var x = 10; var y = 20; var c = 0; (c ? x : y) + 1"), 21);
+  BOOST_CHECK_EQUAL(c.exec<int>(
+    "var x = 10; var y = 20; var c = 1; (c ? y : x) * y"), 400);
+  BOOST_CHECK_EQUAL(c.exec<int>(
+    "var h = { v: 3 }; var g = { v: 4 }; var c = 1; (c ? g : h).v"), 4);
+
+  // closures
+  BOOST_CHECK_EQUAL(c.exec<int>(
+    "var x = 5; var f = func(y) { x * y + 1 }; f(3)"), 16);
+}
+
+//------------------------------------------------------------------------------
+static double timeScript(TestContext& c, const char* name,
+                         const std::string& script, double expected)
+{
+  SGTimeStamp st;
+  st.stamp();
+  double result = c.exec<double>(script);
+  double msec = st.elapsedMSec();
+
+  BOOST_CHECK_EQUAL(result, expected);
+  std::cout << name << ": " << msec << " msec" << std::endl;
+  return msec;
+}
+
+BOOST_AUTO_TEST_CASE( interpreter_benchmark )
+{
+  TestContext c;
+
+  timeScript(c, "numeric loop",
+    "var sum = 0;"
+    "for(var i = 0; i < 1000000; i += 1) {"
+    "  var x = i * 0.5;"
+    "  if(x > 100) sum = sum + x - 100;"
+    "}"
+    "sum;", 249899760050.0);
+
+  timeScript(c, "nested loops",
+    "var n = 0;"
+    "for(var i = 0; i < 1000; i += 1)"
+    "  for(var j = 0; j < 1000; j += 1)"
+    "    if(i == j) n += 1;"
+    "n;", 1000);
+
+  timeScript(c, "field access",
+    "var obj = { x: 1, y: 2, pos: { lat: 0.5, lon: 0.25 } };"
+    "var sum = 0;"
+    "for(var i = 0; i < 500000; i += 1) {"
+    "  sum += obj.x + obj.y;"
+    "  sum += obj.pos.lat * obj.pos.lon;"
+    "}"
+    "sum;", 500000 * 3.125);
+
+  timeScript(c, "field update",
+    "var obj = { count: 0, total: 0 };"
+    "for(var i = 0; i < 500000; i += 1) {"
+    "  obj.count += 1;"
+    "  obj.total = obj.total + obj.count;"
+    "}"
+    "obj.total;", 500000.0 * 500001.0 / 2.0);
+}
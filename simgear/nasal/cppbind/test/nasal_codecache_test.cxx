@@ -0,0 +1,177 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/nasal/cppbind/NasalCodeCache.hxx>
+
+#include <fstream>
+#include <iostream>
+
+// A module with many functions, using argument lists with default and
+// rest arguments, nested functions, strings, hashes and vectors.
+static std::string makeModule(int nfuncs)
+{
+  std::ostringstream os;
+  os << "var Base = { new: func(id, name = 'base', scale = 1.5, rest...) {\n"
+        "  return { parents: [Base], id: id, name: name,\n"
+        "           scale: scale, extra: size(rest) };\n"
+        "}, value: func { me.id * me.scale + me.extra } };\n"
+        "var total = 0;\n";
+  for(int i = 0; i < nfuncs; ++i)
+    os << "var f" << i << " = func(a, b = " << i << ") {\n"
+          "  var obj = Base.new(a + b, 'obj" << i << "', 0.5, 1, 2);\n"
+          "  var inner = func(x) { x ~ ':' ~ obj.name };\n"
+          "  var v = [a, b, obj.value()];\n"
+          "  if(size(inner('k')) > 0 and v[2] != nil)\n"
+          "    return v[0] + v[1] + v[2];\n"
+          "  return -1;\n"
+          "};\n"
+          "total += f" << i << "(" << i << ");\n";
+  os << "total;\n";
+  return os.str();
+}
+
+static double expected(int nfuncs)
+{
+  double total = 0;
+  for(int i = 0; i < nfuncs; ++i)
+    total += 2 * i + (2 * i * 0.5 + 2);
+  return total;
+}
+
+// Replaces the checksum at the end of stored code, as naSaveCode() does
+static void resum(std::string& data)
+{
+  unsigned int h = 2166136261u;
+  for(size_t i = 0; i + 4 < data.size(); ++i)
+    h = (h ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  for(size_t i = 0; i < 4; ++i)
+    data[data.size() - 4 + i] = static_cast<char>(h >> (8 * i));
+}
+
+static double run(TestContext& c, naRef code)
+{
+  naRef ns = naInit_std(c.c);
+  naRef result = naCall(c.c, naBindFunction(c.c, code, ns), 0, 0, naNil(), naNil());
+  BOOST_REQUIRE( !naGetError(c.c) );
+  return naNumValue(result).num;
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( code_cache )
+{
+  TestContext c;
+  simgear::Dir dir = simgear::Dir::tempDir("nasal_code_cache");
+  dir.setRemoveOnDestroy();
+
+  const int nfuncs = 500;
+  const std::string src = makeModule(nfuncs);
+  int err_line;
+
+  // Cold start: compile and store
+  nasal::CodeCache cold(dir.path());
+  naRef code = cold.parse(c.c, "module.nas", 1, src.c_str(), src.size(), &err_line);
+  BOOST_REQUIRE( naIsCode(code) );
+  BOOST_CHECK_EQUAL(cold.stats().misses, 1);
+  BOOST_CHECK_EQUAL(cold.stats().hits, 0);
+  BOOST_CHECK_EQUAL(run(c, code), expected(nfuncs));
+  int key = naGCSave(code);
+
+  // Warm start: load the stored code, which must be identical
+  nasal::CodeCache warm(dir.path());
+  naRef loaded = warm.parse(c.c, "module.nas", 1, src.c_str(), src.size(), &err_line);
+  BOOST_REQUIRE( naIsCode(loaded) );
+  BOOST_CHECK_EQUAL(warm.stats().hits, 1);
+  BOOST_CHECK_EQUAL(warm.stats().misses, 0);
+  BOOST_CHECK_EQUAL(run(c, loaded), expected(nfuncs));
+
+  naRef a = naSaveCode(c.c, code, 1, src.c_str(), src.size()),
+        b = naSaveCode(c.c, loaded, 1, src.c_str(), src.size());
+  BOOST_CHECK_EQUAL( std::string(naStr_data(a), naStr_len(a)),
+                     std::string(naStr_data(b), naStr_len(b)) );
+  naGCRelease(key);
+
+  std::cout << nfuncs * 9 << " lines: compiled in "
+            << cold.stats().compile_msec << " msec, loaded in "
+            << warm.stats().load_msec << " msec" << std::endl;
+
+  // Changed source and first line are compiled again
+  const std::string changed = makeModule(nfuncs - 1);
+  loaded = warm.parse(c.c, "module.nas", 1, changed.c_str(), changed.size(), &err_line);
+  BOOST_CHECK_EQUAL(run(c, loaded), expected(nfuncs - 1));
+  loaded = warm.parse(c.c, "module.nas", 5, src.c_str(), src.size(), &err_line);
+  BOOST_CHECK( naIsCode(loaded) );
+  BOOST_CHECK_EQUAL(warm.stats().misses, 2);
+
+  // Damaged entries are ignored and replaced
+  simgear::PathList entries = dir.children(simgear::Dir::TYPE_FILE, ".nbc");
+  BOOST_CHECK_EQUAL(entries.size(), 2);
+  for(size_t i = 0; i < entries.size(); ++i)
+  {
+    std::fstream f(entries[i].c_str(),
+                   std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(100);
+    f.put('\xff');
+  }
+
+  loaded = warm.parse(c.c, "module.nas", 5, src.c_str(), src.size(), &err_line);
+  BOOST_CHECK_EQUAL(run(c, loaded), expected(nfuncs));
+  BOOST_CHECK_EQUAL(warm.stats().misses, 3);
+  loaded = warm.parse(c.c, "module.nas", 5, src.c_str(), src.size(), &err_line);
+  BOOST_CHECK_EQUAL(warm.stats().hits, 2);
+
+  // Parse errors are reported as by naParseCode()
+  char broken[] = "var x = 1;\nvar y = (;\n";
+  int parse_err_line;
+  naParseCode( c.c, c.to_nasal("broken.nas"), 1,
+               broken, strlen(broken), &parse_err_line );
+  loaded = warm.parse(c.c, "broken.nas", 1, broken, strlen(broken), &err_line);
+  BOOST_CHECK( naIsNil(loaded) );
+  BOOST_CHECK_EQUAL(err_line, parse_err_line);
+
+  warm.clear();
+  BOOST_CHECK( dir.children(simgear::Dir::TYPE_FILE, ".nbc").empty() );
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( code_cache_validation )
+{
+  TestContext c;
+  const std::string src = "var x = 1; while(x < 3) x += 1; x";
+  int err_line;
+  naRef src_file = c.to_nasal("loop.nas");
+  naRef code = naParseCode( c.c, src_file, 1, const_cast<char*>(src.c_str()),
+                            src.size(), &err_line );
+  BOOST_REQUIRE( naIsCode(code) );
+  naRef saved = naSaveCode(c.c, code, 1, src.c_str(), src.size());
+  std::string data(naStr_data(saved), naStr_len(saved));
+  BOOST_REQUIRE( naIsCode(naLoadCode( c.c, src_file, 1, src.c_str(), src.size(),
+                                      data.data(), data.size() )) );
+
+  // Find the bytecode: a 20 byte header, 11 bytes of sizes, and the
+  // constants, which are numbers and symbols in this case
+  const unsigned char* p =
+    reinterpret_cast<const unsigned char*>(data.data());
+  int nconsts = p[25] | p[26] << 8,
+      codesz = p[27] | p[28] << 8;
+  size_t pos = 31;
+  for(int i = 0; i < nconsts; ++i)
+  {
+    BOOST_REQUIRE( p[pos] == 1 || p[pos] == 2 || p[pos] == 3 );
+    pos += p[pos] == 1 ? 9 : 5 + (p[pos + 1] | p[pos + 2] << 8);
+  }
+
+  // Opcodes, constant indices and jump targets out of range are
+  // rejected, even with a valid checksum
+  for(int i = 0; i < codesz; ++i)
+  {
+    std::string bad = data;
+    bad[pos + 2 * i] = bad[pos + 2 * i + 1] = '\xff';
+    resum(bad);
+    BOOST_CHECK_MESSAGE( naIsNil(naLoadCode( c.c, src_file, 1,
+                                             src.c_str(), src.size(),
+                                             bad.data(), bad.size() )),
+                         "word " << i << " of the bytecode" );
+  }
+}
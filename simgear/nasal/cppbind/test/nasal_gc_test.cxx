@@ -2,8 +2,10 @@
 #include <BoostTestTargetConfig.h>
 
 #include "TestContext.hxx"
+#include <algorithm>
 #include <iostream>
 #include <set>
+#include <vector>
 
 static std::set<intptr_t> active_instances;
 
@@ -91,3 +93,108 @@ BOOST_AUTO_TEST_CASE( ghost_gc )
 
   BOOST_REQUIRE(active_instances.empty());
 }
+
+//------------------------------------------------------------------------------
+// Builds a large live heap, then runs "frames" which allocate garbage and
+// store new objects into the old ones (exercising the write barrier), and
+// reports the collector pauses.  The final check fails if the incremental
+// collector has freed anything still reachable.
+static const char* heap_script =
+  "var n = 40000;"
+  "var live = setsize([], n);"
+  "for(var i = 0; i < n; i += 1)"
+  "  live[i] = {id: i, name: 'obj' ~ i, pos: [i, 2 * i, 3 * i], peer: nil};"
+  "var tick = func(t) {"
+  "  var tmp = [];"
+  "  for(var j = 0; j < 100; j += 1)"
+  "    append(tmp, {a: j, b: 'x' ~ j});"
+  "  for(var j = 0; j < 20; j += 1) {"
+  "    var k = (t * 20 + j) * 7919;"
+  "    k = k - int(k / n) * n;"
+  "    live[k] = {id: k, name: 'obj' ~ k, pos: [k, 2 * k, 3 * k], peer: tmp[j]};"
+  "  }"
+  "};"
+  "var check = func {"
+  "  var sum = 0;"
+  "  forindex(var i; live) {"
+  "    var o = live[i];"
+  "    if(o.id != i or o.name != 'obj' ~ i or o.pos[2] != 3 * i) return -1;"
+  "    if(o.peer != nil and o.peer.b != 'x' ~ o.peer.a) return -1;"
+  "    sum += o.id;"
+  "  }"
+  "  return sum;"
+  "};"
+  "[tick, check];";
+
+static void runPauseBenchmark(TestContext& c, int mode, const char* name)
+{
+  naGCSetMode(mode, 500);
+
+  int err_line = -1;
+  naRef code = naParseCode( c.c, c.to_nasal("<gc_benchmark>"), 1,
+                            (char*)heap_script, strlen(heap_script),
+                            &err_line );
+  BOOST_REQUIRE( naIsCode(code) );
+
+  naRef ns = naInit_std(c.c);
+  naRef funcs = naCall(c.c, naBindFunction(c.c, code, ns), 0, 0, naNil(), naNil());
+  BOOST_REQUIRE( naVec_size(funcs) == 2 );
+  int key = naGCSave(funcs);
+
+  naGC();
+  naGCResetStats();
+
+  const int ticks = 3000;
+  std::vector<double> pauses;
+  naGCStats stats;
+  double total = 0;
+  for(int t = 0; t < ticks; ++t)
+  {
+    naRef arg = naNum(t);
+    naCall(c.c, naVec_get(funcs, 0), 1, &arg, naNil(), naNil());
+    BOOST_REQUIRE( !naGetError(c.c) );
+
+    // ticks allocate less than an incremental step interval, so there is
+    // at most one pause per tick
+    naGCGetStats(&stats);
+    if( stats.totalPause > total )
+      pauses.push_back(stats.totalPause - total);
+    total = stats.totalPause;
+  }
+
+  naRef sum = naCall(c.c, naVec_get(funcs, 1), 0, 0, naNil(), naNil());
+  BOOST_CHECK_EQUAL(naNumValue(sum).num, 40000.0 * 39999.0 / 2);
+
+  std::sort(pauses.begin(), pauses.end());
+  double p99 = pauses.empty() ? 0 : pauses[pauses.size() * 99 / 100];
+  std::cout << name << ": " << stats.cycles << " collections, "
+            << stats.pauses << " pauses, max " << stats.maxPause
+            << " usec, p99 " << p99 << " usec" << std::endl;
+
+  naGCRelease(key);
+  naGCSetMode(NA_GC_FULL, 500);
+}
+
+BOOST_AUTO_TEST_CASE( gc_pause_benchmark )
+{
+  TestContext c;
+  runPauseBenchmark(c, NA_GC_FULL, "full");
+  runPauseBenchmark(c, NA_GC_INCREMENTAL, "incremental");
+  c.runGC();
+}
+
+BOOST_AUTO_TEST_CASE( gc_parallel )
+{
+  TestContext c;
+  naGCSetThreads(3);
+  runPauseBenchmark(c, NA_GC_FULL, "full, 3 helper threads");
+  runPauseBenchmark(c, NA_GC_INCREMENTAL, "incremental, 3 helper threads");
+
+  // surplus helpers exit, and are started again when wanted
+  naGCSetThreads(1);
+  c.runGC();
+  naGCSetThreads(2);
+  c.runGC();
+  naGCSetThreads(0);
+  c.runGC();
+}
@@ -0,0 +1,139 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+#include <simgear/nasal/cppbind/NasalHash.hxx>
+#include <simgear/timing/timestamp.hxx>
+#include <iostream>
+
+class MathContext:
+  public TestContext
+{
+  public:
+    MathContext():
+      _me(c)
+    {
+      _me.set("math", naInit_math(c));
+      _me.set("std", naInit_std(c));
+    }
+
+    template<class T>
+    T run(const std::string& code)
+    {
+      return from_nasal<T>(exec("var math = me.math;" + code, _me.get_naRef()));
+    }
+
+    /// Run code which is expected to fail, return the error message
+    std::string error(const std::string& code)
+    {
+      return TestContext::error("var math = me.math;" + code, _me.get_naRef());
+    }
+
+  protected:
+    nasal::Hash _me;
+};
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( vector_math )
+{
+  MathContext c;
+
+  BOOST_CHECK_EQUAL(c.run<double>("math.vsum([1, 2, 3.5])"), 6.5);
+  BOOST_CHECK_EQUAL(c.run<double>("math.vsum([])"), 0);
+
+  typedef std::vector<double> Vec;
+  Vec v = c.run<Vec>("math.vscale([1, 2, 3], 0.5)");
+  BOOST_REQUIRE_EQUAL(v.size(), 3);
+  BOOST_CHECK_EQUAL(v[0], 0.5);
+  BOOST_CHECK_EQUAL(v[2], 1.5);
+
+  v = c.run<Vec>("math.vadd([1, 2, 3], [10, 20, 30])");
+  BOOST_REQUIRE_EQUAL(v.size(), 3);
+  BOOST_CHECK_EQUAL(v[1], 22);
+
+  v = c.run<Vec>("math.vadd([1, 2, 3], -1)");
+  BOOST_REQUIRE_EQUAL(v.size(), 3);
+  BOOST_CHECK_EQUAL(v[0], 0);
+  BOOST_CHECK_EQUAL(v[2], 2);
+
+  v = c.run<Vec>("math.vlerp([0, 10], [10, 20], 0.25)");
+  BOOST_REQUIRE_EQUAL(v.size(), 2);
+  BOOST_CHECK_EQUAL(v[0], 2.5);
+  BOOST_CHECK_EQUAL(v[1], 12.5);
+
+  v = c.run<Vec>("math.vmap(math.sqrt, [4, 9, 16])");
+  BOOST_REQUIRE_EQUAL(v.size(), 3);
+  BOOST_CHECK_EQUAL(v[0], 2);
+  BOOST_CHECK_EQUAL(v[2], 4);
+
+  // The output vector is reused and resized, and may be the input
+  BOOST_CHECK_EQUAL(c.run<int>(
+    "var out = [0, 0, 0, 0, 0];"
+    "var r = math.vscale([1, 2], 3, out);"
+    "(r == out) * 100 + out[0] + out[1]"), 109);
+  BOOST_CHECK_EQUAL(c.run<double>(
+    "var v = [1, 2, 3];"
+    "math.vadd(v, v, v); math.vmap(math.floor, math.vscale(v, 0.3, v), v);"
+    "v[0] * 100 + v[1] * 10 + v[2]"), 11);
+
+  // Errors for non numeric content, mismatched sizes and invalid results
+  BOOST_CHECK_EQUAL(c.error("math.vsum([1, 'a'])"),
+                    "non numeric element in vector passed to vsum()");
+  BOOST_CHECK_EQUAL(c.error("math.vscale({}, 2)"),
+                    "non vector argument to vscale()");
+  BOOST_CHECK_EQUAL(c.error("math.vadd([1, 2], [1])"),
+                    "vectors of different size passed to vadd()");
+  BOOST_CHECK_EQUAL(c.error("math.vmap(func(x) x, [1])"),
+                    "vmap() needs a unary math function");
+  BOOST_CHECK_EQUAL(c.error("math.vmap(math.ln, [1, 0])"),
+                    "floating point error in math.vmap()");
+
+  // an input given as the result is left alone on errors
+  BOOST_CHECK_EQUAL(c.run<int>(
+    "var v = [1, 0, 2];"
+    "var err = [];"
+    "me.std.call(math.vmap, [math.ln, v, v], nil, nil, err);"
+    "me.std.size(err) > 0 and v[0] == 1 and v[1] == 0 and v[2] == 2"), 1);
+}
+
+//------------------------------------------------------------------------------
+static double timeScript(MathContext& c, const char* name,
+                         const std::string& script, double expected)
+{
+  SGTimeStamp st;
+  st.stamp();
+  double result = c.run<double>(script);
+  double msec = st.elapsedMSec();
+
+  BOOST_CHECK_CLOSE(result, expected, 1e-9);
+  std::cout << name << ": " << msec << " msec" << std::endl;
+  return msec;
+}
+
+BOOST_AUTO_TEST_CASE( vector_math_benchmark )
+{
+  MathContext c;
+  const std::string setup =
+    "var n = 10000;"
+    "var setsize = me.std.setsize;"
+    "var x = setsize([], n); var y = setsize([], n); var tx = setsize([], n);"
+    "for(var i = 0; i < n; i += 1) { x[i] = i; y[i] = n - i; }";
+  const double expected = 100 * (0.5 * 0.25 * 9999 * 10000 / 2 + 10000 * 2);
+
+  // 100 frames of transforming and blending a 10000 point path
+  timeScript(c, "scripted loops", setup +
+    "var s = 0;"
+    "for(var f = 0; f < 100; f += 1) {"
+    "  for(var i = 0; i < n; i += 1) tx[i] = x[i] * 0.5 + (y[i] - x[i]) * 0;"
+    "  for(var i = 0; i < n; i += 1) s += tx[i] * 0.25 + 2;"
+    "}"
+    "s", expected);
+
+  timeScript(c, "vector builtins", setup +
+    "var s = 0;"
+    "for(var f = 0; f < 100; f += 1) {"
+    "  math.vlerp(math.vscale(x, 0.5, tx), y, 0, tx);"
+    "  s += math.vsum(math.vadd(math.vscale(tx, 0.25, tx), 2, tx));"
+    "}"
+    "s", expected);
+}
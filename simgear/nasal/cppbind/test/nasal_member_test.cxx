@@ -0,0 +1,109 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+#include <simgear/timing/timestamp.hxx>
+#include <iostream>
+
+// Class hierarchy of the given depth, each level overriding "level" and
+// adding a method of its own.
+static std::string hierarchy(int depth)
+{
+  std::ostringstream os;
+  os << "var C0 = { level: func 0, base: func me.id };";
+  for(int i = 1; i <= depth; ++i)
+    os << "var C" << i << " = { parents: [C" << i - 1 << "],"
+       << " level: func " << i << ", m" << i << ": func me.id + " << i << " };";
+  os << "var obj = { parents: [C" << depth << "], id: 7 };";
+  return os.str();
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( member_cache_invalidation )
+{
+  TestContext c;
+  const std::string classes = hierarchy(3);
+
+  // the same call site in a loop hits the cache after the first iteration
+  BOOST_CHECK_EQUAL(c.exec<int>(classes +
+    "var sum = 0;"
+    "for(var i = 0; i < 10; i += 1) sum += obj.base();"
+    "sum;"), 70);
+
+  // changing a method of a parent class
+  BOOST_CHECK_EQUAL(c.exec<int>(classes +
+    "var f = func obj.base();"
+    "var a = f(); var b = f();"
+    "C0.base = func me.id * 2;"
+    "a * 100 + b * 10 + f() - 14;"), 770);
+
+  // shadowing a method in an intermediate class, and replacing it again
+  BOOST_CHECK_EQUAL(c.exec<int>(classes +
+    "var f = func obj.base();"
+    "var a = f(); f();"
+    "C3.m1 = func 42;"
+    "C2.base = func 20;"
+    "var b = obj.base() + f();"
+    "C2.base = func 21;"
+    "a * 1000 + b * 10 + f();"), 7421);
+
+  // changing the parents vector of an intermediate class
+  BOOST_CHECK_EQUAL(c.exec<int>(classes +
+    "var Other = { base: func -1 };"
+    "var f = func obj.base();"
+    "var a = f(); f();"
+    "C1.parents[0] = Other;"
+    "a * 10 + f();"), 69);
+
+  // objects with different parents at the same call site
+  BOOST_CHECK_EQUAL(c.exec<int>(classes +
+    "var objs = [obj, { parents: [C1], id: 1 }, { parents: [C2], id: 2 },"
+    "            { parents: [C3], id: 3 }];"
+    "var sum = 0;"
+    "for(var i = 0; i < 10; i += 1) foreach(var o; objs) sum += o.level();"
+    "sum;"), 10 * (3 + 1 + 2 + 3));
+
+  // own fields still take precedence over cached parent fields
+  BOOST_CHECK_EQUAL(c.exec<int>(classes +
+    "var f = func(o) o.level();"
+    "f(obj); f(obj);"
+    "obj.level = func 99;"
+    "f(obj);"), 99);
+}
+
+//------------------------------------------------------------------------------
+static double timeCalls(TestContext& c, const std::string& classes,
+                        const char* method, int& result)
+{
+  std::ostringstream os;
+  os << classes
+     << "var sum = 0;"
+        "for(var i = 0; i < 200000; i += 1) sum += obj." << method << "();"
+        "sum;";
+
+  SGTimeStamp st;
+  st.stamp();
+  result = c.exec<int>(os.str());
+  return st.elapsedMSec();
+}
+
+BOOST_AUTO_TEST_CASE( member_cache_benchmark )
+{
+  TestContext c;
+  int result;
+
+  const std::string flat = hierarchy(0);
+  double own = timeCalls(c, flat, "base", result);
+  BOOST_CHECK_EQUAL(result, 200000 * 7);
+
+  const std::string deep = hierarchy(12);
+  double inherited = timeCalls(c, deep, "base", result);
+  BOOST_CHECK_EQUAL(result, 200000 * 7);
+
+  double mid = timeCalls(c, deep, "m6", result);
+  BOOST_CHECK_EQUAL(result, 200000 * 13);
+
+  std::cout << "200000 method calls: depth 0 " << own << " msec, "
+            << "depth 6 " << mid << " msec, "
+            << "depth 12 " << inherited << " msec" << std::endl;
+}
@@ -0,0 +1,105 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+#include <simgear/nasal/cppbind/NasalContext.hxx>
+#include <simgear/timing/timestamp.hxx>
+#include <iostream>
+#include <sstream>
+
+static naRef f_tick(naContext, naRef, int, naRef*)
+{
+  naProfileTick();
+  return naNil();
+}
+
+static void countFrames(void* user, const naProfileFrame* frames,
+                        int depth, int count)
+{
+  std::vector<naProfileFrame>& leaves =
+    *static_cast<std::vector<naProfileFrame>*>(user);
+  for(int i = 0; i < count; ++i)
+    leaves.push_back(frames[depth - 1]);
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( profile_sample )
+{
+  TestContext c;
+  nasal::Hash me(c.c);
+  me.set("tick", naNewFunc(c.c, naNewCCode(c.c, &f_tick)));
+
+  // The tick requests a sample, which is taken at the next backward jump
+  // of the loop in hot().  TestContext::exec() numbers lines from 0.
+  const std::string script =
+    "var tick = me.tick;\n"
+    "var hot = func {\n"
+    "  tick();\n"
+    "  var n = 0;\n"
+    "  for(var i = 0; i < 10; i += 1)\n"
+    "    n += i;\n"
+    "  return n;\n"
+    "};\n"
+    "hot() + hot();\n";
+
+  naProfileReset();
+  BOOST_CHECK_EQUAL(c.from_nasal<int>(c.exec(script, me.get_naRef())), 90);
+  BOOST_CHECK_EQUAL(naProfileSamples(), 0);
+
+  naProfileStart();
+  BOOST_CHECK(naProfileRunning());
+  BOOST_CHECK_EQUAL(c.from_nasal<int>(c.exec(script, me.get_naRef())), 90);
+  naProfileStop();
+  BOOST_CHECK_EQUAL(naProfileSamples(), 2);
+
+  std::vector<naProfileFrame> leaves;
+  naProfileForEach(&countFrames, &leaves);
+  BOOST_REQUIRE_EQUAL(leaves.size(), 2);
+  BOOST_CHECK_EQUAL(leaves[0].file, std::string("<TextContext::exec>"));
+  BOOST_CHECK_EQUAL(leaves[0].funcLine, 2);
+  BOOST_CHECK(leaves[0].line >= 4 && leaves[0].line <= 5);
+
+  // Both samples have the same stack: the script and hot()
+  std::ostringstream folded;
+  nasal::Context::writeFoldedStacks(folded);
+  BOOST_CHECK_EQUAL(folded.str(),
+                    "<TextContext::exec>:1;<TextContext::exec>:2 2\n");
+
+  std::ostringstream profile;
+  nasal::Context::writeProfile(profile);
+  BOOST_CHECK(profile.str().find("  2 2 <TextContext::exec>:2\n")
+              != std::string::npos);
+  BOOST_CHECK(profile.str().find("  0 2 <TextContext::exec>:1\n")
+              != std::string::npos);
+
+  nasal::Context::resetProfiler();
+  BOOST_CHECK_EQUAL(naProfileSamples(), 0);
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( profile_timer )
+{
+  TestContext c;
+  nasal::Context::resetProfiler();
+  nasal::Context::startProfiler(100);
+  BOOST_CHECK(nasal::Context::isProfiling());
+
+  SGTimeStamp st;
+  st.stamp();
+  while( naProfileSamples() < 10 && st.elapsedMSec() < 10000 )
+    c.exec<int>(
+      "var n = 0;"
+      "for(var i = 0; i < 100000; i += 1) n += 1;"
+      "n;"
+    );
+
+  nasal::Context::stopProfiler();
+  BOOST_CHECK(!nasal::Context::isProfiling());
+  BOOST_CHECK(naProfileSamples() >= 10);
+
+  // Stopped profilers take no more samples
+  int samples = naProfileSamples();
+  naProfileTick();
+  c.exec<int>("var n = 0; for(var i = 0; i < 10; i += 1) n += 1; n;");
+  BOOST_CHECK_EQUAL(naProfileSamples(), samples);
+}
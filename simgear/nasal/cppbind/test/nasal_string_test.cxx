@@ -0,0 +1,206 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+#include <simgear/nasal/cppbind/NasalHash.hxx>
+#include <simgear/nasal/iolib.h>
+#include <simgear/timing/timestamp.hxx>
+#include <cstdio>
+#include <iostream>
+
+class StringContext:
+  public TestContext
+{
+  public:
+    StringContext():
+      _me(c)
+    {
+      _me.set("std", naInit_std(c));
+      _me.set("bits", naInit_bits(c));
+      _me.set("io", naInit_io(c));
+    }
+
+    template<class T>
+    T run(const std::string& code)
+    {
+      return from_nasal<T>(exec(prelude() + code, _me.get_naRef()));
+    }
+
+    /// Run code which is expected to fail, return the error message
+    std::string error(const std::string& code)
+    {
+      return TestContext::error(prelude() + code, _me.get_naRef());
+    }
+
+    void set(const std::string& name, naRef val)
+    {
+      _me.set(name, val);
+    }
+
+  protected:
+    nasal::Hash _me;
+
+    static std::string prelude()
+    {
+      return "var size = me.std.size; var substr = me.std.substr;"
+             "var sprintf = me.std.sprintf; var keys = me.std.keys;"
+             "var cmp = me.std.cmp; var id = me.std.id;"
+             "var bits = me.bits; var io = me.io;";
+    }
+};
+
+// 64 characters, so that every concatenation below is long enough to
+// give a rope
+static const std::string piece =
+  "var piece = '0123456789abcdef0123456789abcdef"
+              "0123456789abcdef0123456789abcdef';";
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( string_ropes )
+{
+  StringContext c;
+
+  // short concatenations are still plain copies
+  BOOST_CHECK_EQUAL(c.run<std::string>("var a = 'ab'; a ~ 'cd' ~ a"), "abcdab");
+
+  // appending, and reading the bytes of ropes built from other ropes
+  BOOST_CHECK_EQUAL(c.run<int>(piece +
+    "var s = piece ~ 'x';"
+    "var t = s ~ 'y';"
+    "var u = t ~ t;"
+    "size(u) == 2 * 66 and u[65] == `y` and u[66] == `0`"
+    "  and substr(u, 64, 4) == 'xy01'"), 1);
+
+  // a rope flattened before being appended to
+  BOOST_CHECK_EQUAL(c.run<std::string>(piece +
+    "var s = piece ~ piece;"
+    "var n = s[0];"
+    "s = s ~ '!';"
+    "substr(s, size(s) - 3)"), "ef!");
+
+  // prepending, which copies
+  BOOST_CHECK_EQUAL(c.run<std::string>(piece +
+    "var s = piece ~ piece;"
+    "s = '<' ~ s;"
+    "substr(s, 0, 3)"), "<01");
+
+  // the pieces stay alive as long as the rope, even across collections
+  BOOST_CHECK_EQUAL(c.run<int>(piece +
+    "var s = '';"
+    "for(var i = 0; i < 200; i += 1) {"
+    "  s = s ~ sprintf('%03d', i) ~ piece;"
+    "  var garbage = [{}, {}, {}];"
+    "}"
+    "size(s) == 200 * 67 and substr(s, 199 * 67, 5) == '19901'"), 1);
+
+  // ropes as hash keys and in comparisons
+  BOOST_CHECK_EQUAL(c.run<int>(piece +
+    "var h = {};"
+    "h[piece ~ 'key'] = 5;"
+    "var k = piece ~ 'k' ~ 'ey';"
+    "h[k] + (k == piece ~ 'key') + cmp(k, piece ~ 'kez')"), 5);
+
+  // sprintf builds its result by appending
+  BOOST_CHECK_EQUAL(c.run<std::string>(
+    "var s = sprintf('%s|%s|%d', '0123456789012345678901234567890123',"
+    "                '0123456789012345678901234567890123', 42);"
+    "substr(s, 30, 12)"), "0123|0123456");
+
+  BOOST_CHECK_EQUAL(c.run<std::string>("var s = 'ab' ~ 'cd'; s[0] = 65; s"),
+                    "Abcd");
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( string_ropes_changed )
+{
+  StringContext c;
+
+  // reading bit fields of a rope
+  BOOST_CHECK_EQUAL(c.run<int>(
+    "var s = '';"
+    "for(var i = 0; i < 10; i += 1) s = s ~ 'abcdefgh';"
+    "bits.fld(s, 0, 8) * 1000 + bits.sfld(s, 8 * 79, 8)"), 97104);
+
+  // changing a rope copies it, other ropes built from it keep the old bytes
+  BOOST_CHECK_EQUAL(c.run<std::string>(piece +
+    "var s = piece ~ piece;"
+    "var t = s ~ '!';"
+    "s[0] = `A`;"
+    "bits.setfld(s, 8, 8, `B`);"
+    "substr(s, 0, 3) ~ substr(t, 0, 3) ~ substr(s ~ '', 0, 3)"),
+    "AB2012AB2");
+
+  // the same for a rope which was flattened before, and one built from it
+  BOOST_CHECK_EQUAL(c.run<std::string>(piece +
+    "var s = piece ~ piece;"
+    "var t = s ~ '!';"
+    "var n = size(t) + s[0];"
+    "var u = s ~ '?';"
+    "bits.setfld(s, 0, 8, `Z`);"
+    "substr(s, 0, 2) ~ substr(t, 0, 2) ~ substr(u, 0, 2)"), "Z10101");
+
+  // strings which are hash keys still can't be changed
+  BOOST_CHECK_EQUAL(c.error("var h = {}; h.key = 1;"
+                            "bits.setfld(keys(h)[0], 0, 8, 65)"),
+                    "missing/bad argument to setfld");
+
+  // reading into a rope
+  FILE* f = std::tmpfile();
+  BOOST_REQUIRE(f);
+  std::fputs("ABCDEFGH", f);
+  std::rewind(f);
+  c.set("file", naIOGhost(c.c, f));
+  BOOST_CHECK_EQUAL(c.run<std::string>(piece +
+    "var s = piece ~ piece;"
+    "var t = s ~ '';"
+    "var n = io.read(me.file, s, 8);"
+    "n ~ substr(s, 0, 10) ~ substr(t, 0, 2)"), "8ABCDEFGH8901");
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( string_interning )
+{
+  StringContext c;
+
+  // keys built at runtime are replaced by the symbol of the same name
+  BOOST_CHECK_EQUAL(c.run<int>(
+    "var h = {};"
+    "var name = 'va' ~ 'lue';"
+    "h[name] = 1;"
+    "h.value += 2;"
+    "h['val' ~ 'ue'] += 3;"
+    "h.value * 10 + size(keys(h))"), 61);
+
+  // ... which is the very same string as the key in a hash literal
+  BOOST_CHECK_EQUAL(c.run<int>(
+    "var lit = { value: 0 };"
+    "var h = {};"
+    "h['va' ~ 'lue'] = 1;"
+    "id(keys(h)[0]) == id(keys(lit)[0])"), 1);
+
+  // unknown names and long keys are kept as they are
+  BOOST_CHECK_EQUAL(c.run<int>(
+    "var h = {};"
+    "h['xyzzy' ~ 'plugh'] = 1;"
+    "h['a rather long key which is never a symbol'] = 2;"
+    "h['xyzzyplugh'] + h['a rather long key ' ~ 'which is never a symbol']"),
+    3);
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( string_append_benchmark )
+{
+  StringContext c;
+
+  // 1 MB in 64 byte pieces
+  SGTimeStamp st;
+  st.stamp();
+  int len = c.run<int>(piece +
+    "var s = '';"
+    "for(var i = 0; i < 16384; i += 1) s = s ~ piece;"
+    "s[size(s) - 1] == `f` ? size(s) : -1;");
+  double msec = st.elapsedMSec();
+
+  BOOST_CHECK_EQUAL(len, 16384 * 64);
+  std::cout << "appending 1 MB: " << msec << " msec" << std::endl;
+}
@@ -93,10 +93,25 @@ struct naObj {
     GC_HEADER;
 };
 
+// Concatenation results are built as ropes: the node holds the bytes
+// appended to "left", another string.  They are flattened into an
+// ordinary buffer on the first access to the data.  Other ropes may
+// still refer to a flattened one, so neither can be changed in place:
+// naStr_mutable() thaws them into a private copy first.
+#define STR_ROPE -2
+#define STR_FROZEN -3
+#define STR_THAWED -4
+
+struct naRope {
+    naRef left; // nil, or the string preceding data
+    int len;
+    unsigned char data[];
+};
+
 #define MAX_STR_EMBLEN 15
 struct naStr {
     GC_HEADER;
-    signed char emblen; /* [0-15], or -1 to indicate "not embedded" */
+    signed char emblen; /* [0-15], -1 "not embedded", or STR_ROPE etc. */
     unsigned int hashcode;
     union {
         unsigned char buf[16];
@@ -104,6 +119,10 @@ struct naStr {
             int len;
             unsigned char* ptr;
         } ref;
+        struct {
+            int len; // total length, the same field as ref.len
+            struct naRope* node;
+        } rope;
     } data;
 };
 
@@ -115,6 +134,7 @@ struct VecRec {
 
 struct naVec {
     GC_HEADER;
+    unsigned char proto; // is or was in a "parents" chain
     struct VecRec* rec;
 };
 
@@ -126,6 +146,7 @@ struct HashNode {
 
 struct naHash {
     GC_HEADER;
+    unsigned char proto; // is or was in a "parents" chain
     struct HashRec* rec;
 };
 
@@ -140,6 +161,7 @@ struct naCode {
     unsigned short nLines;
     naRef srcFile;
     naRef* constants;
+    struct MemberCache* mcache; // OP_MEMBER caches, one per constant
 };
 
 /* naCode objects store their variable length arrays in a single block
@@ -187,6 +209,10 @@ struct naPool {
     void**    free; // current "free frame"
     int      nfree; // down-counting index within the free frame
     int    freetop; // curr. top of the free list
+    struct Block* sweep; // block being swept by an incremental collection
+    int  sweepElem; // next element within that block
+    int sweepTotal; // pool size when the sweep started
+    int   sweeping; // free list is still being rebuilt
 };
 
 void naFree(void* m);
@@ -205,17 +231,39 @@ int naStr_numeric(naRef str);
 int naStr_parsenum(char* str, int len, double* result);
 int naStr_tonum(naRef str, double* out);
 naRef naStr_buf(naRef str, int len);
+char* naStr_mutable(naRef s);
 
 int naiHash_tryset(naRef hash, naRef key, naRef val); // sets if exists
 int naiHash_sym(struct naHash* h, struct naStr* sym, naRef* out);
 void naiHash_newsym(struct naHash* h, naRef* sym, naRef* val);
 
+// Must be called before storing a reference into an existing object
+// (not one just created with naNew), so that an incremental collection
+// in progress does not lose it.
+extern int naGC_marking;
+#define naGC_barrier(r) do { if(naGC_marking) naGC_shade(r); } while(0)
+void naGC_shade(naRef r);
+
+// Must be called before changing the contents of a vector or hash.
+// Cached OP_MEMBER lookups through "parents" are valid only as long as
+// naMemberEpoch is unchanged.
+extern unsigned int naMemberEpoch;
+#define naMember_changed(o) do { if((o)->proto) naMemberEpoch++; } while(0)
+
 void naGC_init(struct naPool* p, int type);
 struct naObj** naGC_get(struct naPool* p, int n, int* nout);
 void naGC_swapfree(void** target, void* val);
 void naGC_freedead();
-void naiGCMark(naRef r);
-void naiGCMarkHash(naRef h);
+
+// Objects marked but not yet scanned by the collector.  Every thread
+// marking in parallel has its own.
+struct GrayStack {
+    struct naObj** objs;
+    int n;
+    int sz;
+};
+void naiGCMark(naRef r, struct GrayStack* g);
+void naiGCMarkHash(naRef h, struct GrayStack* g);
 
 void naStr_gcclean(struct naStr* s);
 void naVec_gcclean(struct naVec* s);
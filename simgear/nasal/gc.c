@@ -1,18 +1,65 @@
+#include <limits.h>
+#include <stddef.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include "nasal.h"
 #include "data.h"
 #include "code.h"
 
 #define MIN_BLOCK_SIZE 32
 
-static void reap(struct naPool* p);
-static void mark(naRef r);
-
 struct Block {
     int   size;
     char* block;
     struct Block* next;
 };
 
+// Allocations between two steps of an incremental collection
+#define GC_STEP_ALLOCS 1024
+
+// Objects scanned between checks of the step time budget
+#define GC_CLOCK_INTERVAL 64
+
+// Gray objects taken at once by a parallel marking thread
+#define GC_SHARE_CHUNK 64
+
+// Pauses which try to finish the marking within the time budget, before
+// one finishes it regardless
+#define GC_FINISH_TRIES 4
+
+// Claims an unmarked object for the calling thread.  Parallel marking
+// threads may race for the same object; an atomic exchange makes sure
+// that only one of them queues it.
+#if defined(__GNUC__)
+# define CLAIM(o) (!__sync_lock_test_and_set(&(o)->mark, 1))
+#elif defined(_MSC_VER)
+# define CLAIM(o) (!_InterlockedExchange8((char*)&(o)->mark, 1))
+#else
+# define CLAIM(o) ((o)->mark = 1)
+#endif
+
+enum { GC_IDLE, GC_MARKING, GC_SWEEPING };
+
+// Nonzero while an incremental collection is marking, see naGC_barrier
+int naGC_marking = 0;
+
+// Collector settings and statistics.  These live outside the globals
+// so that they can be set up before the first context is created.
+static int gcMode = NA_GC_FULL;
+static int gcStepUsec = 1000;
+static int gcFinishTries = 0;
+static naGCStats gcStats;
+
+static void reap(struct naPool* p);
+static void startReap(struct naPool* p);
+static int sweepPool(struct naPool* p, double deadline);
+static void sweepElems(struct naPool* p, struct Block* b, int from);
+static void finishReap(struct naPool* p);
+static void cleanelem(struct naPool* p, struct naObj* o);
+static void mark(naRef r, struct GrayStack* g);
+static void scan(struct naObj* o, struct GrayStack* g);
+
 // Must be called with the giant exclusive lock!
 static void freeDead()
 {
@@ -22,47 +69,305 @@ static void freeDead()
     globals->ndead = 0;
 }
 
-static void marktemps(struct Context* c)
+static void marktemps(struct Context* c, struct GrayStack* g)
 {
     int i;
     naRef r = naNil();
     for(i=0; i<c->ntemps; i++) {
         SETPTR(r, c->temps[i]);
-        mark(r);
+        mark(r, g);
     }
 }
 
-// Must be called with the big lock!
-static void garbageCollect()
+// The roots which are not covered by the write barrier
+static void markcontexts()
 {
     int i;
-    struct Context* c;
-    globals->allocCount = 0;
-    c = globals->allContexts;
+    struct GrayStack* g = &globals->gray;
+    struct Context* c = globals->allContexts;
     while(c) {
-        for(i=0; i<NUM_NASAL_TYPES; i++)
-            c->nfree[i] = 0;
         for(i=0; i < c->fTop; i++) {
-            mark(c->fStack[i].func);
-            mark(c->fStack[i].locals);
+            mark(c->fStack[i].func, g);
+            mark(c->fStack[i].locals, g);
         }
         for(i=0; i < c->opTop; i++)
-            mark(c->opStack[i]);
-        mark(c->dieArg);
-        marktemps(c);
+            mark(c->opStack[i], g);
+        mark(c->dieArg, g);
+        marktemps(c, g);
         c = c->nextAll;
     }
+}
+
+static void markroots()
+{
+    struct GrayStack* g = &globals->gray;
+    markcontexts();
+    mark(globals->save, g);
+    mark(globals->save_hash, g);
+    mark(globals->symbols, g);
+    mark(globals->meRef, g);
+    mark(globals->argRef, g);
+    mark(globals->parentsRef, g);
+}
+
+// Parallel collection.  Helper threads wait on a semaphore between
+// collections, and join the thread running the collector to mark, or to
+// sweep the pools whose objects need no cleanup callbacks.  The world
+// is stopped meanwhile, so they don't need the giant lock.  Each marking
+// thread scans from its own gray stack, and hands out work through
+// globals->gray when the others have run out.  Surplus helpers are
+// told to exit when the number of threads is lowered.
+enum { GC_TASK_MARK, GC_TASK_SWEEP, GC_TASK_EXIT };
+
+static struct {
+    void* lock;   // guards globals->gray and the task state while running
+    void* start;  // helpers wait here for a task
+    void* done;   // ...and report here when finished
+    void* wake;   // idle marking threads wait here for work
+    int nwanted;  // from naGCSetThreads()
+    int nhelpers; // threads running
+    struct GrayStack* stacks; // per thread, [0] is the collector's
+    int nstacks;  // stacks handed out to the helpers of the current task
+
+    int task;
+    int active;   // threads taking part in the task
+    int idle;     // marking threads out of work
+    int sleeping; // ...of which waiting on the wake semaphore
+    int stop;     // marking deadline has passed
+    double deadline;
+    int sweepType; // pool whose blocks are being handed out
+} workers;
+
+static void markWorker(struct GrayStack* local);
+static void sweepWorker();
+
+// Helpers are woken in no particular order, so each takes the next
+// free gray stack when marking.
+static void helper(void* arg)
+{
+    int id;
+    for(;;) {
+        naSemDown(workers.start);
+        if(workers.task == GC_TASK_EXIT) break;
+        if(workers.task == GC_TASK_MARK) {
+            naLock(workers.lock);
+            id = ++workers.nstacks;
+            naUnlock(workers.lock);
+            markWorker(&workers.stacks[id]);
+        } else {
+            sweepWorker();
+        }
+        naSemUp(workers.done, 1);
+    }
+    naSemUp(workers.done, 1);
+}
+
+// Starts the helpers asked for but not running yet.  Returns the number
+// to use, which is smaller if threads could not be created.
+static int startHelpers()
+{
+    if(!workers.lock) {
+        workers.lock = naNewLock();
+        workers.start = naNewSem();
+        workers.done = naNewSem();
+        workers.wake = naNewSem();
+    }
+    if(!workers.stacks) {
+        workers.stacks = naAlloc(sizeof(struct GrayStack));
+        naBZero(&workers.stacks[0], sizeof(struct GrayStack));
+    }
+    while(workers.nhelpers < workers.nwanted) {
+        int id = workers.nhelpers + 1;
+        workers.stacks = naRealloc(workers.stacks,
+                                   sizeof(struct GrayStack) * (id + 1));
+        naBZero(&workers.stacks[id], sizeof(struct GrayStack));
+        if(!naNewThread(helper, 0)) {
+            workers.nwanted = workers.nhelpers;
+            break;
+        }
+        workers.nhelpers++;
+    }
+    return workers.nwanted < workers.nhelpers
+        ? workers.nwanted : workers.nhelpers;
+}
+
+// Stops the helpers beyond the number wanted, and waits for them to
+// exit.  Must be called with the big lock, so that no task is running.
+static void stopHelpers()
+{
+    int i, n = workers.nhelpers - workers.nwanted;
+    if(n <= 0) return;
+    workers.task = GC_TASK_EXIT;
+    naSemUp(workers.start, n);
+    for(i=0; i<n; i++)
+        naSemDown(workers.done);
+    for(i=workers.nwanted+1; i<=workers.nhelpers; i++)
+        naFree(workers.stacks[i].objs);
+    workers.nhelpers = workers.nwanted;
+}
+
+static void runTask(int task, double deadline)
+{
+    int i, n = startHelpers();
+    workers.task = task;
+    workers.active = n + 1;
+    workers.idle = workers.sleeping = workers.stop = 0;
+    workers.deadline = deadline;
+    workers.sweepType = 0;
+    workers.nstacks = 0;
+    if(n) naSemUp(workers.start, n);
+    if(task == GC_TASK_MARK) {
+        markWorker(&workers.stacks[0]);
+    } else {
+        // Cleanup callbacks of code and ghosts run on this thread only
+        sweepPool(&globals->pools[T_CCODE], 0);
+        sweepPool(&globals->pools[T_GHOST], 0);
+        sweepWorker();
+    }
+    for(i=0; i<n; i++)
+        naSemDown(workers.done);
+}
+
+static void pushGray(struct GrayStack* g, struct naObj* o)
+{
+    if(g->n >= g->sz) {
+        g->sz = g->sz ? 2 * g->sz : 1024;
+        g->objs = naRealloc(g->objs, sizeof(struct naObj*) * g->sz);
+    }
+    g->objs[g->n++] = o;
+}
+
+// Moves the n top objects of one gray stack to another
+static void moveGray(struct GrayStack* dst, struct GrayStack* src, int n)
+{
+    while(n-- > 0)
+        pushGray(dst, src->objs[--src->n]);
+}
+
+// Must be called with workers.lock
+static void wakeWorkers()
+{
+    if(workers.sleeping) naSemUp(workers.wake, workers.sleeping);
+    workers.sleeping = 0;
+}
+
+static void markWorker(struct GrayStack* local)
+{
+    struct GrayStack* shared = &globals->gray;
+    int n = 0;
+    naLock(workers.lock);
+    for(;;) {
+        if(!shared->n || workers.stop) {
+            // Out of work: wait for some, or for everyone to run out
+            workers.idle++;
+            while((!shared->n || workers.stop)
+                  && workers.idle < workers.active) {
+                workers.sleeping++;
+                naUnlock(workers.lock);
+                naSemDown(workers.wake);
+                naLock(workers.lock);
+            }
+            if(workers.idle == workers.active) {
+                wakeWorkers();
+                break;
+            }
+            workers.idle--;
+        }
+        moveGray(local, shared,
+                 shared->n < GC_SHARE_CHUNK ? shared->n : GC_SHARE_CHUNK);
+        naUnlock(workers.lock);
+
+        while(local->n) {
+            scan(local->objs[--local->n], local);
+            if(++n % GC_CLOCK_INTERVAL)
+                continue;
+            naLock(workers.lock);
+            if(workers.deadline && naTimeUsec() >= workers.deadline)
+                workers.stop = 1;
+            if(workers.stop) {
+                moveGray(shared, local, local->n);
+            } else if(!shared->n && workers.sleeping) {
+                moveGray(shared, local, local->n / 2);
+                wakeWorkers();
+            }
+            naUnlock(workers.lock);
+        }
+        naLock(workers.lock);
+    }
+    naUnlock(workers.lock);
+}
+
+// Scans gray objects until none are left (returning 1), or until the
+// deadline (if nonzero) has passed.
+static int drain(double deadline)
+{
+    int n = 0;
+    struct GrayStack* g = &globals->gray;
+    if(workers.nwanted) {
+        runTask(GC_TASK_MARK, deadline);
+        return g->n == 0;
+    }
+    while(g->n) {
+        scan(g->objs[--g->n], g);
+        if(deadline && ++n % GC_CLOCK_INTERVAL == 0 && naTimeUsec() >= deadline)
+            break;
+    }
+    return g->n == 0;
+}
+
+// Drops the objects cached by each context, which are about to be
+// reused by the sweep.
+static void flushcaches()
+{
+    int i;
+    struct Context* c;
+    for(c = globals->allContexts; c; c = c->nextAll)
+        for(i=0; i<NUM_NASAL_TYPES; i++)
+            c->nfree[i] = 0;
+}
 
-    mark(globals->save);
-    mark(globals->save_hash);
-    mark(globals->symbols);
-    mark(globals->meRef);
-    mark(globals->argRef);
-    mark(globals->parentsRef);
+static void startMark()
+{
+    // Objects allocated from now on start out white, and are found
+    // either through the barrier or the final root scan
+    markroots();
+    globals->gcPhase = GC_MARKING;
+    naGC_marking = 1;
+    globals->allocCount = INT_MAX/2;
+}
 
-    // Finally collect all the freed objects
+// Returns 0 if the marking has to go on in the next step
+static int finishMark(double deadline)
+{
+    int i;
+
+    // The stacks and temporaries of the contexts are not covered by the
+    // write barrier, so they are rescanned with the world stopped, and
+    // what they refer to is marked in the same pause.  That is mostly
+    // what was allocated meanwhile.  If it can't be done by the
+    // deadline, marking goes on in the next step, which tries again.
+    markcontexts();
+    if(++gcFinishTries < GC_FINISH_TRIES && !drain(deadline))
+        return 0;
+    drain(0);
+    gcFinishTries = 0;
+    naGC_marking = 0;
+    globals->gcPhase = GC_SWEEPING;
+
+    // Cached member lookups may refer to objects about to be freed
+    naMemberEpoch++;
+
+    globals->allocCount = 0;
+    flushcaches();
     for(i=0; i<NUM_NASAL_TYPES; i++)
-        reap(&(globals->pools[i]));
+        startReap(&(globals->pools[i]));
+    return 1;
+}
+
+static void endCycle()
+{
+    globals->gcPhase = GC_IDLE;
+    globals->gcFull = 0;
 
     // Make enough space for the dead blocks we need to free during
     // execution.  This works out to 1 spot for every 2 live objects,
@@ -74,7 +379,84 @@ static void garbageCollect()
         naFree(globals->deadBlocks);
         globals->deadBlocks = naAlloc(sizeof(void*) * globals->deadsz);
     }
+    gcStats.cycles++;
+}
+
+// Sweeps the pools until done (returning 1), or until the deadline (if
+// nonzero) has passed.  Pools which have run dry go first, as their
+// allocators are waiting on them.
+static int sweep(double deadline)
+{
+    int i, pass, done = 1;
+    flushcaches();
+    if(!deadline && workers.nwanted) {
+        // Blocks are handed out whole, so the one an earlier step
+        // stopped in is finished first
+        for(i=0; i<NUM_NASAL_TYPES; i++) {
+            struct naPool* p = &(globals->pools[i]);
+            if(p->sweeping && p->sweep && p->sweepElem) {
+                sweepElems(p, p->sweep, p->sweepElem);
+                p->sweep = p->sweep->next;
+                p->sweepElem = 0;
+            }
+        }
+        runTask(GC_TASK_SWEEP, 0);
+    }
+    for(pass=0; pass<2; pass++) {
+        for(i=0; i<NUM_NASAL_TYPES; i++) {
+            struct naPool* p = &(globals->pools[i]);
+            if(!p->sweeping || (pass == 0 && p->nfree))
+                continue;
+            if(sweepPool(p, deadline))
+                finishReap(p);
+            else
+                return 0;
+        }
+    }
+    for(i=0; i<NUM_NASAL_TYPES; i++)
+        if(globals->pools[i].sweeping) done = 0;
+    if(done) endCycle();
+    return done;
+}
+
+// Completes a collection, starting one first if none is in progress.
+// Must be called with the big lock!
+static void garbageCollect()
+{
+    if(globals->gcPhase == GC_SWEEPING)
+        sweep(0);
+    if(globals->gcPhase == GC_IDLE)
+        startMark();
+    finishMark(0);
+    sweep(0);
+}
+
+// Runs the collector for one pause: a complete collection in full
+// mode, otherwise one time-limited step of an incremental collection.
+// Must be called with the big lock!
+static void collect()
+{
+    double start = naTimeUsec(), pause;
+    double deadline = start + gcStepUsec;
+
+    if(gcMode == NA_GC_FULL || globals->gcFull) {
+        garbageCollect();
+    } else {
+        if(globals->gcPhase == GC_IDLE)
+            startMark();
+        if(globals->gcPhase == GC_MARKING && drain(deadline))
+            finishMark(deadline);
+        if(globals->gcPhase == GC_SWEEPING)
+            sweep(deadline);
+    }
+    globals->gcStepCount = GC_STEP_ALLOCS;
     globals->needGC = 0;
+
+    pause = naTimeUsec() - start;
+    gcStats.pauses++;
+    gcStats.lastPause = pause;
+    gcStats.totalPause += pause;
+    if(pause > gcStats.maxPause) gcStats.maxPause = pause;
 }
 
 void naModLock()
@@ -113,7 +495,7 @@ static void bottleneck()
     }
     if(g->waitCount >= g->nThreads - 1) {
         freeDead();
-        if(g->needGC) garbageCollect();
+        if(g->needGC) collect();
         if(g->waitCount) naSemUp(g->sem, g->waitCount);
         g->bottleneck = 0;
     }
@@ -121,6 +503,17 @@ static void bottleneck()
 
 void naGC()
 {
+    LOCK();
+    globals->needGC = 1;
+    globals->gcFull = 1;
+    bottleneck();
+    UNLOCK();
+    naCheckBottleneck();
+}
+
+void naGCStep()
+{
+    if(!globals || globals->gcPhase == GC_IDLE) return;
     LOCK();
     globals->needGC = 1;
     bottleneck();
@@ -128,6 +521,35 @@ void naGC()
     naCheckBottleneck();
 }
 
+void naGCSetMode(int mode, int stepUsec)
+{
+    gcMode = mode;
+    gcStepUsec = stepUsec > 0 ? stepUsec : 1;
+}
+
+void naGCSetThreads(int n)
+{
+    // Helpers are only started by collections, which need a context
+    if(!globals) {
+        workers.nwanted = n > 0 ? n : 0;
+        return;
+    }
+    LOCK();
+    workers.nwanted = n > 0 ? n : 0;
+    stopHelpers();
+    UNLOCK();
+}
+
+void naGCGetStats(naGCStats* stats)
+{
+    *stats = gcStats;
+}
+
+void naGCResetStats()
+{
+    naBZero(&gcStats, sizeof(gcStats));
+}
+
 void naCheckBottleneck()
 {
     if(globals->bottleneck) { LOCK(); bottleneck(); UNLOCK(); }
@@ -136,6 +558,7 @@ void naCheckBottleneck()
 static void naCode_gcclean(struct naCode* o)
 {
     naFree(o->constants);  o->constants = 0;
+    naFree(o->mcache);     o->mcache = 0;
 }
 
 static void naCCode_gcclean(struct naCCode* c)
@@ -150,9 +573,9 @@ static void naGhost_gcclean(struct naGhost* g)
     g->ptr = 0;
 }
 
-static void freeelem(struct naPool* p, struct naObj* o)
+// Cleans up any intrinsic storage the object might have
+static void cleanelem(struct naPool* p, struct naObj* o)
 {
-    // Clean up any intrinsic storage the object might have...
     switch(p->type) {
     case T_STR:   naStr_gcclean  ((struct naStr*)  o); break;
     case T_VEC:   naVec_gcclean  ((struct naVec*)  o); break;
@@ -161,6 +584,11 @@ static void freeelem(struct naPool* p, struct naObj* o)
     case T_CCODE: naCCode_gcclean((struct naCCode*)o); break;
     case T_GHOST: naGhost_gcclean((struct naGhost*)o); break;
     }
+}
+
+static void freeelem(struct naPool* p, struct naObj* o)
+{
+    cleanelem(p, o);
     p->free[p->nfree++] = o;  // ...and add it to the free list
 }
 
@@ -213,7 +641,11 @@ struct naObj** naGC_get(struct naPool* p, int n, int* nout)
     struct naObj** result;
     naCheckBottleneck();
     LOCK();
-    while(globals->allocCount < 0 || (p->nfree == 0 && p->freetop >= p->freesz)) {
+    while(globals->allocCount < 0 || globals->gcStepCount < 0
+          || (p->nfree == 0 && (p->sweeping || p->freetop >= p->freesz))) {
+        // Out of space: an incremental collection can't wait any longer
+        if(p->nfree == 0 && !p->sweeping && p->freetop >= p->freesz)
+            globals->gcFull = 1;
         globals->needGC = 1;
         bottleneck();
     }
@@ -223,63 +655,94 @@ struct naObj** naGC_get(struct naPool* p, int n, int* nout)
     *nout = n;
     p->nfree -= n;
     globals->allocCount -= n;
+    if(globals->gcPhase != GC_IDLE)
+        globals->gcStepCount -= n;
     result = (struct naObj**)(p->free + p->nfree);
     UNLOCK();
     return result;
 }
 
-static void markvec(naRef r)
+static void markvec(naRef r, struct GrayStack* g)
 {
     int i;
     struct VecRec* vr = PTR(r).vec->rec;
     if(!vr) return;
     for(i=0; i<vr->size; i++)
-        mark(vr->array[i]);
+        mark(vr->array[i], g);
 }
 
-// Sets the reference bit on the object, and recursively on all
-// objects reachable from it.  Uses the processor stack for recursion...
-static void mark(naRef r)
+// Sets the reference bit on the object ("gray"), and queues it to have
+// its children marked by scan() ("black").  Objects without references
+// go straight to black, which is all strings but unflattened ropes.
+static void mark(naRef r, struct GrayStack* g)
 {
-    int i;
+    struct naObj* o;
 
     if(IS_NUM(r) || IS_NIL(r))
         return;
 
-    if(PTR(r).obj->mark == 1)
+    o = PTR(r).obj;
+    if(o->mark == 1 || !CLAIM(o))
+        return;
+
+    if(o->type == T_CCODE
+       || (o->type == T_STR && ((struct naStr*)o)->emblen != STR_ROPE))
         return;
 
-    PTR(r).obj->mark = 1;
-    switch(PTR(r).obj->type) {
-    case T_VEC: markvec(r); break;
-    case T_HASH: naiGCMarkHash(r); break;
+    pushGray(g, o);
+}
+
+static void scan(struct naObj* o, struct GrayStack* g)
+{
+    int i;
+    naRef r;
+    SETPTR(r, o);
+    switch(o->type) {
+    case T_STR:
+        // may have been flattened since it was marked
+        if(PTR(r).str->emblen == STR_ROPE)
+            mark(PTR(r).str->data.rope.node->left, g);
+        break;
+    case T_VEC: markvec(r, g); break;
+    case T_HASH: naiGCMarkHash(r, g); break;
     case T_CODE:
-        mark(PTR(r).code->srcFile);
+        mark(PTR(r).code->srcFile, g);
         for(i=0; i<PTR(r).code->nConstants; i++)
-            mark(PTR(r).code->constants[i]);
+            mark(PTR(r).code->constants[i], g);
         break;
     case T_FUNC:
-        mark(PTR(r).func->code);
-        mark(PTR(r).func->namespace);
-        mark(PTR(r).func->next);
+        mark(PTR(r).func->code, g);
+        mark(PTR(r).func->namespace, g);
+        mark(PTR(r).func->next, g);
         break;
     case T_GHOST:
-        mark(PTR(r).ghost->data);
+        mark(PTR(r).ghost->data, g);
         break;
     }
 }
 
-void naiGCMark(naRef r)
+void naiGCMark(naRef r, struct GrayStack* g)
 {
-    mark(r);
+    mark(r, g);
 }
 
-// Collects all the unreachable objects into a free list, and
-// allocates more space if needed.
-static void reap(struct naPool* p)
+// Slow path of naGC_barrier: shades a white object stored into the heap
+// while marking, so that a black object never points to a white one.
+// Mutators run concurrently between steps, hence the lock.
+void naGC_shade(naRef r)
 {
-    struct Block* b;
-    int elem, freesz, total = poolsize(p);
+    if(IS_NUM(r) || IS_NIL(r) || PTR(r).obj->mark)
+        return;
+    LOCK();
+    if(naGC_marking) mark(r, &globals->gray);
+    UNLOCK();
+}
+
+// Starts collecting the unreachable objects into a new free list.
+// Until finishReap(), the pool only hands out objects found so far.
+static void startReap(struct naPool* p)
+{
+    int freesz, total = poolsize(p);
     freesz = total < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : total;
     freesz = (3 * freesz / 2) + (globals->nThreads * OBJ_CACHE_SZ);
     if(p->freesz < freesz) {
@@ -290,19 +753,101 @@ static void reap(struct naPool* p)
 
     p->nfree = 0;
     p->free = p->free0;
+    p->freetop = 0;
+    p->sweep = p->blocks;
+    p->sweepElem = 0;
+    p->sweepTotal = total;
+    p->sweeping = 1;
+
+    // allocs of this type until the next collection
+    globals->allocCount += total/2;
+}
 
-    for(b = p->blocks; b; b = b->next)
-        for(elem=0; elem < b->size; elem++) {
-            struct naObj* o = (struct naObj*)(b->block + elem * p->elemsz);
+// Frees the unmarked objects and clears the marks, until the end of
+// the pool (returning 1) or until the deadline (if nonzero) has passed.
+static int sweepPool(struct naPool* p, double deadline)
+{
+    int n = 0;
+    struct Block* b;
+    for(b = p->sweep; b; b = b->next, p->sweepElem = 0) {
+        while(p->sweepElem < b->size) {
+            struct naObj* o = (struct naObj*)(b->block + p->sweepElem++ * p->elemsz);
             if(o->mark == 0)
                 freeelem(p, o);
             o->mark = 0;
+            if(deadline && ++n % GC_CLOCK_INTERVAL == 0
+               && naTimeUsec() >= deadline) {
+                p->sweep = b;
+                return 0;
+            }
         }
+    }
+    p->sweep = 0;
+    return 1;
+}
 
-    p->freetop = p->nfree;
+// Frees the unmarked objects of a block from index "from" on, and
+// clears the marks
+static void sweepElems(struct naPool* p, struct Block* b, int from)
+{
+    int i;
+    for(i=from; i<b->size; i++) {
+        struct naObj* o = (struct naObj*)(b->block + i * p->elemsz);
+        if(o->mark == 0)
+            freeelem(p, o);
+        o->mark = 0;
+    }
+}
 
-    // allocs of this type until the next collection
-    globals->allocCount += total/2;
+// Parallel part of the sweep: takes blocks of the pools without cleanup
+// callbacks, and frees their unmarked objects.  The dead objects of a
+// block are counted first, to reserve their slots in the free list.
+static void sweepWorker()
+{
+    for(;;) {
+        int i, slot, dead = 0;
+        struct naPool* p = 0;
+        struct Block* b = 0;
+
+        naLock(workers.lock);
+        for(; workers.sweepType < NUM_NASAL_TYPES; workers.sweepType++) {
+            int t = workers.sweepType;
+            p = &globals->pools[t];
+            if(t != T_CCODE && t != T_GHOST && p->sweeping && p->sweep) {
+                b = p->sweep;
+                p->sweep = b->next;
+                break;
+            }
+        }
+        naUnlock(workers.lock);
+        if(!b) return;
+
+        for(i=0; i<b->size; i++)
+            if(((struct naObj*)(b->block + i * p->elemsz))->mark == 0)
+                dead++;
+
+        naLock(workers.lock);
+        slot = p->nfree;
+        p->nfree += dead;
+        naUnlock(workers.lock);
+
+        for(i=0; i<b->size; i++) {
+            struct naObj* o = (struct naObj*)(b->block + i * p->elemsz);
+            if(o->mark == 0) {
+                cleanelem(p, o);
+                p->free[slot++] = o;
+            }
+            o->mark = 0;
+        }
+    }
+}
+
+// Allocates more space if needed once the pool has been swept
+static void finishReap(struct naPool* p)
+{
+    int total = p->sweepTotal;
+    p->sweeping = 0;
+    p->freetop = p->nfree;
 
     // Allocate more if necessary (try to keep 25-50% of the objects
     // available)
@@ -315,6 +860,15 @@ static void reap(struct naPool* p)
     }
 }
 
+// Collects all the unreachable objects into a free list, and
+// allocates more space if needed.
+static void reap(struct naPool* p)
+{
+    startReap(p);
+    sweepPool(p, 0);
+    finishReap(p);
+}
+
 // Does the swap, returning the old value
 static void* doswap(void** target, void* val)
 {
@@ -1,6 +1,7 @@
 #include <string.h>
 #include "nasal.h"
 #include "data.h"
+#include "code.h"
 
 /* A HashRec lives in a single allocated block.  The layout is the
  * header struct, then a table of 2^lgsz hash entries (key/value
@@ -81,10 +82,25 @@ static int findcell(struct HashRec *hr, naRef key, unsigned int hash)
     return i;
 }
 
-static void hashset(HashRec* hr, naRef key, naRef val)
+/* Short string keys are replaced by the symbol of the same name, if
+ * there is one.  Lookups with symbols (member names, mostly) then
+ * match by identity, and the key built at runtime can be freed. */
+static naRef internkey(naRef key)
+{
+    naRef sym;
+    if(IS_STR(key) && naStr_len(key) <= MAX_STR_EMBLEN
+       && IS_HASH(globals->symbols) && naHash_get(globals->symbols, key, &sym))
+        return sym;
+    return key;
+}
+
+static void hashset(HashRec* hr, naRef key, naRef val, int intern)
 {
     int ent, cell = findcell(hr, key, refhash(key));
     if((ent = TAB(hr)[cell]) == ENT_EMPTY) {
+        /* Look up the symbol before claiming the cell, the lookup may be
+         * in this very hash (when interning a new symbol) */
+        if(intern) key = internkey(key);
         ent = hr->next++;
         if(ent >= NCELLS(hr)) return; /* race protection, don't overrun */
         TAB(hr)[cell] = ent;
@@ -115,8 +131,10 @@ static HashRec* resize(struct naHash* hash)
     for(i=0; i<(2*(1<<lgsz)); i++)
         TAB(hr2)[i] = ENT_EMPTY;
     for(i=0; hr && i < POW2(hr->lgsz+1); i++)
-        if(TAB(hr)[i] >= 0)
-            hashset(hr2, ENTS(hr)[TAB(hr)[i]].key, ENTS(hr)[TAB(hr)[i]].val);
+        if(TAB(hr)[i] >= 0) {
+            HashEnt* e = &ENTS(hr)[TAB(hr)[i]];
+            hashset(hr2, e->key, e->val, 0);
+        }
     naGC_swapfree((void*)&hash->rec, hr2);
     return hr2;
 }
@@ -140,7 +158,10 @@ void naHash_set(naRef hash, naRef key, naRef val)
     HashRec* hr = REC(hash);
     if(!hr || hr->next >= POW2(hr->lgsz))
         hr = resize(PTR(hash).hash);
-    hashset(hr, key, val);
+    naGC_barrier(key);
+    naMember_changed(PTR(hash).hash);
+    naGC_barrier(val);
+    hashset(hr, key, val, 1);
 }
 
 void naHash_delete(naRef hash, naRef key)
@@ -149,6 +170,7 @@ void naHash_delete(naRef hash, naRef key)
     if(hr) {
         int cell = findcell(hr, key, refhash(key));
         if(TAB(hr)[cell] >= 0) {
+            naMember_changed(PTR(hash).hash);
             TAB(hr)[cell] = ENT_DELETED;
             if(--hr->size < POW2(hr->lgsz-1))
                 resize(PTR(hash).hash);
@@ -165,14 +187,14 @@ void naHash_keys(naRef dst, naRef hash)
             naVec_append(dst, ENTS(hr)[TAB(hr)[i]].key);
 }
 
-void naiGCMarkHash(naRef hash)
+void naiGCMarkHash(naRef hash, struct GrayStack* g)
 {
     int i;
     HashRec* hr = REC(hash);
     for(i=0; hr && i < NCELLS(hr); i++)
         if(TAB(hr)[i] >= 0) {
-            naiGCMark(ENTS(hr)[TAB(hr)[i]].key);
-            naiGCMark(ENTS(hr)[TAB(hr)[i]].val);
+            naiGCMark(ENTS(hr)[TAB(hr)[i]].key, g);
+            naiGCMark(ENTS(hr)[TAB(hr)[i]].val, g);
         }
 }
 
@@ -213,7 +235,12 @@ int naiHash_tryset(naRef hash, naRef key, naRef val)
     HashRec* hr = REC(hash);
     if(hr) {
         int ent, cell = findcell(hr, key, refhash(key));
-        if((ent = TAB(hr)[cell]) >= 0) { ENTS(hr)[ent].val = val; return 1; }
+        if((ent = TAB(hr)[cell]) >= 0) {
+            naGC_barrier(val);
+            naMember_changed(PTR(hash).hash);
+            ENTS(hr)[ent].val = val;
+            return 1;
+        }
     }
     return 0;
 }
@@ -266,6 +293,9 @@ void naiHash_newsym(struct naHash* hash, naRef* sym, naRef* val)
     if(ent >= NCELLS(hr)) return; /* race protection, don't overrun */
     TAB(hr)[cell] = ent;
     hr->size++;
+    naGC_barrier(*sym);
+    naGC_barrier(*val);
+    naMember_changed(hash);
     ENTS(hr)[TAB(hr)[cell]].key = *sym;
     ENTS(hr)[TAB(hr)[cell]].val = *val;
 }
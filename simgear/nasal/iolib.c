@@ -30,12 +30,12 @@ static naRef f_read(naContext c, naRef me, int argc, naRef* args)
     struct naIOGhost* g = argc > 0 ? ioghost(args[0]) : 0;
     naRef str = argc > 1 ? args[1] : naNil();
     naRef len = argc > 2 ? naNumValue(args[2]) : naNil();
-    if(!g || !MUTABLE(str) || !IS_NUM(len))
+    char* buf = naStr_mutable(str);
+    if(!g || !buf || !IS_NUM(len))
         naRuntimeError(c, "bad argument to read()");
     if(naStr_len(str) < (int)len.num)
         naRuntimeError(c, "string not big enough for read");
-    return naNum(g->type->read(c, g->handle, naStr_data(str),
-                               (int)len.num));
+    return naNum(g->type->read(c, g->handle, buf, (int)len.num));
 }
 
 static naRef f_write(naContext c, naRef me, int argc, naRef* args)
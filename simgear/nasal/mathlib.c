@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "nasal.h"
+#include "data.h"
 
 // Toss a runtime error for any NaN or Inf values produced.  Note that
 // this assumes an IEEE 754 format.
@@ -203,6 +204,187 @@ static naRef f_acos(naContext c, naRef me, int argc, naRef* args)
     return VALIDATE(a);
 }
 
+// Bulk operations on vectors of numbers.  Numbers are stored unboxed in
+// naRefs (as doubles on 64 bit platforms), so a vector holding only
+// numbers is already a packed array and the loops below run directly
+// over it, without per element type dispatch or allocation.  Results go
+// to a new vector, or to the optional "out" vector which is resized as
+// needed and may be one of the inputs, so that scripts updating the
+// same data every frame don't create garbage.
+
+// Checks that v is a vector of numbers, returns its size
+static int numvec(naContext c, naRef v, const char* fn)
+{
+    int i;
+    struct VecRec* r;
+    if(!IS_VEC(v))
+        naRuntimeError(c, "non vector argument to %s()", fn);
+    if(!(r = PTR(v).vec->rec)) return 0;
+    for(i=0; i<r->size; i++)
+        if(!IS_NUM(r->array[i]))
+            naRuntimeError(c, "non numeric element in vector passed to %s()",
+                           fn);
+    return r->size;
+}
+
+// Returns the storage of an n element result vector
+static naRef* outvec(naContext c, naRef* out, int n)
+{
+    if(!IS_VEC(*out)) *out = naNewVector(c);
+    if(naVec_size(*out) != n) naVec_setsize(c, *out, n);
+    naMember_changed(PTR(*out).vec);
+    return n ? PTR(*out).vec->rec->array : 0;
+}
+
+static naRef* elems(naRef v)
+{
+    return PTR(v).vec->rec ? PTR(v).vec->rec->array : 0;
+}
+
+// Results are computed into a scratch buffer, and only stored once all
+// of them are valid: out may be one of the inputs, which is then left as
+// it was on errors.
+#define SCRATCH_LOCAL 32
+
+struct Scratch {
+    double* d;
+    double local[SCRATCH_LOCAL];
+};
+
+static double* scratch(struct Scratch* s, int n)
+{
+    s->d = n > SCRATCH_LOCAL ? naAlloc(n * sizeof(double)) : s->local;
+    return s->d;
+}
+
+static naRef storevec(naContext c, struct Scratch* s, naRef out, int n,
+                      const char* fn)
+{
+    int i;
+    naRef* o;
+    for(i=0; i<n && valid(s->d[i]); i++);
+    if(i < n) {
+        if(s->d != s->local) naFree(s->d);
+        return die(c, fn);
+    }
+    o = outvec(c, &out, n);
+    for(i=0; i<n; i++)
+        SETNUM(o[i], s->d[i]);
+    if(s->d != s->local) naFree(s->d);
+    return out;
+}
+
+static naRef f_vsum(naContext c, naRef me, int argc, naRef* args)
+{
+    int i, n = numvec(c, argc > 0 ? args[0] : naNil(), "vsum");
+    naRef* a = elems(args[0]);
+    naRef r;
+    double sum = 0;
+    for(i=0; i<n; i++)
+        sum += a[i].num;
+    r = naNum(sum);
+    return VALIDATE(r);
+}
+
+static naRef f_vscale(naContext c, naRef me, int argc, naRef* args)
+{
+    int i, n = numvec(c, argc > 0 ? args[0] : naNil(), "vscale");
+    naRef s = naNumValue(argc > 1 ? args[1] : naNil());
+    naRef out = argc > 2 ? args[2] : naNil();
+    naRef* a = elems(args[0]);
+    struct Scratch r;
+    double* o;
+    if(naIsNil(s))
+        naRuntimeError(c, "non numeric scale factor to vscale()");
+    o = scratch(&r, n);
+    for(i=0; i<n; i++)
+        o[i] = a[i].num * s.num;
+    return storevec(c, &r, out, n, "vscale");
+}
+
+// vadd(a, b[, out]): b is a vector of the same size or a number
+static naRef f_vadd(naContext c, naRef me, int argc, naRef* args)
+{
+    int i, n = numvec(c, argc > 0 ? args[0] : naNil(), "vadd");
+    naRef b = argc > 1 ? args[1] : naNil();
+    naRef out = argc > 2 ? args[2] : naNil();
+    naRef* a = elems(args[0]);
+    struct Scratch r;
+    double* o;
+    if(IS_VEC(b)) {
+        naRef* bv;
+        if(numvec(c, b, "vadd") != n)
+            naRuntimeError(c, "vectors of different size passed to vadd()");
+        o = scratch(&r, n);
+        bv = elems(b);
+        for(i=0; i<n; i++)
+            o[i] = a[i].num + bv[i].num;
+    } else {
+        b = naNumValue(b);
+        if(naIsNil(b))
+            naRuntimeError(c, "non numeric argument to vadd()");
+        o = scratch(&r, n);
+        for(i=0; i<n; i++)
+            o[i] = a[i].num + b.num;
+    }
+    return storevec(c, &r, out, n, "vadd");
+}
+
+// vlerp(a, b, t[, out]): a + (b - a) * t for vectors a and b
+static naRef f_vlerp(naContext c, naRef me, int argc, naRef* args)
+{
+    int i, n = numvec(c, argc > 0 ? args[0] : naNil(), "vlerp");
+    naRef t = naNumValue(argc > 2 ? args[2] : naNil());
+    naRef out = argc > 3 ? args[3] : naNil();
+    naRef *a, *b;
+    struct Scratch r;
+    double* o;
+    if(numvec(c, argc > 1 ? args[1] : naNil(), "vlerp") != n)
+        naRuntimeError(c, "vectors of different size passed to vlerp()");
+    if(naIsNil(t))
+        naRuntimeError(c, "non numeric argument to vlerp()");
+    o = scratch(&r, n);
+    a = elems(args[0]);
+    b = elems(args[1]);
+    for(i=0; i<n; i++)
+        o[i] = a[i].num + (b[i].num - a[i].num) * t.num;
+    return storevec(c, &r, out, n, "vlerp");
+}
+
+static struct { naCFunction f; double (*fn)(double); } vmapFuncs[] = {
+    { f_sin, sin }, { f_cos, cos }, { f_tan, tan },
+    { f_asin, asin }, { f_acos, acos },
+    { f_exp, exp }, { f_ln, log }, { f_sqrt, sqrt },
+    { f_floor, floor }, { f_ceil, ceil },
+    { 0, 0 }
+};
+
+// vmap(f, v[, out]): applies one of the unary math functions (math.sin,
+// math.sqrt, ...) to every element
+static naRef f_vmap(naContext c, naRef me, int argc, naRef* args)
+{
+    int i, n;
+    naRef f = argc > 0 ? args[0] : naNil();
+    naRef out = argc > 2 ? args[2] : naNil();
+    double (*fn)(double) = 0;
+    naRef* a;
+    struct Scratch r;
+    double* o;
+    if(IS_FUNC(f) && IS_CCODE(PTR(f).func->code)
+       && !PTR(PTR(f).func->code).ccode->fptru)
+        for(i=0; vmapFuncs[i].f; i++)
+            if(vmapFuncs[i].f == PTR(PTR(f).func->code).ccode->fptr)
+                fn = vmapFuncs[i].fn;
+    if(!fn)
+        naRuntimeError(c, "vmap() needs a unary math function");
+    n = numvec(c, argc > 1 ? args[1] : naNil(), "vmap");
+    o = scratch(&r, n);
+    a = elems(args[1]);
+    for(i=0; i<n; i++)
+        o[i] = fn(a[i].num);
+    return storevec(c, &r, out, n, "vmap");
+}
+
 static naCFuncItem funcs[] = {
     { "sin", f_sin },
     { "cos", f_cos },
@@ -220,6 +402,11 @@ static naCFuncItem funcs[] = {
     { "tan", f_tan },   
     { "acos", f_acos },
     { "asin", f_asin },   
+    { "vsum", f_vsum },
+    { "vscale", f_vscale },
+    { "vadd", f_vadd },
+    { "vlerp", f_vlerp },
+    { "vmap", f_vmap },
     { 0 }
 };
 
@@ -87,6 +87,7 @@ naRef naNewString(struct Context* c)
 naRef naNewVector(struct Context* c)
 {
     naRef r = naNew(c, T_VEC);
+    PTR(r).vec->proto = 0;
     PTR(r).vec->rec = 0;
     return r;
 }
@@ -94,6 +95,7 @@ naRef naNewVector(struct Context* c)
 naRef naNewHash(struct Context* c)
 {
     naRef r = naNew(c, T_HASH);
+    PTR(r).hash->proto = 0;
     PTR(r).hash->rec = 0;
     return r;
 }
@@ -174,8 +176,10 @@ void* naGhost_ptr(naRef ghost)
 
 void naGhost_setData(naRef ghost, naRef data)
 {
-    if(IS_GHOST(ghost))
+    if(IS_GHOST(ghost)) {
+        naGC_barrier(data);
         PTR(ghost).ghost->data = data;
+    }
 }
 
 naRef naGhost_data(naRef ghost)
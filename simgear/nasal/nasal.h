@@ -45,6 +45,61 @@ void* naGetUserData(naContext c) GCC_PURE;
 // run GC now (may block)
 void naGC();
 
+// Garbage collector modes.  NA_GC_FULL (the default) collects the whole
+// heap in a single pause.  NA_GC_INCREMENTAL spreads the marking and
+// the sweep over many pauses of at most stepUsec microseconds each.
+// The final rescan of the context stacks is retried in later pauses
+// while the objects it finds take longer to mark; the last try marks
+// them all in one go, which takes as long as marking everything
+// allocated (and only referenced from the stacks) since the collection
+// started.
+enum { NA_GC_FULL, NA_GC_INCREMENTAL };
+void naGCSetMode(int mode, int stepUsec);
+
+// Number of helper threads which mark and sweep in parallel with the
+// thread running the collector, to shorten the pauses on large heaps.
+// The default of 0 collects on that thread alone.
+void naGCSetThreads(int n);
+
+// Run one step of an incremental collection, if one is in progress.
+// Lets the host do collection work at a convenient point (e.g. once per
+// frame) rather than in the middle of an allocation.
+void naGCStep();
+
+typedef struct {
+    int cycles;        // completed collections
+    int pauses;        // collector pauses, including incremental steps
+    double lastPause;  // duration of the last pause, in microseconds
+    double maxPause;   // longest pause, in microseconds
+    double totalPause; // time spent in all pauses, in microseconds
+} naGCStats;
+void naGCGetStats(naGCStats* stats);
+void naGCResetStats();
+
+// Sampling profiler.  While it runs, every naProfileTick() (typically
+// called from a timer thread) makes the interpreter record the Nasal
+// call stack at its next backward jump or function call.  Samples are
+// kept until naProfileReset().
+void naProfileStart();
+void naProfileStop();
+int naProfileRunning();
+void naProfileTick();
+void naProfileReset();
+int naProfileSamples();
+
+typedef struct {
+    const char* file; // source file of the function
+    int funcLine;     // first line of the function
+    int line;         // line being executed, or calling the next frame
+} naProfileFrame;
+
+// Calls cb once for every distinct stack sampled, outermost frame
+// first, with its number of samples.  Runs with the interpreter lock
+// held, so cb must not call into Nasal.
+typedef void (*naProfileCallback)(void* user, const naProfileFrame* frames,
+                                  int depth, int count);
+void naProfileForEach(naProfileCallback cb, void* user);
+
 // "Save" this object in the context, preventing it (and objects
 // referenced by it) from being garbage collected.
 // TODO do we need a context? It is not used anyhow...
@@ -77,6 +132,16 @@ void naTempSave(naContext c, naRef r);
 naRef naParseCode(naContext c, naRef srcFile, int firstLine,
                   char* buf, int len, int* errLine);
 
+// Compiled code caching.  naSaveCode() serializes a code object
+// returned by naParseCode() for the given source text and first line,
+// and returns it as a (binary) string.  naLoadCode() recreates the code
+// object, or returns nil if the buffer is damaged, was written by an
+// incompatible version, or for a different source text.
+naRef naSaveCode(naContext c, naRef code, int firstLine,
+                 const char* src, int srclen);
+naRef naLoadCode(naContext c, naRef srcFile, int firstLine,
+                 const char* src, int srclen, const char* buf, int len);
+
 // Binds a bare code object (as returned from naParseCode) with a
 // closure object (a hash) to act as the outer scope / namespace.
 naRef naBindFunction(naContext ctx, naRef code, naRef closure);
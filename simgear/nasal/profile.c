@@ -0,0 +1,264 @@
+#include <string.h>
+#include "nasal.h"
+#include "code.h"
+
+// Sampling profiler.  naProfileTick(), usually called from a timer
+// thread, raises naProfileFlag.  The interpreter checks the flag at
+// backward jumps and function calls, and the first one to see it
+// records the call stack of the running context.  Samples are counted
+// per distinct stack; every frame of a stack is a location (the
+// function's file and first line, and the line being executed).
+
+#define PROF_MAX_DEPTH 256
+
+struct ProfLoc {
+    const char* file;
+    int funcLine;
+    int line;
+    unsigned int hash;
+};
+
+struct ProfStack {
+    int* locs;
+    int depth;
+    int count;
+    unsigned int hash;
+};
+
+// Both are read by naProfileTick() on the timer thread
+volatile int naProfileFlag = 0;
+static volatile int profiling = 0;
+
+// Open addressing tables of indexes into locs and stacks, -1 if empty
+static struct ProfLoc* locs;
+static int nlocs, locsz, *locIndex;
+static struct ProfStack* stacks;
+static int nstacks, stacksz, *stackIndex;
+static int nsamples;
+
+// Interned file names, so that locations don't refer to strings which
+// the garbage collector might free.  Lookups go through a small cache
+// keyed by the naStr, which is checked against the contents as the
+// string may have been freed and reused since.
+#define FILE_CACHE_SZ 64
+static char** files;
+static int nfiles, filesz;
+static struct { struct naStr* str; char* file; } fileCache[FILE_CACHE_SZ];
+
+static unsigned int hashints(const int* v, int n, unsigned int h)
+{
+    int i;
+    for(i=0; i<n; i++) h = (h ^ (unsigned int)v[i]) * 16777619u;
+    return h;
+}
+
+static unsigned int ptrhash(const void* p)
+{
+    size_t v = (size_t)p;
+    return (unsigned int)(v ^ (v >> 16)) * 2654435761u;
+}
+
+// Builds an index table with 2*sz cells for the first n entries
+static int* reindex(int* index, int sz, int n, unsigned int (*hashof)(int))
+{
+    int i, mask = 2*sz - 1, *tab = naAlloc(sizeof(int) * 2 * sz);
+    for(i=0; i <= mask; i++) tab[i] = -1;
+    for(i=0; i<n; i++) {
+        int cell = hashof(i) & mask;
+        while(tab[cell] >= 0) cell = (cell + 1) & mask;
+        tab[cell] = i;
+    }
+    naFree(index);
+    return tab;
+}
+
+static unsigned int lochash(int i) { return locs[i].hash; }
+static unsigned int stackhash(int i) { return stacks[i].hash; }
+
+static const char* internFile(naRef src)
+{
+    int i, len, slot;
+    const char* s;
+    if(!IS_STR(src)) return "<unknown>";
+    s = naStr_data(src);
+    len = naStr_len(src);
+    slot = ptrhash(PTR(src).str) & (FILE_CACHE_SZ-1);
+    if(fileCache[slot].str == PTR(src).str) {
+        char* f = fileCache[slot].file;
+        if((int)strlen(f) == len && memcmp(f, s, len) == 0)
+            return f;
+    }
+    for(i=nfiles-1; i>=0; i--)
+        if((int)strlen(files[i]) == len && memcmp(files[i], s, len) == 0)
+            break;
+    if(i < 0) {
+        if(nfiles >= filesz) {
+            filesz = filesz ? 2*filesz : 16;
+            files = naRealloc(files, sizeof(char*) * filesz);
+        }
+        i = nfiles++;
+        files[i] = naAlloc(len + 1);
+        memcpy(files[i], s, len);
+        files[i][len] = 0;
+    }
+    fileCache[slot].str = PTR(src).str;
+    fileCache[slot].file = files[i];
+    return files[i];
+}
+
+static int findLoc(struct Frame* f)
+{
+    struct ProfLoc loc;
+    int cell, mask;
+
+    loc.file = "<native>";
+    loc.funcLine = loc.line = 0;
+    if(IS_FUNC(f->func) && IS_CODE(PTR(f->func).func->code)) {
+        struct naCode* c = PTR(PTR(f->func).func->code).code;
+        int i = c->nLines - 2;
+        loc.file = internFile(c->srcFile);
+        if(c->nLines > 0) {
+            // Indexes, as a pointer before the table would be undefined
+            while(i >= 0 && LINEIPS(c)[i] > f->ip)
+                i -= 2;
+            loc.funcLine = LINEIPS(c)[1];
+            loc.line = i >= 0 ? LINEIPS(c)[i+1] : loc.funcLine;
+        }
+    }
+    loc.hash = ptrhash(loc.file) ^ hashints(&loc.funcLine, 1, 2166136261u);
+    loc.hash = hashints(&loc.line, 1, loc.hash);
+
+    mask = 2*locsz - 1;
+    for(cell = loc.hash & mask; locsz && locIndex[cell] >= 0;
+        cell = (cell + 1) & mask) {
+        struct ProfLoc* l = &locs[locIndex[cell]];
+        if(l->file == loc.file && l->funcLine == loc.funcLine
+           && l->line == loc.line)
+            return locIndex[cell];
+    }
+
+    if(nlocs >= locsz) {
+        locsz = locsz ? 2*locsz : 64;
+        locs = naRealloc(locs, sizeof(struct ProfLoc) * locsz);
+        locs[nlocs] = loc;
+        locIndex = reindex(locIndex, locsz, nlocs + 1, lochash);
+    } else {
+        locs[nlocs] = loc;
+        locIndex[cell] = nlocs;
+    }
+    return nlocs++;
+}
+
+static void addStack(int* frames, int depth)
+{
+    int i, cell, mask;
+    unsigned int hash = hashints(frames, depth, 2166136261u);
+
+    mask = 2*stacksz - 1;
+    for(cell = hash & mask; stacksz && stackIndex[cell] >= 0;
+        cell = (cell + 1) & mask) {
+        struct ProfStack* s = &stacks[stackIndex[cell]];
+        if(s->hash == hash && s->depth == depth
+           && memcmp(s->locs, frames, sizeof(int) * depth) == 0) {
+            s->count++;
+            return;
+        }
+    }
+
+    if(nstacks >= stacksz) {
+        stacksz = stacksz ? 2*stacksz : 64;
+        stacks = naRealloc(stacks, sizeof(struct ProfStack) * stacksz);
+        cell = -1;
+    }
+    stacks[nstacks].locs = naAlloc(sizeof(int) * (depth ? depth : 1));
+    for(i=0; i<depth; i++) stacks[nstacks].locs[i] = frames[i];
+    stacks[nstacks].depth = depth;
+    stacks[nstacks].count = 1;
+    stacks[nstacks].hash = hash;
+    if(cell < 0)
+        stackIndex = reindex(stackIndex, stacksz, nstacks + 1, stackhash);
+    else
+        stackIndex[cell] = nstacks;
+    nstacks++;
+}
+
+// Called by the interpreter when it finds naProfileFlag set
+void naProfileSample(naContext ctx)
+{
+    int i, depth = 0, frames[PROF_MAX_DEPTH];
+    naProfileFlag = 0;
+    if(!profiling) return;
+
+    // Calls from C code into Nasal run in sub-contexts; the outermost
+    // context holds the bottom of the stack
+    while(ctx->callParent) ctx = ctx->callParent;
+    LOCK();
+    for(; ctx; ctx = ctx->callChild)
+        for(i=0; i < ctx->fTop && depth < PROF_MAX_DEPTH; i++)
+            frames[depth++] = findLoc(&ctx->fStack[i]);
+    addStack(frames, depth);
+    nsamples++;
+    UNLOCK();
+}
+
+void naProfileStart()
+{
+    profiling = 1;
+}
+
+void naProfileStop()
+{
+    profiling = 0;
+    naProfileFlag = 0;
+}
+
+int naProfileRunning()
+{
+    return profiling;
+}
+
+void naProfileTick()
+{
+    if(profiling) naProfileFlag = 1;
+}
+
+int naProfileSamples()
+{
+    return nsamples;
+}
+
+void naProfileForEach(naProfileCallback cb, void* user)
+{
+    int i, j;
+    naProfileFrame frames[PROF_MAX_DEPTH];
+    if(!globals) return;
+    LOCK();
+    for(i=0; i<nstacks; i++) {
+        for(j=0; j<stacks[i].depth; j++) {
+            struct ProfLoc* l = &locs[stacks[i].locs[j]];
+            frames[j].file = l->file;
+            frames[j].funcLine = l->funcLine;
+            frames[j].line = l->line;
+        }
+        cb(user, frames, stacks[i].depth, stacks[i].count);
+    }
+    UNLOCK();
+}
+
+void naProfileReset()
+{
+    int i;
+    if(!globals) return;
+    LOCK();
+    for(i=0; i<nstacks; i++) naFree(stacks[i].locs);
+    for(i=0; i<nfiles; i++) naFree(files[i]);
+    naFree(stacks); naFree(stackIndex);
+    naFree(locs); naFree(locIndex);
+    naFree(files);
+    stacks = 0; stackIndex = 0; nstacks = stacksz = 0;
+    locs = 0; locIndex = 0; nlocs = locsz = 0;
+    files = 0; nfiles = filesz = 0;
+    memset(fileCache, 0, sizeof(fileCache));
+    nsamples = 0;
+    UNLOCK();
+}
@@ -1,8 +1,12 @@
 #include <math.h>
 #include <string.h>
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
 
 #include "nasal.h"
 #include "data.h"
+#include "code.h"
 
 // The maximum number of significant (decimal!) figures in an IEEE
 // double.
@@ -11,8 +15,91 @@
 static int tonum(unsigned char* s, int len, double* result);
 static int fromnum(double val, unsigned char* s);
 
-#define LEN(s) ((s)->emblen != -1 ? (s)->emblen : (s)->data.ref.len)
-#define DATA(s) ((s)->emblen != -1 ? (s)->data.buf : (s)->data.ref.ptr)
+// Concatenations shorter than this are copied as before, longer ones
+// become ropes (see data.h)
+#define ROPE_MIN 64
+
+#define LEN(s) ((s)->emblen >= 0 ? (s)->emblen : (s)->data.ref.len)
+#define DATA(s) ((s)->emblen >= 0 ? (s)->data.buf : \
+                 (s)->emblen == STR_ROPE ? flatten(s) : (s)->data.ref.ptr)
+
+// A thawed string keeps the bytes it had while frozen, for the ropes
+// that may still refer to it, in front of its own copy.
+#define FROZEN_DATA(s) (((unsigned char**)(s)->data.ref.ptr)[-1])
+
+// Orders the store of a new buffer before that of the new state
+#if defined(__GNUC__)
+#define PUBLISH() __sync_synchronize()
+#elif defined(_MSC_VER)
+#define PUBLISH() MemoryBarrier()
+#else
+#define PUBLISH()
+#endif
+
+// Copies a rope into a single buffer.  Strings are shared between
+// threads, so this may race with another flatten() of the same rope:
+// the check is repeated under the lock, and the buffer is published
+// before the new state.
+static unsigned char* flatten(struct naStr* s)
+{
+    int pos;
+    unsigned char* buf;
+    struct naRope *node, *r;
+    naLock(globals->strLock);
+    if(s->emblen != STR_ROPE) {
+        naUnlock(globals->strLock);
+        return s->data.ref.ptr;
+    }
+    node = s->data.rope.node;
+    pos = s->data.rope.len;
+    buf = naAlloc(pos + 1);
+    buf[pos] = 0;
+    for(r = node; r; ) {
+        struct naStr* left;
+        pos -= r->len;
+        memcpy(buf + pos, r->data, r->len);
+        if(IS_NIL(r->left)) break;
+        left = PTR(r->left).str;
+        if(left->emblen != STR_ROPE) {
+            memcpy(buf, left->emblen >= 0 ? left->data.buf
+                        : left->emblen == STR_THAWED ? FROZEN_DATA(left)
+                        : left->data.ref.ptr, pos);
+            break;
+        }
+        r = left->data.rope.node;
+    }
+    s->data.ref.ptr = buf;
+    PUBLISH();
+    s->emblen = STR_FROZEN;
+    naUnlock(globals->strLock);
+    naFree(node);
+    return buf;
+}
+
+// Copy on write: a rope is flattened and then gets a private copy of
+// its bytes.
+static void thaw(struct naStr* s)
+{
+    unsigned char **blk, *frozen = DATA(s);
+    naLock(globals->strLock);
+    if(s->emblen == STR_FROZEN) {
+        blk = naAlloc(sizeof(unsigned char*) + s->data.ref.len + 1);
+        blk[0] = frozen;
+        memcpy(blk + 1, frozen, s->data.ref.len + 1);
+        s->data.ref.ptr = (unsigned char*)(blk + 1);
+        PUBLISH();
+        s->emblen = STR_THAWED;
+    }
+    naUnlock(globals->strLock);
+}
+
+char* naStr_mutable(naRef s)
+{
+    if(!IS_STR(s) || PTR(s).str->hashcode) return 0;
+    if(PTR(s).str->emblen == STR_ROPE || PTR(s).str->emblen == STR_FROZEN)
+        thaw(PTR(s).str);
+    return (char*)DATA(PTR(s).str);
+}
 
 int naStr_len(naRef s)
 {
@@ -24,9 +111,19 @@ char* naStr_data(naRef s)
     return IS_STR(s) ? (char*)DATA(PTR(s).str) : 0;
 }
 
+static void freedata(struct naStr* s)
+{
+    if(s->emblen == STR_ROPE) naFree(s->data.rope.node);
+    else if(s->emblen == STR_THAWED) {
+        naFree(FROZEN_DATA(s));
+        naFree((unsigned char**)s->data.ref.ptr - 1);
+    }
+    else if(s->emblen < 0) naFree(s->data.ref.ptr);
+}
+
 static void setlen(struct naStr* s, int sz)
 {
-    if(s->emblen == -1 && DATA(s)) naFree(s->data.ref.ptr);
+    freedata(s);
     if(sz > MAX_STR_EMBLEN) {
         s->emblen = -1;
         s->data.ref.len = sz;
@@ -52,15 +149,42 @@ naRef naStr_fromdata(naRef dst, const char* data, int len)
     return dst;
 }
 
+// Long results become ropes, so that building a string by appending
+// to it copies each piece once instead of the whole string every
+// time.  A rope can only refer to strings which never change (ropes
+// themselves and hash keys), the bytes of any other are copied.
 naRef naStr_concat(naRef dest, naRef s1, naRef s2)
 {
     struct naStr* dst = PTR(dest).str;
     struct naStr* a = PTR(s1).str;
     struct naStr* b = PTR(s2).str;
+    struct naRope* node;
+    int len;
     if(!(IS_STR(s1)&&IS_STR(s2)&&IS_STR(dest))) return naNil();
-    setlen(dst, LEN(a) + LEN(b));
-    memcpy(DATA(dst), DATA(a), LEN(a));
-    memcpy(DATA(dst) + LEN(a), DATA(b), LEN(b));
+    len = LEN(a) + LEN(b);
+    if(len < ROPE_MIN || dst == a || dst == b) {
+        setlen(dst, len);
+        memcpy(DATA(dst), DATA(a), LEN(a));
+        memcpy(DATA(dst) + LEN(a), DATA(b), LEN(b));
+        return dest;
+    }
+    if(a->emblen == STR_ROPE || a->emblen == STR_FROZEN || a->hashcode) {
+        node = naAlloc(sizeof(struct naRope) + LEN(b));
+        node->left = s1;
+        node->len = LEN(b);
+        memcpy(node->data, DATA(b), LEN(b));
+    } else {
+        node = naAlloc(sizeof(struct naRope) + len);
+        node->left = naNil();
+        node->len = len;
+        memcpy(node->data, DATA(a), LEN(a));
+        memcpy(node->data + LEN(a), DATA(b), LEN(b));
+    }
+    naGC_barrier(node->left);
+    freedata(dst);
+    dst->emblen = STR_ROPE;
+    dst->data.rope.len = len;
+    dst->data.rope.node = node;
     return dest;
 }
 
@@ -112,7 +236,7 @@ int naStr_numeric(naRef str)
 
 void naStr_gcclean(struct naStr* str)
 {
-    if(str->emblen == -1) naFree(str->data.ref.ptr);
+    freedata(str);
     str->data.ref.ptr = 0;
     str->data.ref.len = 0;
     str->emblen = -1;
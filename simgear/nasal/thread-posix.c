@@ -1,6 +1,8 @@
 #ifndef _WIN32
 
 #include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
 #include "code.h"
 
 void* naNewLock()
@@ -68,6 +70,47 @@ void naSemUp(void* sh, int count)
     pthread_mutex_unlock(&sem->lock);
 }
 
+struct ThreadStart {
+    void (*fn)(void*);
+    void* arg;
+};
+
+static void* threadstart(void* p)
+{
+    struct ThreadStart ts = *(struct ThreadStart*)p;
+    naFree(p);
+    ts.fn(ts.arg);
+    return 0;
+}
+
+int naNewThread(void (*fn)(void*), void* arg)
+{
+    pthread_t t;
+    struct ThreadStart* ts = naAlloc(sizeof(struct ThreadStart));
+    ts->fn = fn;
+    ts->arg = arg;
+    if(pthread_create(&t, 0, threadstart, ts)) {
+        naFree(ts);
+        return 0;
+    }
+    pthread_detach(t);
+    return 1;
+}
+
+double naTimeUsec()
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+#endif
+    {
+        struct timeval tv;
+        gettimeofday(&tv, 0);
+        return tv.tv_sec * 1e6 + tv.tv_usec;
+    }
+}
+
 #endif
 
 extern int GccWarningWorkaround_IsoCForbidsAnEmptySourceFile;
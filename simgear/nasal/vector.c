@@ -42,6 +42,8 @@ void naVec_set(naRef vec, int i, naRef o)
     if(IS_VEC(vec)) {
         struct VecRec* r = PTR(vec).vec->rec;
         if(r && i >= r->size) return;
+        naGC_barrier(o);
+        naMember_changed(PTR(vec).vec);
         r->array[i] = o;
     }
 }
@@ -63,6 +65,8 @@ int naVec_append(naRef vec, naRef o)
             resize(PTR(vec).vec);
             r = PTR(vec).vec->rec;
         }
+        naGC_barrier(o);
+        naMember_changed(PTR(vec).vec);
         r->array[r->size] = o;
         return r->size++;
     }
@@ -81,6 +85,7 @@ void naVec_setsize(naContext c, naRef vec, int sz)
         struct VecRec* nv = naAlloc(sizeof(struct VecRec) + sizeof(naRef) * sz);
         nv->size = sz;
         nv->alloced = sz;
+        naMember_changed(PTR(vec).vec);
         for(i=0; i<sz; i++)
             nv->array[i] = (v && i < v->size) ? v->array[i] : naNil();
         naGC_swapfree((void*)&(PTR(vec).vec->rec), nv);
@@ -95,6 +100,7 @@ naRef naVec_removefirst(naRef vec)
     if(IS_VEC(vec)) {
         struct VecRec* v = PTR(vec).vec->rec;
         if(!v || v->size == 0) return naNil();
+        naMember_changed(PTR(vec).vec);
         o = v->array[0];
         for (i=1; i<v->size; i++)
             v->array[i-1] = v->array[i];
@@ -113,6 +119,7 @@ naRef naVec_removelast(naRef vec)
     if(IS_VEC(vec)) {
         struct VecRec* v = PTR(vec).vec->rec;
         if(!v || v->size == 0) return naNil();
+        naMember_changed(PTR(vec).vec);
         o = v->array[v->size - 1];
         v->size--;
         if(v->size < (v->alloced >> 1))
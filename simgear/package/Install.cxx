@@ -29,6 +29,7 @@
 #include <simgear/package/Root.hxx>
 #include <simgear/io/HTTPRequest.hxx>
 #include <simgear/io/HTTPClient.hxx>
+#include <simgear/io/ObjectStore.hxx>
 #include <simgear/misc/sg_dir.hxx>
 #include <simgear/misc/strutils.hxx>
 
@@ -58,6 +59,33 @@ public:
         m_extractPath.append("_DOWNLOAD"); // add some temporary value
         
     }
+
+    /**
+     * install from an archive held in the object store, if there is one
+     * matching the package MD5. The store checks the digest of the data
+     * it reads, dropping a corrupt archive. Returns false if the archive
+     * was not available (or unusable), in which case the caller should
+     * download.
+     */
+    bool installFromStore()
+    {
+        ObjectStore* store = m_owner->package()->catalog()->root()->objectStore();
+        if (!store || !store->read(m_owner->package()->md5(), m_buffer)) {
+            return false;
+        }
+
+        Dir d(m_extractPath);
+        d.create(0755);
+        if (!extractUnzip()) {
+            SG_LOG(SG_GENERAL, SG_WARN, "cached archive extraction failed, downloading");
+            d.remove(true /* recursive */);
+            m_buffer.clear();
+            return false;
+        }
+
+        finishInstall();
+        return true;
+    }
     
 protected:
     virtual std::string url() const
@@ -109,7 +137,19 @@ protected:
             doFailure(Delegate::FAIL_EXTRACT);
             return;
         }
-                  
+
+        ObjectStore* store = m_owner->package()->catalog()->root()->objectStore();
+        if (store) {
+            store->insertData(hex_md5, m_buffer.data(), m_buffer.size());
+        }
+
+        finishInstall();
+    }
+    
+private:
+
+    void finishInstall()
+    {
         if (m_owner->path().exists()) {
             //std::cout << "removing existing path" << std::endl;
             Dir destDir(m_owner->path());
@@ -127,8 +167,6 @@ protected:
         m_owner->writeRevisionFile();
         m_owner->installResult(Delegate::FAIL_SUCCESS);
     }
-    
-private:
 
     void extractCurrentFile(unzFile zip, char* buffer, size_t bufferSize)
     {
@@ -309,8 +347,14 @@ void Install::startUpdate()
     }
     
     m_download = new PackageArchiveDownloader(this);
-    m_package->catalog()->root()->makeHTTPRequest(m_download);
+    HTTP::Request_ptr req(m_download); // the HTTP client may not own it
     m_package->catalog()->root()->startInstall(this);
+    if (m_download->installFromStore()) {
+        m_download = NULL;
+        return;
+    }
+
+    m_package->catalog()->root()->makeHTTPRequest(m_download);
 }
 
 bool Install::uninstall()
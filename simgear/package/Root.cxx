@@ -27,6 +27,7 @@
 #include <simgear/props/props_io.hxx>
 #include <simgear/io/HTTPRequest.hxx>
 #include <simgear/io/HTTPClient.hxx>
+#include <simgear/io/ObjectStore.hxx>
 #include <simgear/misc/sg_dir.hxx>
 #include <simgear/structure/exception.hxx>
 #include <simgear/package/Package.hxx>
@@ -57,6 +58,7 @@ public:
     unsigned int maxAgeSeconds;
     Delegate* delegate;
     std::string version;
+    ObjectStoreRef objectStore;
     
     std::set<CatalogRef> refreshing;
     std::deque<InstallRef> updateDeque;
@@ -88,6 +90,16 @@ void Root::setHTTPClient(HTTP::Client* aHTTP)
     d->httpPendingRequests.clear();
 }
 
+void Root::setObjectStore(ObjectStore* aStore)
+{
+    d->objectStore = aStore;
+}
+
+ObjectStore* Root::objectStore() const
+{
+    return d->objectStore.get();
+}
+
 void Root::makeHTTPRequest(HTTP::Request *req)
 {
     if (d->http) {
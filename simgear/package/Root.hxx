@@ -36,6 +36,8 @@ namespace HTTP {
     class Client;
     class Request;
 }
+
+class ObjectStore;
     
 namespace pkg
 {
@@ -79,6 +81,14 @@ public:
      * set yet.
      */
     void makeHTTPRequest(HTTP::Request* req);
+
+    /**
+     * content-addressed store consulted for package archives (by their
+     * catalog MD5) before downloading, and populated after each successful
+     * download. May be shared with TerraSync and other installations.
+     */
+    void setObjectStore(ObjectStore* aStore);
+    ObjectStore* objectStore() const;
     
     /**
      * the version string of the root. Catalogs must match this version,
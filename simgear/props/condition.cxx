@@ -14,6 +14,9 @@
 // #include <iostream>
 
 #include <simgear/structure/exception.hxx>
+#include <simgear/structure/SGAtomic.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/threads/SGGuard.hxx>
 
 #include "props.hxx"
 #include "condition.hxx"
@@ -39,6 +42,7 @@ public:
   virtual bool test () const { return _node->getBoolValue(); }
   virtual void collectDependentProperties(std::set<const SGPropertyNode*>& props) const
     { props.insert(_node.get()); }
+  virtual bool dependsOnPropertiesOnly () const { return true; }
 private:
   SGConstPropertyNode_ptr _node;
 };
@@ -52,6 +56,7 @@ class SGConstantCondition : public SGCondition
 public:
   SGConstantCondition (bool v) : _value(v) { ; }
   virtual bool test () const { return _value; }
+  virtual bool dependsOnPropertiesOnly () const { return true; }
 private:
   bool _value;
 };
@@ -68,6 +73,7 @@ public:
   virtual ~SGNotCondition ();
   virtual bool test () const;
   virtual void collectDependentProperties(std::set<const SGPropertyNode*>& props) const;
+  virtual bool dependsOnPropertiesOnly () const;
 private:
   SGConditionRef _condition;
 };
@@ -88,6 +94,7 @@ public:
 				// transfer pointer ownership
   virtual void addCondition (SGCondition * condition);
   virtual void collectDependentProperties(std::set<const SGPropertyNode*>& props) const;
+  virtual bool dependsOnPropertiesOnly () const;
 private:
   std::vector<SGConditionRef> _conditions;
 };
@@ -108,6 +115,7 @@ public:
 				// transfer pointer ownership
   virtual void addCondition (SGCondition * condition);
   virtual void collectDependentProperties(std::set<const SGPropertyNode*>& props) const;
+  virtual bool dependsOnPropertiesOnly () const;
 private:
   std::vector<SGConditionRef> _conditions;
 };
@@ -143,6 +151,7 @@ public:
   void setPrecisionDExpression(SGExpressiond* dexp);
   
   virtual void collectDependentProperties(std::set<const SGPropertyNode*>& props) const;
+  virtual bool dependsOnPropertiesOnly () const { return true; }
 private:
   Type _type;
   bool _reverse;
@@ -209,6 +218,12 @@ SGNotCondition::collectDependentProperties(std::set<const SGPropertyNode*>& prop
     _condition->collectDependentProperties(props);
 }
 
+bool
+SGNotCondition::dependsOnPropertiesOnly () const
+{
+  return _condition->dependsOnPropertiesOnly();
+}
+
 ////////////////////////////////////////////////////////////////////////
 // Implementation of SGAndCondition.
 ////////////////////////////////////////////////////////////////////////
@@ -245,6 +260,17 @@ SGAndCondition::collectDependentProperties(std::set<const SGPropertyNode*>& prop
     _conditions[i]->collectDependentProperties(props);
 }
 
+bool
+SGAndCondition::dependsOnPropertiesOnly () const
+{
+  for( size_t i = 0; i < _conditions.size(); i++ )
+  {
+    if (!_conditions[i]->dependsOnPropertiesOnly())
+      return false;
+  }
+  return true;
+}
+
 
 ////////////////////////////////////////////////////////////////////////
 // Implementation of SGOrCondition.
@@ -282,6 +308,17 @@ SGOrCondition::collectDependentProperties(std::set<const SGPropertyNode*>& props
     _conditions[i]->collectDependentProperties(props);
 }
 
+bool
+SGOrCondition::dependsOnPropertiesOnly () const
+{
+  for( size_t i = 0; i < _conditions.size(); i++ )
+  {
+    if (!_conditions[i]->dependsOnPropertiesOnly())
+      return false;
+  }
+  return true;
+}
+
 
 ////////////////////////////////////////////////////////////////////////
 // Implementation of SGComparisonCondition.
@@ -470,6 +507,144 @@ SGComparisonCondition::collectDependentProperties(std::set<const SGPropertyNode*
   
 }
 
+////////////////////////////////////////////////////////////////////////
+// Implementation of SGCachedCondition.
+////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  struct ConditionCacheCounters
+  {
+    SGAtomic evaluations;
+    SGAtomic avoided;
+  } counters;
+
+  // Listeners of deleted conditions, left for removeRetiredListeners()
+  SGMutex retiredMutex;
+  std::vector<SGPropertyChangeListener*> retiredListeners;
+
+  void store(SGAtomic& atomic, unsigned value)
+  {
+    for (unsigned old = atomic; !atomic.compareAndExchange(old, value);
+         old = atomic)
+      ;
+  }
+}
+
+// Counts the changes, so that a test can tell whether the properties
+// changed since the value was cached.  It doesn't refer to the
+// condition, which may be gone before the listener is removed.
+class SGCachedCondition::Listener : public SGPropertyChangeListener
+{
+public:
+  virtual void valueChanged (SGPropertyNode * node)
+  {
+    ++changes;
+  }
+  SGAtomic changes;
+};
+
+SGCachedCondition::SGCachedCondition (const SGCondition * condition)
+  : _condition(condition),
+    _listener(new Listener),
+    _listening(false),
+    _volatile(!condition->dependsOnPropertiesOnly()),
+    _cache(0)
+{
+  std::set<const SGPropertyNode*> props;
+  _condition->collectDependentProperties(props);
+  _properties.assign(props.begin(), props.end());
+}
+
+SGCachedCondition::~SGCachedCondition ()
+{
+  if (!_listening) {
+    delete _listener;
+    return;
+  }
+  SGGuard<SGMutex> lock(retiredMutex);
+  retiredListeners.push_back(_listener);
+}
+
+void
+SGCachedCondition::listen ()
+{
+  removeRetiredListeners();
+  if (_listening || _volatile)
+    return;
+  for( size_t i = 0; i < _properties.size(); i++ )
+  {
+    if (_properties[i]->isTied() || _properties[i]->isAlias())
+      store(_volatile, true);
+    else
+      const_cast<SGPropertyNode*>(_properties[i])->addChangeListener(_listener);
+  }
+  // Changes before the listeners were added would be lost.  Counted
+  // before _listening is set, which test() reads first.
+  ++_listener->changes;
+  store(_listening, true);
+}
+
+void
+SGCachedCondition::removeRetiredListeners ()
+{
+  std::vector<SGPropertyChangeListener*> listeners;
+  {
+    SGGuard<SGMutex> lock(retiredMutex);
+    listeners.swap(retiredListeners);
+  }
+  for (size_t i = 0; i < listeners.size(); ++i)
+    delete listeners[i];
+}
+
+bool
+SGCachedCondition::test () const
+{
+  // The count is read before testing, so that changes while testing
+  // are not lost.  The value is cached together with the count it
+  // belongs to, as other threads may test at the same time.
+  bool listening = _listening;
+  unsigned changes = _listener->changes & (~0u >> 1);
+  if (listening && !_volatile) {
+    // Properties tied since, which no longer notify the listener
+    for( size_t i = 0; i < _properties.size(); i++ )
+    {
+      if (_properties[i]->isTied() || _properties[i]->isAlias())
+        store(_volatile, true);
+    }
+    unsigned cache = _cache;
+    if (!_volatile && cache >> 1 == changes) {
+      ++counters.avoided;
+      return cache & 1;
+    }
+  }
+  bool value = _condition->test();
+  store(_cache, changes << 1 | value);
+  ++counters.evaluations;
+  return value;
+}
+
+void
+SGCachedCondition::collectDependentProperties(std::set<const SGPropertyNode*>& props) const
+{
+  _condition->collectDependentProperties(props);
+}
+
+bool
+SGCachedCondition::dependsOnPropertiesOnly () const
+{
+  return _condition->dependsOnPropertiesOnly();
+}
+
+SGConditionCacheStats
+sgGetConditionCacheStats ()
+{
+  SGConditionCacheStats stats;
+  stats.evaluations = counters.evaluations;
+  stats.avoided = counters.avoided;
+  return stats;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // Read a condition and use it if necessary.
 ////////////////////////////////////////////////////////////////////////
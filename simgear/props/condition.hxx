@@ -11,6 +11,8 @@
 #define __SG_CONDITION_HXX
 
 #include <set>
+#include <vector>
+#include <simgear/structure/SGAtomic.hxx>
 #include <simgear/structure/SGReferenced.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
 
@@ -36,11 +38,87 @@ public:
   virtual ~SGCondition ();
   virtual bool test () const = 0;
   virtual void collectDependentProperties(std::set<const SGPropertyNode*>& props) const { }
+  /**
+   * Whether test() depends on nothing but the properties reported by
+   * collectDependentProperties(), so that its result can be cached.
+   */
+  virtual bool dependsOnPropertiesOnly () const { return false; }
 };
 
 typedef SGSharedPtr<SGCondition> SGConditionRef;
 
 
+/**
+ * A condition which caches the result of another one.
+ *
+ * The wrapped condition is only tested again after one of the
+ * properties it depends on has changed, which it learns from
+ * property listeners, so that conditions tested many times per frame
+ * (eg. by the cull traversal of every camera) cost next to nothing
+ * while their inputs do not change.  The wrapped condition has to
+ * report all of its properties through collectDependentProperties(),
+ * as the ones read by sgReadCondition() do; one which doesn't say so
+ * through dependsOnPropertiesOnly() is tested every time.
+ *
+ * The listeners are only added by listen(), which has to be called by
+ * the thread changing the properties, so that conditions can be
+ * created while loading models on another thread.  Until then the
+ * condition is tested every time, too.
+ *
+ * Tied and aliased properties do not notify listeners, so a
+ * condition depending on any, or on one which gets tied later, is
+ * tested every time again.
+ */
+class SGCachedCondition : public SGCondition
+{
+public:
+  SGCachedCondition (const SGCondition * condition);
+  virtual ~SGCachedCondition ();
+  virtual bool test () const;
+  virtual void collectDependentProperties(std::set<const SGPropertyNode*>& props) const;
+  virtual bool dependsOnPropertiesOnly () const;
+  const SGCondition * getCondition () const { return _condition; }
+  /**
+   * Start caching, by listening to the properties of the condition.
+   * Call from the thread changing the properties; test() may be called
+   * from any thread.
+   */
+  void listen ();
+  /**
+   * Remove the listeners of cached conditions deleted since the last
+   * call, which listen() also does.  Conditions are usually deleted by
+   * the thread dropping the scene graph holding them, so their listeners
+   * are left to the thread changing the properties.
+   */
+  static void removeRetiredListeners ();
+private:
+  SGCachedCondition (const SGCachedCondition&);
+  SGCachedCondition& operator= (const SGCachedCondition&);
+
+  class Listener;
+  SGSharedPtr<const SGCondition> _condition;
+  std::vector<const SGPropertyNode*> _properties;
+  Listener * _listener;
+  SGAtomic _listening;
+  mutable SGAtomic _volatile;
+  /// Changes counted by the listener when last tested, and the value
+  mutable SGAtomic _cache;
+};
+
+
+/**
+ * Counters of all cached conditions, for finding out how many
+ * evaluations caching saves.
+ */
+struct SGConditionCacheStats
+{
+  unsigned evaluations; ///< tests of cached conditions evaluating them
+  unsigned avoided;     ///< tests answered from the cache
+};
+
+SGConditionCacheStats sgGetConditionCacheStats ();
+
+
 /**
  * Base class for a conditional components.
  *
@@ -0,0 +1,212 @@
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include "props.hxx"
+#include "props_io.hxx"
+#include "condition.hxx"
+
+using std::cout;
+using std::endl;
+
+// A panel-like condition: a comparison on an expression, a string
+// comparison and a flag
+const char* conditionXml =
+  "<?xml version=\"1.0\"?>"
+  "<PropertyList>"
+    "<condition>"
+      "<greater-than>"
+        "<expression>"
+          "<sum>"
+            "<property>/a</property>"
+            "<product>"
+              "<property>/b</property>"
+              "<value>2</value>"
+            "</product>"
+          "</sum>"
+        "</expression>"
+        "<value>5</value>"
+      "</greater-than>"
+      "<or>"
+        "<property>/flag</property>"
+        "<equals>"
+          "<property>/mode</property>"
+          "<value>on</value>"
+        "</equals>"
+      "</or>"
+    "</condition>"
+  "</PropertyList>";
+
+SGCondition* readCondition(SGPropertyNode* root)
+{
+  SGPropertyNode_ptr desc = new SGPropertyNode;
+  readProperties(conditionXml, strlen(conditionXml), desc);
+  return sgReadCondition(root, desc->getChild("condition"));
+}
+
+void testCaching()
+{
+  SGPropertyNode_ptr root = new SGPropertyNode;
+  root->setDoubleValue("a", 1);
+  root->setDoubleValue("b", 1);
+  root->setBoolValue("flag", false);
+  root->setStringValue("mode", "off");
+
+  SGConditionRef plain = readCondition(root);
+  VERIFY(plain->dependsOnPropertiesOnly());
+  SGSharedPtr<SGCachedCondition> cached = new SGCachedCondition(plain);
+
+  std::set<const SGPropertyNode*> props;
+  cached->collectDependentProperties(props);
+  // the four properties and the copies of the two values compared to
+  COMPARE(props.size(), 6u);
+
+  // Nothing is cached before listening to the properties
+  SGConditionCacheStats before = sgGetConditionCacheStats();
+  VERIFY(!cached->test());
+  VERIFY(!cached->test());
+  SGConditionCacheStats stats = sgGetConditionCacheStats();
+  COMPARE(stats.evaluations - before.evaluations, 2u);
+  COMPARE(stats.avoided - before.avoided, 0u);
+
+  cached->listen();
+  before = sgGetConditionCacheStats();
+  VERIFY(!cached->test());
+  VERIFY(!cached->test());
+  stats = sgGetConditionCacheStats();
+  COMPARE(stats.evaluations - before.evaluations, 1u);
+  COMPARE(stats.avoided - before.avoided, 1u);
+
+  root->setDoubleValue("b", 3);
+  COMPARE(cached->test(), plain->test());
+  root->setStringValue("mode", "on");
+  VERIFY(cached->test());
+  root->setStringValue("mode", "off");
+  root->setBoolValue("flag", true);
+  VERIFY(cached->test());
+  root->setDoubleValue("a", -10);
+  VERIFY(!cached->test());
+
+  // Tied properties do not notify listeners, so they are read every time
+  double a = -10;
+  root->getNode("a")->tie(SGRawValuePointer<double>(&a), false);
+  VERIFY(!cached->test());
+  a = 10;
+  VERIFY(cached->test());
+  before = sgGetConditionCacheStats();
+  VERIFY(cached->test());
+  stats = sgGetConditionCacheStats();
+  COMPARE(stats.avoided - before.avoided, 0u);
+  root->getNode("a")->untie();
+}
+
+// Depends on something besides properties
+class CounterCondition : public SGCondition
+{
+public:
+  CounterCondition() : _count(0) {}
+  virtual bool test() const { return ++_count % 2; }
+private:
+  mutable int _count;
+};
+
+void testUncacheable()
+{
+  SGSharedPtr<SGCachedCondition> cached =
+    new SGCachedCondition(new CounterCondition);
+  VERIFY(!cached->dependsOnPropertiesOnly());
+  cached->listen();
+  VERIFY(cached->test());
+  VERIFY(!cached->test());
+  VERIFY(cached->test());
+}
+
+// The listeners of deleted conditions stay until the thread changing the
+// properties removes them
+void testRetiredListeners()
+{
+  SGPropertyNode_ptr root = new SGPropertyNode;
+  root->setDoubleValue("a", 1);
+  root->setDoubleValue("b", 1);
+  root->setBoolValue("flag", false);
+  root->setStringValue("mode", "off");
+
+  SGConditionRef plain = readCondition(root);
+  SGSharedPtr<SGCachedCondition> cached = new SGCachedCondition(plain);
+  cached->listen();
+  COMPARE(root->getNode("a")->nListeners(), 1);
+
+  cached = 0;
+  COMPARE(root->getNode("a")->nListeners(), 1);
+  root->setDoubleValue("a", 2);
+  SGCachedCondition::removeRetiredListeners();
+  COMPARE(root->getNode("a")->nListeners(), 0);
+
+  // ... or a condition listening later
+  cached = new SGCachedCondition(plain);
+  cached->listen();
+  cached = 0;
+  cached = new SGCachedCondition(plain);
+  cached->listen();
+  COMPARE(root->getNode("a")->nListeners(), 1);
+}
+
+// Cost of testing a condition several times per frame, with one of its
+// properties changing every frame
+void benchmark()
+{
+  SGPropertyNode_ptr root = new SGPropertyNode;
+  root->setDoubleValue("a", 1);
+  root->setDoubleValue("b", 1);
+  root->setBoolValue("flag", false);
+  root->setStringValue("mode", "off");
+
+  SGConditionRef plain = readCondition(root);
+  SGSharedPtr<SGCachedCondition> cached = new SGCachedCondition(plain);
+  cached->listen();
+
+  const int frames = 100000;
+  const int tests = 8;
+  SGCondition* conditions[] = { plain, cached };
+  double msec[2];
+  int results[2] = { 0, 0 };
+  for(int c = 0; c < 2; ++c)
+  {
+    SGTimeStamp start = SGTimeStamp::now();
+    for(int frame = 0; frame < frames; ++frame)
+    {
+      root->setDoubleValue("b", frame % 5);
+      for(int i = 0; i < tests; ++i)
+        results[c] += conditions[c]->test();
+    }
+    msec[c] = (SGTimeStamp::now() - start).toMSecs();
+  }
+  COMPARE(results[0], results[1]);
+
+  SGConditionCacheStats stats = sgGetConditionCacheStats();
+  cout << tests << " tests per frame: plain "
+       << msec[0] * 1e6 / (frames * tests) << " ns/test, cached "
+       << msec[1] * 1e6 / (frames * tests) << " ns/test, "
+       << stats.evaluations << " evaluated, "
+       << stats.avoided << " avoided" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  testCaching();
+  testUncacheable();
+  testRetiredListeners();
+  benchmark();
+
+  cout << __FILE__ << ": All tests passed" << endl;
+  return EXIT_SUCCESS;
+}
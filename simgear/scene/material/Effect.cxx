@@ -33,6 +33,7 @@
 #include <queue>
 #include <utility>
 #include <boost/tr1/unordered_map.hpp>
+#include <boost/tr1/unordered_set.hpp>
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -70,6 +71,7 @@
 #include <osgDB/ReadFile>
 #include <osgDB/Registry>
 
+#include <simgear/props/AtomicChangeListener.hxx>
 #include <simgear/scene/util/SGReaderWriterOptions.hxx>
 #include <simgear/scene/tgdb/userdata.hxx>
 #include <simgear/scene/util/OsgMath.hxx>
@@ -89,8 +91,68 @@ using namespace osgUtil;
 
 using namespace effect;
 
+// Sets a component of uniforms from a property.  All uniforms bound to
+// the same property share one listener, which applies the changes of a
+// frame at once, when AtomicChangeListener::fireChangeListeners() runs.
+class UniformPropertyListener : public AtomicChangeListener
+{
+public:
+    UniformPropertyListener(std::vector<SGPropertyNode*>& nodes)
+        : AtomicChangeListener(nodes), _node(nodes[0])
+    {
+    }
+    void addUniform(Uniform* uniform, int component)
+    {
+        _targets.push_back(Target(uniform, component));
+        apply(_targets.back());
+    }
+    virtual void valuesChanged()
+    {
+        if (!isValid())
+            return;
+        for (size_t i = 0; i < _targets.size(); ++i)
+            apply(_targets[i]);
+    }
+private:
+    typedef std::pair<ref_ptr<Uniform>, int> Target;
+
+    void apply(const Target& target)
+    {
+        Uniform* uniform = target.first.get();
+        switch (uniform->getType()) {
+        case Uniform::BOOL:
+            uniform->set(_node->getValue<bool>());
+            break;
+        case Uniform::FLOAT:
+            uniform->set(_node->getValue<float>());
+            break;
+        case Uniform::FLOAT_VEC3: {
+            Vec3 v;
+            uniform->get(v);
+            v[target.second] = _node->getValue<float>();
+            uniform->set(v);
+            break;
+        }
+        case Uniform::FLOAT_VEC4: {
+            Vec4 v;
+            uniform->get(v);
+            v[target.second] = _node->getValue<float>();
+            uniform->set(v);
+            break;
+        }
+        default:
+            uniform->set(_node->getValue<int>());
+            break;
+        }
+    }
+
+    SGPropertyNode* _node;
+    std::vector<Target> _targets;
+};
+
 class UniformFactoryImpl {
 public:
+    UniformFactoryImpl() : _hits(0), _numListeners(0), _numBindings(0) {}
     ref_ptr<Uniform> getUniform( Effect * effect, 
                                  const string & name, 
                                  Uniform::Type uniformType, 
@@ -98,19 +160,93 @@ public:
                                  const SGReaderWriterOptions* options );
     void updateListeners( SGPropertyNode* propRoot );
     void addListener(DeferredPropertyListener* listener);
+    void bindProperty(SGPropertyNode* node, Uniform* uniform, int component);
+    UniformCacheStats getStats();
 private:
     // Default names for vector property components
     static const char* vec3Names[];
     static const char* vec4Names[];
 
     SGMutex _mutex;
+    SGMutex _listenerMutex;
 
-    typedef boost::tuple<std::string, Uniform::Type, std::string, std::string> UniformCacheKey;
-    typedef boost::tuple<ref_ptr<Uniform>, SGPropertyChangeListener*> UniformCacheValue;
-    std::map<UniformCacheKey,ref_ptr<Uniform> > uniformCache;
+    // The strings of cache keys are interned, so that keys hash and
+    // compare by address
+    struct UniformCacheKey
+    {
+        const string* name;
+        Uniform::Type type;
+        const string* value;
+        const string* effect;
+        bool operator==(const UniformCacheKey& rhs) const
+        {
+            return name == rhs.name && type == rhs.type
+                && value == rhs.value && effect == rhs.effect;
+        }
+    };
+    struct UniformCacheKeyHash
+    {
+        size_t operator()(const UniformCacheKey& key) const
+        {
+            size_t seed = 0;
+            boost::hash_combine(seed, key.name);
+            boost::hash_combine(seed, static_cast<int>(key.type));
+            boost::hash_combine(seed, key.value);
+            boost::hash_combine(seed, key.effect);
+            return seed;
+        }
+    };
+    typedef tr1::unordered_map<UniformCacheKey, ref_ptr<Uniform>,
+                               UniformCacheKeyHash> UniformCache;
+    UniformCache uniformCache;
+    tr1::unordered_set<string> _strings;
+    unsigned _hits;
+
+    const string* intern(const string& str)
+    {
+        return &*_strings.insert(str).first;
+    }
+
+    bool bindProperties(Effect* effect, const SGPropertyNode* prop,
+                        Uniform* uniform,
+                        const SGReaderWriterOptions* options);
 
     typedef std::queue<DeferredPropertyListener*> DeferredListenerList;
     DeferredListenerList deferredListenerList;
+
+    // Guarded by _listenerMutex, like the deferred listeners
+    typedef tr1::unordered_map<SGPropertyNode*,
+                               SGSharedPtr<UniformPropertyListener>,
+                               boost::hash<SGPropertyNode*> >
+    PropertyListenerMap;
+    PropertyListenerMap _propertyListeners;
+    unsigned _numListeners;
+    unsigned _numBindings;
+};
+
+typedef Singleton<UniformFactoryImpl> UniformFactory;
+
+// Binds the components of a uniform to properties, once the update thread
+// gets to it
+class UniformBinding : public DeferredPropertyListener
+{
+public:
+    UniformBinding(Uniform* uniform, const std::vector<std::string>& propNames)
+        : _uniform(uniform), _propNames(propNames)
+    {
+    }
+    void activate(SGPropertyNode* propRoot)
+    {
+        for (size_t i = 0; i < _propNames.size(); ++i)
+            UniformFactory::instance()
+                ->bindProperty(makeNode(propRoot, _propNames[i]),
+                               _uniform.get(), i);
+        _uniform = 0;
+        _propNames.clear();
+    }
+private:
+    ref_ptr<Uniform> _uniform;
+    std::vector<std::string> _propNames;
 };
 
 const char* UniformFactoryImpl::vec3Names[] = {"x", "y", "z"};
@@ -145,19 +281,31 @@ ref_ptr<Uniform> UniformFactoryImpl::getUniform( Effect * effect,
 		}
 	}
 
-	UniformCacheKey key = boost::make_tuple(name, uniformType, val, effect->getName());
-	ref_ptr<Uniform> uniform = uniformCache[key];
+	UniformCacheKey key;
+	key.name = intern(name);
+	key.type = uniformType;
+	key.value = intern(val);
+	key.effect = intern(effect->getName());
+	ref_ptr<Uniform>& cached = uniformCache[key];
 
-    if (uniform.valid()) {
+    if (cached.valid()) {
     	// We've got a hit to cache - simply return it
-    	return uniform;
+    	++_hits;
+    	return cached;
     }
 
     SG_LOG(SG_GL,SG_DEBUG,"new uniform " << name << " value " << uniformCache.size());
-    uniformCache[key] = uniform = new Uniform;
+    ref_ptr<Uniform> uniform = cached = new Uniform;
 
     uniform->setName(name);
     uniform->setType(uniformType);
+
+    // Uniforms following properties get a shared listener per property
+    const SGPropertyNode* prop = getEffectPropertyNode(effect, valProp);
+    if (prop && prop->nChildren() > 0
+        && bindProperties(effect, prop, uniform.get(), options))
+        return uniform;
+
     switch (uniformType) {
     case Uniform::BOOL:
     	initFromParameters(effect, valProp, uniform.get(),
@@ -198,18 +346,82 @@ ref_ptr<Uniform> UniformFactoryImpl::getUniform( Effect * effect,
     return uniform;
 }
 
+bool UniformFactoryImpl::bindProperties(Effect* effect,
+                                        const SGPropertyNode* prop,
+                                        Uniform* uniform,
+                                        const SGReaderWriterOptions* options)
+{
+    std::vector<std::string> propNames;
+    switch (uniform->getType()) {
+    case Uniform::FLOAT_VEC3:
+        propNames = getVectorProperties(prop, options, 3, vec3Names);
+        break;
+    case Uniform::FLOAT_VEC4:
+        propNames = getVectorProperties(prop, options, 4, vec4Names);
+        break;
+    case Uniform::BOOL:
+    case Uniform::FLOAT:
+    case Uniform::INT:
+    case Uniform::SAMPLER_1D:
+    case Uniform::SAMPLER_2D:
+    case Uniform::SAMPLER_3D:
+    case Uniform::SAMPLER_1D_SHADOW:
+    case Uniform::SAMPLER_2D_SHADOW:
+    case Uniform::SAMPLER_CUBE:
+        propNames.push_back(getGlobalProperty(prop, options));
+        break;
+    default:
+        return false;
+    }
+    if (propNames.empty())
+        throw BuilderException();
+    uniform->setDataVariance(Object::DYNAMIC);
+    effect->addDeferredPropertyListener(new UniformBinding(uniform, propNames));
+    return true;
+}
+
+void UniformFactoryImpl::bindProperty(SGPropertyNode* node, Uniform* uniform,
+                                      int component)
+{
+    // Called from updateListeners(), with _listenerMutex held
+    SGSharedPtr<UniformPropertyListener>& listener = _propertyListeners[node];
+    if (!listener.valid() || !listener->isValid()) {
+        // A property which went away may have left a listener behind
+        std::vector<SGPropertyNode*> nodes(1, node);
+        listener = new UniformPropertyListener(nodes);
+        ++_numListeners;
+    }
+    listener->addUniform(uniform, component);
+    ++_numBindings;
+}
+
+UniformCacheStats UniformFactoryImpl::getStats()
+{
+    UniformCacheStats stats;
+    {
+        SGGuard<SGMutex> scopeLock(_mutex);
+        stats.uniforms = uniformCache.size();
+        stats.hits = _hits;
+    }
+    SGGuard<SGMutex> scopeLock(_listenerMutex);
+    stats.listeners = _numListeners;
+    stats.bindings = _numBindings;
+    return stats;
+}
+
 void UniformFactoryImpl::addListener(DeferredPropertyListener* listener)
 {
     if (listener != 0) {
     	// Uniform requires a property listener. Add it to the list to be
     	// created when the main thread gets to it.
+    	SGGuard<SGMutex> scopeLock(_listenerMutex);
     	deferredListenerList.push(listener);
     }
 }
 
 void UniformFactoryImpl::updateListeners( SGPropertyNode* propRoot )
 {
-	SGGuard<SGMutex> scopeLock(_mutex);
+	SGGuard<SGMutex> scopeLock(_listenerMutex);
 
 	if (deferredListenerList.empty()) return;
 
@@ -223,7 +435,10 @@ void UniformFactoryImpl::updateListeners( SGPropertyNode* propRoot )
 	}
 }
 
-typedef Singleton<UniformFactoryImpl> UniformFactory;
+UniformCacheStats getUniformCacheStats()
+{
+    return UniformFactory::instance()->getStats();
+}
 
 
 Effect::Effect()
@@ -830,7 +1045,7 @@ size_t hash_value(const ProgramKey& key)
     return seed;
 }
 
-// XXX Should these be protected by a mutex? Probably
+// Shared between threads building effects, guarded by programMutex
 
 typedef tr1::unordered_map<ProgramKey, ref_ptr<Program>,
                            boost::hash<ProgramKey>, ProgramKey::EqualTo>
@@ -841,9 +1056,11 @@ ProgramMap resolvedProgramMap;  // map with resolved shader file names
 typedef tr1::unordered_map<ShaderKey, ref_ptr<Shader>, boost::hash<ShaderKey> >
 ShaderMap;
 ShaderMap shaderMap;
+SGMutex programMutex;
 
 void reload_shaders()
 {
+    SGGuard<SGMutex> lock(programMutex);
     for(ShaderMap::iterator sitr = shaderMap.begin(); sitr != shaderMap.end(); ++sitr)
     {
         Shader *shader = sitr->second.get();
@@ -918,6 +1135,7 @@ void ShaderProgramBuilder::buildAttribute(Effect* effect, Pass* pass,
     }
     if (options)
         prgKey.paths = options->getDatabasePathList();
+    SGGuard<SGMutex> lock(programMutex);
     Program* program = 0;
     ProgramMap::iterator pitr = programMap.find(prgKey);
     if (pitr != programMap.end()) {
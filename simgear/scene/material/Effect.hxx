@@ -159,6 +159,35 @@ bool makeParametersFromStateSet(SGPropertyNode* paramRoot,
 
 void clearEffectCache();
 
+/**
+ * Counters of the cache of effects loaded by name, for finding out how
+ * much threads loading effects wait for each other.
+ */
+struct EffectCacheStats
+{
+    unsigned lookups;   ///< effects requested by name
+    unsigned hits;      ///< ... which were already in the cache
+    unsigned loads;     ///< effects read from their file and built
+    unsigned races;     ///< effects built by two threads at once
+    unsigned contended; ///< cache locks which had to wait for another thread
+};
+
+EffectCacheStats getEffectCacheStats();
+
+/**
+ * Counters of the uniforms shared between effects and of the property
+ * listeners keeping them up to date.
+ */
+struct UniformCacheStats
+{
+    unsigned uniforms;  ///< distinct uniforms
+    unsigned hits;      ///< requests for a uniform which already existed
+    unsigned listeners; ///< property listeners, one per bound property
+    unsigned bindings;  ///< uniform components bound to properties
+};
+
+UniformCacheStats getUniformCacheStats();
+
 namespace effect
 {
 /**
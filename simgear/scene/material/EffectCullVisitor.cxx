@@ -18,8 +18,14 @@
 #  include <simgear_config.h>
 #endif
 
+#include <algorithm>
+#include <typeinfo>
+
 #include <osg/StateSet>
 #include <osg/Texture2D>
+#include <osgUtil/PositionalStateContainer>
+#include <osgUtil/RenderStage>
+#include <osgUtil/StateGraph>
 
 #include "EffectCullVisitor.hxx"
 
@@ -28,19 +34,241 @@
 #include "Technique.hxx"
 
 #include <simgear/scene/util/RenderConstants.hxx>
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/threads/SGQueue.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 namespace simgear
 {
 
 using osgUtil::CullVisitor;
+using osgUtil::RenderBin;
+using osgUtil::RenderStage;
+using osgUtil::StateGraph;
+
+namespace
+{
+// A group is only split if each thread gets at least this many children
+const unsigned minChildrenPerThread = 4;
+
+class CullTask : public osg::Referenced
+{
+public:
+    virtual void cull() = 0;
+};
+
+// Counts down the tasks of a split group handed to the helper threads
+class CullBatch
+{
+public:
+    CullBatch(unsigned tasks) :
+        _pending(tasks)
+    {}
+    void done()
+    {
+        SGGuard<SGMutex> lock(_mutex);
+        if (--_pending == 0)
+            _finished.signal();
+    }
+    void wait()
+    {
+        SGGuard<SGMutex> lock(_mutex);
+        while (_pending > 0)
+            _finished.wait(_mutex);
+    }
+private:
+    SGMutex _mutex;
+    SGWaitCondition _finished;
+    unsigned _pending;
+};
+
+struct CullJob
+{
+    CullJob(CullTask* task_ = 0, CullBatch* batch_ = 0) :
+        task(task_), batch(batch_)
+    {}
+    CullTask* task;
+    CullBatch* batch;
+};
+
+class CullThread : public SGThread
+{
+public:
+    CullThread(SGBlockingQueue<CullJob>& jobs) :
+        _jobs(jobs)
+    {}
+    virtual ~CullThread() {}
+    virtual void run()
+    {
+        for (;;) {
+            CullJob job = _jobs.pop();
+            // This means stop working
+            if (!job.task)
+                return;
+            job.task->cull();
+            job.batch->done();
+        }
+    }
+private:
+    SGBlockingQueue<CullJob>& _jobs;
+};
+
+// Helper threads shared by all visitors, started as they are needed
+class CullThreadPool
+{
+public:
+    ~CullThreadPool()
+    {
+        for (size_t i = 0; i < _threads.size(); ++i)
+            _jobs.push(CullJob());
+        for (size_t i = 0; i < _threads.size(); ++i) {
+            _threads[i]->join();
+            delete _threads[i];
+        }
+    }
+    void run(CullTask* task, CullBatch* batch, unsigned threads)
+    {
+        {
+            SGGuard<SGMutex> lock(_mutex);
+            while (_threads.size() < threads) {
+                CullThread* thread = new CullThread(_jobs);
+                if (!thread->start()) {
+                    delete thread;
+                    break;
+                }
+                _threads.push_back(thread);
+            }
+            if (_threads.empty()) {
+                task->cull();
+                batch->done();
+                return;
+            }
+        }
+        _jobs.push(CullJob(task, batch));
+    }
+private:
+    SGMutex _mutex;
+    std::vector<CullThread*> _threads;
+    SGBlockingQueue<CullJob> _jobs;
+};
+
+CullThreadPool& cullThreadPool()
+{
+    static CullThreadPool pool;
+    return pool;
+}
+
+// Moves the state graphs culled into a render bin and its sub bins to
+// another bin, numbering their leaves after those already in it
+void mergeRenderBin(RenderBin* from, RenderBin* to, unsigned traversalOffset)
+{
+    RenderBin::StateGraphList& graphs = from->getStateGraphList();
+    for (RenderBin::StateGraphList::iterator itr = graphs.begin(),
+             end = graphs.end();
+         itr != end;
+         ++itr) {
+        StateGraph::LeafList& leaves = (*itr)->_leaves;
+        for (StateGraph::LeafList::iterator leaf = leaves.begin(),
+                 e = leaves.end();
+             leaf != e;
+             ++leaf)
+            (*leaf)->_traversalOrderNumber += traversalOffset;
+        to->addStateGraph(*itr);
+    }
+    RenderBin::RenderBinList& bins = from->getRenderBinList();
+    for (RenderBin::RenderBinList::iterator itr = bins.begin(),
+             end = bins.end();
+         itr != end;
+         ++itr) {
+        RenderBin* bin = to->find_or_insert(itr->first, "RenderBin");
+        bin->setSortMode(itr->second->getSortMode());
+        mergeRenderBin(itr->second.get(), bin, traversalOffset);
+    }
+}
+}
+
+// Culls a range of children of a split group with a visitor of its own,
+// into its own state graph and render stage, starting from the state of
+// the splitting visitor at the group.
+class EffectCullVisitor::CullWorker : public CullTask
+{
+public:
+    CullWorker(EffectCullVisitor* visitor_) :
+        visitor(visitor_),
+        stateGraph(new StateGraph),
+        stage(new RenderStage),
+        group(0),
+        begin(0),
+        end(0),
+        msec(0)
+    {}
+    virtual void cull();
+
+    osg::ref_ptr<EffectCullVisitor> visitor;
+    osg::ref_ptr<StateGraph> stateGraph;
+    osg::ref_ptr<RenderStage> stage;
+    osg::Group* group;
+    unsigned begin;
+    unsigned end;
+    osg::NodePath nodePath;
+    std::vector<const osg::StateSet*> stateSets;
+    osg::ref_ptr<osg::Viewport> viewport;
+    osg::ref_ptr<osg::RefMatrix> projection;
+    osg::ref_ptr<osg::RefMatrix> modelView;
+    double msec;
+};
+
+void EffectCullVisitor::CullWorker::cull()
+{
+    SGTimeStamp start = SGTimeStamp::now();
+    stateGraph->clean();
+    stage->reset();
+    visitor->reset();
+    visitor->setStateGraph(stateGraph.get());
+    visitor->setRenderStage(stage.get());
+    for (size_t i = 0; i < nodePath.size(); ++i)
+        visitor->pushOntoNodePath(nodePath[i]);
+    visitor->pushViewport(viewport.get());
+    visitor->pushProjectionMatrix(projection.get());
+    visitor->pushModelViewMatrix(modelView.get(),
+                                 osg::Transform::ABSOLUTE_RF);
+    for (size_t i = 0; i < stateSets.size(); ++i)
+        visitor->pushStateSet(stateSets[i]);
+    for (unsigned i = begin; i < end; ++i)
+        group->getChild(i)->accept(*visitor);
+    for (size_t i = 0; i < stateSets.size(); ++i)
+        visitor->popStateSet();
+    // The projection is the camera's, which its own visitor clamps to the
+    // near and far planes computed by all threads.
+    visitor->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    visitor->popModelViewMatrix();
+    visitor->popProjectionMatrix();
+    visitor->popViewport();
+    for (size_t i = 0; i < nodePath.size(); ++i)
+        visitor->popFromNodePath();
+    stateGraph->prune();
+    msec = (SGTimeStamp::now() - start).toMSecs();
+}
 
 EffectCullVisitor::EffectCullVisitor(bool collectLights) :
-    _collectLights(collectLights)
+    _collectLights(collectLights),
+    _cullThreads(0),
+    _usedCullWorkers(0),
+    _splitting(false)
 {
 }
 
 EffectCullVisitor::EffectCullVisitor(const EffectCullVisitor& rhs) :
-    CullVisitor(rhs)
+    CullVisitor(rhs),
+    _collectLights(rhs._collectLights),
+    _cullThreads(rhs._cullThreads),
+    _usedCullWorkers(0),
+    _splitting(false)
+{
+}
+
+EffectCullVisitor::~EffectCullVisitor()
 {
 }
 
@@ -49,6 +277,30 @@ CullVisitor* EffectCullVisitor::clone() const
     return new EffectCullVisitor(*this);
 }
 
+void EffectCullVisitor::apply(osg::Group& node)
+{
+    // Subclasses without an apply() of their own, like osg::Sequence or
+    // ConditionNode, choose the children to cull in traverse().
+    if (_cullThreads < 2 || _splitting || typeid(node) != typeid(osg::Group)
+        || node.getCullCallback()
+        || node.getNumChildren() < 2 * minChildrenPerThread) {
+        CullVisitor::apply(node);
+        return;
+    }
+    if (isCulled(node))
+        return;
+    pushCurrentMask();
+    // push the node's state.
+    osg::StateSet* node_state = node.getStateSet();
+    if (node_state)
+        pushStateSet(node_state);
+    cullChildren(node);
+    // pop the node's state off the geostate stack.
+    if (node_state)
+        popStateSet();
+    popCurrentMask();
+}
+
 void EffectCullVisitor::apply(osg::Geode& node)
 {
     if (isCulled(node))
@@ -85,9 +337,136 @@ void EffectCullVisitor::apply(osg::Geode& node)
 
 }
 
+void EffectCullVisitor::cullChildren(osg::Group& node)
+{
+    unsigned numChildren = node.getNumChildren();
+    unsigned threads = std::min(_cullThreads,
+                                numChildren / minChildrenPerThread);
+    // The workers add their state graphs to the render bin of the group,
+    // and near and far planes computed from primitives can't be merged.
+    ComputeNearFarMode nearFarMode = getComputeNearFarMode();
+    bool split = threads > 1
+        && _currentRenderBin == _currentRenderBin->getStage()
+        && (nearFarMode == DO_NOT_COMPUTE_NEAR_FAR
+            || nearFarMode == COMPUTE_NEAR_FAR_USING_BOUNDING_VOLUMES);
+    std::vector<const osg::StateSet*> stateSets;
+    for (StateGraph* sg = _currentStateGraph; split && sg->_parent;
+         sg = sg->_parent) {
+        if (!sg->_stateset || sg->_stateset->useRenderBinDetails())
+            split = false;
+        stateSets.push_back(sg->_stateset);
+    }
+    if (!split) {
+        traverse(node);
+        return;
+    }
+    std::reverse(stateSets.begin(), stateSets.end());
+
+    // Bounds are computed lazily by the first visitor asking for them, and
+    // nodes may be shared between the children culled by different
+    // threads.  The bound of a group is computed from those of its
+    // children, down to the drawables, so computing it here does it for
+    // the whole subgraph on this thread, and the workers only read them.
+    // Only nodes a parent leaves out of its bound (below absolute
+    // reference frame transforms, or LODs with a user defined center)
+    // are still computed during the cull, by the thread reaching them.
+    node.getBound();
+
+    // Workers stay in use until the next traversal, as the render bins
+    // refer to their leaves.
+    unsigned first = _usedCullWorkers;
+    _usedCullWorkers += threads - 1;
+    while (_cullWorkers.size() < _usedCullWorkers)
+        _cullWorkers.push_back(
+            new CullWorker(new EffectCullVisitor(_collectLights)));
+    CullBatch batch(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        CullWorker& worker = *_cullWorkers[first + t - 1];
+        EffectCullVisitor& cv = *worker.visitor;
+        cv.setCullSettings(*this);
+        cv.setTraversalMask(getTraversalMask());
+        cv.setNodeMaskOverride(getNodeMaskOverride());
+        cv.setTraversalNumber(getTraversalNumber());
+        cv.setFrameStamp(const_cast<osg::FrameStamp*>(getFrameStamp()));
+        cv.setDatabaseRequestHandler(getDatabaseRequestHandler());
+        cv.setImageRequestHandler(getImageRequestHandler());
+        cv.setRenderInfo(getRenderInfo());
+        cv._bufferList = _bufferList;
+        worker.group = &node;
+        worker.begin = t * numChildren / threads;
+        worker.end = (t + 1) * numChildren / threads;
+        worker.nodePath = getNodePath();
+        worker.stateSets = stateSets;
+        worker.viewport = getViewport();
+        worker.projection = getProjectionMatrix();
+        worker.modelView = getModelViewMatrix();
+        cullThreadPool().run(&worker, &batch, threads - 1);
+    }
+
+    // Groups below are not split again
+    SGTimeStamp start = SGTimeStamp::now();
+    _splitting = true;
+    for (unsigned i = 0, end = numChildren / threads; i < end; ++i)
+        node.getChild(i)->accept(*this);
+    _splitting = false;
+    if (_cullThreadTimes.size() < threads)
+        _cullThreadTimes.resize(threads, 0.0);
+    _cullThreadTimes[0] += (SGTimeStamp::now() - start).toMSecs();
+
+    batch.wait();
+    for (unsigned t = 1; t < threads; ++t) {
+        CullWorker& worker = *_cullWorkers[first + t - 1];
+        mergeCullWorker(worker);
+        _cullThreadTimes[t] += worker.msec;
+    }
+}
+
+void EffectCullVisitor::mergeCullWorker(CullWorker& worker)
+{
+    EffectCullVisitor* cv = worker.visitor.get();
+    mergeRenderBin(worker.stage.get(), _currentRenderBin,
+                   _traversalOrderNumber);
+    _traversalOrderNumber += cv->_traversalOrderNumber;
+
+    RenderStage* stage = _currentRenderBin->getStage();
+    RenderStage::RenderStageList& preStages = worker.stage->getPreRenderList();
+    for (RenderStage::RenderStageList::iterator itr = preStages.begin(),
+             end = preStages.end();
+         itr != end;
+         ++itr)
+        stage->addPreRenderStage(itr->second.get(), itr->first);
+    RenderStage::RenderStageList& postStages
+        = worker.stage->getPostRenderList();
+    for (RenderStage::RenderStageList::iterator itr = postStages.begin(),
+             end = postStages.end();
+         itr != end;
+         ++itr)
+        stage->addPostRenderStage(itr->second.get(), itr->first);
+    if (osgUtil::PositionalStateContainer* positional
+        = worker.stage->getPositionalStateContainer()) {
+        osgUtil::PositionalStateContainer::AttrMatrixList& attrs
+            = positional->getAttrMatrixList();
+        for (osgUtil::PositionalStateContainer::AttrMatrixList::iterator
+                 itr = attrs.begin(), end = attrs.end();
+             itr != end;
+             ++itr)
+            stage->addPositionedAttribute(itr->second.get(),
+                                          itr->first.get());
+    }
+
+    if (cv->_computed_znear < _computed_znear)
+        _computed_znear = cv->_computed_znear;
+    if (cv->_computed_zfar > _computed_zfar)
+        _computed_zfar = cv->_computed_zfar;
+    _lightList.insert(_lightList.end(),
+                      cv->_lightList.begin(), cv->_lightList.end());
+}
+
 void EffectCullVisitor::reset()
 {
     _lightList.clear();
+    _usedCullWorkers = 0;
+    _cullThreadTimes.clear();
 
     osgUtil::CullVisitor::reset();
 }
@@ -107,4 +486,9 @@ osg::Texture2D* EffectCullVisitor::getBuffer(std::string b)
     return _bufferList[b];
 }
 
+void EffectCullVisitor::setCullThreads(unsigned threads)
+{
+    _cullThreads = threads;
+}
+
 }
@@ -20,6 +20,7 @@
 #include <osgUtil/CullVisitor>
 
 #include <map>
+#include <vector>
 
 namespace osg
 {
@@ -35,8 +36,10 @@ class EffectCullVisitor : public osgUtil::CullVisitor
 public:
     EffectCullVisitor(bool collectLights = false);
     EffectCullVisitor(const EffectCullVisitor&);
+    virtual ~EffectCullVisitor();
     virtual osgUtil::CullVisitor* clone() const;
     using osgUtil::CullVisitor::apply;
+    virtual void apply(osg::Group& node);
     virtual void apply(osg::Geode& node);
     virtual void reset();
 
@@ -44,10 +47,47 @@ public:
     void addBuffer(std::string b, osg::Texture2D* tex);
     osg::Texture2D* getBuffer(std::string b);
 
+    /**
+     * Cull the children of large groups, such as the groups of scenery
+     * tiles, on several threads.  Each thread culls a range of children
+     * into its own render leaves, which are merged into the render bins of
+     * this visitor afterwards, in the order of the children.  Only the
+     * topmost groups with enough children are split, and not those with
+     * cull callbacks, so cull callbacks below them must be safe to run
+     * concurrently, as with the threading models of osgViewer culling
+     * several cameras at once.
+     *
+     * @param threads Number of threads culling a group, including the
+     *                thread running this visitor; 0 or 1 culls everything
+     *                on that thread, which is the default.
+     */
+    void setCullThreads(unsigned threads);
+    unsigned getCullThreads() const { return _cullThreads; }
+
+    /**
+     * Time in ms each thread spent culling the children of split groups
+     * during the last traversal.  The first entry is for the thread
+     * running this visitor.
+     */
+    const std::vector<double>& getCullThreadTimes() const
+    {
+        return _cullThreadTimes;
+    }
+
 private:
+    class CullWorker;
+
+    void cullChildren(osg::Group& node);
+    void mergeCullWorker(CullWorker& worker);
+
     std::map<std::string,osg::ref_ptr<osg::Texture2D> > _bufferList;
     std::vector<osg::ref_ptr<EffectGeode> > _lightList;
     bool _collectLights;
+    unsigned _cullThreads;
+    std::vector<osg::ref_ptr<CullWorker> > _cullWorkers;
+    unsigned _usedCullWorkers;
+    bool _splitting;
+    std::vector<double> _cullThreadTimes;
 };
 }
 #endif
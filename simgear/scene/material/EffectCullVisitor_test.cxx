@@ -0,0 +1,219 @@
+#include <simgear/compiler.h>
+
+#include "EffectCullVisitor.hxx"
+
+#include <simgear/timing/timestamp.hxx>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/StateSet>
+#include <osg/Switch>
+#include <osg/Viewport>
+#include <osgUtil/RenderLeaf>
+#include <osgUtil/RenderStage>
+#include <osgUtil/StateGraph>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace simgear;
+
+#define VERIFY(a) \
+  if( !(a) ) \
+  { \
+    std::cerr << "failed: line " << __LINE__ << ": " << #a << std::endl; \
+    return 1; \
+  }
+
+// A 16x16 km area of scenery, a tile per km
+const int tilesPerSide = 16;
+const int geodesPerTile = 32;
+const float tileSize = 1000;
+const int numViews = 32;
+const unsigned numThreads = 4;
+
+osg::Geode* makeGeode(const osg::Vec3& pos)
+{
+  osg::Vec3Array* vertices = new osg::Vec3Array;
+  vertices->push_back(pos);
+  vertices->push_back(pos + osg::Vec3(10, 0, 0));
+  vertices->push_back(pos + osg::Vec3(0, 0, 10));
+  osg::Geometry* geom = new osg::Geometry;
+  geom->setVertexArray(vertices);
+  geom->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 3));
+  osg::Geode* geode = new osg::Geode;
+  geode->addDrawable(geom);
+  return geode;
+}
+
+// Tiles share a few state sets, and some of their objects are drawn in
+// depth sorted and traversal order bins
+osg::Node* makeScene()
+{
+  std::vector<osg::ref_ptr<osg::StateSet> > tileStates;
+  for (int i = 0; i < 4; ++i)
+    tileStates.push_back(new osg::StateSet);
+  osg::ref_ptr<osg::StateSet> transparent = new osg::StateSet;
+  transparent->setRenderBinDetails(10, "DepthSortedBin");
+  osg::ref_ptr<osg::StateSet> ordered = new osg::StateSet;
+  ordered->setRenderBinDetails(5, "TraversalOrderBin");
+
+  // Shared by all tiles, so that threads culling different tiles reach it
+  osg::ref_ptr<osg::Geode> shared = makeGeode(osg::Vec3(0, 0, 0));
+
+  osg::Group* terrain = new osg::Group;
+  for (int i = 0; i < tilesPerSide * tilesPerSide; ++i) {
+    osg::Group* tile = new osg::Group;
+    tile->setStateSet(tileStates[i % tileStates.size()].get());
+    osg::Vec3 corner((i % tilesPerSide - tilesPerSide / 2) * tileSize,
+                     (i / tilesPerSide - tilesPerSide / 2) * tileSize,
+                     0);
+    for (int j = 0; j < geodesPerTile; ++j) {
+      osg::Vec3 offset((j % 8) * tileSize / 8, (j / 8) * tileSize / 4, 0);
+      osg::Geode* geode = makeGeode(corner + offset);
+      if (j % 8 == 3)
+        geode->setStateSet(transparent.get());
+      else if (j % 8 == 5)
+        geode->setStateSet(ordered.get());
+      tile->addChild(geode);
+    }
+    tile->addChild(shared.get());
+    terrain->addChild(tile);
+  }
+  osg::Group* root = new osg::Group;
+  root->setStateSet(new osg::StateSet);
+  root->addChild(terrain);
+  return root;
+}
+
+struct CullResult
+{
+  std::map<int, unsigned> leavesPerBin;
+  std::vector<std::pair<unsigned, const osg::Drawable*> > leaves;
+  double znear;
+  double zfar;
+};
+
+void collectLeaves(osgUtil::RenderBin* bin, CullResult& result)
+{
+  osgUtil::RenderBin::StateGraphList& graphs = bin->getStateGraphList();
+  for (size_t i = 0; i < graphs.size(); ++i) {
+    osgUtil::StateGraph::LeafList& leaves = graphs[i]->_leaves;
+    for (size_t j = 0; j < leaves.size(); ++j) {
+      result.leaves.push_back(std::make_pair(leaves[j]->_traversalOrderNumber,
+                                             leaves[j]->getDrawable()));
+      ++result.leavesPerBin[bin->getBinNum()];
+    }
+  }
+  osgUtil::RenderBin::RenderBinList& bins = bin->getRenderBinList();
+  for (osgUtil::RenderBin::RenderBinList::iterator itr = bins.begin();
+       itr != bins.end();
+       ++itr)
+    collectLeaves(itr->second.get(), result);
+}
+
+// Culls the scene like osgUtil::SceneView does, from one of a number of
+// points looking around, returning the time taken
+double cullScene(osg::Node* scene, EffectCullVisitor* cv, int view,
+                 CullResult* result = 0)
+{
+  osg::ref_ptr<osgUtil::StateGraph> graph = new osgUtil::StateGraph;
+  osg::ref_ptr<osgUtil::RenderStage> stage = new osgUtil::RenderStage;
+  osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0, 0, 1280, 1024);
+  osg::ref_ptr<osg::RefMatrix> projection =
+    new osg::RefMatrix(osg::Matrix::perspective(60, 1.25, 1, 50000));
+  float heading = view * 2 * osg::PI / numViews;
+  float offset = (view % 4 - 1.5) * tileSize;
+  osg::Vec3 eye(offset, -offset, 20);
+  osg::Vec3 dir(std::cos(heading), std::sin(heading), -0.05);
+  osg::ref_ptr<osg::RefMatrix> modelview =
+    new osg::RefMatrix(osg::Matrix::lookAt(eye, eye + dir, osg::Vec3(0, 0, 1)));
+  osg::ref_ptr<osg::StateSet> global = new osg::StateSet;
+
+  SGTimeStamp start = SGTimeStamp::now();
+  cv->reset();
+  stage->setViewport(viewport.get());
+  cv->setStateGraph(graph.get());
+  cv->setRenderStage(stage.get());
+  cv->pushStateSet(global.get());
+  cv->pushViewport(viewport.get());
+  cv->pushProjectionMatrix(projection.get());
+  cv->pushModelViewMatrix(modelview.get(), osg::Transform::ABSOLUTE_RF);
+  scene->accept(*cv);
+  cv->popModelViewMatrix();
+  cv->popProjectionMatrix();
+  cv->popViewport();
+  cv->popStateSet();
+  double msec = (SGTimeStamp::now() - start).toMSecs();
+
+  if (result) {
+    collectLeaves(stage.get(), *result);
+    std::sort(result->leaves.begin(), result->leaves.end());
+    result->znear = cv->getCalculatedNearPlane();
+    result->zfar = cv->getCalculatedFarPlane();
+  }
+  return msec;
+}
+
+bool sameDrawables(const CullResult& a, const CullResult& b)
+{
+  if (a.leaves.size() != b.leaves.size())
+    return false;
+  for (size_t i = 0; i < a.leaves.size(); ++i)
+    if (a.leaves[i].second != b.leaves[i].second)
+      return false;
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  osg::ref_ptr<osg::Node> scene = makeScene();
+  osg::ref_ptr<EffectCullVisitor> serial = new EffectCullVisitor;
+  osg::ref_ptr<EffectCullVisitor> parallel = new EffectCullVisitor;
+  parallel->setCullThreads(numThreads);
+  VERIFY( parallel->getCullThreads() == numThreads );
+
+  // Both cull the same leaves, in the same bins and traversal order, and
+  // compute the same near and far planes.  The parallel cull goes first,
+  // while none of the bounds of the scene have been computed yet.
+  for (int view = 0; view < numViews; ++view) {
+    CullResult a, b;
+    cullScene(scene.get(), parallel.get(), view, &b);
+    cullScene(scene.get(), serial.get(), view, &a);
+    VERIFY( !a.leaves.empty() );
+    VERIFY( a.leavesPerBin == b.leavesPerBin );
+    VERIFY( sameDrawables(a, b) );
+    VERIFY( a.znear == b.znear && a.zfar == b.zfar );
+    VERIFY( serial->getCullThreadTimes().empty() );
+    VERIFY( parallel->getCullThreadTimes().size() == numThreads );
+  }
+
+  // Subclasses of groups, like switches, choose the children to cull
+  // themselves, so they are not split
+  osg::ref_ptr<osg::Switch> lights = new osg::Switch;
+  for (unsigned i = 0; i < 4 * numThreads * 4; ++i)
+    lights->addChild(makeGeode(osg::Vec3(i * 20, 1000, 0)), i == 0);
+  CullResult lit;
+  cullScene(lights.get(), parallel.get(), 0, &lit);
+  VERIFY( lit.leaves.size() == 1 );
+
+  double msec[2] = { 0, 0 };
+  std::vector<double> threadMsec(numThreads, 0.0);
+  for (int view = 0; view < numViews; ++view) {
+    msec[0] += cullScene(scene.get(), serial.get(), view);
+    msec[1] += cullScene(scene.get(), parallel.get(), view);
+    const std::vector<double>& times = parallel->getCullThreadTimes();
+    for (size_t t = 0; t < times.size(); ++t)
+      threadMsec[t] += times[t];
+  }
+  std::cout << "serial: " << msec[0] / numViews << " msec/cull, "
+            << numThreads << " threads: " << msec[1] / numViews
+            << " msec/cull (";
+  for (unsigned t = 0; t < numThreads; ++t)
+    std::cout << (t ? " " : "") << threadMsec[t] / numViews;
+  std::cout << " msec per thread)" << std::endl;
+  return 0;
+}
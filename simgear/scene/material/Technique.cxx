@@ -13,6 +13,9 @@
 #include <vector>
 #include <string>
 
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
 #include <osg/GLExtensions>
 #include <osg/GL2Extensions>
 #include <osg/Math>
@@ -48,6 +51,8 @@ struct ValidateOperation : GraphicsOperation
 
 const std::string ValidateOperation::opName("ValidateOperation");
 
+// Guards growing the context maps of all techniques
+OpenThreads::Mutex contextMapMutex;
 
 void ValidateOperation::operator() (GraphicsContext* gc)
 {
@@ -83,7 +88,7 @@ Technique::Status Technique::valid(osg::RenderInfo* renderInfo)
     if (_alwaysValid)
         return VALID;
     unsigned contextID = renderInfo->getContextID();
-    ContextInfo& contextInfo = _contextMap[contextID];
+    ContextInfo& contextInfo = getContextInfo(contextID);
     Status status = contextInfo.valid();
     if (status != UNKNOWN)
         return status;
@@ -103,18 +108,35 @@ Technique::Status Technique::valid(osg::RenderInfo* renderInfo)
     return newStatus;
 }
 
+// buffered_object grows when an entry past its end is accessed.  The
+// viewer sizes the maps for all contexts with resizeGLObjectBuffers()
+// before culling, so this only grows for a context the technique hasn't
+// been sized for.  The threads culling one camera in parallel (see
+// EffectCullVisitor) all use the same context ID, so once one of them has
+// grown the map under the lock the others only read it, and no reference
+// to an entry is invalidated while they update its status.
+Technique::ContextInfo& Technique::getContextInfo(unsigned contextID) const
+{
+    if (contextID >= _contextMap.size()) {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(contextMapMutex);
+        if (contextID >= _contextMap.size())
+            _contextMap.resize(contextID + 1);
+    }
+    return _contextMap[contextID];
+}
+
 Technique::Status Technique::getValidStatus(const RenderInfo* renderInfo) const
 {
     if (_alwaysValid)
         return VALID;
-    ContextInfo& contextInfo = _contextMap[renderInfo->getContextID()];
+    ContextInfo& contextInfo = getContextInfo(renderInfo->getContextID());
     return contextInfo.valid();
 }
 
 void Technique::validateInContext(GraphicsContext* gc)
 {
     unsigned int contextId = gc->getState()->getContextID();
-    ContextInfo& contextInfo = _contextMap[contextId];
+    ContextInfo& contextInfo = getContextInfo(contextId);
     Status oldVal = contextInfo.valid();
     Status newVal = INVALID;
     expression::FixedLengthBinding<1> binding;
@@ -241,7 +263,7 @@ void Technique::releaseGLObjects(osg::State* state) const
             info.valid.compareAndSwap(oldVal, UNKNOWN);
         }
     } else {
-        ContextInfo& info = _contextMap[state->getContextID()];
+        ContextInfo& info = getContextInfo(state->getContextID());
         Status oldVal = info.valid();
         info.valid.compareAndSwap(oldVal, UNKNOWN);
     }
@@ -112,6 +112,8 @@ protected:
         Swappable<Status> valid;
     };
     typedef osg::buffered_object<ContextInfo> ContextMap;
+    // Entry of a context, growing the map under a lock if needed.
+    ContextInfo& getContextInfo(unsigned contextID) const;
     mutable ContextMap _contextMap;
     bool _alwaysValid;
     osg::ref_ptr<osg::StateSet> _shadowingStateSet;
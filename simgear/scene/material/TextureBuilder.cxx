@@ -42,6 +42,8 @@
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 
+#include <sstream>
+
 #include <simgear/scene/util/OsgMath.hxx>
 #include <simgear/scene/util/SGReaderWriterOptions.hxx>
 #include <simgear/scene/util/SGSceneFeatures.hxx>
@@ -256,14 +258,36 @@ bool setAttrs(const TexTuple& attrs, Texture* tex,
     if (imageName.empty())
         return false;
 
-    osgDB::ReaderWriter::ReadResult result;
-    result = osgDB::readImageFile(imageName, options);
+    // Images are cached as they come out of computeMipmap, so the entry
+    // depends on the mipmap functions and on the reader options
+    TextureCache* cache = options ? options->getTextureCache() : 0;
+    string entry;
     osg::ref_ptr<osg::Image> image;
-    if (result.success())
-        image = result.getImage();
+    if (cache) {
+        const MipMapTuple& mipmap = attrs.get<7>();
+        std::ostringstream params;
+        params << "mipmap " << mipmap.get<0>() << " " << mipmap.get<1>()
+               << " " << mipmap.get<2>() << " " << mipmap.get<3>()
+               << "\noptions " << options->getOptionString();
+        entry = cache->entryName(imageName, params.str());
+        if (!entry.empty())
+            image = cache->load(entry);
+        if (image.valid())
+            image->setFileName(imageName);
+    }
+    if (!image.valid()) {
+        osgDB::ReaderWriter::ReadResult result;
+        result = osgDB::readImageFile(imageName, options);
+        if (result.success())
+            image = result.getImage();
+        if (image.valid()) {
+            image = computeMipmap( image.get(), attrs.get<7>() );
+            if (!entry.empty())
+                cache->store(entry, image.get());
+        }
+    }
     if (image.valid())
     {
-        image = computeMipmap( image.get(), attrs.get<7>() );
         tex->setImage(GL_FRONT_AND_BACK, image.get());
         int s = image->s();
         int t = image->t();
@@ -301,6 +325,7 @@ public:
 protected:
     typedef map<TexTuple, observer_ptr<T> > TexMap;
     TexMap texMap;
+    Mutex texMutex;
     const string _type;
 };
 
@@ -309,21 +334,30 @@ Texture* TexBuilder<T>::build(Effect* effect, Pass* pass, const SGPropertyNode*
                               const SGReaderWriterOptions* options)
 {
     TexTuple attrs = makeTexTuple(effect, props, options, _type);
-    typename TexMap::iterator itr = texMap.find(attrs);
-
     ref_ptr<T> tex;
-    if ((itr != texMap.end())&&
-        (itr->second.lock(tex)))
     {
-        return tex.release();
+        ScopedLock<Mutex> lock(texMutex);
+        typename TexMap::iterator itr = texMap.find(attrs);
+        if ((itr != texMap.end())&&
+            (itr->second.lock(tex)))
+        {
+            return tex.release();
+        }
     }
 
+    // Load the image without holding the lock, so that threads building
+    // different effects can load their textures at the same time
     tex = new T;
     if (!setAttrs(attrs, tex, options))
         return NULL;
 
+    ScopedLock<Mutex> lock(texMutex);
+    typename TexMap::iterator itr = texMap.find(attrs);
+    ref_ptr<T> old;
     if (itr == texMap.end())
         texMap.insert(make_pair(attrs, tex));
+    else if (itr->second.lock(old))
+        return old.release(); // Another thread beat us to it
     else
         itr->second = tex; // update existing, but empty observer
     return tex.release();
@@ -538,6 +572,7 @@ protected:
     typedef map<string, observer_ptr<TextureCubeMap> > CrossCubeMap;
     CubeMap _cubemaps;
     CrossCubeMap _crossmaps;
+    Mutex _mutex;
 };
 
 // I use this until osg::CopyImage is fixed
@@ -565,6 +600,8 @@ Texture* CubeMapBuilder::build(Effect* effect, Pass* pass, const SGPropertyNode*
         return NULL; // This is redundant
     }
 
+    ScopedLock<Mutex> lock(_mutex);
+
     // Using 6 separate images
     if(texturesProp) {
         CubeMapTuple _tuple = makeCubeMapTuple(effect, texturesProp);
@@ -954,8 +991,6 @@ public:
     GBufferBuilder() {}
     Texture* build(Effect* effect, Pass* pass, const SGPropertyNode*,
                    const SGReaderWriterOptions* options);
-private:
-    string buffer;
 };
 
 class BufferNameChangeListener : public SGPropertyChangeListener,
@@ -1006,8 +1041,7 @@ Texture* GBufferBuilder::build(Effect* effect, Pass* pass, const SGPropertyNode*
         return 0;
 
     if (nameProp->nChildren() == 0) {
-        buffer = nameProp->getStringValue();
-        pass->setBufferUnit( unit, buffer );
+        pass->setBufferUnit( unit, nameProp->getStringValue() );
     } else {
         std::string propName = getGlobalProperty(nameProp, options);
         BufferNameChangeListener* listener = new BufferNameChangeListener(pass, unit, propName);
@@ -0,0 +1,389 @@
+// Disk cache of decoded and processed texture images
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include "TextureCache.hxx"
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <osg/Image>
+#include <osg/ref_ptr>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace simgear
+{
+
+  namespace
+  {
+    // Bump when the entry layout changes
+    const unsigned int CACHE_VERSION = 1;
+
+    // An entry is this header, the offsets of the mipmap levels, and the
+    // image data with all levels, at a multiple of 16 bytes from the start
+    struct EntryHeader
+    {
+      char magic[4];                ///< "SGTX"
+      unsigned int version;
+      int s, t, r;
+      int internal_format;
+      unsigned int pixel_format;
+      unsigned int data_type;
+      int packing;
+      int origin;
+      unsigned int num_mipmaps;     ///< number of offsets
+      unsigned int data_offset;
+      unsigned long long data_size;
+    };
+
+    const unsigned int MAX_MIPMAPS = 32;
+
+    //--------------------------------------------------------------------------
+    // 64 bit FNV-1a
+    class Hash
+    {
+      public:
+        Hash():
+          _hash(14695981039346656037ULL)
+        {}
+
+        void add(const char* buf, size_t len)
+        {
+          for(size_t i = 0; i < len; ++i)
+            _hash = (_hash ^ static_cast<unsigned char>(buf[i]))
+                  * 1099511628211ULL;
+        }
+
+        unsigned long long value() const
+        {
+          return _hash;
+        }
+
+      private:
+        unsigned long long _hash;
+    };
+
+    //--------------------------------------------------------------------------
+    bool validHeader(const EntryHeader& h, size_t file_size)
+    {
+      return memcmp(h.magic, "SGTX", 4) == 0
+          && h.version == CACHE_VERSION
+          && h.s > 0 && h.t > 0 && h.r > 0
+          && h.num_mipmaps <= MAX_MIPMAPS
+          && h.data_offset >= sizeof(EntryHeader)
+                            + h.num_mipmaps * sizeof(unsigned int)
+          && h.data_offset <= file_size
+          && h.data_size == file_size - h.data_offset;
+    }
+
+    //--------------------------------------------------------------------------
+    // Set up an image from an entry, checking that the data is exactly as
+    // large as the image with its mipmap levels
+    bool setupImage( osg::Image* image,
+                     const EntryHeader& h,
+                     const unsigned int* offsets,
+                     unsigned char* data,
+                     osg::Image::AllocationMode mode )
+    {
+      image->setImage( h.s, h.t, h.r,
+                       h.internal_format, h.pixel_format, h.data_type,
+                       data, mode, h.packing );
+      image->setOrigin(static_cast<osg::Image::Origin>(h.origin));
+
+      osg::Image::MipmapDataType levels(offsets, offsets + h.num_mipmaps);
+      for(size_t i = 0; i < levels.size(); ++i)
+        if( levels[i] >= h.data_size || (i && levels[i] <= levels[i - 1]) )
+          return false;
+      image->setMipmapLevels(levels);
+
+      return image->getTotalSizeInBytesIncludingMipmaps() == h.data_size;
+    }
+
+#ifndef _WIN32
+    //--------------------------------------------------------------------------
+    // Image data mapped from a cache entry.  The mapping is private, so
+    // changes to the image never reach the file.
+    class MappedImage:
+      public osg::Image
+    {
+      public:
+        MappedImage(void* map, size_t size):
+          _map(map),
+          _size(size)
+        {}
+
+      protected:
+        virtual ~MappedImage()
+        {
+          munmap(_map, _size);
+        }
+
+      private:
+        void* _map;
+        size_t _size;
+    };
+
+    //--------------------------------------------------------------------------
+    osg::Image* readEntry(const SGPath& path)
+    {
+      int fd = open(path.c_str(), O_RDONLY);
+      if( fd < 0 )
+        return 0;
+
+      struct stat st;
+      void* map = MAP_FAILED;
+      if( fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(EntryHeader) )
+        map = mmap( 0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0 );
+      close(fd);
+      if( map == MAP_FAILED )
+        return 0;
+
+      unsigned char* base = static_cast<unsigned char*>(map);
+      const EntryHeader& h = *reinterpret_cast<const EntryHeader*>(base);
+
+      // From here on the image owns the mapping
+      osg::ref_ptr<osg::Image> image = new MappedImage(map, st.st_size);
+      if(    !validHeader(h, st.st_size)
+          || !setupImage( image.get(), h,
+                          reinterpret_cast<const unsigned int*>(&h + 1),
+                          base + h.data_offset, osg::Image::NO_DELETE ) )
+        return 0;
+
+      return image.release();
+    }
+#else
+    //--------------------------------------------------------------------------
+    osg::Image* readEntry(const SGPath& path)
+    {
+      std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+      if( !in )
+        return 0;
+
+      std::vector<char> buf( (std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>() );
+      if( buf.size() < sizeof(EntryHeader) )
+        return 0;
+
+      EntryHeader h;
+      memcpy(&h, &buf[0], sizeof(h));
+      if( !validHeader(h, buf.size()) )
+        return 0;
+
+      std::vector<unsigned int> offsets(h.num_mipmaps + 1);
+      memcpy( &offsets[0], &buf[sizeof(h)],
+              h.num_mipmaps * sizeof(unsigned int) );
+
+      unsigned char* data = new unsigned char[h.data_size];
+      memcpy(data, &buf[h.data_offset], h.data_size);
+
+      osg::ref_ptr<osg::Image> image = new osg::Image;
+      if( !setupImage( image.get(), h, &offsets[0], data,
+                       osg::Image::USE_NEW_DELETE ) )
+        return 0;
+
+      return image.release();
+    }
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  TextureCache::Stats::Stats():
+    hits(0),
+    misses(0),
+    stores(0),
+    load_msec(0)
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  TextureCache::TextureCache(const SGPath& dir):
+    _dir(dir)
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  std::string TextureCache::entryName( const std::string& file,
+                                       const std::string& params )
+  {
+    SGTimeStamp st;
+    st.stamp();
+
+    std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+    if( !in )
+      return std::string();
+
+    Hash hash;
+    std::vector<char> buf(64 * 1024);
+    while( in )
+    {
+      in.read(&buf[0], buf.size());
+      hash.add(&buf[0], in.gcount());
+    }
+
+    std::ostringstream key;
+    key << '\n' << params << '\n' << CACHE_VERSION;
+    hash.add(key.str().data(), key.str().size());
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.sgtx", hash.value());
+
+    SGGuard<SGMutex> lock(_mutex);
+    _stats.load_msec += (SGTimeStamp::now() - st).toMSecs();
+    return name;
+  }
+
+  //----------------------------------------------------------------------------
+  osg::Image* TextureCache::load(const std::string& entry)
+  {
+    SGTimeStamp st;
+    st.stamp();
+
+    SGPath path = entryPath(entry);
+    osg::Image* image = path.exists() ? readEntry(path) : 0;
+    if( !image && path.exists() )
+      SG_LOG(SG_IO, SG_INFO, "Invalid texture cache entry " << path);
+
+    SGGuard<SGMutex> lock(_mutex);
+    if( image )
+      _stats.hits += 1;
+    else
+      _stats.misses += 1;
+    _stats.load_msec += (SGTimeStamp::now() - st).toMSecs();
+    return image;
+  }
+
+  //----------------------------------------------------------------------------
+  bool TextureCache::store(const std::string& entry, const osg::Image* image)
+  {
+    if( !image || !image->data() || image->isCompressed() )
+      return false;
+
+    const osg::Image::MipmapDataType& levels = image->getMipmapLevels();
+    if( levels.size() > MAX_MIPMAPS )
+      return false;
+
+    EntryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "SGTX", 4);
+    h.version = CACHE_VERSION;
+    h.s = image->s();
+    h.t = image->t();
+    h.r = image->r();
+    h.internal_format = image->getInternalTextureFormat();
+    h.pixel_format = image->getPixelFormat();
+    h.data_type = image->getDataType();
+    h.packing = image->getPacking();
+    h.origin = image->getOrigin();
+    h.num_mipmaps = levels.size();
+    h.data_offset = sizeof(h) + levels.size() * sizeof(unsigned int);
+    h.data_offset = (h.data_offset + 15) & ~15u;
+    h.data_size = image->getTotalSizeInBytesIncludingMipmaps();
+
+    simgear::Dir dir(_dir);
+    if( !dir.exists() && !dir.create(0755) )
+      return false;
+
+    // Write to a temporary file first, so that other threads and processes
+    // sharing the cache never see a partial entry
+    SGPath path = entryPath(entry);
+    std::ostringstream tmp_name;
+    tmp_name << path.str() << "." << getpid()
+             << "." << SGThread::current() << ".tmp";
+    SGPath tmp(tmp_name.str());
+
+    std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    for(size_t i = 0; i < levels.size(); ++i)
+      out.write( reinterpret_cast<const char*>(&levels[i]),
+                 sizeof(unsigned int) );
+    const char padding[16] = {0};
+    out.write( padding,
+               h.data_offset - sizeof(h) - levels.size() * sizeof(unsigned int) );
+    out.write(reinterpret_cast<const char*>(image->data()), h.data_size);
+    out.close();
+
+    if( !out || !tmp.rename(path) )
+    {
+      SG_LOG(SG_IO, SG_WARN, "Failed to write " << path);
+      tmp.remove();
+      return false;
+    }
+
+    SGGuard<SGMutex> lock(_mutex);
+    _stats.stores += 1;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void TextureCache::clear()
+  {
+    simgear::Dir dir(_dir);
+    if( !dir.exists() )
+      return;
+
+    simgear::PathList entries =
+      dir.children(simgear::Dir::TYPE_FILE, ".sgtx");
+    for(size_t i = 0; i < entries.size(); ++i)
+      entries[i].remove();
+  }
+
+  //----------------------------------------------------------------------------
+  TextureCache::Stats TextureCache::stats() const
+  {
+    SGGuard<SGMutex> lock(_mutex);
+    return _stats;
+  }
+
+  //----------------------------------------------------------------------------
+  void TextureCache::resetStats()
+  {
+    SGGuard<SGMutex> lock(_mutex);
+    _stats = Stats();
+  }
+
+  //----------------------------------------------------------------------------
+  SGPath TextureCache::entryPath(const std::string& entry) const
+  {
+    SGPath path(_dir);
+    path.append(entry);
+    return path;
+  }
+
+} // namespace simgear
@@ -0,0 +1,103 @@
+///@file
+/// Disk cache of decoded and processed texture images
+///
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_TEXTURE_CACHE_HXX_
+#define SG_TEXTURE_CACHE_HXX_
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+#include <simgear/threads/SGThread.hxx>
+
+#include <string>
+
+namespace osg { class Image; }
+
+namespace simgear
+{
+
+  /**
+   * Keeps texture images as TextureBuilder hands them to OpenGL (decoded,
+   * with any custom mipmaps computed) in a directory, so that later runs
+   * map them into memory instead of decoding and processing the source
+   * again.  Each entry holds the image with all of its mipmap levels, and
+   * is named after a hash of the contents of the source file and of the
+   * processing parameters, so edited sources simply miss.
+   *
+   * Entries are written to a temporary file first, so that several
+   * threads and processes can share a cache directory.
+   */
+  class TextureCache:
+    public SGReferenced
+  {
+    public:
+      struct Stats
+      {
+        Stats();
+
+        unsigned int hits;      ///< images loaded from the cache
+        unsigned int misses;    ///< images not (or no longer) cached
+        unsigned int stores;    ///< images added to the cache
+        double load_msec;       ///< time spent hashing and loading
+      };
+
+      /**
+       * @param dir   Cache directory, created on first use
+       */
+      explicit TextureCache(const SGPath& dir);
+
+      /**
+       * Name of the entry for an image file processed with the given
+       * parameters, or an empty string if the file can't be read.
+       */
+      std::string entryName( const std::string& file,
+                             const std::string& params );
+
+      /**
+       * Load an entry, or return NULL if it is missing or invalid.  The
+       * image data is a private mapping of the file where supported, so
+       * pages are only read as OpenGL uses them.
+       */
+      osg::Image* load(const std::string& entry);
+
+      /**
+       * Add an image to the cache.  Compressed images are not stored, as
+       * they are loaded without any processing anyway.
+       */
+      bool store(const std::string& entry, const osg::Image* image);
+
+      /**
+       * Remove all entries from the cache directory.
+       */
+      void clear();
+
+      Stats stats() const;
+      void resetStats();
+
+    protected:
+      SGPath _dir;
+      Stats _stats;
+      mutable SGMutex _mutex;
+
+      SGPath entryPath(const std::string& entry) const;
+  };
+
+  typedef SGSharedPtr<TextureCache> TextureCachePtr;
+
+} // namespace simgear
+
+#endif /* SG_TEXTURE_CACHE_HXX_ */
@@ -0,0 +1,141 @@
+#include <simgear/compiler.h>
+
+#include "TextureCache.hxx"
+#include "mipmap.hxx"
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/timing/timestamp.hxx>
+#include <osg/Image>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace simgear;
+using namespace simgear::effect;
+
+#define VERIFY(a) \
+  if( !(a) ) \
+  { \
+    std::cerr << "failed: line " << __LINE__ << ": " << #a << std::endl; \
+    return 1; \
+  }
+
+osg::Image* randomImage(int s, int t, GLenum format)
+{
+  osg::Image* image = new osg::Image;
+  image->allocateImage(s, t, 1, format, GL_UNSIGNED_BYTE);
+  unsigned char* data = image->data();
+  for(unsigned int i = 0; i < image->getTotalSizeInBytes(); ++i)
+    data[i] = rand() & 0xff;
+  return image;
+}
+
+bool sameImages(const osg::Image* a, const osg::Image* b)
+{
+  return a->s() == b->s() && a->t() == b->t() && a->r() == b->r()
+      && a->getPixelFormat() == b->getPixelFormat()
+      && a->getDataType() == b->getDataType()
+      && a->getPacking() == b->getPacking()
+      && a->getOrigin() == b->getOrigin()
+      && a->getMipmapLevels() == b->getMipmapLevels()
+      && a->getTotalSizeInBytesIncludingMipmaps()
+         == b->getTotalSizeInBytesIncludingMipmaps()
+      && memcmp( a->data(), b->data(),
+                 a->getTotalSizeInBytesIncludingMipmaps() ) == 0;
+}
+
+void writeFile(const SGPath& path, const std::string& contents)
+{
+  std::ofstream out(path.c_str(), std::ios::out | std::ios::binary);
+  out << contents;
+}
+
+int main(int argc, char* argv[])
+{
+  SGPath dir = simgear::Dir::tempDir("texture_cache").path();
+  SGPath source(dir);
+  source.append("source.png");
+  writeFile(source, "not really a png");
+
+  SGPath cache_dir(dir);
+  cache_dir.append("cache");
+  TextureCachePtr cache = new TextureCache(cache_dir);
+
+  // names depend on the source contents and the parameters
+  std::string entry = cache->entryName(source.str(), "mipmap 1 1 1 1");
+  VERIFY( !entry.empty() )
+  VERIFY( entry == cache->entryName(source.str(), "mipmap 1 1 1 1") )
+  VERIFY( entry != cache->entryName(source.str(), "mipmap 2 1 1 1") )
+  VERIFY( cache->entryName(dir.str() + "/missing.png", "").empty() )
+
+  writeFile(source, "not really a png either");
+  VERIFY( entry != cache->entryName(source.str(), "mipmap 1 1 1 1") )
+
+  // round trip of an image with custom mipmaps
+  MipMapTuple average(AVERAGE, AVERAGE, AVERAGE, AVERAGE);
+  osg::ref_ptr<osg::Image> image =
+    computeMipmap(randomImage(256, 128, GL_RGBA), average);
+  image->setOrigin(osg::Image::TOP_LEFT);
+  VERIFY( image->getNumMipmapLevels() > 1 )
+
+  VERIFY( !cache->load(entry) )
+  VERIFY( cache->store(entry, image.get()) )
+  osg::ref_ptr<osg::Image> loaded = cache->load(entry);
+  VERIFY( loaded.valid() )
+  VERIFY( sameImages(image.get(), loaded.get()) )
+
+  // the mapping is private, changes stay in memory
+  loaded->data()[0] ^= 0xff;
+  loaded = cache->load(entry);
+  VERIFY( sameImages(image.get(), loaded.get()) )
+
+  // images without mipmaps, and odd row sizes
+  osg::ref_ptr<osg::Image> rgb = randomImage(37, 11, GL_RGB);
+  VERIFY( cache->store("rgb.sgtx", rgb.get()) )
+  loaded = cache->load("rgb.sgtx");
+  VERIFY( loaded.valid() && sameImages(rgb.get(), loaded.get()) )
+
+  // truncated or foreign entries are rejected
+  SGPath entry_path(cache_dir);
+  entry_path.append(entry);
+  {
+    std::ifstream in(entry_path.c_str(), std::ios::in | std::ios::binary);
+    std::string contents( (std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>() );
+    in.close();
+    writeFile(entry_path, contents.substr(0, contents.size() - 1));
+  }
+  VERIFY( !cache->load(entry) )
+  writeFile(entry_path, "SGTX");
+  VERIFY( !cache->load(entry) )
+
+  TextureCache::Stats stats = cache->stats();
+  VERIFY( stats.hits == 3 )
+  VERIFY( stats.misses == 3 )
+  VERIFY( stats.stores == 2 )
+
+  cache->clear();
+  VERIFY( !cache->load("rgb.sgtx") )
+
+  // Loading the whole chain compared to computing it, which is what a
+  // warm start saves besides decoding the source
+  osg::ref_ptr<osg::Image> large = randomImage(2048, 2048, GL_RGBA);
+  SGTimeStamp start = SGTimeStamp::now();
+  osg::ref_ptr<osg::Image> mipmaps = computeMipmap(large.get(), average);
+  double compute_msec = (SGTimeStamp::now() - start).toMSecs();
+  VERIFY( cache->store("large.sgtx", mipmaps.get()) )
+
+  start = SGTimeStamp::now();
+  loaded = cache->load("large.sgtx");
+  double load_msec = (SGTimeStamp::now() - start).toMSecs();
+  VERIFY( loaded.valid() && sameImages(mipmaps.get(), loaded.get()) )
+
+  std::cout << "RGBA 2048 mipmaps: computed in " << compute_msec << " msec, "
+            << "loaded in " << load_msec << " msec" << std::endl;
+
+  cache->clear();
+  simgear::Dir(dir).remove(true);
+  return 0;
+}
@@ -13,12 +13,13 @@
 #include <map>
 #include <sstream>
 
+#include <boost/functional/hash.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 
+#include <OpenThreads/Mutex>
 #include <OpenThreads/ReentrantMutex>
-#include <OpenThreads/ScopedLock>
 
 #include <osg/Material>
 #include <osg/Program>
@@ -35,6 +36,7 @@
 #include <simgear/props/props_io.hxx>
 #include <simgear/scene/util/SGSceneFeatures.hxx>
 #include <simgear/scene/util/SplicingVisitor.hxx>
+#include <simgear/structure/SGAtomic.hxx>
 #include <simgear/structure/SGExpression.hxx>
 
 namespace simgear
@@ -48,8 +50,60 @@ typedef map<const string, ref_ptr<Effect> > EffectMap;
 
 namespace
 {
-EffectMap effectMap;
-OpenThreads::ReentrantMutex effectMutex;
+// Effects loaded by name are spread over shards by the hash of the name,
+// so that pager threads loading different effects don't wait for each
+// other.  The inheritance cache and the techniques of an effect are
+// guarded by one of a set of locks chosen by the address of the effect.
+const size_t numEffectShards = 16;
+const size_t numEffectStripes = 31;
+
+struct EffectShard
+{
+    OpenThreads::Mutex mutex;
+    EffectMap effects;
+};
+
+EffectShard effectShards[numEffectShards];
+OpenThreads::Mutex cacheMutexes[numEffectStripes];
+OpenThreads::ReentrantMutex realizeMutexes[numEffectStripes];
+
+struct EffectCacheCounters
+{
+    SGAtomic lookups;
+    SGAtomic hits;
+    SGAtomic loads;
+    SGAtomic races;
+    SGAtomic contended;
+} counters;
+
+// Scoped lock which counts how often the mutex was held by another thread
+template<typename M>
+class CountedLock
+{
+public:
+    CountedLock(M& mutex) : _mutex(mutex)
+    {
+        if (_mutex.trylock() != 0) {
+            ++counters.contended;
+            _mutex.lock();
+        }
+    }
+    ~CountedLock() { _mutex.unlock(); }
+private:
+    M& _mutex;
+};
+
+EffectShard& getShard(const string& name)
+{
+    return effectShards[boost::hash<string>()(name) % numEffectShards];
+}
+
+template<typename M>
+M& getStripe(M* mutexes, const Effect* effect)
+{
+    size_t addr = reinterpret_cast<size_t>(effect);
+    return mutexes[(addr / sizeof(void*)) % numEffectStripes];
+}
 }
 
 /** Merge two property trees, producing a new tree.
@@ -119,12 +173,16 @@ Effect* makeEffect(const string& name,
                    bool realizeTechniques,
                    const SGReaderWriterOptions* options)
 {
+    EffectShard& shard = getShard(name);
+    ++counters.lookups;
     {
-        OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(effectMutex);
-        EffectMap::iterator itr = effectMap.find(name);
-        if ((itr != effectMap.end())&&
-            itr->second.valid())
+        CountedLock<OpenThreads::Mutex> lock(shard.mutex);
+        EffectMap::iterator itr = shard.effects.find(name);
+        if ((itr != shard.effects.end())&&
+            itr->second.valid()) {
+            ++counters.hits;
             return itr->second.get();
+        }
     }
     string effectFileName(name);
     effectFileName += ".eff";
@@ -146,12 +204,14 @@ Effect* makeEffect(const string& name,
     ref_ptr<Effect> result = makeEffect(effectProps.ptr(), realizeTechniques,
                                         options);
     if (result.valid()) {
-        OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(effectMutex);
+        ++counters.loads;
+        CountedLock<OpenThreads::Mutex> lock(shard.mutex);
         pair<EffectMap::iterator, bool> irslt
-            = effectMap.insert(make_pair(name, result));
+            = shard.effects.insert(make_pair(name, result));
         if (!irslt.second) {
             // Another thread beat us to it!. Discard our newly
             // constructed Effect and use the one in the cache.
+            ++counters.races;
             result = irslt.first->second;
         }
     }
@@ -203,11 +263,11 @@ Effect* makeEffect(SGPropertyNode* prop,
             if (options) {
                 key.paths = options->getDatabasePathList();
             }
+            OpenThreads::Mutex& cacheMutex = getStripe(cacheMutexes, parent);
             Effect::Cache* cache = 0;
             Effect::Cache::iterator itr;
             {
-                OpenThreads::ScopedLock<OpenThreads::ReentrantMutex>
-                    lock(effectMutex);
+                CountedLock<OpenThreads::Mutex> lock(cacheMutex);
                 cache = parent->getCache();
                 itr = cache->find(key);
                 if ((itr != cache->end())&&
@@ -222,15 +282,15 @@ Effect* makeEffect(SGPropertyNode* prop,
                 effect->root = new SGPropertyNode;
                 mergePropertyTrees(effect->root, prop, parent->root);
                 effect->parametersProp = effect->root->getChild("parameters");
-                OpenThreads::ScopedLock<OpenThreads::ReentrantMutex>
-                    lock(effectMutex);
+                CountedLock<OpenThreads::Mutex> lock(cacheMutex);
                 pair<Effect::Cache::iterator, bool> irslt
                     = cache->insert(make_pair(key, effect));
                 if (!irslt.second) {
                     ref_ptr<Effect> old;
-                    if (irslt.first->second.lock(old))
+                    if (irslt.first->second.lock(old)) {
                         effect = old; // Another thread beat us in creating it! Discard our own...
-                    else
+                        ++counters.races;
+                    } else
                         irslt.first->second = effect; // update existing, but empty observer
                 }
                 effect->generator = parent->generator;  // Copy the generators
@@ -263,8 +323,8 @@ Effect* makeEffect(SGPropertyNode* prop,
     }
     if (realizeTechniques) {
         try {
-            OpenThreads::ScopedLock<OpenThreads::ReentrantMutex>
-                lock(effectMutex);
+            CountedLock<OpenThreads::ReentrantMutex>
+                lock(getStripe(realizeMutexes, effect.get()));
             effect->realizeTechniques(options);
         }
         catch (BuilderException& e) {
@@ -278,8 +338,21 @@ Effect* makeEffect(SGPropertyNode* prop,
 
 void clearEffectCache()
 {
-    OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(effectMutex);
-    effectMap.clear();
+    for (size_t i = 0; i < numEffectShards; ++i) {
+        CountedLock<OpenThreads::Mutex> lock(effectShards[i].mutex);
+        effectShards[i].effects.clear();
+    }
+}
+
+EffectCacheStats getEffectCacheStats()
+{
+    EffectCacheStats stats;
+    stats.lookups = counters.lookups;
+    stats.hits = counters.hits;
+    stats.loads = counters.loads;
+    stats.races = counters.races;
+    stats.contended = counters.contended;
+    return stats;
 }
 
 }
@@ -0,0 +1,203 @@
+#include <simgear/compiler.h>
+
+#include "Effect.hxx"
+#include "EffectGeode.hxx"
+#include "Technique.hxx"
+#include "Pass.hxx"
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/props/AtomicChangeListener.hxx>
+#include <simgear/scene/tgdb/userdata.hxx>
+#include <simgear/scene/util/SGReaderWriterOptions.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace simgear;
+
+#define VERIFY(a) \
+  if( !(a) ) \
+  { \
+    std::cerr << "failed: line " << __LINE__ << ": " << #a << std::endl; \
+    return 1; \
+  }
+
+const int numEffects = 200;
+
+std::string effectName(int i)
+{
+  std::ostringstream name;
+  name << "Effects/test-" << i;
+  return name.str();
+}
+
+void writeEffects(const SGPath& dir)
+{
+  SGPath effects(dir);
+  effects.append("Effects");
+  simgear::Dir(effects).create(0755);
+
+  std::ofstream base(SGPath(effects, "base.eff").c_str());
+  base << "<PropertyList>\n"
+          " <name>Effects/base</name>\n"
+          " <parameters>\n"
+          "  <shade>smooth</shade>\n"
+          "  <visibility><use>/test/visibility</use></visibility>\n"
+          " </parameters>\n"
+          " <technique n=\"0\">\n"
+          "  <pass>\n"
+          "   <lighting>true</lighting>\n"
+          "   <shade-model><use>shade</use></shade-model>\n"
+          "   <uniform>\n"
+          "    <name>visibility</name>\n"
+          "    <type>float</type>\n"
+          "    <value><use>visibility</use></value>\n"
+          "   </uniform>\n"
+          "  </pass>\n"
+          " </technique>\n"
+          "</PropertyList>\n";
+
+  for(int i = 0; i < numEffects; ++i)
+  {
+    std::ostringstream file;
+    file << "test-" << i << ".eff";
+    std::ofstream eff(SGPath(effects, file.str()).c_str());
+    eff << "<PropertyList>\n"
+           " <name>" << effectName(i) << "</name>\n"
+           " <inherits-from>Effects/base</inherits-from>\n"
+           " <parameters><shade>" << (i % 2 ? "flat" : "smooth")
+        << "</shade></parameters>\n"
+           "</PropertyList>\n";
+  }
+}
+
+// Loads all test effects, starting at a different one in each thread
+class LoadThread:
+  public SGThread
+{
+  public:
+    LoadThread(int start, const SGReaderWriterOptions* options):
+      _start(start),
+      _options(options),
+      effects(numEffects)
+    {}
+
+    virtual void run()
+    {
+      for(int i = 0; i < numEffects; ++i)
+      {
+        int n = (_start + i) % numEffects;
+        effects[n] = makeEffect(effectName(n), true, _options);
+      }
+    }
+
+    int _start;
+    const SGReaderWriterOptions* _options;
+    std::vector<osg::ref_ptr<Effect> > effects;
+};
+
+// Loads the effects with a number of threads, returning the time taken
+double loadEffects( int numThreads,
+                    const SGReaderWriterOptions* options,
+                    std::vector<LoadThread*>& threads )
+{
+  clearEffectCache();
+  SGTimeStamp start = SGTimeStamp::now();
+  for(int i = 0; i < numThreads; ++i)
+  {
+    threads.push_back(new LoadThread(i * numEffects / numThreads, options));
+    threads.back()->start();
+  }
+  for(int i = 0; i < numThreads; ++i)
+    threads[i]->join();
+  return (SGTimeStamp::now() - start).toMSecs();
+}
+
+int main(int argc, char* argv[])
+{
+  simgear::Dir dir = simgear::Dir::tempDir("effects");
+  writeEffects(dir.path());
+
+  osg::ref_ptr<SGReaderWriterOptions> options = new SGReaderWriterOptions;
+  options->setDatabasePath(dir.path().str());
+
+  for(int numThreads = 1; numThreads <= 8; numThreads *= 2)
+  {
+    EffectCacheStats before = getEffectCacheStats();
+    std::vector<LoadThread*> threads;
+    double msec = loadEffects(numThreads, options.get(), threads);
+    EffectCacheStats stats = getEffectCacheStats();
+
+    // every thread gets the same, realized effects
+    for(int i = 0; i < numEffects; ++i)
+    {
+      Effect* effect = threads[0]->effects[i].get();
+      VERIFY( effect )
+      VERIFY( effect->getName() == effectName(i) )
+      VERIFY( effect->techniques.size() == 1 )
+      for(int t = 1; t < numThreads; ++t)
+        VERIFY( threads[t]->effects[i].get() == effect )
+    }
+
+    unsigned lookups = stats.lookups - before.lookups;
+    unsigned loads = stats.loads - before.loads;
+    VERIFY( lookups >= unsigned(numThreads * numEffects) )
+    VERIFY( loads >= unsigned(numEffects) )
+
+    std::cout << numThreads << " thread(s): " << msec << " msec, "
+              << lookups << " lookups, "
+              << stats.hits - before.hits << " hits, "
+              << loads << " loads, "
+              << stats.races - before.races << " races, "
+              << stats.contended - before.contended << " contended locks"
+              << std::endl;
+
+    for(int t = 0; t < numThreads; ++t)
+      delete threads[t];
+  }
+
+  // Each effect has a uniform of its own, but all of them follow the
+  // same property through a single listener
+  SGPropertyNode_ptr root = new SGPropertyNode;
+  root->setFloatValue("test/visibility", 5);
+  sgUserDataInit(root);
+
+  clearEffectCache();
+  UniformCacheStats before = getUniformCacheStats();
+  std::vector<osg::ref_ptr<Effect> > effects;
+  for(int i = 0; i < numEffects; ++i)
+    effects.push_back(makeEffect(effectName(i), true, options.get()));
+  osg::ref_ptr<EffectGeode> geode = new EffectGeode;
+  geode->setEffect(effects[0].get());
+  osg::ref_ptr<Effect::InitializeCallback> init =
+    new Effect::InitializeCallback;
+  init->doUpdate(geode.get(), 0);
+  UniformCacheStats stats = getUniformCacheStats();
+
+  VERIFY( stats.uniforms >= unsigned(numEffects) )
+  VERIFY( stats.listeners == 1 )
+  VERIFY( stats.bindings == unsigned(numEffects) )
+  VERIFY( stats.hits - before.hits >= unsigned(numEffects) )
+
+  root->setFloatValue("test/visibility", 7);
+  AtomicChangeListener::fireChangeListeners();
+  for(int i = 0; i < numEffects; ++i)
+  {
+    float visibility = 0;
+    effects[i]->techniques[0]->passes[0]->getUniform("visibility")
+      ->get(visibility);
+    VERIFY( visibility == 7 )
+  }
+
+  std::cout << stats.uniforms << " uniforms, " << stats.hits << " hits, "
+            << stats.listeners << " property listeners, "
+            << stats.bindings << " bindings" << std::endl;
+
+  clearEffectCache();
+  dir.remove(true);
+  return 0;
+}
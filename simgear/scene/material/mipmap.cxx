@@ -21,15 +21,20 @@
 #include "mipmap.hxx"
 #include "EffectBuilder.hxx"
 
+#include <algorithm>
 #include <limits>
 #include <iomanip>
+#include <vector>
 
 #include <osg/Image>
 #include <osg/Vec4>
+#include <OpenThreads/Thread>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 
+#include <simgear/threads/SGThread.hxx>
+
 namespace simgear { namespace effect {
 
 EffectNameValue<MipMapFunction> mipmapFunctionsInit[] =
@@ -264,7 +269,334 @@ void dumpMipmap( std::string n, int s, int t, int r, int c, unsigned char *d, co
     }
 }
 
-osg::Image* computeMipmap( osg::Image* image, MipMapTuple attrs )
+namespace
+{
+
+// Computes rows [y0, y1) of the next level one texel at a time, which
+// works for all image formats.
+void reduceRowsGeneric( const osg::Image* image, MipMapTuple attrs,
+                        unsigned char* src, unsigned char* dest,
+                        int s, int t, int r, int y0, int y1 )
+{
+    int ns = s >> 1; if ( ns == 0 ) ns = 1;
+    int nt = t >> 1; if ( nt == 0 ) nt = 1;
+
+    for ( int k = 0; k < r; k += 2 )
+    {
+        for ( int j = 2 * y0; j < t && j < 2 * y1; j += 2 )
+        {
+            for ( int i = 0; i < s; i += 2 )
+            {
+                osg::Vec4 colors[2][2][2];
+                bool colorValid[2][2][2];
+                colorValid[0][0][0] = false; colorValid[0][0][1] = false; colorValid[0][1][0] = false; colorValid[0][1][1] = false;
+                colorValid[1][0][0] = false; colorValid[1][0][1] = false; colorValid[1][1][0] = false; colorValid[1][1][1] = false;
+                if ( true )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k );
+                    colors[0][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[0][0][0] = true;
+                }
+                if ( i + 1 < s )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k );
+                    colors[0][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[0][0][1] = true;
+                }
+                if ( j + 1 < t )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k );
+                    colors[0][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[0][1][0] = true;
+                }
+                if ( i + 1 < s && j + 1 < t )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k );
+                    colors[0][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[0][1][1] = true;
+                }
+                if ( k + 1 < r )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k + 1 );
+                    colors[1][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[1][0][0] = true;
+                }
+                if ( i + 1 < s && k + 1 < r )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k + 1 );
+                    colors[1][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[1][0][1] = true;
+                }
+                if ( j + 1 < t && k + 1 < r )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k + 1 );
+                    colors[1][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[1][1][0] = true;
+                }
+                if ( i + 1 < s && j + 1 < t && k + 1 < r )
+                {
+                    unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k + 1 );
+                    colors[1][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                    colorValid[1][1][1] = true;
+                }
+
+                unsigned char *ptr = imageData( dest, image->getPixelFormat(), image->getDataType(), ns, nt, image->getPacking(), i/2, j/2, k/2 );
+                osg::Vec4 color = computeColor( colors, colorValid, attrs, image->getPixelFormat() );
+                setColor( ptr, image->getPixelFormat(), image->getDataType(), color );
+            }
+        }
+    }
+}
+
+// Reductions of one component as in computeAverage() and friends: the
+// texels are combined in the same order and with the same float
+// operations, so that the results are the same to the bit.
+template <MipMapFunction F> struct Reduce;
+
+template <> struct Reduce<AVERAGE>
+{
+    static float init() { return 0; }
+    static float apply( float r, float v ) { return r + v; }
+    static float finish( float r, int n ) { return r / n; }
+};
+
+template <> struct Reduce<SUM>
+{
+    static float init() { return 0; }
+    static float apply( float r, float v ) { return r + v; }
+    static float finish( float r, int ) { return r; }
+};
+
+template <> struct Reduce<PRODUCT>
+{
+    static float init() { return 1; }
+    static float apply( float r, float v ) { return r * v; }
+    static float finish( float r, int ) { return r; }
+};
+
+template <> struct Reduce<MIN>
+{
+    static float init() { return std::numeric_limits<float>::max(); }
+    static float apply( float r, float v ) { return std::min( r, v ); }
+    static float finish( float r, int ) { return r; }
+};
+
+template <> struct Reduce<MAX>
+{
+    static float init() { return std::numeric_limits<float>::min(); }
+    static float apply( float r, float v ) { return std::max( r, v ); }
+    static float finish( float r, int ) { return r; }
+};
+
+// Converts back like setColor(), which truncates and lets sums above 1
+// wrap around
+inline unsigned char toByte( float v )
+{
+    return (unsigned char)(int)( v * 255.0f );
+}
+
+// N adjacent components of a row of the next level from one or two
+// rows of 8 bit texels with nc components: either one component, or
+// all of them (N == nc) when they use the same function.  The loops are
+// kept simple enough for the compiler to vectorize.
+template <MipMapFunction F, bool TwoColumns, bool TwoRows, int N>
+void reduceComponents( const unsigned char* row0, const unsigned char* row1,
+                       unsigned char* out, int ns, int nc )
+{
+    typedef Reduce<F> R;
+    const float scale = 1.0f / 255.0f;
+    const int n = ( TwoColumns ? 2 : 1 ) * ( TwoRows ? 2 : 1 );
+    const int stride = N > 1 ? N : nc;
+    for ( int x = 0; x < ns; ++x )
+    {
+        for ( int c = 0; c < N; ++c )
+        {
+            const int i = 2 * x * stride + c;
+            float v = R::apply( R::init(), row0[i] * scale );
+            if ( TwoRows )
+                v = R::apply( v, row1[i] * scale );
+            if ( TwoColumns )
+            {
+                v = R::apply( v, row0[i + stride] * scale );
+                if ( TwoRows )
+                    v = R::apply( v, row1[i + stride] * scale );
+            }
+            out[x * stride + c] = toByte( R::finish( v, n ) );
+        }
+    }
+}
+
+typedef void (*ComponentKernel)( const unsigned char*, const unsigned char*,
+                                 unsigned char*, int, int );
+
+template <bool TwoColumns, bool TwoRows, int N>
+ComponentKernel componentKernel( MipMapFunction f )
+{
+    switch ( f )
+    {
+    case AVERAGE: return &reduceComponents<AVERAGE, TwoColumns, TwoRows, N>;
+    case SUM: return &reduceComponents<SUM, TwoColumns, TwoRows, N>;
+    case PRODUCT: return &reduceComponents<PRODUCT, TwoColumns, TwoRows, N>;
+    case MIN: return &reduceComponents<MIN, TwoColumns, TwoRows, N>;
+    case MAX: return &reduceComponents<MAX, TwoColumns, TwoRows, N>;
+    default: break;
+    }
+    return 0;
+}
+
+template <int N>
+ComponentKernel componentKernel( MipMapFunction f, int s, int t )
+{
+    if ( s > 1 )
+        return t > 1 ? componentKernel<true, true, N>( f )
+                     : componentKernel<true, false, N>( f );
+    return t > 1 ? componentKernel<false, true, N>( f )
+                 : componentKernel<false, false, N>( f );
+}
+
+// Computes rows [y0, y1) of the next level of an 8 bit RGB(A) or BGR(A)
+// image.
+void reduceRowsFast( const osg::Image* image, MipMapTuple attrs,
+                     const unsigned char* src, unsigned char* dest,
+                     int s, int t, int y0, int y1 )
+{
+    GLenum format = image->getPixelFormat();
+    int nc = osg::Image::computeNumComponents( format );
+    int ns = s >> 1; if ( ns == 0 ) ns = 1;
+    int rowBytes = osg::Image::computeRowWidthInBytes( s, format, GL_UNSIGNED_BYTE, image->getPacking() );
+    int destRowBytes = osg::Image::computeRowWidthInBytes( ns, format, GL_UNSIGNED_BYTE, image->getPacking() );
+
+    // byte c of a texel holds component c, except that red and blue
+    // are swapped in BGR(A)
+    MipMapFunction functions[4] = { attrs.get<0>(), attrs.get<1>(), attrs.get<2>(), attrs.get<3>() };
+    if ( format == GL_BGR || format == GL_BGRA )
+        std::swap( functions[0], functions[2] );
+    ComponentKernel kernels[4];
+    int nkernels = nc;
+    if ( functions[0] == functions[1] && functions[0] == functions[2]
+         && ( nc == 3 || functions[0] == functions[3] ) )
+    {
+        kernels[0] = nc == 3 ? componentKernel<3>( functions[0], s, t )
+                             : componentKernel<4>( functions[0], s, t );
+        nkernels = 1;
+    }
+    else
+    {
+        for ( int c = 0; c < nc; ++c )
+            kernels[c] = componentKernel<1>( functions[c], s, t );
+    }
+
+    for ( int y = y0; y < y1; ++y )
+    {
+        const unsigned char* row0 = src + 2 * y * rowBytes;
+        const unsigned char* row1 = t > 1 ? row0 + rowBytes : 0;
+        unsigned char* out = dest + y * destRowBytes;
+        for ( int c = 0; c < nkernels; ++c )
+            kernels[c]( row0 + c, row1 ? row1 + c : 0, out + c, ns, nc );
+    }
+}
+
+// Computing one level of the chain from the previous one
+struct MipmapLevel
+{
+    MipmapLevel( const osg::Image* image, MipMapTuple attrs,
+                 unsigned char* src, unsigned char* dest, int s, int t, int r ) :
+        image( image ), attrs( attrs ), src( src ), dest( dest ),
+        s( s ), t( t ), r( r )
+    {}
+
+    int rows() const { return t > 1 ? t >> 1 : 1; }
+    int texels() const { return ( s > 1 ? s >> 1 : 1 ) * rows(); }
+
+    // The generic code writes past the end of the rows of levels of odd
+    // size, which are left to it to give the same result
+    bool fast() const
+    {
+        GLenum format = image->getPixelFormat();
+        return image->getDataType() == GL_UNSIGNED_BYTE
+            && ( format == GL_RGB || format == GL_RGBA
+              || format == GL_BGR || format == GL_BGRA )
+            && r == 1 && ( s == 1 || s % 2 == 0 ) && ( t == 1 || t % 2 == 0 );
+    }
+
+    void reduceRows( int y0, int y1, bool generic ) const
+    {
+        if ( !generic && fast() )
+            reduceRowsFast( image, attrs, src, dest, s, t, y0, y1 );
+        else
+            reduceRowsGeneric( image, attrs, src, dest, s, t, r, y0, y1 );
+    }
+
+    const osg::Image* image;
+    MipMapTuple attrs;
+    unsigned char* src;
+    unsigned char* dest;
+    int s, t, r;
+};
+
+// Computes a share of the rows of a level
+class ReduceThread : public SGThread
+{
+public:
+    ReduceThread( const MipmapLevel& level, int y0, int y1, bool generic ) :
+        _level( level ), _y0( y0 ), _y1( y1 ), _generic( generic )
+    {}
+
+    virtual ~ReduceThread() {}
+
+    virtual void run()
+    {
+        _level.reduceRows( _y0, _y1, _generic );
+    }
+
+private:
+    MipmapLevel _level;
+    int _y0, _y1;
+    bool _generic;
+};
+
+// Levels of at least this many texels are split by rows between threads.
+// Only the fast code writes nothing but its own rows.
+const int parallelMinTexels = 256 * 256;
+const int parallelMinRows = 16;
+
+void reduceLevel( const MipmapLevel& level, bool generic )
+{
+    int rows = level.rows();
+    int nthreads = 1;
+    if ( !generic && level.fast() && level.texels() >= parallelMinTexels )
+        nthreads = std::min( OpenThreads::GetNumberOfProcessors(),
+                             rows / parallelMinRows );
+
+    std::vector<ReduceThread*> threads;
+    int y0 = 0;
+    for ( int i = 1; i < nthreads; ++i )
+    {
+        int y1 = rows * i / nthreads;
+        ReduceThread* thread = new ReduceThread( level, y0, y1, generic );
+        if ( thread->start() )
+        {
+            threads.push_back( thread );
+        }
+        else
+        {
+            delete thread;
+            level.reduceRows( y0, y1, generic );
+        }
+        y0 = y1;
+    }
+    level.reduceRows( y0, rows, generic );
+
+    for ( size_t i = 0; i < threads.size(); ++i )
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+}
+
+} // anonymous namespace
+
+osg::Image* computeMipmap( osg::Image* image, MipMapTuple attrs, bool generic )
 {
     bool computeMipmap = false;
     unsigned int nbComponents = osg::Image::computeNumComponents( image->getPixelFormat() );
@@ -318,71 +650,8 @@ osg::Image* computeMipmap( osg::Image* image, MipMapTuple attrs )
             int nt = t >> 1; if ( nt == 0 ) nt = 1;
             int nr = r >> 1; if ( nr == 0 ) nr = 1;
 
-            for ( int k = 0; k < r; k += 2 )
-            {
-                for ( int j = 0; j < t; j += 2 )
-                {
-                    for ( int i = 0; i < s; i += 2 )
-                    {
-                        osg::Vec4 colors[2][2][2];
-                        bool colorValid[2][2][2];
-                        colorValid[0][0][0] = false; colorValid[0][0][1] = false; colorValid[0][1][0] = false; colorValid[0][1][1] = false;
-                        colorValid[1][0][0] = false; colorValid[1][0][1] = false; colorValid[1][1][0] = false; colorValid[1][1][1] = false;
-                        if ( true )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k );
-                            colors[0][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][0][0] = true;
-                        }
-                        if ( i + 1 < s )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k );
-                            colors[0][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][0][1] = true;
-                        }
-                        if ( j + 1 < t )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k );
-                            colors[0][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][1][0] = true;
-                        }
-                        if ( i + 1 < s && j + 1 < t )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k );
-                            colors[0][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][1][1] = true;
-                        }
-                        if ( k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k + 1 );
-                            colors[1][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][0][0] = true;
-                        }
-                        if ( i + 1 < s && k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k + 1 );
-                            colors[1][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][0][1] = true;
-                        }
-                        if ( j + 1 < t && k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k + 1 );
-                            colors[1][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][1][0] = true;
-                        }
-                        if ( i + 1 < s && j + 1 < t && k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k + 1 );
-                            colors[1][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][1][1] = true;
-                        }
-
-                        unsigned char *ptr = imageData( dest, image->getPixelFormat(), image->getDataType(), ns, nt, image->getPacking(), i/2, j/2, k/2 );
-                        osg::Vec4 color = computeColor( colors, colorValid, attrs, image->getPixelFormat() );
-                        setColor( ptr, image->getPixelFormat(), image->getDataType(), color );
-                    }
-                }
-            }
+            reduceLevel( MipmapLevel( image, attrs, src, dest, s, t, r ),
+                         generic );
             s = ns;
             t = nt;
             r = nr;
@@ -44,7 +44,10 @@ typedef boost::tuple<MipMapFunction, MipMapFunction, MipMapFunction, MipMapFunct
 
 MipMapTuple makeMipMapTuple(Effect* effect, const SGPropertyNode* props,
                       const SGReaderWriterOptions* options);
-osg::Image* computeMipmap( osg::Image* image, MipMapTuple attrs );
+// 8 bit RGB(A) and BGR(A) images are reduced by faster code with the
+// same results, unless generic is set
+osg::Image* computeMipmap( osg::Image* image, MipMapTuple attrs,
+                           bool generic = false );
 } }
 
 #endif
@@ -0,0 +1,125 @@
+#include <simgear/compiler.h>
+
+#include "mipmap.hxx"
+
+#include <simgear/timing/timestamp.hxx>
+#include <osg/Image>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace simgear::effect;
+
+#define VERIFY(a) \
+  if( !(a) ) \
+  { \
+    std::cerr << "failed: line " << __LINE__ << ": " << #a << std::endl; \
+    return 1; \
+  }
+
+// Random contents give sums above 1 and products of all sizes
+osg::Image* randomImage(int s, int t, GLenum format, int packing = 1)
+{
+  osg::Image* image = new osg::Image;
+  image->allocateImage(s, t, 1, format, GL_UNSIGNED_BYTE, packing);
+  unsigned char* data = image->data();
+  for(unsigned int i = 0; i < image->getTotalSizeInBytes(); ++i)
+    data[i] = rand() & 0xff;
+  return image;
+}
+
+// Compares the fast path with the generic per texel code, leaving out
+// the padding at the end of rows which neither of them writes
+bool sameMipmaps(osg::Image* image, MipMapTuple attrs)
+{
+  osg::ref_ptr<osg::Image> ref = image;
+  osg::ref_ptr<osg::Image> fast = computeMipmap(image, attrs);
+  osg::ref_ptr<osg::Image> generic = computeMipmap(image, attrs, true);
+  if( fast->getNumMipmapLevels() != generic->getNumMipmapLevels() )
+    return false;
+
+  GLenum format = image->getPixelFormat();
+  int s = image->s(), t = image->t();
+  for(unsigned int level = 0; level < fast->getNumMipmapLevels(); ++level)
+  {
+    unsigned int rowBytes = osg::Image::computeRowWidthInBytes
+      (s, format, GL_UNSIGNED_BYTE, image->getPacking());
+    unsigned int texelBytes = osg::Image::computeNumComponents(format) * s;
+    for(int y = 0; y < t; ++y)
+      if( memcmp(fast->getMipmapData(level) + y * rowBytes,
+                 generic->getMipmapData(level) + y * rowBytes,
+                 texelBytes) != 0 )
+        return false;
+    s = s > 1 ? s >> 1 : 1;
+    t = t > 1 ? t >> 1 : 1;
+  }
+  return true;
+}
+
+double mipmapMSec(osg::Image* image, MipMapTuple attrs, bool generic = false)
+{
+  osg::ref_ptr<osg::Image> ref = image;
+  SGTimeStamp start = SGTimeStamp::now();
+  osg::ref_ptr<osg::Image> mipmaps = computeMipmap(image, attrs, generic);
+  return (SGTimeStamp::now() - start).toMSecs();
+}
+
+int main(int argc, char* argv[])
+{
+  const MipMapFunction functions[] = { AVERAGE, SUM, PRODUCT, MIN, MAX };
+  for(int i = 0; i < 5; ++i)
+  {
+    MipMapFunction f = functions[i];
+    MipMapTuple attrs(f, f, f, f);
+    VERIFY( sameMipmaps(randomImage(256, 256, GL_RGBA), attrs) )
+    VERIFY( sameMipmaps(randomImage(256, 128, GL_RGB), attrs) )
+    VERIFY( sameMipmaps(randomImage(64, 256, GL_BGRA), attrs) )
+    VERIFY( sameMipmaps(randomImage(128, 128, GL_BGR), attrs) )
+  }
+
+  // a different function per component, swapped for BGR(A)
+  MipMapTuple mixed(AVERAGE, MAX, SUM, PRODUCT);
+  VERIFY( sameMipmaps(randomImage(128, 128, GL_RGBA), mixed) )
+  VERIFY( sameMipmaps(randomImage(128, 128, GL_BGRA), mixed) )
+  VERIFY( sameMipmaps(randomImage(128, 128, GL_RGB), mixed) )
+  VERIFY( sameMipmaps(randomImage(128, 128, GL_BGR), mixed) )
+
+  // single rows and columns, padded rows and odd sizes, the latter
+  // taking the generic path for some levels
+  VERIFY( sameMipmaps(randomImage(512, 1, GL_RGBA), mixed) )
+  VERIFY( sameMipmaps(randomImage(1, 512, GL_RGB), mixed) )
+  VERIFY( sameMipmaps(randomImage(256, 4, GL_RGB), mixed) )
+  VERIFY( sameMipmaps(randomImage(6, 64, GL_RGB, 4), mixed) )
+  VERIFY( sameMipmaps(randomImage(100, 60, GL_RGBA), mixed) )
+
+  // large enough to be split between threads, except for the levels of
+  // odd size, which have to give the same result as the generic code
+  VERIFY( sameMipmaps(randomImage(1024, 1024, GL_RGBA), mixed) )
+  VERIFY( sameMipmaps(randomImage(1023, 1024, GL_RGBA), mixed) )
+  VERIFY( sameMipmaps(randomImage(1024, 1535, GL_RGB), mixed) )
+
+  // Time of each level, from the times of whole chains
+  MipMapTuple average(AVERAGE, AVERAGE, AVERAGE, AVERAGE);
+  const int sizes[] = { 4096, 2048, 1024, 512, 256 };
+  double chain[5];
+  for(int i = 0; i < 5; ++i)
+    chain[i] = mipmapMSec(randomImage(sizes[i], sizes[i], GL_RGBA), average);
+  for(int i = 0; i < 4; ++i)
+  {
+    double msec = chain[i] - chain[i + 1];
+    std::cout << "RGBA level " << sizes[i] << ": " << msec << " msec, "
+              << sizes[i] / 1000.0 * sizes[i] / msec << " Mtexel/s"
+              << std::endl;
+  }
+
+  double generic = mipmapMSec(randomImage(4096, 4096, GL_RGBA), average,
+                              true);
+  double rgb = mipmapMSec(randomImage(4096, 4096, GL_RGB), mixed);
+  std::cout << "RGBA 4096 chain: " << chain[0] << " msec, "
+            << "generic " << generic << " msec" << std::endl;
+  std::cout << "RGB 4096 chain, mixed functions: " << rgb << " msec"
+            << std::endl;
+
+  return 0;
+}
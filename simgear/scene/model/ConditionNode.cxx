@@ -24,10 +24,30 @@
 #include <osgDB/Registry>
 #include <osgDB/Output>
 
+#include <simgear/scene/util/UpdateOnceCallback.hxx>
+
 namespace simgear
 {
 using namespace osg;
 
+namespace
+{
+// Adds the property listeners of a cached condition in the update thread
+struct ListenCallback : public UpdateOnceCallback
+{
+    ListenCallback(SGCachedCondition* condition)
+        : _condition(condition)
+    {
+    }
+    virtual void doUpdate(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        _condition->listen();
+        traverse(node, nv);
+    }
+    SGSharedPtr<SGCachedCondition> _condition;
+};
+}
+
 ConditionNode::ConditionNode()
 {
 }
@@ -41,6 +61,17 @@ ConditionNode::~ConditionNode()
 {
 }
 
+void ConditionNode::setCachedCondition(const SGCondition* condition)
+{
+    if (!condition || !condition->dependsOnPropertiesOnly()) {
+        _condition = condition;
+        return;
+    }
+    SGCachedCondition* cached = new SGCachedCondition(condition);
+    _condition = cached;
+    addUpdateCallback(new ListenCallback(cached));
+}
+
 void ConditionNode::traverse(NodeVisitor& nv)
 {
     if (nv.getTraversalMode() == NodeVisitor::TRAVERSE_ACTIVE_CHILDREN) {
@@ -26,6 +26,10 @@ namespace simgear
 /**
  * If the condition is true, traverse the first child; otherwise,
  * traverse the second if it exists.
+ *
+ * The condition is tested by every traversal, several per frame, so
+ * conditions read from properties are best set with
+ * setCachedCondition().
  */
 class ConditionNode : public osg::Group
 {
@@ -37,6 +41,13 @@ public:
     ~ConditionNode();
     const SGCondition* getCondition() const { return _condition.ptr(); }
     void setCondition(const SGCondition* condition) { _condition = condition; }
+    /**
+     * Set a condition, wrapped in an SGCachedCondition if it depends on
+     * nothing but properties. The cache starts listening to them in the
+     * first update traversal of the node, as models are loaded by
+     * another thread.
+     */
+    void setCachedCondition(const SGCondition* condition);
 
     virtual void traverse(osg::NodeVisitor& nv);
 protected:
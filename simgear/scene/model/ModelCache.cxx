@@ -0,0 +1,244 @@
+// Disk cache of loaded and optimized models
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include "ModelCache.hxx"
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <osg/Node>
+#include <osg/Version>
+#include <osg/ref_ptr>
+#include <osgDB/Options>
+#include <osgDB/ReaderWriter>
+#include <osgDB/Registry>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#endif
+
+namespace simgear
+{
+
+  namespace
+  {
+    // Bump when the way models are loaded or optimized changes
+    const unsigned int CACHE_VERSION = 1;
+
+    //--------------------------------------------------------------------------
+    // 64 bit FNV-1a
+    class Hash
+    {
+      public:
+        Hash():
+          _hash(14695981039346656037ULL)
+        {}
+
+        void add(const char* buf, size_t len)
+        {
+          for(size_t i = 0; i < len; ++i)
+            _hash = (_hash ^ static_cast<unsigned char>(buf[i]))
+                  * 1099511628211ULL;
+        }
+
+        unsigned long long value() const
+        {
+          return _hash;
+        }
+
+      private:
+        unsigned long long _hash;
+    };
+
+    //--------------------------------------------------------------------------
+    osgDB::ReaderWriter* getReaderWriter()
+    {
+      return osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  ModelCache::Stats::Stats():
+    hits(0),
+    misses(0),
+    stores(0),
+    hash_msec(0),
+    load_msec(0),
+    store_msec(0)
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  ModelCache::ModelCache(const SGPath& dir):
+    _dir(dir)
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  std::string ModelCache::entryName( const std::string& file,
+                                     const std::string& params )
+  {
+    SGTimeStamp st;
+    st.stamp();
+
+    std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+    if( !in )
+      return std::string();
+
+    Hash hash;
+    std::vector<char> buf(64 * 1024);
+    while( in )
+    {
+      in.read(&buf[0], buf.size());
+      hash.add(&buf[0], in.gcount());
+    }
+
+    // Textures are referenced relative to the model, so its path matters
+    std::ostringstream key;
+    key << '\n' << file
+        << '\n' << params
+        << '\n' << CACHE_VERSION << ' ' << osgGetVersion();
+    hash.add(key.str().data(), key.str().size());
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.osgb", hash.value());
+
+    SGGuard<SGMutex> lock(_mutex);
+    _stats.hash_msec += (SGTimeStamp::now() - st).toMSecs();
+    return name;
+  }
+
+  //----------------------------------------------------------------------------
+  osg::Node* ModelCache::load( const std::string& entry,
+                               const osgDB::Options* options )
+  {
+    SGTimeStamp st;
+    st.stamp();
+
+    SGPath path = entryPath(entry);
+    osg::Node* node = 0;
+    osgDB::ReaderWriter* rw = path.exists() ? getReaderWriter() : 0;
+    if( rw )
+    {
+      osgDB::ReaderWriter::ReadResult res = rw->readNode(path.str(), options);
+      if( res.validNode() )
+        node = res.takeNode();
+      else
+        SG_LOG(SG_IO, SG_INFO, "Invalid model cache entry " << path);
+    }
+
+    SGGuard<SGMutex> lock(_mutex);
+    if( node )
+      _stats.hits += 1;
+    else
+      _stats.misses += 1;
+    _stats.load_msec += (SGTimeStamp::now() - st).toMSecs();
+    return node;
+  }
+
+  //----------------------------------------------------------------------------
+  bool ModelCache::store(const std::string& entry, const osg::Node* node)
+  {
+    osgDB::ReaderWriter* rw = getReaderWriter();
+    if( !node || !rw )
+      return false;
+
+    SGTimeStamp st;
+    st.stamp();
+
+    simgear::Dir dir(_dir);
+    if( !dir.exists() && !dir.create(0755) )
+      return false;
+
+    // Write to a temporary file first, so that other threads and processes
+    // sharing the cache never see a partial entry.  The plugin picks the
+    // format by extension, so the temporary file keeps it.
+    SGPath path = entryPath(entry);
+    std::ostringstream tmp_name;
+    tmp_name << path.str() << "." << getpid()
+             << "." << SGThread::current() << ".tmp.osgb";
+    SGPath tmp(tmp_name.str());
+
+    osg::ref_ptr<osgDB::Options> options =
+      new osgDB::Options("WriteImageHint=UseExternal");
+    osgDB::ReaderWriter::WriteResult res =
+      rw->writeNode(*node, tmp.str(), options.get());
+
+    if( !res.success() || !tmp.rename(path) )
+    {
+      SG_LOG(SG_IO, SG_WARN, "Failed to write " << path);
+      tmp.remove();
+      return false;
+    }
+
+    SGGuard<SGMutex> lock(_mutex);
+    _stats.stores += 1;
+    _stats.store_msec += (SGTimeStamp::now() - st).toMSecs();
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void ModelCache::clear()
+  {
+    simgear::Dir dir(_dir);
+    if( !dir.exists() )
+      return;
+
+    simgear::PathList entries =
+      dir.children(simgear::Dir::TYPE_FILE, ".osgb");
+    for(size_t i = 0; i < entries.size(); ++i)
+      entries[i].remove();
+  }
+
+  //----------------------------------------------------------------------------
+  ModelCache::Stats ModelCache::stats() const
+  {
+    SGGuard<SGMutex> lock(_mutex);
+    return _stats;
+  }
+
+  //----------------------------------------------------------------------------
+  void ModelCache::resetStats()
+  {
+    SGGuard<SGMutex> lock(_mutex);
+    _stats = Stats();
+  }
+
+  //----------------------------------------------------------------------------
+  SGPath ModelCache::entryPath(const std::string& entry) const
+  {
+    SGPath path(_dir);
+    path.append(entry);
+    return path;
+  }
+
+} // namespace simgear
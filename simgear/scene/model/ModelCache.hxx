@@ -0,0 +1,109 @@
+///@file
+/// Disk cache of loaded and optimized models
+///
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_MODEL_CACHE_HXX_
+#define SG_MODEL_CACHE_HXX_
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+#include <simgear/threads/SGThread.hxx>
+
+#include <string>
+
+namespace osg { class Node; }
+namespace osgDB { class Options; }
+
+namespace simgear
+{
+
+  /**
+   * Keeps models as the ModelRegistry callbacks leave them after loading
+   * and optimizing in a directory, as OpenSceneGraph binary (.osgb) files,
+   * so that later runs read them directly instead of loading and
+   * optimizing the source again.  Entries are named after a hash of the
+   * contents and path of the source file, of the loading and optimizer
+   * parameters and of the OpenSceneGraph version, so edited sources and
+   * upgrades simply miss.
+   *
+   * Texture images are not stored in the entries, but referenced by file
+   * name, so they are still shared and looked up through the registry.
+   * Entries are written to a temporary file first, so that several
+   * threads and processes can share a cache directory.
+   */
+  class ModelCache:
+    public SGReferenced
+  {
+    public:
+      struct Stats
+      {
+        Stats();
+
+        unsigned int hits;      ///< models loaded from the cache
+        unsigned int misses;    ///< models not (or no longer) cached
+        unsigned int stores;    ///< models added to the cache
+        double hash_msec;       ///< time spent naming entries
+        double load_msec;       ///< time spent loading entries
+        double store_msec;      ///< time spent writing entries
+      };
+
+      /**
+       * @param dir   Cache directory, created on first use
+       */
+      explicit ModelCache(const SGPath& dir);
+
+      /**
+       * Name of the entry for a model file loaded with the given
+       * parameters, or an empty string if the file can't be read.
+       */
+      std::string entryName( const std::string& file,
+                             const std::string& params );
+
+      /**
+       * Load an entry, or return NULL if it is missing or can't be read.
+       *
+       * @param options Options for reading the textures of the model
+       */
+      osg::Node* load( const std::string& entry,
+                       const osgDB::Options* options = 0 );
+
+      /**
+       * Add a model to the cache.
+       */
+      bool store(const std::string& entry, const osg::Node* node);
+
+      /**
+       * Remove all entries from the cache directory.
+       */
+      void clear();
+
+      Stats stats() const;
+      void resetStats();
+
+    protected:
+      SGPath _dir;
+      Stats _stats;
+      mutable SGMutex _mutex;
+
+      SGPath entryPath(const std::string& entry) const;
+  };
+
+  typedef SGSharedPtr<ModelCache> ModelCachePtr;
+
+} // namespace simgear
+
+#endif /* SG_MODEL_CACHE_HXX_ */
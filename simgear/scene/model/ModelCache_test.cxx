@@ -0,0 +1,131 @@
+#include <simgear/compiler.h>
+
+#include "ModelCache.hxx"
+#include "ModelRegistry.hxx"
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/scene/util/SGReaderWriterOptions.hxx>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Group>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace simgear;
+
+#define VERIFY(a) \
+  if( !(a) ) \
+  { \
+    std::cerr << "failed: line " << __LINE__ << ": " << #a << std::endl; \
+    return 1; \
+  }
+
+osg::Node* makeModel()
+{
+  osg::Vec3Array* vertices = new osg::Vec3Array;
+  vertices->push_back(osg::Vec3(0, 0, 0));
+  vertices->push_back(osg::Vec3(1, 0, 0));
+  vertices->push_back(osg::Vec3(0, 1, 0));
+  osg::Geometry* geom = new osg::Geometry;
+  geom->setVertexArray(vertices);
+  geom->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 3));
+  osg::Geode* geode = new osg::Geode;
+  geode->setName("triangle");
+  geode->addDrawable(geom);
+  osg::Group* group = new osg::Group;
+  group->addChild(geode);
+  return group;
+}
+
+void writeFile(const SGPath& path, const std::string& contents)
+{
+  std::ofstream out(path.c_str(), std::ios::out | std::ios::binary);
+  out << contents;
+}
+
+typedef ModelRegistryCallback<DefaultProcessPolicy, NoCachePolicy,
+                              OptimizeModelPolicy,
+                              NoSubstitutePolicy, NoBuildBVHPolicy,
+                              ModelDiskCachePolicy>
+TestCallback;
+
+int main(int argc, char* argv[])
+{
+  SGPath dir = simgear::Dir::tempDir("model_cache").path();
+  SGPath source(dir);
+  source.append("source.obj");
+  writeFile(source, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+
+  SGPath cacheDir(dir);
+  cacheDir.append("cache");
+  ModelCachePtr cache = new ModelCache(cacheDir);
+
+  // Entries are named after the contents of the source and the parameters
+  std::string entry = cache->entryName(source.str(), "params");
+  VERIFY( !entry.empty() );
+  VERIFY( entry == cache->entryName(source.str(), "params") );
+  VERIFY( entry != cache->entryName(source.str(), "other params") );
+  SGPath missing(dir);
+  missing.append("missing.obj");
+  VERIFY( cache->entryName(missing.str(), "params").empty() );
+
+  VERIFY( !cache->load(entry) );
+  osg::ref_ptr<osg::Node> model = makeModel();
+  VERIFY( cache->store(entry, model.get()) );
+
+  osg::ref_ptr<osg::Node> loaded = cache->load(entry);
+  VERIFY( loaded.valid() );
+  osg::Group* group = loaded->asGroup();
+  VERIFY( group && group->getNumChildren() == 1 );
+  osg::Geode* geode = group->getChild(0)->asGeode();
+  VERIFY( geode && geode->getName() == "triangle" );
+  VERIFY( geode->getNumDrawables() == 1 );
+  osg::Geometry* geom = geode->getDrawable(0)->asGeometry();
+  VERIFY( geom && geom->getVertexArray()->getNumElements() == 3 );
+
+  ModelCache::Stats stats = cache->stats();
+  VERIFY( stats.hits == 1 && stats.misses == 1 && stats.stores == 1 );
+
+  // Edited sources miss
+  writeFile(source, "v 0 0 0\nv 2 0 0\nv 0 2 0\nf 1 2 3\n");
+  std::string edited = cache->entryName(source.str(), "params");
+  VERIFY( edited != entry );
+  VERIFY( !cache->load(edited) );
+
+  cache->clear();
+  VERIFY( !cache->load(entry) );
+  cache->resetStats();
+
+  // The registry callbacks read models optimized before from the cache,
+  // and keep load statistics per model
+  osg::ref_ptr<SGReaderWriterOptions> options = new SGReaderWriterOptions;
+  options->setModelCache(cache.get());
+  osg::ref_ptr<TestCallback> callback = new TestCallback("obj");
+  resetModelLoadStats();
+  for(int i = 0; i < 2; ++i)
+  {
+    osgDB::ReaderWriter::ReadResult res =
+      callback->readNode(source.str(), options.get());
+    VERIFY( res.validNode() );
+  }
+  stats = cache->stats();
+  VERIFY( stats.stores == 1 && stats.hits == 1 );
+
+  ModelLoadStatsMap loadStats = getModelLoadStats();
+  VERIFY( loadStats.size() == 1 );
+  const ModelLoadStats& modelStats = loadStats.begin()->second;
+  VERIFY( modelStats.loads == 2 && modelStats.diskCacheHits == 1 );
+  std::cout << loadStats.begin()->first << ": "
+            << modelStats.totalMsec << " msec total, "
+            << modelStats.readMsec << " reading, "
+            << modelStats.optimizeMsec << " optimizing, "
+            << modelStats.diskCacheMsec << " in the cache ("
+            << stats.hash_msec << " hashing, "
+            << stats.load_msec << " loading, "
+            << stats.store_msec << " storing)" << std::endl;
+
+  cache->clear();
+  return 0;
+}
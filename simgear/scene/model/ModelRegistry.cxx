@@ -24,9 +24,11 @@
 #include "ModelRegistry.hxx"
 
 #include <algorithm>
+#include <sstream>
 #include <utility>
 #include <vector>
 
+#include <OpenThreads/Mutex>
 #include <OpenThreads/ScopedLock>
 
 #include <osg/ref_ptr>
@@ -56,6 +58,7 @@
 #include <simgear/props/condition.hxx>
 
 #include "BoundingVolumeBuildVisitor.hxx"
+#include "ModelCache.hxx"
 #include "model.hxx"
 
 using namespace std;
@@ -168,8 +171,55 @@ public:
   }
 };
 
+OpenThreads::Mutex modelLoadStatsMutex;
+ModelLoadStatsMap modelLoadStats;
+
+ModelCache* getModelCache(const Options* opt)
+{
+    const SGReaderWriterOptions* sgopt
+        = dynamic_cast<const SGReaderWriterOptions*>(opt);
+    return sgopt ? sgopt->getModelCache() : 0;
+}
+
 } // namespace
 
+ModelLoadStats::ModelLoadStats() :
+    loads(0), diskCacheHits(0), readMsec(0), optimizeMsec(0),
+    diskCacheMsec(0), bvhMsec(0), totalMsec(0)
+{
+}
+
+ModelLoadStats& ModelLoadStats::operator+=(const ModelLoadStats& rhs)
+{
+    loads += rhs.loads;
+    diskCacheHits += rhs.diskCacheHits;
+    readMsec += rhs.readMsec;
+    optimizeMsec += rhs.optimizeMsec;
+    diskCacheMsec += rhs.diskCacheMsec;
+    bvhMsec += rhs.bvhMsec;
+    totalMsec += rhs.totalMsec;
+    return *this;
+}
+
+void simgear::addModelLoadStats(const string& fileName,
+                                const ModelLoadStats& stats)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(modelLoadStatsMutex);
+    modelLoadStats[fileName] += stats;
+}
+
+ModelLoadStatsMap simgear::getModelLoadStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(modelLoadStatsMutex);
+    return modelLoadStats;
+}
+
+void simgear::resetModelLoadStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(modelLoadStatsMutex);
+    modelLoadStats.clear();
+}
+
 Node* DefaultProcessPolicy::process(Node* node, const string& filename,
                                     const Options* opt)
 {
@@ -331,12 +381,57 @@ osg::Node* OptimizeModelPolicy::optimize(osg::Node* node,
     // STATIC so that textures will be globally shared.
     SGTexDataVarianceVisitor dataVarianceVisitor;
     node->accept(dataVarianceVisitor);
+    return node;
+}
 
+osg::Node* OptimizeModelPolicy::finish(osg::Node* node,
+                                       const string& fileName,
+                                       const osgDB::Options* opt)
+{
     SGTexCompressionVisitor texComp;
     node->accept(texComp);
     return node;
 }
 
+string OptimizeModelPolicy::getCacheParams() const
+{
+    std::ostringstream params;
+    params << "optimizer " << _osgOptions;
+    return params.str();
+}
+
+string ModelDiskCachePolicy::entryName(const string& fileName,
+                                       const string& params,
+                                       const Options* opt)
+{
+    ModelCache* cache = getModelCache(opt);
+    if (!cache)
+        return string();
+    // Native files load about as fast as the cache would
+    string ext = getLowerCaseFileExtension(fileName);
+    if (ext == "osg" || ext == "osgb" || ext == "osgt" || ext == "ive")
+        return string();
+    string absFileName = SGModelLib::findDataFile(fileName, opt);
+    if (absFileName.empty())
+        return string();
+    return cache->entryName(absFileName,
+                            params + '\n' + opt->getOptionString());
+}
+
+osg::Node* ModelDiskCachePolicy::load(const string& entry, const Options* opt)
+{
+    ModelCache* cache = getModelCache(opt);
+    return cache ? cache->load(entry, opt) : 0;
+}
+
+void ModelDiskCachePolicy::store(const string& entry, osg::Node* node,
+                                 const Options* opt)
+{
+    ModelCache* cache = getModelCache(opt);
+    if (cache)
+        cache->store(entry, node);
+}
+
 string OSGSubstitutePolicy::substitute(const string& name,
                                        const Options* opt)
 {
@@ -453,11 +548,18 @@ struct ACOptimizePolicy : public OptimizeModelPolicy {
                 && group->getNumChildren() == 1)
                 optimized = static_cast<Node*>(group->getChild(0));
         }
+        return optimized.release();
+    }
+    Node* finish(Node* node, const string& fileName,
+                 const Options* opt)
+    {
+        ref_ptr<Node> finished
+            = OptimizeModelPolicy::finish(node, fileName, opt);
         const SGReaderWriterOptions* sgopt
             = dynamic_cast<const SGReaderWriterOptions*>(opt);
         if (sgopt && sgopt->getInstantiateEffects())
-            optimized = instantiateEffects(optimized.get(), sgopt);
-        return optimized.release();
+            finished = instantiateEffects(finished.get(), sgopt);
+        return finished.release();
     }
 };
 
@@ -486,7 +588,8 @@ struct ACProcessPolicy {
 
 typedef ModelRegistryCallback<ACProcessPolicy, DefaultCachePolicy,
                               ACOptimizePolicy,
-                              OSGSubstitutePolicy, BuildLeafBVHPolicy>
+                              OSGSubstitutePolicy, BuildLeafBVHPolicy,
+                              ModelDiskCachePolicy>
 ACCallback;
 
 namespace
@@ -28,6 +28,7 @@
 
 #include <simgear/compiler.h>
 #include <simgear/scene/util/OsgSingleton.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include <string>
 #include <map>
@@ -55,17 +56,50 @@ namespace simgear
 // the optimized version to the cache ourselves, replacing the
 // original subgraph.
 //
+// Processing and optimizing a model is slow enough that models can
+// also be kept in a disk cache, which holds them as optimized, before
+// the optimize policy finishes them for the options of a particular
+// load.
+//
 // To support all these options with a minimum of duplication, the
 // readNode function is specified as a template with a bunch of
 // pluggable (and predefined) policies.
+
+// Time spent loading a model file, to find the models that dominate
+// loading times.
+struct ModelLoadStats {
+    ModelLoadStats();
+    ModelLoadStats& operator+=(const ModelLoadStats& rhs);
+    unsigned loads;             // loads missing the object cache
+    unsigned diskCacheHits;     // loads from the disk cache
+    double readMsec;            // reading and processing the file
+    double optimizeMsec;        // optimizing and finishing the model
+    double diskCacheMsec;       // looking up and storing in the disk cache
+    double bvhMsec;             // building the bounding volume tree
+    double totalMsec;
+};
+
+typedef std::map<std::string, ModelLoadStats> ModelLoadStatsMap;
+
+// Add the times of a load to the statistics of a model file
+void addModelLoadStats(const std::string& fileName,
+                       const ModelLoadStats& stats);
+// Statistics of all model files loaded since the last reset
+ModelLoadStatsMap getModelLoadStats();
+void resetModelLoadStats();
+
+struct NoDiskCachePolicy;
+
 template <typename ProcessPolicy, typename CachePolicy, typename OptimizePolicy,
-          typename SubstitutePolicy, typename BVHPolicy>
+          typename SubstitutePolicy, typename BVHPolicy,
+          typename DiskCachePolicy = NoDiskCachePolicy>
 class ModelRegistryCallback : public osgDB::Registry::ReadFileCallback {
 public:
     ModelRegistryCallback(const std::string& extension) :
         _processPolicy(extension), _cachePolicy(extension),
         _optimizePolicy(extension),
-        _substitutePolicy(extension), _bvhPolicy(extension)
+        _substitutePolicy(extension), _bvhPolicy(extension),
+        _diskCachePolicy(extension)
     {
     }
     virtual osgDB::ReaderWriter::ReadResult
@@ -78,6 +112,9 @@ public:
 //        Registry* registry = Registry::instance();
         ref_ptr<osg::Node> optimizedNode = _cachePolicy.find(fileName, opt);
         if (!optimizedNode.valid()) {
+            ModelLoadStats stats;
+            SGTimeStamp start = SGTimeStamp::now();
+            SGTimeStamp step = start;
             std::string otherFileName = _substitutePolicy.substitute(fileName,
                                                                      opt);
             ReaderWriter::ReadResult res;
@@ -85,19 +122,43 @@ public:
                 res = loadUsingReaderWriter(otherFileName, opt);
                 if (res.validNode())
                     optimizedNode = res.getNode();
+                stats.readMsec += elapsedMsec(step);
             }
             if (!optimizedNode.valid()) {
-                res = loadUsingReaderWriter(fileName, opt);
-                if (!res.validNode())
-                    return res;
-                ref_ptr<osg::Node> processedNode
-                    = _processPolicy.process(res.getNode(), fileName, opt);
-                optimizedNode = _optimizePolicy.optimize(processedNode.get(),
-                                                         fileName, opt);
+                std::string entry = _diskCachePolicy.entryName(
+                    fileName, _optimizePolicy.getCacheParams(), opt);
+                if (!entry.empty())
+                    optimizedNode = _diskCachePolicy.load(entry, opt);
+                stats.diskCacheMsec += elapsedMsec(step);
+                if (optimizedNode.valid()) {
+                    stats.diskCacheHits = 1;
+                } else {
+                    res = loadUsingReaderWriter(fileName, opt);
+                    if (!res.validNode())
+                        return res;
+                    ref_ptr<osg::Node> processedNode
+                        = _processPolicy.process(res.getNode(), fileName, opt);
+                    stats.readMsec += elapsedMsec(step);
+                    optimizedNode
+                        = _optimizePolicy.optimize(processedNode.get(),
+                                                   fileName, opt);
+                    stats.optimizeMsec += elapsedMsec(step);
+                    if (!entry.empty())
+                        _diskCachePolicy.store(entry, optimizedNode.get(),
+                                               opt);
+                    stats.diskCacheMsec += elapsedMsec(step);
+                }
+                optimizedNode = _optimizePolicy.finish(optimizedNode.get(),
+                                                       fileName, opt);
+                stats.optimizeMsec += elapsedMsec(step);
             }
             if (opt->getPluginStringData("SimGear::BOUNDINGVOLUMES") != "OFF")
                 _bvhPolicy.buildBVH(fileName, optimizedNode.get());
+            stats.bvhMsec += elapsedMsec(step);
             _cachePolicy.addToCache(fileName, optimizedNode.get());
+            stats.loads = 1;
+            stats.totalMsec = (SGTimeStamp::now() - start).toMSecs();
+            addModelLoadStats(fileName, stats);
         }
         return ReaderWriter::ReadResult(optimizedNode.get());
     }
@@ -113,12 +174,21 @@ protected:
             return ReaderWriter::ReadResult(); // FILE_NOT_HANDLED
         return rw->readNode(fileName, opt);
     }
+    // Time since the last step, starting the next one
+    static double elapsedMsec(SGTimeStamp& step)
+    {
+        SGTimeStamp now = SGTimeStamp::now();
+        double msec = (now - step).toMSecs();
+        step = now;
+        return msec;
+    }
     
     ProcessPolicy _processPolicy;
     CachePolicy _cachePolicy;
     OptimizePolicy _optimizePolicy;
     SubstitutePolicy _substitutePolicy;
     BVHPolicy _bvhPolicy;
+    DiskCachePolicy _diskCachePolicy;
     virtual ~ModelRegistryCallback() {}
 };
 
@@ -147,11 +217,18 @@ struct NoCachePolicy {
     void addToCache(const std::string& filename, osg::Node* node) {}
 };
 
+// optimize() leaves a model as it can be kept in the disk cache, and
+// finish() applies what depends on the options of a load or on the
+// scene features, like texture compression.
 class OptimizeModelPolicy {
 public:
     OptimizeModelPolicy(const std::string& extension);
     osg::Node* optimize(osg::Node* node, const std::string& fileName,
                         const osgDB::Options* opt);
+    osg::Node* finish(osg::Node* node, const std::string& fileName,
+                      const osgDB::Options* opt);
+    // Parameters of optimize(), part of the disk cache key
+    std::string getCacheParams() const;
 protected:
     unsigned _osgOptions;
 };
@@ -163,6 +240,15 @@ struct NoOptimizePolicy {
     {
         return node;
     }
+    osg::Node* finish(osg::Node* node, const std::string& fileName,
+                      const osgDB::Options* opt)
+    {
+        return node;
+    }
+    std::string getCacheParams() const
+    {
+        return std::string();
+    }
 };
 
 struct OSGSubstitutePolicy {
@@ -195,9 +281,38 @@ struct NoBuildBVHPolicy {
     void buildBVH(const std::string& fileName, osg::Node* node);
 };
 
+struct NoDiskCachePolicy {
+    NoDiskCachePolicy(const std::string& extension) {}
+    std::string entryName(const std::string& fileName,
+                          const std::string& params,
+                          const osgDB::Options* opt)
+    {
+        return std::string();
+    }
+    osg::Node* load(const std::string& entry, const osgDB::Options* opt)
+    {
+        return 0;
+    }
+    void store(const std::string& entry, osg::Node* node,
+               const osgDB::Options* opt) {}
+};
+
+// Keeps optimized models in the ModelCache of the SGReaderWriterOptions
+// of a load, if any.
+struct ModelDiskCachePolicy {
+    ModelDiskCachePolicy(const std::string& extension) {}
+    std::string entryName(const std::string& fileName,
+                          const std::string& params,
+                          const osgDB::Options* opt);
+    osg::Node* load(const std::string& entry, const osgDB::Options* opt);
+    void store(const std::string& entry, osg::Node* node,
+               const osgDB::Options* opt);
+};
+
 typedef ModelRegistryCallback<DefaultProcessPolicy, DefaultCachePolicy,
                               OptimizeModelPolicy,
-                              OSGSubstitutePolicy, BuildLeafBVHPolicy>
+                              OSGSubstitutePolicy, BuildLeafBVHPolicy,
+                              ModelDiskCachePolicy>
 DefaultCallback;
 
 // The manager for the callbacks
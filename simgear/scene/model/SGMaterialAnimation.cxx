@@ -563,7 +563,7 @@ SGMaterialAnimation::createAnimationGroup(osg::Group& parent)
   }
   if (getCondition()) {
     ConditionNode* cn = new ConditionNode;
-    cn->setCondition(getCondition());
+    cn->setCachedCondition(getCondition());
     osg::Group* modelGroup = new osg::Group;
     group->addChild(modelGroup);
     cn->addChild(group);
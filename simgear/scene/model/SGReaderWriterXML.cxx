@@ -538,7 +538,9 @@ sgLoad3DModel_internal(const SGPath& path,
                              options.get(), path.str(), i);
     }
     
-    if (!needTransform && group->getNumChildren() < 2) {
+    // The group also holds the callback computing the animation values
+    if (!needTransform && group->getNumChildren() < 2
+        && !group->getUpdateCallback()) {
         model = group->getChild(0);
         group->removeChild(model.get());
         if (data.valid())
@@ -24,6 +24,7 @@
 #include <osg/LOD>
 #include <osg/Math>
 #include <osg/Object>
+#include <osg/observer_ptr>
 #include <osg/StateSet>
 #include <osg/Switch>
 #include <osg/TexMat>
@@ -46,6 +47,7 @@
 #include <simgear/scene/util/SGSceneUserData.hxx>
 #include <simgear/scene/util/SGStateAttributeVisitor.hxx>
 #include <simgear/scene/util/StateAttributeFactory.hxx>
+#include <simgear/structure/SGExpressionProgram.hxx>
 
 #include "vg/vgu.h"
 
@@ -207,6 +209,192 @@ read_value(const SGPropertyNode* configNode, SGPropertyNode* modelRoot,
   return 0;
 }
 
+////////////////////////////////////////////////////////////////////////
+// Compiled animation values
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Computes the values of the animations applied to a node with a single
+ * SGExpressionProgram, which reads each property once and skips animations
+ * whose properties did not change, and hands the changed values to the
+ * animated nodes before the update traversal reaches them.  Animations
+ * with a condition keep callbacks of their own.
+ */
+class SGAnimation::ProgramCallback : public osg::NodeCallback {
+public:
+  /// Sets the values of one animation on the animated node
+  class Output : public SGReferenced {
+  public:
+    virtual ~Output() { }
+    virtual void set(osg::Node& node, const double* values) const = 0;
+  };
+
+  ProgramCallback() :
+    _program(new SGExpressionProgram),
+    _resolved(true)
+  {
+    setName("SGAnimation::ProgramCallback");
+  }
+  ProgramCallback(const ProgramCallback& rhs, const osg::CopyOp& copyOp) :
+    osg::NodeCallback(rhs, copyOp),
+    _program(new SGExpressionProgram),
+    _resolved(false)
+  {
+    // A copy of a model gets its own program state, and finds the copies
+    // of the animated nodes by their position below its root.  Nodes which
+    // are gone or no longer below the root are dropped, a copy of a copy
+    // which was never run keeps the positions it got.
+    for (unsigned i = 0; i < rhs._program->getNumExpressions(); ++i)
+      _program->addExpression(rhs._program->getExpression(i));
+    for (size_t i = 0; i < rhs._targets.size(); ++i) {
+      Target target = rhs._targets[i];
+      if (target.node.valid()) {
+        if (!rhs.findPath(*target.node.get(), target.path))
+          continue;
+      } else if (rhs._resolved) {
+        continue;
+      }
+      target.node = 0;
+      _targets.push_back(target);
+    }
+  }
+  META_Object(simgear, ProgramCallback);
+
+  static ProgramCallback* get(osg::Node& root)
+  {
+    osg::NodeCallback* callback = root.getUpdateCallback();
+    for (; callback; callback = callback->getNestedCallback()) {
+      ProgramCallback* program = dynamic_cast<ProgramCallback*>(callback);
+      if (program)
+        return program;
+    }
+    ProgramCallback* program = new ProgramCallback;
+    program->_root = &root;
+    root.addUpdateCallback(program);
+    return program;
+  }
+
+  void addOutput(osg::Node* node, const Output* output,
+                 const SGExpressiond* value0,
+                 const SGExpressiond* value1 = 0,
+                 const SGExpressiond* value2 = 0)
+  {
+    const SGExpressiond* values[3] = { value0, value1, value2 };
+    Target target;
+    target.node = node;
+    target.output = output;
+    target.numValues = 0;
+    for (; target.numValues < 3 && values[target.numValues];
+         ++target.numValues)
+      target.values[target.numValues]
+        = _program->addExpression(values[target.numValues]);
+    _targets.push_back(target);
+  }
+
+  virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+  {
+    if (!_resolved)
+      resolve(*node);
+
+    _program->update();
+    double values[3];
+    for (size_t i = 0; i < _targets.size(); ++i) {
+      const Target& target = _targets[i];
+      bool changed = false;
+      for (unsigned j = 0; j < target.numValues; ++j) {
+        values[j] = _program->getValue(target.values[j]);
+        changed = changed || _program->hasChanged(target.values[j]);
+      }
+      osg::Node* animated = target.node.get();
+      if (changed && animated)
+        target.output->set(*animated, values);
+    }
+    traverse(node, nv);
+  }
+
+private:
+  struct Target {
+    osg::observer_ptr<osg::Node> node;
+    std::vector<unsigned> path; ///< child indices below the root, for copies
+    SGSharedPtr<const Output> output;
+    unsigned values[3];
+    unsigned numValues;
+  };
+
+  SGExpressionProgramPtr _program;
+  std::vector<Target> _targets;
+  osg::observer_ptr<osg::Node> _root;
+  bool _resolved;
+
+  bool findPath(osg::Node& node, std::vector<unsigned>& path) const
+  {
+    osg::Node* root = _root.get();
+    if (!root)
+      return false;
+    osg::NodePathList nodePaths = node.getParentalNodePaths(root);
+    for (size_t i = 0; i < nodePaths.size(); ++i) {
+      const osg::NodePath& nodePath = nodePaths[i];
+      if (nodePath.empty() || nodePath.front() != root)
+        continue;
+      path.clear();
+      for (size_t j = 0; j + 1 < nodePath.size(); ++j)
+        path.push_back(nodePath[j]->asGroup()->getChildIndex(nodePath[j + 1]));
+      return true;
+    }
+    return false;
+  }
+
+  void resolve(osg::Node& root)
+  {
+    _root = &root;
+    for (size_t i = 0; i < _targets.size(); ++i) {
+      Target& target = _targets[i];
+      if (target.node.valid())
+        continue;
+      osg::Node* node = &root;
+      for (size_t j = 0; node && j < target.path.size(); ++j) {
+        osg::Group* group = node->asGroup();
+        node = group && target.path[j] < group->getNumChildren()
+             ? group->getChild(target.path[j]) : 0;
+      }
+      if (!node)
+        SG_LOG(SG_GENERAL, SG_WARN, "Animated node not found in model copy");
+      target.node = node;
+    }
+    _resolved = true;
+  }
+};
+
+class TranslateOutput : public SGAnimation::ProgramCallback::Output {
+public:
+  virtual void set(osg::Node& node, const double* values) const
+  {
+    SGTranslateTransform* transform = dynamic_cast<SGTranslateTransform*>(&node);
+    if (transform)
+      transform->setValue(values[0]);
+  }
+};
+
+class RotateOutput : public SGAnimation::ProgramCallback::Output {
+public:
+  virtual void set(osg::Node& node, const double* values) const
+  {
+    SGRotateTransform* transform = dynamic_cast<SGRotateTransform*>(&node);
+    if (transform)
+      transform->setAngleDeg(values[0]);
+  }
+};
+
+class ScaleOutput : public SGAnimation::ProgramCallback::Output {
+public:
+  virtual void set(osg::Node& node, const double* values) const
+  {
+    SGScaleTransform* transform = dynamic_cast<SGScaleTransform*>(&node);
+    if (transform)
+      transform->setScaleFactor(SGVec3d(values[0], values[1], values[2]));
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////
 // Animation installer
 ////////////////////////////////////////////////////////////////////////
@@ -330,7 +518,8 @@ SGAnimation::SGAnimation(const SGPropertyNode* configNode,
   osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
   _found(false),
   _configNode(configNode),
-  _modelRoot(modelRoot)
+  _modelRoot(modelRoot),
+  _node(0)
 {
   _name = configNode->getStringValue("name", "");
   _enableHOT = configNode->getBoolValue("enable-hot", true);
@@ -446,6 +635,7 @@ SGAnimation::animate(osg::Node* node, const SGPropertyNode* configNode,
 void
 SGAnimation::apply(osg::Node* node)
 {
+  _node = node;
   // duh what a special case ...
   if (_objectNames.empty()) {
     osg::Group* group = node->asGroup();
@@ -467,6 +657,14 @@ SGAnimation::install(osg::Node& node)
     node.setNodeMask(~SG_NODEMASK_TERRAIN_BIT & node.getNodeMask());
 }
 
+SGAnimation::ProgramCallback*
+SGAnimation::getProgramCallback() const
+{
+  if (!_node)
+    return 0;
+  return ProgramCallback::get(*_node);
+}
+
 osg::Group*
 SGAnimation::createAnimationGroup(osg::Group& parent)
 {
@@ -728,8 +926,13 @@ SGTranslateAnimation::createAnimationGroup(osg::Group& parent)
   SGTranslateTransform* transform = new SGTranslateTransform;
   transform->setName("translate animation");
   if (_animationValue && !_animationValue->isConst()) {
-    UpdateCallback* uc = new UpdateCallback(_condition, _animationValue);
-    transform->setUpdateCallback(uc);
+    ProgramCallback* program = _condition ? 0 : getProgramCallback();
+    if (program) {
+      program->addOutput(transform, new TranslateOutput, _animationValue);
+    } else {
+      UpdateCallback* uc = new UpdateCallback(_condition, _animationValue);
+      transform->setUpdateCallback(uc);
+    }
   }
   transform->setAxis(_axis);
   transform->setValue(_initialValue);
@@ -966,6 +1169,17 @@ SGRotateAnimation::createAnimationGroup(osg::Group& parent)
         transform->setAngleDeg(_initialValue);
         parent.addChild(transform);
         return transform;
+    }
+    ProgramCallback* program = _condition ? 0 : getProgramCallback();
+    if (program) {
+        SGRotateTransform* transform = new SGRotateTransform;
+        transform->setName("rotate animation");
+        transform->setCenter(_center);
+        transform->setAxis(_axis);
+        transform->setAngleDeg(_initialValue);
+        program->addOutput(transform, new RotateOutput, _animationValue);
+        parent.addChild(transform);
+        return transform;
     } else {
         SGRotAnimTransform* transform = new SGRotAnimTransform;
         transform->setName("rotate animation");
@@ -1107,8 +1321,14 @@ SGScaleAnimation::createAnimationGroup(osg::Group& parent)
   transform->setName("scale animation");
   transform->setCenter(_center);
   transform->setScaleFactor(_initialValue);
-  UpdateCallback* uc = new UpdateCallback(_condition, _animationValue);
-  transform->setUpdateCallback(uc);
+  ProgramCallback* program = _condition ? 0 : getProgramCallback();
+  if (program) {
+    program->addOutput(transform, new ScaleOutput, _animationValue[0],
+                       _animationValue[1], _animationValue[2]);
+  } else {
+    UpdateCallback* uc = new UpdateCallback(_condition, _animationValue);
+    transform->setUpdateCallback(uc);
+  }
   parent.addChild(transform);
   return transform;
 }
@@ -1627,7 +1847,8 @@ SGSelectAnimation::createAnimationGroup(osg::Group& parent)
     return new osg::Group;
   simgear::ConditionNode* cn = new simgear::ConditionNode;
   cn->setName("select animation node");
-  cn->setCondition(condition.ptr());
+  // tested by every traversal, only evaluate it after its properties change
+  cn->setCachedCondition(condition);
   osg::Group* grp = new osg::Group;
   cn->addChild(grp);
   parent.addChild(cn);
@@ -1792,6 +2013,15 @@ public:
   SGSharedPtr<SGExpressiond const> _animationValue;
 };
 
+class SGBlendAnimation::BlendOutput : public ProgramCallback::Output {
+public:
+  virtual void set(osg::Node& node, const double* values) const
+  {
+    BlendVisitor visitor(1-values[0]);
+    node.accept(visitor);
+  }
+};
+
 
 SGBlendAnimation::SGBlendAnimation(const SGPropertyNode* configNode,
                                    SGPropertyNode* modelRoot)
@@ -1808,7 +2038,11 @@ SGBlendAnimation::createAnimationGroup(osg::Group& parent)
 
   osg::Group* group = new osg::Switch;
   group->setName("blend animation node");
-  group->setUpdateCallback(new UpdateCallback(getConfig(), _animationValue));
+  ProgramCallback* program = getProgramCallback();
+  if (program)
+    program->addOutput(group, new BlendOutput, _animationValue);
+  else
+    group->setUpdateCallback(new UpdateCallback(getConfig(), _animationValue));
   parent.addChild(group);
   return group;
 }
@@ -50,6 +50,12 @@ public:
                       const osgDB::Options* options,
                       const std::string &path, int i);
 
+  /**
+   * Update callback computing the values of all animations applied to a
+   * node in one pass.
+   */
+  class ProgramCallback;
+
 protected:
   void apply(osg::Node* node);
 
@@ -100,6 +106,13 @@ protected:
 
   const SGCondition* getCondition() const;
 
+  /**
+   * Callback on the node this animation is applied to (normally the root
+   * of a model), created on first use.  NULL if the animation is not being
+   * applied.
+   */
+  ProgramCallback* getProgramCallback() const;
+
   std::list<std::string> _objectNames;
 private:
   void installInGroup(const std::string& name, osg::Group& group,
@@ -116,6 +129,7 @@ private:
   std::string _name;
   SGSharedPtr<SGPropertyNode const> _configNode;
   SGPropertyNode* _modelRoot;
+  osg::Node* _node;
   
   std::list<osg::ref_ptr<osg::Node> > _installedAnimations;
   bool _enableHOT;
@@ -282,6 +296,7 @@ public:
   virtual void install(osg::Node& node);
 private:
   class BlendVisitor;
+  class BlendOutput;
   class UpdateCallback;
   SGSharedPtr<SGExpressiond> _animationValue;
 };
@@ -0,0 +1,231 @@
+// Packing of randomly placed objects fading out with distance
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include "FadeOutLevels.hxx"
+
+#include <vector>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+
+using namespace osg;
+
+namespace simgear
+{
+
+namespace
+{
+
+typedef std::vector<ref_ptr<Drawable> > DrawableList;
+
+// Distance up to which the objects of a level are drawn, the same as the
+// ranges of the LOD children of the unpacked objects
+float levelRange(float range, int levels, int level)
+{
+    if (levels < 2)
+        return 2.0f * range;
+    return range * (1.0f + level / (levels - 1.0f));
+}
+
+// The level of an object, as the unpacked objects choose their LOD child.
+// They take the remainder of the unsigned number of children, so negative
+// positions are converted to unsigned as well.
+int objectLevel(const Array* positions, unsigned index, int levels)
+{
+    float x = 0;
+    if (const Vec3Array* v3 = dynamic_cast<const Vec3Array*>(positions))
+        x = (*v3)[index].x();
+    else if (const Vec4Array* v4 = dynamic_cast<const Vec4Array*>(positions))
+        x = (*v4)[index].x();
+    return unsigned(int(x * 10.0f)) % unsigned(levels);
+}
+
+template<typename ArrayType>
+ArrayType* reorder( const ArrayType* array,
+                    const std::vector<unsigned>& order,
+                    unsigned verticesPerObject )
+{
+    ArrayType* result = new ArrayType;
+    result->reserve(array->size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        typename ArrayType::const_iterator begin
+            = array->begin() + order[i] * verticesPerObject;
+        result->insert(result->end(), begin, begin + verticesPerObject);
+    }
+    return result;
+}
+
+Array* reorderArray( const Array* array,
+                     const std::vector<unsigned>& order,
+                     unsigned verticesPerObject )
+{
+    if (const Vec3Array* v3 = dynamic_cast<const Vec3Array*>(array))
+        return reorder(v3, order, verticesPerObject);
+    if (const Vec4Array* v4 = dynamic_cast<const Vec4Array*>(array))
+        return reorder(v4, order, verticesPerObject);
+    return 0;
+}
+
+// Culls a drawable outside of a band of distances from the viewer,
+// measured from the center of its quadtree cell like an LOD does
+class DistanceBandCullCallback : public Drawable::CullCallback
+{
+public:
+    DistanceBandCullCallback(const Vec3& center = Vec3(),
+                             float minRange = 0, float maxRange = 0) :
+        _center(center), _minRange(minRange), _maxRange(maxRange)
+    {}
+    DistanceBandCullCallback(const DistanceBandCullCallback& rhs,
+                             const CopyOp& copyop) :
+        Drawable::CullCallback(rhs, copyop),
+        _center(rhs._center),
+        _minRange(rhs._minRange),
+        _maxRange(rhs._maxRange)
+    {}
+    META_Object(simgear, DistanceBandCullCallback);
+
+    virtual bool cull(NodeVisitor* nv, Drawable* drawable,
+                      RenderInfo* renderInfo) const
+    {
+        float distance = nv->getDistanceToViewPoint(_center, true);
+        return distance < _minRange || distance >= _maxRange;
+    }
+private:
+    Vec3 _center;
+    float _minRange;
+    float _maxRange;
+};
+
+// Replaces a geometry by its distance band drawables, returning false if
+// it is not laid out as expected
+bool packGeometry( Geometry* geom,
+                   const Vec3& center,
+                   unsigned verticesPerObject,
+                   float range,
+                   int levels,
+                   DrawableList& packed )
+{
+    const Array* positions = geom->getColorArray();
+    const Array* secondary = geom->getSecondaryColorArray();
+    if (!positions || positions->getNumElements() % verticesPerObject)
+        return false;
+    unsigned numObjects = positions->getNumElements() / verticesPerObject;
+    if (secondary && secondary->getNumElements() != positions->getNumElements())
+        return false;
+
+    Geometry::PrimitiveSetList primitives = geom->getPrimitiveSetList();
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        const DrawArrays* da = dynamic_cast<DrawArrays*>(primitives[i].get());
+        if (!da || da->getFirst() != 0)
+            return false;
+    }
+    if (numObjects == 0)
+        return true;
+
+    // Farthest level first, keeping the order of the objects within a level
+    std::vector<int> objectLevels(numObjects);
+    for (unsigned i = 0; i < numObjects; ++i)
+        objectLevels[i] = objectLevel(positions, i * verticesPerObject, levels);
+    std::vector<unsigned> order;
+    std::vector<unsigned> visible(levels); // objects drawn within a band
+    order.reserve(numObjects);
+    for (int level = levels - 1; level >= 0; --level) {
+        for (unsigned i = 0; i < numObjects; ++i)
+            if (objectLevels[i] == level)
+                order.push_back(i);
+        visible[level] = order.size();
+    }
+
+    ref_ptr<Array> sortedPositions
+        = reorderArray(positions, order, verticesPerObject);
+    ref_ptr<Array> sortedSecondary;
+    if (secondary)
+        sortedSecondary = reorderArray(secondary, order, verticesPerObject);
+    if (!sortedPositions || (secondary && !sortedSecondary))
+        return false;
+    geom->setColorArray(sortedPositions.get(), Array::BIND_PER_VERTEX);
+    if (secondary)
+        geom->setSecondaryColorArray(sortedSecondary.get(),
+                                     Array::BIND_PER_VERTEX);
+
+    for (int band = 0; band < levels && visible[band] > 0; ++band) {
+        Geometry* bandGeom = band == 0
+                           ? geom
+                           : new Geometry(*geom, CopyOp::SHALLOW_COPY);
+        bandGeom->removePrimitiveSet(0, bandGeom->getNumPrimitiveSets());
+        for (size_t i = 0; i < primitives.size(); ++i)
+            bandGeom->addPrimitiveSet(
+                new DrawArrays(primitives[i]->getMode(), 0,
+                               visible[band] * verticesPerObject));
+        bandGeom->setCullCallback(
+            new DistanceBandCullCallback(
+                center,
+                band == 0 ? 0.0f : levelRange(range, levels, band - 1),
+                levelRange(range, levels, band)));
+        bandGeom->dirtyBound();
+        packed.push_back(bandGeom);
+    }
+    return true;
+}
+
+class PackVisitor : public NodeVisitor
+{
+public:
+    PackVisitor(unsigned verticesPerObject, float range, int levels) :
+        NodeVisitor(NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _verticesPerObject(verticesPerObject),
+        _range(range),
+        _levels(levels)
+    {}
+    virtual void apply(Geode& geode)
+    {
+        Vec3 center = geode.getBound().center();
+        DrawableList packed;
+        for (unsigned i = 0; i < geode.getNumDrawables(); ++i) {
+            Drawable* drawable = geode.getDrawable(i);
+            Geometry* geom = drawable->asGeometry();
+            if (!geom
+                || !packGeometry(geom, center, _verticesPerObject, _range,
+                                 _levels, packed))
+                packed.push_back(drawable);
+        }
+        geode.removeDrawables(0, geode.getNumDrawables());
+        for (size_t i = 0; i < packed.size(); ++i)
+            geode.addDrawable(packed[i].get());
+    }
+private:
+    unsigned _verticesPerObject;
+    float _range;
+    int _levels;
+};
+
+}
+
+void packFadeOutLevels( Node* node,
+                        unsigned verticesPerObject,
+                        float range,
+                        int levels )
+{
+    PackVisitor visitor(verticesPerObject, range, levels);
+    node->accept(visitor);
+}
+
+}
@@ -0,0 +1,55 @@
+// Packing of randomly placed objects fading out with distance
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_FADE_OUT_LEVELS_HXX
+#define SG_FADE_OUT_LEVELS_HXX 1
+
+#include <osg/Node>
+
+namespace simgear
+{
+
+/**
+ * Random trees and buildings thin out gradually with distance: each object
+ * belongs to one of a number of fade out levels, chosen by its position,
+ * and is only drawn up to the range of its level.  Instead of a geode per
+ * level below the LOD of each quadtree cell, this packs all levels of a
+ * cell into a single geode.
+ *
+ * The objects of each geometry below \a node are sorted by level, farthest
+ * first, so that the objects visible at any distance are a prefix of its
+ * arrays.  The geometry is then replaced by one drawable per distance band
+ * between two level ranges, each sharing the sorted arrays, drawing the
+ * prefix visible in its band and culled outside of it.  Whatever the
+ * distance, a cell takes a single draw of a single drawable per geometry.
+ *
+ * The per object data has to be in the color array, with the position in
+ * its first three components, and optionally the secondary color array,
+ * both with \a verticesPerObject entries per object.  The vertex and other
+ * arrays are assumed to be shared templates, and the primitive sets to be
+ * DrawArrays covering all objects.  Other geometries are left as they are.
+ *
+ * @param range   Range of the first level; the last one is twice as far.
+ * @param levels  Number of fade out levels.
+ */
+void packFadeOutLevels( osg::Node* node,
+                        unsigned verticesPerObject,
+                        float range,
+                        int levels );
+
+}
+
+#endif
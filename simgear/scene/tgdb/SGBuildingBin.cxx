@@ -52,7 +52,9 @@
 #include <simgear/scene/material/EffectGeode.hxx>
 #include <simgear/scene/model/model.hxx>
 #include <simgear/props/props.hxx>
+#include <simgear/scene/util/SGReaderWriterOptions.hxx>
 
+#include "FadeOutLevels.hxx"
 #include "ShaderGeometry.hxx"
 #include "SGBuildingBin.hxx"
 
@@ -747,6 +749,14 @@ BuildingBoundingBoxCallback::computeBound(const Drawable& drawable) const
           iter->second = effect; // update existing, but empty observer
     }
 
+    bool packed = false;
+    if (options) {
+      SGPropertyNode* propertyNode = options->getPropertyNode().get();
+      if (propertyNode)
+        packed = propertyNode->getBoolValue("/sim/rendering/random-buildings-packed",
+                                            packed);
+    }
+
     ref_ptr<Group> group = new osg::Group();
 
     // Now, create a quadbuilding for the buildings.
@@ -761,7 +771,7 @@ BuildingBoundingBoxCallback::computeBound(const Drawable& drawable) const
       BuildingGeometryQuadtree
           quadbuilding(GetBuildingCoord(), AddBuildingLeafObject(),
                    SG_BUILDING_QUAD_TREE_DEPTH,
-                   MakeBuildingLeaf(buildingRange, effect, (i != 2)));
+                   MakeBuildingLeaf(buildingRange, effect, (i != 2), packed));
 
       // Transform building positions from the "geocentric" positions we
       // get from the scenery polys into the local Z-up coordinate
@@ -772,6 +782,9 @@ BuildingBoundingBoxCallback::computeBound(const Drawable& drawable) const
                      std::back_inserter(rotatedBuildings),
                      BuildingInstanceTransformer(transInv));
       quadbuilding.buildQuadTree(rotatedBuildings.begin(), rotatedBuildings.end());
+      if (packed && (i != 2))
+        packFadeOutLevels(quadbuilding.getRoot(), VERTICES_PER_BUILDING,
+                          buildingRange, SG_BUILDING_FADE_OUT_LEVELS);
 
       for (size_t j = 0; j < quadbuilding.getRoot()->getNumChildren(); ++j)
               group->addChild(quadbuilding.getRoot()->getChild(j));
@@ -194,18 +194,19 @@ public:
   // Helper classes for creating the quad tree
   struct MakeBuildingLeaf
   {
-      MakeBuildingLeaf(float range, Effect* effect, bool fade) :
-          _range(range), _effect(effect), _fade_out(fade) {}
+      MakeBuildingLeaf(float range, Effect* effect, bool fade, bool packed) :
+          _range(range), _effect(effect), _fade_out(fade), _packed(packed) {}
 
       MakeBuildingLeaf(const MakeBuildingLeaf& rhs) :
-          _range(rhs._range), _effect(rhs._effect), _fade_out(rhs._fade_out)
+          _range(rhs._range), _effect(rhs._effect), _fade_out(rhs._fade_out),
+          _packed(rhs._packed)
       {}
 
       LOD* operator() () const
       {
           LOD* result = new LOD;
 
-          if (_fade_out) {
+          if (_fade_out && !_packed) {
               // Create a series of LOD nodes so buidling cover decreases
               // gradually with distance from _range to 2*_range
               for (float i = 0.0; i < SG_BUILDING_FADE_OUT_LEVELS; i++)
@@ -215,7 +216,9 @@ public:
                   result->addChild(geode, 0, _range * (1.0 + i / (SG_BUILDING_FADE_OUT_LEVELS - 1.0)));
               }
           } else {
-              // No fade-out, so all are visible for 2X range
+              // No fade-out, so all are visible for 2X range.  Packed
+              // buildings are split into the fade out levels by
+              // packFadeOutLevels() once all of them are added.
               EffectGeode* geode = new EffectGeode;
               geode->setEffect(_effect.get());
               result->addChild(geode, 0, 2.0 * _range);
@@ -226,6 +229,7 @@ public:
       float _range;
       ref_ptr<Effect> _effect;
       bool _fade_out;
+      bool _packed;
   };
 
   struct AddBuildingLeafObject
@@ -52,6 +52,7 @@
 #include <simgear/scene/util/SGReaderWriterOptions.hxx>
 #include <simgear/structure/OSGUtils.hxx>
 
+#include "FadeOutLevels.hxx"
 #include "ShaderGeometry.hxx"
 #include "TreeBin.hxx"
 
@@ -65,6 +66,7 @@ namespace simgear
 
 bool use_tree_shadows;
 bool use_tree_normals;
+bool use_packed_trees;
 
 // Tree instance scheme:
 // vertex - local position of quad vertex.
@@ -242,20 +244,29 @@ namespace
 struct MakeTreesLeaf
 {
     MakeTreesLeaf(float range, int varieties, float width, float height, 
-        Effect* effect) :
+        Effect* effect, bool packed) :
         _range(range),  _varieties(varieties),
-        _width(width), _height(height), _effect(effect) {}
+        _width(width), _height(height), _effect(effect), _packed(packed) {}
 
     MakeTreesLeaf(const MakeTreesLeaf& rhs) :
         _range(rhs._range),
         _varieties(rhs._varieties), _width(rhs._width), _height(rhs._height), 
-        _effect(rhs._effect)
+        _effect(rhs._effect), _packed(rhs._packed)
     {}
 
     LOD* operator() () const
     {
         LOD* result = new LOD;
 
+        if (_packed) {
+            // A single geode, split into the fade out levels by
+            // packFadeOutLevels() once all trees are added.
+            EffectGeode* geode = createTreeGeode(_width, _height, _varieties);
+            geode->setEffect(_effect.get());
+            result->addChild(geode, 0, 2.0 * _range);
+            return result;
+        }
+
         // Create a series of LOD nodes so trees cover decreases slightly
         // gradually with distance from _range to 2*_range
         for (float i = 0.0; i < SG_TREE_FADE_OUT_LEVELS; i++)
@@ -271,6 +282,7 @@ struct MakeTreesLeaf
     float _width;
     float _height;
     ref_ptr<Effect> _effect;
+    bool _packed;
 };
 
 struct AddTreesLeafObject
@@ -359,6 +371,7 @@ osg::Group* createForest(SGTreeBinList& forestList, const osg::Matrix& transform
      
     use_tree_shadows = false;
     use_tree_normals = false;
+    use_packed_trees = false;
     if (options) {
         SGPropertyNode* propertyNode = options->getPropertyNode().get();
         if (propertyNode) {
@@ -368,6 +381,9 @@ osg::Group* createForest(SGTreeBinList& forestList, const osg::Matrix& transform
            use_tree_normals
                 = propertyNode->getBoolValue("/sim/rendering/random-vegetation-normals",
                                              use_tree_normals);
+           use_packed_trees
+                = propertyNode->getBoolValue("/sim/rendering/random-vegetation-packed",
+                                             use_packed_trees);
 		}	
 	}
 
@@ -398,7 +414,8 @@ osg::Group* createForest(SGTreeBinList& forestList, const osg::Matrix& transform
             quadtree(GetTreeCoord(), AddTreesLeafObject(),
                      SG_TREE_QUAD_TREE_DEPTH,
                      MakeTreesLeaf(forest->range, forest->texture_varieties,
-                                   forest->width, forest->height, effect));
+                                   forest->width, forest->height, effect,
+                                   use_packed_trees));
         // Transform tree positions from the "geocentric" positions we
         // get from the scenery polys into the local Z-up coordinate
         // system.
@@ -409,6 +426,9 @@ osg::Group* createForest(SGTreeBinList& forestList, const osg::Matrix& transform
                        TreeTransformer(transInv));
         quadtree.buildQuadTree(rotatedTrees.begin(), rotatedTrees.end());
         group = quadtree.getRoot();
+        if (use_packed_trees)
+            packFadeOutLevels(group.get(), 4, forest->range,
+                              SG_TREE_FADE_OUT_LEVELS);
 
         for (size_t i = 0; i < group->getNumChildren(); ++i)
             mt->addChild(group->getChild(i));
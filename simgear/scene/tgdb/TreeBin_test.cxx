@@ -0,0 +1,300 @@
+#include <simgear/compiler.h>
+
+#include <simgear/math/sg_random.h>
+#include <simgear/props/props.hxx>
+#include <simgear/scene/util/SGReaderWriterOptions.hxx>
+
+#include "TreeBin.hxx"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/LOD>
+#include <osg/NodeVisitor>
+#include <osg/Viewport>
+#include <osgUtil/CullVisitor>
+#include <osgUtil/RenderStage>
+#include <osgUtil/StateGraph>
+#include <osgUtil/Statistics>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace simgear;
+
+#define VERIFY(a) \
+  if( !(a) ) \
+  { \
+    std::cerr << "failed: line " << __LINE__ << ": " << #a << std::endl; \
+    return 1; \
+  }
+
+// A forest over a 10x10 km tile, in local coordinates
+const int numTrees = 20000;
+const float tileSize = 10000;
+const float treeRange = 2000;
+const int fadeOutLevels = 10;
+const int numViews = 16;
+
+// Trees are told apart by their position
+typedef std::pair<float, float> TreeKey;
+typedef std::set<TreeKey> TreeSet;
+typedef std::map<TreeKey, osg::Vec3> CenterMap;
+
+SGTreeBinList makeForest()
+{
+  mt seed;
+  mt_init(&seed, unsigned(42));
+  TreeBin* bin = new TreeBin;
+  bin->texture_varieties = 4;
+  bin->range = treeRange;
+  bin->height = 20;
+  bin->width = 10;
+  bin->texture = "Textures/Trees/test.png";
+  bin->teffect = "Effects/tree";
+  for (int i = 0; i < numTrees; ++i) {
+    SGVec3f pos((mt_rand(&seed) - 0.5) * tileSize,
+                (mt_rand(&seed) - 0.5) * tileSize,
+                0);
+    bin->insert(pos, SGVec3f(0, 0, 1));
+  }
+  SGTreeBinList forest;
+  forest.push_back(bin);
+  return forest;
+}
+
+// Counts nodes and drawables, and estimates the memory they take
+class StatsVisitor : public osg::NodeVisitor
+{
+public:
+  StatsVisitor() :
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+    nodes(0),
+    drawables(0),
+    trees(0),
+    bytes(0)
+  {}
+
+  virtual void apply(osg::Node& node)
+  {
+    ++nodes;
+    traverse(node);
+  }
+
+  virtual void apply(osg::Geode& geode)
+  {
+    ++nodes;
+    for (unsigned i = 0; i < geode.getNumDrawables(); ++i) {
+      ++drawables;
+      const osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+      if (!geom)
+        continue;
+      bytes += sizeof(osg::Geometry)
+             + geom->getNumPrimitiveSets() * sizeof(osg::DrawArrays);
+      // tree positions, 4 per tree
+      if (addArray(geom->getColorArray()))
+        trees += geom->getColorArray()->getNumElements() / 4;
+      addArray(geom->getVertexArray());
+      addArray(geom->getNormalArray());
+      addArray(geom->getSecondaryColorArray());
+      addArray(geom->getFogCoordArray());
+      addArray(geom->getTexCoordArray(0));
+    }
+  }
+
+  bool addArray(const osg::Array* array)
+  {
+    if (!array || !arrays.insert(array).second)
+      return false;
+    bytes += array->getTotalDataSize();
+    return true;
+  }
+
+  unsigned nodes;
+  unsigned drawables;
+  unsigned trees;
+  size_t bytes;
+  std::set<const osg::Array*> arrays;
+};
+
+// Finds the center of the quadtree cell of each tree, which its LOD
+// measures the distance from
+class CenterVisitor : public osg::NodeVisitor
+{
+public:
+  CenterVisitor() :
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+  {}
+
+  virtual void apply(osg::LOD& lod)
+  {
+    center = lod.getCenter();
+    traverse(lod);
+  }
+
+  virtual void apply(osg::Geode& geode)
+  {
+    for (unsigned i = 0; i < geode.getNumDrawables(); ++i) {
+      const osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+      const osg::Vec3Array* pos = geom
+        ? dynamic_cast<const osg::Vec3Array*>(geom->getColorArray()) : 0;
+      if (!pos)
+        continue;
+      for (unsigned v = 0; v < pos->size(); v += 4)
+        centers[TreeKey((*pos)[v].x(), (*pos)[v].y())] = center;
+    }
+  }
+
+  osg::Vec3 center;
+  CenterMap centers;
+};
+
+// Collects the trees drawn by the leaves of a state graph, which are the
+// first ones of the position array of each drawable
+void collectTrees(const osgUtil::StateGraph* graph, TreeSet& trees)
+{
+  for (osgUtil::StateGraph::LeafList::const_iterator
+         leaf = graph->_leaves.begin(); leaf != graph->_leaves.end(); ++leaf) {
+    const osg::Geometry* geom = (*leaf)->_drawable->asGeometry();
+    if (!geom || geom->getNumPrimitiveSets() == 0)
+      continue;
+    const osg::Vec3Array* pos =
+      dynamic_cast<const osg::Vec3Array*>(geom->getColorArray());
+    const osg::DrawArrays* da =
+      dynamic_cast<const osg::DrawArrays*>(geom->getPrimitiveSet(0));
+    if (!pos || !da)
+      continue;
+    for (GLint v = da->getFirst(); v < da->getFirst() + da->getCount(); v += 4)
+      trees.insert(TreeKey((*pos)[v].x(), (*pos)[v].y()));
+  }
+  for (osgUtil::StateGraph::ChildList::const_iterator
+         child = graph->_children.begin(); child != graph->_children.end();
+       ++child)
+    collectTrees(child->second.get(), trees);
+}
+
+osg::Vec3 viewPoint(int view)
+{
+  float offset = (view % 8 - 3.5) * tileSize / 10;
+  return osg::Vec3(offset, -offset, 50);
+}
+
+// Culls the forest looking around from a number of points on the ground,
+// returning the number of drawables drawn, and the trees drawn from each
+// point.  There is no frustum culling, so that only the fade out levels
+// decide which trees are drawn.
+unsigned cullForest(osg::Node* forest, std::vector<TreeSet>& trees)
+{
+  osg::ref_ptr<osgUtil::CullVisitor> cv = new osgUtil::CullVisitor;
+  osg::ref_ptr<osgUtil::StateGraph> graph = new osgUtil::StateGraph;
+  osg::ref_ptr<osgUtil::RenderStage> stage = new osgUtil::RenderStage;
+  osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0, 0, 1280, 1024);
+  osg::ref_ptr<osg::RefMatrix> projection =
+    new osg::RefMatrix(osg::Matrix::perspective(55, 1.25, 1, 40000));
+  cv->setCullingMode(osg::CullSettings::NO_CULLING);
+
+  unsigned drawn = 0;
+  trees.assign(numViews, TreeSet());
+  for (int view = 0; view < numViews; ++view) {
+    float heading = view * 2 * osg::PI / numViews;
+    osg::Vec3 eye = viewPoint(view);
+    osg::Vec3 dir(std::cos(heading), std::sin(heading), -0.1);
+    osg::ref_ptr<osg::RefMatrix> modelview =
+      new osg::RefMatrix(osg::Matrix::lookAt(eye, eye + dir,
+                                             osg::Vec3(0, 0, 1)));
+
+    cv->reset();
+    graph->clean();
+    stage->reset();
+    stage->setViewport(viewport.get());
+    cv->setStateGraph(graph.get());
+    cv->setRenderStage(stage.get());
+    cv->pushViewport(viewport.get());
+    cv->pushProjectionMatrix(projection.get());
+    cv->pushModelViewMatrix(modelview.get(), osg::Transform::ABSOLUTE_RF);
+    forest->accept(*cv);
+    cv->popModelViewMatrix();
+    cv->popProjectionMatrix();
+    cv->popViewport();
+
+    collectTrees(graph.get(), trees[view]);
+    osgUtil::Statistics stats;
+    stage->getStats(stats);
+    drawn += stats.numDrawables;
+  }
+  return drawn;
+}
+
+// The fade out level of a tree, as TreeBin chooses the LOD child
+int treeLevel(const TreeKey& tree)
+{
+  return unsigned(int(tree.first * 10.0f)) % unsigned(fadeOutLevels);
+}
+
+int main(int argc, char* argv[])
+{
+  SGPropertyNode_ptr root = new SGPropertyNode;
+  osg::ref_ptr<SGReaderWriterOptions> options = new SGReaderWriterOptions;
+  options->setPropertyNode(root);
+
+  unsigned nodes[2], drawn[2];
+  std::vector<TreeSet> trees[2];
+  CenterMap centers;
+  for (int packed = 0; packed < 2; ++packed) {
+    root->setBoolValue("/sim/rendering/random-vegetation-packed", packed);
+    SGTreeBinList forestList = makeForest();
+    osg::ref_ptr<osg::Group> forest =
+      createForest(forestList, osg::Matrix::identity(), options.get());
+
+    StatsVisitor stats;
+    forest->accept(stats);
+    drawn[packed] = cullForest(forest.get(), trees[packed]);
+    nodes[packed] = stats.nodes;
+    VERIFY( stats.trees == unsigned(numTrees) )
+    if (!packed) {
+      CenterVisitor cells;
+      forest->accept(cells);
+      centers.swap(cells.centers);
+      VERIFY( centers.size() == unsigned(numTrees) )
+    }
+
+    std::cout << (packed ? "packed:   " : "unpacked: ")
+              << stats.nodes << " nodes, "
+              << stats.drawables << " drawables, "
+              << stats.bytes / 1024 << " KiB, "
+              << double(drawn[packed]) / numViews << " drawables/cull"
+              << std::endl;
+  }
+
+  // The packed forest has a geode per cell instead of one per fade out
+  // level, and draws a single band of each cell
+  VERIFY( nodes[1] < nodes[0] )
+  VERIFY( drawn[1] < drawn[0] )
+
+  // Both draw the same trees, except for those at the range of their
+  // level: the packed cells measure the distance from a center a few
+  // meters off, as their bounds include the tree quads, which are
+  // assigned to the trees in a different order.
+  const float slack = 25;
+  for (int view = 0; view < numViews; ++view) {
+    VERIFY( !trees[0][view].empty() )
+    TreeSet differing;
+    std::set_symmetric_difference(trees[0][view].begin(),
+                                  trees[0][view].end(),
+                                  trees[1][view].begin(),
+                                  trees[1][view].end(),
+                                  std::inserter(differing, differing.end()));
+    for (TreeSet::const_iterator tree = differing.begin();
+         tree != differing.end(); ++tree) {
+      int level = treeLevel(*tree);
+      float range = treeRange * (1 + level / (fadeOutLevels - 1.0f));
+      float distance = (centers[*tree] - viewPoint(view)).length();
+      VERIFY( std::fabs(distance - range) < slack )
+    }
+  }
+  return 0;
+}
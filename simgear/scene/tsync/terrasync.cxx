@@ -63,6 +63,7 @@
 #include <simgear/props/props_io.hxx>
 #include <simgear/io/HTTPClient.hxx>
 #include <simgear/io/SVNRepository.hxx>
+#include <simgear/io/ObjectStore.hxx>
 #include <simgear/structure/exception.hxx>
 
 static const bool svn_built_in_available = true;
@@ -268,6 +269,7 @@ public:
    void   setCachePath(const SGPath& p)     {_persistentCachePath = p;}
    void   setCacheHits(unsigned int hits)   {_cache_hits = hits;}
    void   setUseBuiltin(bool built_in) { _use_built_in = built_in;}
+   void   setObjectStore(ObjectStore* store) { _objectStore = store;}
 
    volatile bool _active;
    volatile bool _running;
@@ -323,6 +325,7 @@ private:
    string _rsync_server;
    string _local_dir;
    SGPath _persistentCachePath;
+   ObjectStoreRef _objectStore;
 };
 
 SGTerraSync::SvnThread::SvnThread() :
@@ -652,6 +655,7 @@ void SGTerraSync::SvnThread::updateSyncSlot(SyncSlot &slot)
 
         slot.repository.reset(new SVNRepository(path, &_http));
         slot.repository->setBaseUrl(serverUrl + "/" + slot.currentItem._dir);
+        slot.repository->setObjectStore(_objectStore);
         slot.repository->update();
 
         slot.nextWarnTimeout = 20000;
@@ -911,6 +915,17 @@ void SGTerraSync::reinit()
         _svnThread->setUseSvn(_terraRoot->getBoolValue("use-svn",true));
         _svnThread->setExtSvnUtility(_terraRoot->getStringValue("ext-svn-utility","svn"));
 
+        // optional content-addressed store, shareable between installations
+        SGPath objectStorePath(_terraRoot->getStringValue("object-store-path",""));
+        if (objectStorePath.isNull()) {
+            _svnThread->setObjectStore(NULL);
+        } else {
+            ObjectStore* store = new ObjectStore(objectStorePath);
+            size_t maxMBytes = _terraRoot->getIntValue("object-store-max-mb", 0);
+            store->setMaxSize(maxMBytes * 1024 * 1024);
+            _svnThread->setObjectStore(store);
+        }
+
         if (_svnThread->start())
         {
             syncAirportsModels();
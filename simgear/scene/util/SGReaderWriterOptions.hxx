@@ -22,7 +22,9 @@
 
 #include <osgDB/Options>
 #include <simgear/scene/model/modellib.hxx>
+#include <simgear/scene/model/ModelCache.hxx>
 #include <simgear/scene/material/matlib.hxx>
+#include <simgear/scene/material/TextureCache.hxx>
 
 #include <simgear/props/props.hxx>
 
@@ -60,6 +62,8 @@ public:
         osgDB::Options(options, copyop),
         _propertyNode(options._propertyNode),
         _materialLib(options._materialLib),
+        _textureCache(options._textureCache),
+        _modelCache(options._modelCache),
         _load_panel(options._load_panel),
         _model_data(options._model_data),
         _instantiateEffects(options._instantiateEffects)
@@ -77,6 +81,16 @@ public:
     void setMaterialLib(SGMaterialLib* materialLib)
     { _materialLib = materialLib; }
 
+    TextureCache* getTextureCache() const
+    { return _textureCache.get(); }
+    void setTextureCache(TextureCache* textureCache)
+    { _textureCache = textureCache; }
+
+    ModelCache* getModelCache() const
+    { return _modelCache.get(); }
+    void setModelCache(ModelCache* modelCache)
+    { _modelCache = modelCache; }
+
     typedef osg::Node *(*panel_func)(SGPropertyNode *);
 
     panel_func getLoadPanel() const
@@ -103,6 +117,8 @@ protected:
 private:
     SGSharedPtr<SGPropertyNode> _propertyNode;
     SGSharedPtr<SGMaterialLib> _materialLib;
+    SGSharedPtr<TextureCache> _textureCache;
+    SGSharedPtr<ModelCache> _modelCache;
     osg::Node *(*_load_panel)(SGPropertyNode *);
     osg::ref_ptr<SGModelData> _model_data;
     bool _instantiateEffects;
@@ -32,6 +32,8 @@
 
 #include <osg/Image>
 
+#include <OpenThreads/ScopedLock>
+
 #include <simgear/debug/logstream.hxx>
 
 #include "Noise.hxx"
@@ -139,6 +141,7 @@ osg::Image* make3DNoiseImage(int texSize)
 
 osg::Texture3D* StateAttributeFactory::getNoiseTexture(int size)
 {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_noiseMutex);
     NoiseMap::iterator itr = _noises.find(size);
     if (itr != _noises.end())
         return itr->second.get();
@@ -87,6 +87,7 @@ protected:
     osg::ref_ptr<osg::Depth> _depthWritesDisabled;
     typedef std::map<int, osg::ref_ptr<osg::Texture3D> > NoiseMap;
     NoiseMap _noises;
+    OpenThreads::Mutex _noiseMutex;
 };
 }
 #endif
@@ -288,7 +288,36 @@ protected:
   { }
   SGNaryExpression(SGExpression<T>* expr0, SGExpression<T>* expr1)
   { addOperand(expr0); addOperand(expr1); }
-  
+
+  /**
+   * Combine all constant operands into a single one at the end, which is
+   * left out if it equals @a identity.  Only for operations where neither
+   * grouping nor order of the operands matter.
+   */
+  template<typename Op>
+  SGExpression<T>* foldConstants(Op op, const T* identity = 0)
+  {
+    std::vector<SGSharedPtr<SGExpression<T> > > operands;
+    bool found = false;
+    T value = T();
+    for (size_t i = 0; i < _expressions.size(); ++i) {
+      if (!_expressions[i]->isConst())
+        operands.push_back(_expressions[i]);
+      else if (found)
+        value = op(value, _expressions[i]->getValue());
+      else {
+        value = _expressions[i]->getValue();
+        found = true;
+      }
+    }
+    if (found && (!identity || value != *identity || operands.empty()))
+      operands.push_back(new SGConstExpression<T>(value));
+    _expressions.swap(operands);
+    if (_expressions.size() == 1)
+      return _expressions[0];
+    return this;
+  }
+
 private:
   std::vector<SGSharedPtr<SGExpression<T> > > _expressions;
 };
@@ -303,6 +332,8 @@ public:
   { }
   void setPropertyNode(const SGPropertyNode* prop)
   { _prop = prop; }
+  const SGPropertyNode* getPropertyNode() const
+  { return _prop; }
   virtual void eval(T& value, const simgear::expression::Binding*) const
   { doEval(value); }
   
@@ -561,7 +592,17 @@ public:
   {
     if (_scale == 1)
       return getOperand()->simplify();
-    return SGUnaryExpression<T>::simplify();
+    SGExpression<T>* expr = SGUnaryExpression<T>::simplify();
+    if (expr != this)
+      return expr;
+
+    // Nested scales are folded into one
+    SGScaleExpression* inner = dynamic_cast<SGScaleExpression*>(getOperand());
+    if (!inner)
+      return this;
+    _scale *= inner->getScale();
+    SGUnaryExpression<T>::setOperand(inner->getOperand());
+    return simplify();
   }
 
   using SGUnaryExpression<T>::getOperand;
@@ -588,7 +629,17 @@ public:
   {
     if (_bias == 0)
       return getOperand()->simplify();
-    return SGUnaryExpression<T>::simplify();
+    SGExpression<T>* expr = SGUnaryExpression<T>::simplify();
+    if (expr != this)
+      return expr;
+
+    // Nested biases are folded into one
+    SGBiasExpression* inner = dynamic_cast<SGBiasExpression*>(getOperand());
+    if (!inner)
+      return this;
+    _bias += inner->getBias();
+    SGUnaryExpression<T>::setOperand(inner->getOperand());
+    return simplify();
   }
 
   using SGUnaryExpression<T>::getOperand;
@@ -605,6 +656,9 @@ public:
     _interpTable(interpTable)
   { }
 
+  const SGInterpTable* getInterpTable() const
+  { return _interpTable; }
+
   virtual void eval(T& value, const simgear::expression::Binding* b) const
   {
     if (_interpTable)
@@ -718,6 +772,8 @@ public:
   { return _disabledValue; }
   void setDisabledValue(const T& disabledValue)
   { _disabledValue = disabledValue; }
+  const SGCondition* getCondition() const
+  { return _enable; }
 
   virtual void eval(T& value, const simgear::expression::Binding* b) const
   {
@@ -812,6 +868,14 @@ public:
     for (size_t i = 0; i < sz; ++i)
       value += getOperand(i)->getValue(b);
   }
+  virtual SGExpression<T>* simplify()
+  {
+    SGExpression<T>* expr = SGNaryExpression<T>::simplify();
+    if (expr != this)
+      return expr;
+    const T zero(0);
+    return SGNaryExpression<T>::foldConstants(std::plus<T>(), &zero);
+  }
   using SGNaryExpression<T>::getValue;
   using SGNaryExpression<T>::getOperand;
 };
@@ -850,6 +914,14 @@ public:
     for (size_t i = 0; i < sz; ++i)
       value *= getOperand(i)->getValue(b);
   }
+  virtual SGExpression<T>* simplify()
+  {
+    SGExpression<T>* expr = SGNaryExpression<T>::simplify();
+    if (expr != this)
+      return expr;
+    const T one(1);
+    return SGNaryExpression<T>::foldConstants(std::multiplies<T>(), &one);
+  }
   using SGNaryExpression<T>::getValue;
   using SGNaryExpression<T>::getOperand;
 };
@@ -872,7 +944,19 @@ public:
     for (size_t i = 1; i < sz; ++i)
       value = SGMisc<T>::min(value, getOperand(i)->getValue(b));
   }
+  virtual SGExpression<T>* simplify()
+  {
+    SGExpression<T>* expr = SGNaryExpression<T>::simplify();
+    if (expr != this)
+      return expr;
+    return SGNaryExpression<T>::foldConstants(Min());
+  }
   using SGNaryExpression<T>::getOperand;
+private:
+  struct Min {
+    T operator()(const T& a, const T& b) const
+    { return SGMisc<T>::min(a, b); }
+  };
 };
 
 template<typename T>
@@ -893,7 +977,19 @@ public:
     for (size_t i = 1; i < sz; ++i)
       value = SGMisc<T>::max(value, getOperand(i)->getValue(b));
   }
+  virtual SGExpression<T>* simplify()
+  {
+    SGExpression<T>* expr = SGNaryExpression<T>::simplify();
+    if (expr != this)
+      return expr;
+    return SGNaryExpression<T>::foldConstants(Max());
+  }
   using SGNaryExpression<T>::getOperand;
+private:
+  struct Max {
+    T operator()(const T& a, const T& b) const
+    { return SGMisc<T>::max(a, b); }
+  };
 };
 
 typedef SGExpression<int> SGExpressioni;
@@ -0,0 +1,437 @@
+// Evaluation of many expressions as one flat list of instructions
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include "SGExpressionProgram.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <typeinfo>
+
+namespace
+{
+  typedef SGExpression<double> Expr;
+
+  //----------------------------------------------------------------------------
+  // Only exact types are compiled, as derived classes may evaluate
+  // differently
+  template<class E>
+  const E* exactly(const Expr* expr)
+  {
+    return typeid(*expr) == typeid(E) ? static_cast<const E*>(expr) : 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Same as SGStepExpression
+  double step(double value, double step, double scroll)
+  {
+    if( step <= SGLimitsd::min() )
+      return value;
+
+    double modprop = floor(value / step) * step;
+    double remainder = value <= SGLimitsd::min() ? -fmod(value, step)
+                                                 : (step - fmod(value, step));
+    if( remainder > SGLimitsd::min() && remainder < scroll )
+      modprop += (scroll - remainder) / scroll * step;
+
+    return modprop;
+  }
+}
+
+//------------------------------------------------------------------------------
+SGExpressionProgram::Stats::Stats():
+  expressions(0),
+  instructions(0),
+  properties(0),
+  volatiles(0),
+  evaluated(0),
+  skipped(0)
+{
+
+}
+
+//------------------------------------------------------------------------------
+SGExpressionProgram::SGExpressionProgram():
+  _first_update(true)
+{
+
+}
+
+//------------------------------------------------------------------------------
+unsigned int
+SGExpressionProgram::addExpression(const SGExpression<double>* expression)
+{
+  std::map<const SGExpression<double>*, unsigned int>::iterator it =
+    _expression_index.find(expression);
+  if( it != _expression_index.end() )
+    return it->second;
+
+  Expression expr;
+  expr.expression = expression;
+  expr.begin = _instructions.size();
+  expr.inputs_begin = _inputs.size();
+  expr.is_volatile = false;
+  expr.changed = true;
+  expr.value = 0;
+
+  std::vector<unsigned int> inputs;
+  expr.result = compile(expression, inputs, expr.is_volatile);
+  expr.end = _instructions.size();
+
+  // Each property only needs to be checked once
+  std::sort(inputs.begin(), inputs.end());
+  inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+  _inputs.insert(_inputs.end(), inputs.begin(), inputs.end());
+  expr.inputs_end = _inputs.size();
+
+  _expressions.push_back(expr);
+  _expression_index[expression] = _expressions.size() - 1;
+  _first_update = true;
+
+  _stats.expressions = _expressions.size();
+  _stats.instructions = _instructions.size();
+  _stats.properties = _properties.size();
+  if( expr.is_volatile )
+    _stats.volatiles += 1;
+
+  return _expressions.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+void SGExpressionProgram::update()
+{
+  for(size_t i = 0; i < _properties.size(); ++i)
+  {
+    Property& prop = _properties[i];
+    double value = prop.node->getDoubleValue();
+    prop.changed = _first_update || value != _registers[prop.reg];
+    _registers[prop.reg] = value;
+  }
+
+  for(size_t i = 0; i < _expressions.size(); ++i)
+  {
+    Expression& expr = _expressions[i];
+
+    bool dirty = _first_update || expr.is_volatile;
+    for(unsigned int j = expr.inputs_begin; !dirty && j < expr.inputs_end; ++j)
+      dirty = _properties[_inputs[j]].changed;
+
+    if( !dirty )
+    {
+      expr.changed = false;
+      _stats.skipped += 1;
+      continue;
+    }
+
+    run(expr.begin, expr.end, &_registers[0], 0);
+    double value = _registers[expr.result];
+    expr.changed = _first_update || value != expr.value;
+    expr.value = value;
+    _stats.evaluated += 1;
+  }
+
+  _first_update = false;
+}
+
+//------------------------------------------------------------------------------
+double
+SGExpressionProgram::evaluate( unsigned int index,
+                               double* registers,
+                               const simgear::expression::Binding* b ) const
+{
+  const Expression& expr = _expressions[index];
+  std::copy(_registers.begin(), _registers.end(), registers);
+  for(unsigned int i = expr.inputs_begin; i < expr.inputs_end; ++i)
+  {
+    const Property& prop = _properties[_inputs[i]];
+    registers[prop.reg] = prop.node->getDoubleValue();
+  }
+  run(expr.begin, expr.end, registers, b);
+  return registers[expr.result];
+}
+
+//------------------------------------------------------------------------------
+unsigned int
+SGExpressionProgram::compile( const SGExpression<double>* expr,
+                              std::vector<unsigned int>& inputs,
+                              bool& is_volatile )
+{
+  if( expr->isConst() )
+    return addRegister(expr->getValue());
+
+  if( const SGCompiledExpression* e = exactly<SGCompiledExpression>(expr) )
+    return compile(e->getExpression(), inputs, is_volatile);
+
+  if( const SGPropertyExpression<double>* e =
+        exactly<SGPropertyExpression<double> >(expr) )
+  {
+    // An expression without a node keeps its (undefined) value, which is
+    // left to the expression itself
+    if( e->getPropertyNode() )
+    {
+      unsigned int index = addProperty(e->getPropertyNode());
+      inputs.push_back(index);
+      return _properties[index].reg;
+    }
+  }
+  else if( const SGUnaryExpression<double>* unary =
+             dynamic_cast<const SGUnaryExpression<double>*>(expr) )
+  {
+    OpCode op = EVAL;
+    double p0 = 0,
+           p1 = 0;
+    const void* ptr = 0;
+
+    if( exactly<SGAbsExpression<double> >(expr) )        op = ABS;
+    else if( exactly<SGACosExpression<double> >(expr) )  op = ACOS;
+    else if( exactly<SGASinExpression<double> >(expr) )  op = ASIN;
+    else if( exactly<SGATanExpression<double> >(expr) )  op = ATAN;
+    else if( exactly<SGCeilExpression<double> >(expr) )  op = CEIL;
+    else if( exactly<SGCosExpression<double> >(expr) )   op = COS;
+    else if( exactly<SGCoshExpression<double> >(expr) )  op = COSH;
+    else if( exactly<SGExpExpression<double> >(expr) )   op = EXP;
+    else if( exactly<SGFloorExpression<double> >(expr) ) op = FLOOR;
+    else if( exactly<SGLogExpression<double> >(expr) )   op = LOG;
+    else if( exactly<SGLog10Expression<double> >(expr) ) op = LOG10;
+    else if( exactly<SGSinExpression<double> >(expr) )   op = SIN;
+    else if( exactly<SGSinhExpression<double> >(expr) )  op = SINH;
+    else if( exactly<SGSqrExpression<double> >(expr) )   op = SQR;
+    else if( exactly<SGSqrtExpression<double> >(expr) )  op = SQRT;
+    else if( exactly<SGTanExpression<double> >(expr) )   op = TAN;
+    else if( exactly<SGTanhExpression<double> >(expr) )  op = TANH;
+    else if( const SGScaleExpression<double>* e =
+               exactly<SGScaleExpression<double> >(expr) )
+    {
+      op = SCALE;
+      p0 = e->getScale();
+    }
+    else if( const SGBiasExpression<double>* e =
+               exactly<SGBiasExpression<double> >(expr) )
+    {
+      op = BIAS;
+      p0 = e->getBias();
+    }
+    else if( const SGClipExpression<double>* e =
+               exactly<SGClipExpression<double> >(expr) )
+    {
+      op = CLIP;
+      p0 = e->getClipMin();
+      p1 = e->getClipMax();
+    }
+    else if( const SGStepExpression<double>* e =
+               exactly<SGStepExpression<double> >(expr) )
+    {
+      op = STEP;
+      p0 = e->getStep();
+      p1 = e->getScroll();
+    }
+    else if( const SGInterpTableExpression<double>* e =
+               exactly<SGInterpTableExpression<double> >(expr) )
+    {
+      if( (ptr = e->getInterpTable()) )
+        op = INTERP;
+    }
+    else if( const SGEnableExpression<double>* e =
+               exactly<SGEnableExpression<double> >(expr) )
+    {
+      if( (ptr = e->getCondition()) )
+      {
+        op = ENABLE;
+        p0 = e->getDisabledValue();
+        is_volatile = true;
+      }
+    }
+
+    if( op != EVAL )
+    {
+      unsigned int a = compile(unary->getOperand(), inputs, is_volatile);
+      return addInstruction(op, a, 0, p0, p1, ptr);
+    }
+  }
+  else if( const SGBinaryExpression<double>* binary =
+             dynamic_cast<const SGBinaryExpression<double>*>(expr) )
+  {
+    OpCode op = EVAL;
+    if( exactly<SGAtan2Expression<double> >(expr) )     op = ATAN2;
+    else if( exactly<SGDivExpression<double> >(expr) )  op = DIV;
+    else if( exactly<SGModExpression<double> >(expr) )  op = MOD;
+    else if( exactly<SGPowExpression<double> >(expr) )  op = POW;
+
+    if( op != EVAL )
+    {
+      unsigned int a = compile(binary->getOperand(0), inputs, is_volatile);
+      unsigned int b = compile(binary->getOperand(1), inputs, is_volatile);
+      return addInstruction(op, a, b);
+    }
+  }
+  else if( const SGNaryExpression<double>* nary =
+             dynamic_cast<const SGNaryExpression<double>*>(expr) )
+  {
+    OpCode op = EVAL;
+    if( exactly<SGSumExpression<double> >(expr) )             op = ADD;
+    else if( exactly<SGDifferenceExpression<double> >(expr) ) op = SUB;
+    else if( exactly<SGProductExpression<double> >(expr) )    op = MUL;
+    else if( exactly<SGMinExpression<double> >(expr) )        op = MIN;
+    else if( exactly<SGMaxExpression<double> >(expr) )        op = MAX;
+
+    // Without operands the expression is constant (and handled above)
+    if( op != EVAL && nary->getNumOperands() > 0 )
+    {
+      unsigned int a = compile(nary->getOperand(0), inputs, is_volatile);
+      for(size_t i = 1; i < nary->getNumOperands(); ++i)
+        a = addInstruction
+        (
+          op,
+          a,
+          compile(nary->getOperand(i), inputs, is_volatile)
+        );
+      return a;
+    }
+  }
+
+  // Anything else is evaluated as it is, without knowing what it depends on
+  is_volatile = true;
+  return addInstruction(EVAL, 0, 0, 0, 0, expr);
+}
+
+//------------------------------------------------------------------------------
+unsigned int SGExpressionProgram::addRegister(double value)
+{
+  _registers.push_back(value);
+  return _registers.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SGExpressionProgram::addInstruction( OpCode op,
+                                                  unsigned int a,
+                                                  unsigned int b,
+                                                  double p0,
+                                                  double p1,
+                                                  const void* ptr )
+{
+  Instruction instruction;
+  instruction.op = op;
+  instruction.dst = addRegister();
+  instruction.a = a;
+  instruction.b = b;
+  instruction.p0 = p0;
+  instruction.p1 = p1;
+  instruction.ptr = ptr;
+  _instructions.push_back(instruction);
+  return instruction.dst;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SGExpressionProgram::addProperty(const SGPropertyNode* node)
+{
+  std::map<const SGPropertyNode*, unsigned int>::iterator it =
+    _property_index.find(node);
+  if( it != _property_index.end() )
+    return it->second;
+
+  Property prop;
+  prop.node = node;
+  prop.reg = addRegister();
+  prop.changed = true;
+  _properties.push_back(prop);
+
+  _property_index[node] = _properties.size() - 1;
+  return _properties.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+void SGExpressionProgram::run( unsigned int begin,
+                               unsigned int end,
+                               double* r,
+                               const simgear::expression::Binding* b ) const
+{
+  for(unsigned int i = begin; i < end; ++i)
+  {
+    const Instruction& in = _instructions[i];
+    const double a = r[in.a];
+    double& dst = r[in.dst];
+
+    switch( in.op )
+    {
+      case EVAL:
+        dst = static_cast<const Expr*>(in.ptr)->getValue(b);
+        break;
+      case ABS:   dst = a <= 0 ? -a : a;                    break;
+      case ACOS:  dst = acos(SGMiscd::clip(a, -1, 1));      break;
+      case ASIN:  dst = asin(SGMiscd::clip(a, -1, 1));      break;
+      case ATAN:  dst = atan(a);                            break;
+      case CEIL:  dst = ceil(a);                            break;
+      case COS:   dst = cos(a);                             break;
+      case COSH:  dst = cosh(a);                            break;
+      case EXP:   dst = exp(a);                             break;
+      case FLOOR: dst = floor(a);                           break;
+      case LOG:   dst = log(a);                             break;
+      case LOG10: dst = log10(a);                           break;
+      case SIN:   dst = sin(a);                             break;
+      case SINH:  dst = sinh(a);                            break;
+      case SQR:   dst = a * a;                              break;
+      case SQRT:  dst = sqrt(a);                            break;
+      case TAN:   dst = tan(a);                             break;
+      case TANH:  dst = tanh(a);                            break;
+      case SCALE: dst = in.p0 * a;                          break;
+      case BIAS:  dst = in.p0 + a;                          break;
+      case CLIP:  dst = SGMiscd::clip(a, in.p0, in.p1);     break;
+      case STEP:  dst = step(a, in.p0, in.p1);              break;
+      case INTERP:
+        dst = static_cast<const SGInterpTable*>(in.ptr)->interpolate(a);
+        break;
+      case ENABLE:
+        dst = static_cast<const SGCondition*>(in.ptr)->test() ? a : in.p0;
+        break;
+      case ADD:   dst = a + r[in.b];                        break;
+      case SUB:   dst = a - r[in.b];                        break;
+      case MUL:   dst = a * r[in.b];                        break;
+      case DIV:   dst = a / r[in.b];                        break;
+      case MOD:   dst = fmod(a, r[in.b]);                   break;
+      case POW:   dst = pow(a, r[in.b]);                    break;
+      case ATAN2: dst = atan2(a, r[in.b]);                  break;
+      case MIN:   dst = SGMiscd::min(a, r[in.b]);           break;
+      case MAX:   dst = SGMiscd::max(a, r[in.b]);           break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+SGCompiledExpression::SGCompiledExpression(
+  const SGExpression<double>* expression
+):
+  _program(new SGExpressionProgram)
+{
+  _program->addExpression(expression);
+}
+
+//------------------------------------------------------------------------------
+void SGCompiledExpression::eval( double& value,
+                                 const simgear::expression::Binding* b ) const
+{
+  // Registers of small programs live on the stack
+  double registers[64];
+  if( _program->getNumRegisters() <= 64 )
+    value = _program->evaluate(0, registers, b);
+  else
+  {
+    std::vector<double> heap(_program->getNumRegisters());
+    value = _program->evaluate(0, &heap[0], b);
+  }
+}
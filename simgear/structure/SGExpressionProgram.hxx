@@ -0,0 +1,234 @@
+///@file
+/// Evaluation of many expressions as one flat list of instructions
+///
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_EXPRESSION_PROGRAM_HXX_
+#define SG_EXPRESSION_PROGRAM_HXX_
+
+#include "SGExpression.hxx"
+
+#include <map>
+#include <vector>
+
+/**
+ * Compiles a set of double valued expressions, like all the animations of a
+ * model, into a single array of instructions working on an array of
+ * registers, which update() runs in one pass instead of walking each
+ * expression tree through virtual calls.
+ *
+ * Each property is read once per update, however many expressions use it,
+ * and expressions are only evaluated again if one of their properties has
+ * changed since the previous update.  Constant subexpressions are computed
+ * once while compiling.  Expression types without an instruction of their
+ * own (and SGEnableExpression, whose condition may depend on anything) are
+ * still supported, but the expressions containing them are evaluated on
+ * every update.
+ */
+class SGExpressionProgram:
+  public SGReferenced
+{
+  public:
+    struct Stats
+    {
+      Stats();
+
+      unsigned int expressions;   ///< expressions added
+      unsigned int instructions;  ///< instructions of all expressions
+      unsigned int properties;    ///< distinct properties read per update
+      unsigned int volatiles;     ///< expressions evaluated on every update
+      unsigned long evaluated;    ///< expressions evaluated by update()
+      unsigned long skipped;      ///< expressions skipped by update()
+    };
+
+    SGExpressionProgram();
+
+    /**
+     * Add an expression to the program.  Adding the same expression again
+     * returns the index it already has.
+     *
+     * @return Index of the expression, for getValue() and hasChanged()
+     */
+    unsigned int addExpression(const SGExpression<double>* expression);
+
+    /**
+     * Read all properties and evaluate the expressions depending on any
+     * which have changed.  The first update evaluates all expressions.
+     */
+    void update();
+
+    /**
+     * Value of an expression as of the last update().
+     */
+    double getValue(unsigned int index) const
+    { return _expressions[index].value; }
+
+    /**
+     * Whether the last update() changed the value of an expression.  Always
+     * true after the first update.
+     */
+    bool hasChanged(unsigned int index) const
+    { return _expressions[index].changed; }
+
+    unsigned int getNumExpressions() const
+    { return _expressions.size(); }
+
+    const SGExpression<double>* getExpression(unsigned int index) const
+    { return _expressions[index].expression; }
+
+    /**
+     * Evaluate a single expression, reading its properties, without
+     * changing the state of the program, so that several threads can do so
+     * at the same time.
+     *
+     * @param registers   Space for getNumRegisters() values
+     */
+    double evaluate( unsigned int index,
+                     double* registers,
+                     const simgear::expression::Binding* binding = 0 ) const;
+
+    unsigned int getNumRegisters() const
+    { return _registers.size(); }
+
+    const Stats& getStats() const
+    { return _stats; }
+
+  protected:
+
+    enum OpCode
+    {
+      EVAL,         ///< evaluate an expression tree (ptr)
+      ABS,
+      ACOS,
+      ASIN,
+      ATAN,
+      CEIL,
+      COS,
+      COSH,
+      EXP,
+      FLOOR,
+      LOG,
+      LOG10,
+      SIN,
+      SINH,
+      SQR,
+      SQRT,
+      TAN,
+      TANH,
+      SCALE,        ///< a * p0
+      BIAS,         ///< a + p0
+      CLIP,         ///< a clipped to [p0, p1]
+      STEP,         ///< a stepped by p0, scrolling over p1
+      INTERP,       ///< table (ptr) at a
+      ENABLE,       ///< a if condition (ptr), else p0
+      ADD,
+      SUB,
+      MUL,
+      DIV,
+      MOD,
+      POW,
+      ATAN2,
+      MIN,
+      MAX
+    };
+
+    struct Instruction
+    {
+      OpCode op;
+      unsigned int dst, a, b;
+      double p0, p1;
+      const void* ptr;
+    };
+
+    struct Expression
+    {
+      SGSharedPtr<const SGExpression<double> > expression;
+      unsigned int begin, end;              ///< range of instructions
+      unsigned int inputs_begin, inputs_end;///< range of _inputs
+      unsigned int result;                  ///< register holding the value
+      bool is_volatile;
+      bool changed;
+      double value;
+    };
+
+    struct Property
+    {
+      SGConstPropertyNode_ptr node;
+      unsigned int reg;
+      bool changed;
+    };
+
+    std::vector<double> _registers;
+    std::vector<Property> _properties;
+    std::map<const SGPropertyNode*, unsigned int> _property_index;
+
+    std::vector<Instruction> _instructions;
+    std::vector<unsigned int> _inputs;      ///< indices into _properties
+    std::vector<Expression> _expressions;
+    std::map<const SGExpression<double>*, unsigned int> _expression_index;
+    bool _first_update;
+    Stats _stats;
+
+    unsigned int compile( const SGExpression<double>* expression,
+                          std::vector<unsigned int>& inputs,
+                          bool& is_volatile );
+    unsigned int addRegister(double value = 0);
+    unsigned int addInstruction( OpCode op,
+                                 unsigned int a,
+                                 unsigned int b = 0,
+                                 double p0 = 0,
+                                 double p1 = 0,
+                                 const void* ptr = 0 );
+    unsigned int addProperty(const SGPropertyNode* node);
+
+    void run( unsigned int begin,
+              unsigned int end,
+              double* registers,
+              const simgear::expression::Binding* binding ) const;
+};
+
+typedef SGSharedPtr<SGExpressionProgram> SGExpressionProgramPtr;
+
+/**
+ * An expression evaluated by a program of its own instead of walking the
+ * tree, which is usually simplify()'d first.  Unlike SGExpressionProgram it
+ * keeps no state between evaluations and can be used anywhere a tree can.
+ * SGExpressionProgram compiles the wrapped tree again, so wrapping does not
+ * hide anything from a program the expression is added to.
+ */
+class SGCompiledExpression:
+  public SGExpression<double>
+{
+  public:
+    explicit SGCompiledExpression(const SGExpression<double>* expression);
+
+    virtual void eval( double& value,
+                       const simgear::expression::Binding* binding ) const;
+
+    virtual bool isConst() const
+    { return getExpression()->isConst(); }
+
+    virtual void
+    collectDependentProperties(std::set<const SGPropertyNode*>& props) const
+    { getExpression()->collectDependentProperties(props); }
+
+    const SGExpression<double>* getExpression() const
+    { return _program->getExpression(0); }
+
+  protected:
+    SGExpressionProgramPtr _program;
+};
+
+#endif /* SG_EXPRESSION_PROGRAM_HXX_ */
@@ -0,0 +1,245 @@
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <simgear/compiler.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/props/props.hxx>
+#include <simgear/props/props_io.hxx>
+#include <simgear/structure/SGExpressionProgram.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using namespace std;
+using namespace simgear;
+
+const int numProperties = 500;
+const int numExpressions = 5000;
+
+class FlagCondition : public SGCondition
+{
+public:
+  FlagCondition(const SGPropertyNode* flag) : _flag(flag)
+  { }
+  virtual bool test() const
+  { return _flag->getBoolValue(); }
+private:
+  SGConstPropertyNode_ptr _flag;
+};
+
+// Not known to the program, which has to evaluate it as a tree
+class TwiceExpression : public SGUnaryExpression<double>
+{
+public:
+  TwiceExpression(SGExpression<double>* expr)
+    : SGUnaryExpression<double>(expr)
+  { }
+  virtual void eval(double& value, const expression::Binding* b) const
+  { value = 2 * getOperand()->getValue(b); }
+};
+
+SGPropertyNode* input(SGPropertyNode* root, int i)
+{
+  return root->getNode("controls/input", i % numProperties, true);
+}
+
+// The shapes read_value() and friends give animations
+SGExpression<double>* animationExpression(SGPropertyNode* root, int i)
+{
+  SGExpression<double>* value =
+    new SGPropertyExpression<double>(input(root, i));
+
+  switch( i % 8 )
+  {
+    case 0:
+    case 1:
+    case 2:
+      value = new SGScaleExpression<double>(value, 0.5 + i % 7);
+      value = new SGBiasExpression<double>(value, -1.5);
+      return new SGClipExpression<double>(value, -10, 10);
+    case 3:
+    {
+      SGInterpTable* table = new SGInterpTable;
+      table->addEntry(-1, 0);
+      table->addEntry(0, 15);
+      table->addEntry(2, 90 + i % 10);
+      return new SGInterpTableExpression<double>(value, table);
+    }
+    case 4:
+      value = new SGBiasExpression<double>(value, 0.25);
+      value = new SGStepExpression<double>(value, 0.1, 0.05);
+      return new SGScaleExpression<double>(value, 36);
+    case 5:
+    {
+      SGExpression<double>* other =
+        new SGPropertyExpression<double>(input(root, i + 1));
+      value = new SGSumExpression<double>(value, other);
+      value = new SGProductExpression<double>
+      (
+        value,
+        new SGSinExpression<double>(new SGConstExpression<double>(0.5))
+      );
+      return new SGMaxExpression<double>
+      (
+        value,
+        new SGAbsExpression<double>(other)
+      );
+    }
+    case 6:
+      value = new SGDivExpression<double>
+      (
+        new SGAtan2Expression<double>(value, new SGConstExpression<double>(2)),
+        new SGConstExpression<double>(3)
+      );
+      return new SGSqrExpression<double>(value);
+    default:
+      // rare in practice: conditional and unknown parts
+      if( i % 16 == 7 )
+        return new SGEnableExpression<double>
+        (
+          value,
+          new FlagCondition(root->getNode("controls/enable", true)),
+          -1
+        );
+      return new SGBiasExpression<double>(new TwiceExpression(value), 1);
+  }
+}
+
+void changeInputs(SGPropertyNode* root, int frame, int count)
+{
+  for(int i = 0; i < count; ++i)
+  {
+    int n = (frame * 7919 + i * 104729) % numProperties;
+    input(root, n)->setDoubleValue(((frame + i) % 41) / 10.0 - 2);
+  }
+}
+
+void testProgram()
+{
+  SGPropertyNode_ptr root = new SGPropertyNode;
+  changeInputs(root, 0, numProperties);
+
+  std::vector<SGSharedPtr<SGExpression<double> > > expressions;
+  SGExpressionProgram program;
+  for(int i = 0; i < numExpressions; ++i)
+  {
+    expressions.push_back(animationExpression(root, i));
+    COMPARE(program.addExpression(expressions.back()), unsigned(i));
+  }
+
+  const SGExpressionProgram::Stats& stats = program.getStats();
+  COMPARE(stats.expressions, unsigned(numExpressions));
+  COMPARE(stats.properties, unsigned(numProperties));
+  COMPARE(stats.volatiles, unsigned(numExpressions / 8));
+
+  const char* xml =
+    "<?xml version=\"1.0\"?>"
+    "<PropertyList>"
+      "<sqr>"
+        "<max>"
+          "<property>/controls/input[1]</property>"
+          "<property>/controls/input[2]</property>"
+          "<value>0.5</value>"
+        "</max>"
+      "</sqr>"
+    "</PropertyList>";
+  SGPropertyNode_ptr desc = new SGPropertyNode;
+  readProperties(xml, strlen(xml), desc);
+  expressions.push_back(SGReadDoubleExpression(root, desc->getChild(0)));
+  program.addExpression(expressions.back());
+  COMPARE(program.addExpression(expressions[2]), 2u);
+  COMPARE(program.getExpression(2), expressions[2].get());
+
+  for(int frame = 0; frame < 20; ++frame)
+  {
+    changeInputs(root, frame, 10);
+    root->setBoolValue("controls/enable", frame % 3);
+    program.update();
+    for(size_t i = 0; i < expressions.size(); ++i)
+      COMPARE(program.getValue(i), expressions[i]->getValue());
+  }
+
+  // Without changes only volatile expressions are evaluated, and no value
+  // changes
+  unsigned long evaluated = stats.evaluated;
+  program.update();
+  COMPARE(stats.evaluated - evaluated, stats.volatiles);
+  for(size_t i = 0; i < expressions.size(); ++i)
+    VERIFY(!program.hasChanged(i));
+
+  input(root, 3)->setDoubleValue(1.75);
+  program.update();
+  VERIFY(program.hasChanged(3));
+  VERIFY(!program.hasChanged(4));
+  COMPARE(program.getValue(3), expressions[3]->getValue());
+}
+
+// Update cost of a large model, with a few inputs changing every frame
+void benchmark()
+{
+  SGPropertyNode_ptr root = new SGPropertyNode;
+  changeInputs(root, 0, numProperties);
+
+  std::vector<SGSharedPtr<SGExpression<double> > > expressions;
+  SGExpressionProgram program;
+  for(int i = 0; i < numExpressions; ++i)
+  {
+    expressions.push_back(animationExpression(root, i));
+    program.addExpression(expressions.back());
+  }
+
+  const int frames = 200;
+  const int changes[] = { 5, 50, numProperties };
+  for(int c = 0; c < 3; ++c)
+  {
+    // Both runs start from the same inputs
+    changeInputs(root, 0, numProperties);
+    double sum = 0;
+    SGTimeStamp start = SGTimeStamp::now();
+    for(int frame = 0; frame < frames; ++frame)
+    {
+      changeInputs(root, frame, changes[c]);
+      for(size_t i = 0; i < expressions.size(); ++i)
+        sum += expressions[i]->getValue();
+    }
+    double tree_msec = (SGTimeStamp::now() - start).toMSecs();
+
+    changeInputs(root, 0, numProperties);
+    double program_sum = 0;
+    start = SGTimeStamp::now();
+    for(int frame = 0; frame < frames; ++frame)
+    {
+      changeInputs(root, frame, changes[c]);
+      program.update();
+      for(size_t i = 0; i < expressions.size(); ++i)
+        program_sum += program.getValue(i);
+    }
+    double program_msec = (SGTimeStamp::now() - start).toMSecs();
+    COMPARE(sum, program_sum);
+
+    cout << numExpressions << " expressions, " << changes[c] << " of "
+         << numProperties << " properties changing: trees "
+         << tree_msec / frames << " msec/frame, program "
+         << program_msec / frames << " msec/frame" << endl;
+  }
+
+  const SGExpressionProgram::Stats& stats = program.getStats();
+  cout << stats.instructions << " instructions, "
+       << stats.properties << " properties, "
+       << stats.evaluated << " evaluated, "
+       << stats.skipped << " skipped" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  testProgram();
+  benchmark();
+
+  cout << __FILE__ << ": All tests passed" << endl;
+  return EXIT_SUCCESS;
+}
@@ -18,9 +18,11 @@
 #include <simgear/misc/test_macros.hxx>
 #include <simgear/structure/exception.hxx>
 #include <simgear/structure/SGExpression.hxx>
+#include <simgear/structure/SGExpressionProgram.hxx>
 #include <simgear/props/condition.hxx>
 #include <simgear/props/props.hxx>
 #include <simgear/props/props_io.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 using namespace std;    
 using namespace simgear;
@@ -97,12 +99,151 @@ void testParse()
     VERIFY(deps.find(propertyTree->getNode("group-b/thing-1")) != deps.end());
 }
 
+SGExpressiond* readExpression(const char* xml)
+{
+    SGPropertyNode_ptr desc = new SGPropertyNode;
+    readProperties(xml, strlen(xml), desc);
+    return SGReadDoubleExpression(propertyTree, desc->getChild(0));
+}
+
+// A gauge like expression, with constants left in by whoever wrote it
+const char* gaugeXml = "<?xml version=\"1.0\"?>"
+    "<PropertyList>"
+      "<sum>"
+        "<prod>"
+          "<property>/bench/x</property>"
+          "<value>0.5</value>"
+          "<value>4</value>"
+        "</prod>"
+        "<value>10</value>"
+        "<clip>"
+          "<clipMin>-50</clipMin>"
+          "<clipMax>50</clipMax>"
+          "<difference>"
+            "<property>/bench/y</property>"
+            "<value>3</value>"
+          "</difference>"
+        "</clip>"
+        "<sqr>"
+          "<max>"
+            "<property>/bench/x</property>"
+            "<value>1</value>"
+            "<value>0.5</value>"
+          "</max>"
+        "</sqr>"
+        "<sin>"
+          "<deg2rad>"
+            "<deg2rad>"
+              "<property>/bench/y</property>"
+            "</deg2rad>"
+          "</deg2rad>"
+        "</sin>"
+        "<value>-2</value>"
+      "</sum>"
+    "</PropertyList>";
+
+void testSimplify()
+{
+    initPropTree();
+    SGPropertyNode* x = propertyTree->getNode("bench/x", true);
+    SGPropertyNode* y = propertyTree->getNode("bench/y", true);
+    x->setDoubleValue(2);
+    y->setDoubleValue(99);
+
+    SGSharedPtr<SGExpressiond> tree = readExpression(gaugeXml);
+    SGSharedPtr<SGExpressiond> simplified = readExpression(gaugeXml);
+    simplified = simplified->simplify();
+
+    // constants of the sum and the product are combined, the max keeps
+    // the larger one, and the nested scales become one
+    SGSumExpression<double>* sum =
+        dynamic_cast<SGSumExpression<double>*>(simplified.get());
+    VERIFY(sum);
+    COMPARE(sum->getNumOperands(), 5);
+    VERIFY(sum->getOperand(4)->isConst());
+    COMPARE(sum->getOperand(4)->getValue(), 8);
+    SGProductExpression<double>* prod =
+        dynamic_cast<SGProductExpression<double>*>(sum->getOperand(0));
+    VERIFY(prod);
+    COMPARE(prod->getNumOperands(), 2);
+    COMPARE(prod->getOperand(1)->getValue(), 2);
+    SGSqrExpression<double>* sqr =
+        dynamic_cast<SGSqrExpression<double>*>(sum->getOperand(2));
+    VERIFY(sqr);
+    SGMaxExpression<double>* max =
+        dynamic_cast<SGMaxExpression<double>*>(sqr->getOperand());
+    VERIFY(max);
+    COMPARE(max->getNumOperands(), 2);
+    COMPARE(max->getOperand(1)->getValue(), 1);
+    SGSinExpression<double>* sin =
+        dynamic_cast<SGSinExpression<double>*>(sum->getOperand(3));
+    VERIFY(sin);
+    SGScaleExpression<double>* scale =
+        dynamic_cast<SGScaleExpression<double>*>(sin->getOperand());
+    VERIFY(scale);
+    VERIFY(dynamic_cast<SGPropertyExpression<double>*>(scale->getOperand()));
+
+    SGCompiledExpression compiled(simplified);
+    for (int i = -20; i < 20; ++i) {
+        x->setDoubleValue(i * 0.37);
+        y->setDoubleValue(i * 11.3);
+        COMPARE_EP2(simplified->getValue(), tree->getValue(), 1e-9);
+        COMPARE(compiled.getValue(), simplified->getValue());
+    }
+
+    // neutral elements disappear, and so do sums of a single operand
+    SGSharedPtr<SGExpressiond> single =
+        new SGSumExpression<double>(new SGPropertyExpression<double>(x),
+                                    new SGConstExpression<double>(0));
+    VERIFY(dynamic_cast<SGPropertyExpression<double>*>(single->simplify()));
+
+    SGSharedPtr<SGExpressiond> biases =
+        new SGBiasExpression<double>(
+            new SGBiasExpression<double>(new SGPropertyExpression<double>(x), 1),
+            -1);
+    VERIFY(dynamic_cast<SGPropertyExpression<double>*>(biases->simplify()));
+}
+
+// Tree evaluation compared to the simplified tree and compiled programs
+void benchmark()
+{
+    SGPropertyNode* x = propertyTree->getNode("bench/x", true);
+    SGPropertyNode* y = propertyTree->getNode("bench/y", true);
+
+    SGSharedPtr<SGExpressiond> tree = readExpression(gaugeXml);
+    SGSharedPtr<SGExpressiond> simplified = readExpression(gaugeXml);
+    simplified = simplified->simplify();
+    SGSharedPtr<SGExpressiond> compiled = new SGCompiledExpression(simplified);
+
+    const int count = 1000000;
+    const SGExpressiond* expressions[] = { tree, simplified, compiled };
+    const char* names[] = { "tree", "simplified tree", "compiled" };
+    double sums[3];
+    for (int e = 0; e < 3; ++e) {
+        sums[e] = 0;
+        SGTimeStamp start = SGTimeStamp::now();
+        for (int i = 0; i < count; ++i) {
+            if (i % 16 == 0) {
+                x->setDoubleValue((i % 1000) * 0.01);
+                y->setDoubleValue((i % 777) * 0.1);
+            }
+            sums[e] += expressions[e]->getValue();
+        }
+        double msec = (SGTimeStamp::now() - start).toMSecs();
+        cout << names[e] << ": " << msec * 1e6 / count << " nsec" << endl;
+    }
+    COMPARE_EP2(sums[1], sums[0], 1e-6 * fabs(sums[0]));
+    COMPARE(sums[2], sums[1]);
+}
+
 int main(int argc, char* argv[])
 {
     sglog().setLogLevels( SG_ALL, SG_INFO );
   
     testBasic();
     testParse();
+    testSimplify();
+    benchmark();
     
     cout << __FILE__ << ": All tests passed" << endl;
     return EXIT_SUCCESS;